@@ -0,0 +1,110 @@
+"""
+Scaling of Matrix.sum() and Matrix.mean() with the number of threads.
+
+Every summation mode is timed on 1 to N threads, and the speedup is given
+relative to 1 thread. The sum of every thread count is also compared with the
+one of 1 thread, as the partial sums are added in a different order.
+
+With --baseline, plain sum() and mean() are also timed on the same size in a
+second build of libpymath, e.g. one from before the sums were parallelised, and
+every row gives its speedup over that build as well. The baseline is imported
+in a subprocess from the given directory, which must contain the built
+libpymath package.
+
+Run with: python benchmarks/bench_sum.py [--size 4000] [--threads N] [--repeat 10] [--baseline DIR]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+from time import perf_counter
+
+import libpymath
+from libpymath.matrix import Matrix
+
+
+def _best(fn, repeat):
+    fn()
+    best = None
+
+    for _ in range(repeat):
+        start = perf_counter()
+        fn()
+        t = perf_counter() - start
+        best = t if best is None else min(best, t)
+
+    return best
+
+
+def _timePlain(size, repeat):
+    # Only uses calls that every build has
+    mat = Matrix(size, size, threads=1)
+    mat.fillRandom(-1, 1)
+    print(os.path.dirname(os.path.abspath(libpymath.__file__)))
+    print(_best(mat.sum, repeat), _best(mat.mean, repeat))
+
+
+def _timeBaseline(path, size, repeat):
+    env = dict(os.environ, PYTHONPATH=os.path.abspath(path))
+    out = subprocess.run([sys.executable, os.path.abspath(__file__), "--plain", "--size", str(size),
+                          "--repeat", str(repeat)], env=env, cwd=os.path.abspath(path), check=True,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout.split("\n")
+
+    if not out[0].startswith(os.path.abspath(path)):
+        raise RuntimeError("The baseline imported libpymath from {}, not from {}".format(out[0], path))
+
+    sumTime, meanTime = (float(t) for t in out[1].split())
+    return sumTime, meanTime
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--size", type=int, default=4000, help="Rows and columns of the matrix")
+    parser.add_argument("--threads", type=int, default=os.cpu_count(), help="Largest number of threads to time")
+    parser.add_argument("--repeat", type=int, default=10, help="Timings per measurement, the fastest is kept")
+    parser.add_argument("--baseline", help="Directory of another libpymath build to compare with")
+    parser.add_argument("--plain", action="store_true", help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.plain:
+        _timePlain(args.size, args.repeat)
+        return
+
+    mat = Matrix(args.size, args.size, threads=1)
+    mat.fillRandom(-1, 1)
+    gigabytes = args.size * args.size * 8 / 1e9
+
+    print("{0}x{0} float64, {1} cores".format(args.size, os.cpu_count()))
+
+    baseline = None
+    if args.baseline is not None:
+        baseline = _timeBaseline(args.baseline, args.size, args.repeat)
+        print("baseline {}: sum {:.2f} ms, mean {:.2f} ms, {:.1f} GB/s".format(
+            args.baseline, baseline[0] * 1e3, baseline[1] * 1e3, gigabytes / baseline[0]))
+
+    print("{:<9} {:>7} {:>10} {:>10} {:>8} {:>8} {:>8} {:>10}".format("mode", "threads", "sum ms", "mean ms", "GB/s",
+                                                                     "speedup", "vs base", "rel diff"))
+
+    for mode in ("fast", "pairwise", "kahan"):
+        serial = None
+        reference = None
+
+        for threads in range(1, args.threads + 1):
+            # The same values, summed with a different number of threads
+            m = Matrix._internal_new(mat.matrix, threads=threads)
+            sumTime = _best(lambda: m.sum(mode=mode), args.repeat)
+            meanTime = _best(lambda: m.mean(mode=mode), args.repeat)
+            total = m.sum(mode=mode)
+
+            if serial is None:
+                serial, reference = sumTime, total
+
+            print("{:<9} {:>7} {:>10.2f} {:>10.2f} {:>8.1f} {:>8.2f} {:>8} {:>10.1e}".format(
+                mode, threads, sumTime * 1e3, meanTime * 1e3, gigabytes / sumTime, serial / sumTime,
+                "-" if baseline is None else "{:.2f}".format(baseline[0] / sumTime),
+                abs(total - reference) / abs(reference)))
+
+
+if __name__ == "__main__":
+    main()
@@ -20,3 +20,4 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 """
 
 from .matrix import *
+from ._threadSetup import tuneGemmBlocking
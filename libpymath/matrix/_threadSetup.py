@@ -6,8 +6,38 @@ import libpymath.progress as _progress
 from time import time
 import math
 import shutil
+import ast
 
 LPM_CORES = os.cpu_count()
+_LPM_THREAD_INFO = "{}/_threadInfo.py".format(os.path.dirname(os.path.realpath(__file__)))
+
+
+# Read the values stored in _threadInfo.py, or an empty dict if it has not been written yet
+def _lpmReadThreadInfo():
+    info = {}
+
+    try:
+        with open(_LPM_THREAD_INFO, "r") as f:
+            lines = f.read().splitlines()
+    except FileNotFoundError:
+        return info
+
+    for line in lines:
+        if "=" in line:
+            name, value = line.split("=", 1)
+            try:
+                info[name.strip()] = ast.literal_eval(value.strip())
+            except (ValueError, SyntaxError):
+                pass
+
+    return info
+
+
+# Write every value to _threadInfo.py, replacing whatever was there
+def _lpmWriteThreadInfo(info):
+    with open(_LPM_THREAD_INFO, "w") as f:
+        for name, value in info.items():
+            f.write("{} = {!r}\n".format(name, value))
 
 # Find the optimal number of threads to use
 def _lpmFindOptimalMatrixThreads(matSize=1000, n=1000, verbose=False):
@@ -49,20 +79,92 @@ def _lpmFindOptimalMatrixThreads(matSize=1000, n=1000, verbose=False):
 
     return fastThreads
 
-write = False
-try:
-    with open("{}/_threadInfo.py".format(os.path.dirname(os.path.realpath(__file__))), "r") as f:
-        if f.read() == "UNINITIALIZED":
-            write = True
-except FileNotFoundError:
-    write = True
+def tuneGemmBlocking(matSize=800, n=3, threads=None, persist=True, verbose=False):
+    """
+    Time matrix products over a small sweep of GEMM block sizes around the ones
+    derived from the cache sizes, and use the fastest.
+
+    The cache model gets close on most machines, but can be off on virtual machines
+    that report the host's caches, or on processors with an unusual cache layout.
+
+    :param matSize: The size of the square matrices to multiply
+    :param n: The number of products to time for each block size
+    :param threads: The number of threads to use. Defaults to LPM_OPTIMAL_MATRIX_THREADS
+    :param persist: Store the result so it is used every time libpymath is imported
+    :param verbose: Print the time taken for each block size
+    :return: The (mc, kc, nc) block sizes chosen
+    """
+
+    if threads is None:
+        threads = _lpmReadThreadInfo().get("LPM_OPTIMAL_MATRIX_THREADS", LPM_CORES)
+
+    # Start from the cache model, then try smaller and larger blocks
+    _matrix.setGemmBlocking()
+    mc, kc, nc = _matrix.gemmBlocking()
+
+    mat = _matrix.Matrix(matSize, matSize)
+    mat.matrixFillRandom(-1, 1, threads)
+
+    fastTime = None
+    fastBlocking = (mc, kc, nc)
+
+    for kcScale in (0.5, 0.75, 1, 1.5):
+        for mcScale in (0.5, 1, 2):
+            _matrix.setGemmBlocking(int(mc * mcScale), int(kc * kcScale), nc)
+            blocking = _matrix.gemmBlocking()
+
+            # Warm up once so the first timing does not include page faults
+            mat.matrixProduct(mat, threads)
+
+            dt = 99999999999999
+            for _ in range(n):
+                start = time()
+                mat.matrixProduct(mat, threads)
+                dt = min(dt, time() - start)
+
+            if verbose:
+                print("mc={:<5} kc={:<5} nc={:<6} {:.2f} GFLOP/s".format(*blocking, 2 * matSize ** 3 / dt * 1e-9))
+
+            if fastTime is None or dt < fastTime:
+                fastTime = dt
+                fastBlocking = blocking
+
+    _matrix.setGemmBlocking(*fastBlocking)
+
+    # The packed path got faster or slower, so the small kernels may now win over a different range
+    crossover = _matrix.measureGemmCrossover()
+
+    if persist:
+        info = _lpmReadThreadInfo()
+        info.setdefault("LPM_GEMM_BLOCKING", {})[_matrix.gemmKernel()] = tuple(fastBlocking)
+        info.setdefault("LPM_GEMM_SMALL_CROSSOVER", {})[_matrix.gemmKernel()] = crossover
+        _lpmWriteThreadInfo(info)
+
+    return tuple(fastBlocking)
+
+
+_lpmInfo = _lpmReadThreadInfo()
 
 # If running in idle don't use verbose output. It takes *FOREVER* due to the printing speed
 verbose = "idlelib.run" not in sys.modules
 
-if write:
+if "LPM_OPTIMAL_MATRIX_THREADS" not in _lpmInfo:
     LPM_OPTIMAL_MATRIX_THREADS = _lpmFindOptimalMatrixThreads(matSize=2000, n=25, verbose=verbose)
 
-    with open("{}/_threadInfo.py".format(os.path.dirname(os.path.realpath(__file__))), "w") as f:
-        f.write("LPM_CORES = {}\n".format(LPM_CORES))
-        f.write("LPM_OPTIMAL_MATRIX_THREADS = {}\n".format(LPM_OPTIMAL_MATRIX_THREADS))
+    _lpmInfo["LPM_CORES"] = LPM_CORES
+    _lpmInfo["LPM_OPTIMAL_MATRIX_THREADS"] = LPM_OPTIMAL_MATRIX_THREADS
+    _lpmWriteThreadInfo(_lpmInfo)
+
+# The GEMM measurements are stored per kernel, as {kernel name: value}, and only those of the kernel in use apply.
+# The others are kept, e.g. if the file was copied from a machine with another kernel
+_lpmKernel = _matrix.gemmKernel()
+
+if _lpmKernel in _lpmInfo.get("LPM_GEMM_BLOCKING", {}):
+    _matrix.setGemmBlocking(*_lpmInfo["LPM_GEMM_BLOCKING"][_lpmKernel])
+
+# Finding where the small kernels stop winning only takes a moment, so it is always done
+if _lpmKernel in _lpmInfo.get("LPM_GEMM_SMALL_CROSSOVER", {}):
+    _matrix.setGemmCrossover(_lpmInfo["LPM_GEMM_SMALL_CROSSOVER"][_lpmKernel])
+else:
+    _lpmInfo.setdefault("LPM_GEMM_SMALL_CROSSOVER", {})[_lpmKernel] = _matrix.measureGemmCrossover()
+    _lpmWriteThreadInfo(_lpmInfo)
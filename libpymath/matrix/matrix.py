@@ -10,7 +10,9 @@ except ImportError:
 import libpymath.core.matrix as _matrix
 
 __all__ = ["Matrix", "SCALAR", "ASCENDING", "DESCENDING", "RANDOM", "SIGMOID", "TANH", "RELU", "LEAKY_RELU",
-           "D_SIGMOID", "D_TANH", "D_RELU", "D_LEAKY_RELU"]
+           "EXP", "D_SIGMOID", "D_TANH", "D_RELU", "D_LEAKY_RELU", "addmm",
+           "dotBatched", "dotStridedBatched", "SparseMatrix", "DiagonalMatrix", "ScaledIdentity",
+           "PackedMatrix"]
 
 # Matrix fill options
 SCALAR = 1
@@ -23,6 +25,7 @@ SIGMOID = 1 << 5
 TANH = 1 << 6
 RELU = 1 << 7
 LEAKY_RELU = 1 << 8
+EXP = 1 << 9
 
 # Matrix map derivative options (shift 5 right for corresponding activation)
 D_SIGMOID = 1 << 10
@@ -30,6 +33,68 @@ D_TANH = 1 << 11
 D_RELU = 1 << 12
 D_LEAKY_RELU = 1 << 13
 
+# Activation codes understood by the fused product epilogue
+_EPILOGUE_ACTIVATIONS = {
+    None: 0,
+    SIGMOID: 1,
+    TANH: 2,
+    RELU: 3,
+    LEAKY_RELU: 4
+}
+
+# Datatypes a matrix can hold, and their codes in the C routines
+_DTYPES = {
+    "float64": 0,
+    "float32": 1
+}
+
+# Ways of summing the values of a matrix, and their codes in the C routines
+_SUM_MODES = {
+    "fast": 0,
+    "pairwise": 1,
+    "kahan": 2
+}
+
+# Accuracies of the SIGMOID and TANH maps, and their codes in the C routines
+_MAP_ACCURACIES = {
+    "full": 0,
+    "fast": 1
+}
+
+# Reductions along an axis of a matrix, and their codes in the C routines
+_REDUCE_SUM = 0
+_REDUCE_MEAN = 1
+_REDUCE_MIN = 2
+_REDUCE_MAX = 3
+_REDUCE_ARGMIN = 4
+_REDUCE_ARGMAX = 5
+
+# Kinds of packed matrix, and their codes in the C routines
+_PACKED_KINDS = {
+    "symmetric": 0,
+    "lower": 1,
+    "upper": 2
+}
+
+_PACKED_KIND_NAMES = {code: name for name, code in _PACKED_KINDS.items()}
+
+# Operations on the values of packed matrices
+_PACKED_ADD = 0
+_PACKED_SUB = 1
+_PACKED_MUL = 2
+_PACKED_DIV = 3
+
+
+def _epilogueArgs(bias, activation):
+    # Convert the bias and activation of a fused product into the arguments of the C routines
+    if bias is not None and not isinstance(bias, Matrix):
+        raise TypeError("Bias of a matrix product must be a Matrix")
+
+    if activation not in _EPILOGUE_ACTIVATIONS:
+        raise NotImplementedError("The activation {} cannot be fused into a matrix product".format(activation))
+
+    return (bias.matrix if bias is not None else None), _EPILOGUE_ACTIVATIONS[activation]
+
 
 # The Matrix class
 class Matrix:
@@ -49,7 +114,7 @@ class Matrix:
         :param cols: The columns of the matrix
         :param data: The data to fill the matrix with
         :param threads: The number of threads to use for matrix calculations
-        :param dtype: The datatype of the matrix. Defaults to "float64"
+        :param dtype: The datatype of the matrix, "float64" or "float32". Defaults to "float64"
         """
 
         self.__safe_for_unpickling__ = True
@@ -89,7 +154,7 @@ class Matrix:
             data = None
             dataDims = []
             threads = None
-            dtype = None
+            dtype = "float64"
 
             # Sanity check
             if len(kwargs) == 0:
@@ -114,9 +179,8 @@ class Matrix:
                 if isinstance(kwargs["dtype"], str):
                     dtype = kwargs["dtype"]
 
-                    # TODO: Add different datatypes
-                    if dtype != "float64":
-                        raise NotImplementedError("Matrix currently only supports \"float64\" as datatype. {} is invalid".format(dtype))
+                    if dtype not in _DTYPES:
+                        raise NotImplementedError("Matrix supports the datatypes {}. {} is invalid".format(", ".join(_DTYPES), dtype))
                 else:
                     raise TypeError("Datatype must be a string, not {}".format(type(kwargs["dtype"])))
 
@@ -221,15 +285,15 @@ class Matrix:
             # Construct the matrix
             if data is not None:
                 if len(dataDims) == 1:
-                    self.matrix = _matrix.matrixFromData1D(data, rows, cols)
+                    self.matrix = _matrix.matrixFromData1D(data, rows, cols, _DTYPES[dtype])
                 else:
-                    self.matrix = _matrix.matrixFromData2D(data, dataDims[0], dataDims[1])
+                    self.matrix = _matrix.matrixFromData2D(data, dataDims[0], dataDims[1], _DTYPES[dtype])
 
                     # reshape
                     if rows != dataDims[0] or cols != dataDims[1]:
                         self.matrix.matrixReshape(rows, cols)
             else:
-                self.matrix = _matrix.Matrix(rows, cols)
+                self.matrix = _matrix.Matrix(rows, cols, _DTYPES[dtype])
             self._threads = threads
             self._dtype = dtype
 
@@ -308,6 +372,7 @@ class Matrix:
         # Create result
         res = Matrix(self.rows, self.cols, internal_new=True)
         res.matrix = self.matrix.transpose()
+        res._dtype = self._dtype
         return res
 
     @property
@@ -321,20 +386,210 @@ class Matrix:
         # Create result
         res = Matrix(self.rows, self.cols, internal_new=True)
         res.matrix = self.matrix.transpose()
+        res._dtype = self._dtype
         return res
 
-    def dot(self, other):
+    def dot(self, other, transA=False, transB=False, out=None, alpha=1.0, beta=1.0, bias=None, activation=None,
+            strassen=None):
         """
         Compute the matrix-matrix product with another matrix
 
-        :param other: Matrix to compute matrix product with
-        :return: Result of matrix product calculation
+        Transposing an operand with transA or transB does not copy it, so
+        a.dot(b, transB=True) is faster than a @ b.T
+
+        If out is given, the result is accumulated into it in place as
+        out = alpha * self @ other + beta * out, and no new matrix is created.
+        beta defaults to 1, as for addmm, so pass beta=0 to overwrite out.
+
+        A bias and an activation are applied to each block of the result while
+        it is still in cache, so a.dot(b, bias=c, activation=RELU) gives the
+        same result as (a @ b + c).map(RELU) without the two extra passes.
+
+        Very large products can use the Strassen-Winograd algorithm, which
+        saves up to 1/8 of the work for every halving of the matrices until
+        they fall below a cutoff. It is less accurate: the error is bounded
+        relative to max|a| * max|b| rather than elementwise, and the bound
+        grows about 4.5 times per halving. By default it is only used when
+        every dimension is at least the automatic size set with
+        libpymath.core.matrix.setGemmStrassen(cutoff, autoSize).
+
+        If this matrix was quantized with Matrix.quantize(), the product is
+        computed in int8 unless transA is set or out is given.
+
+        other may also be a SparseMatrix, in which case only its non-zero values
+        are read. out and strassen are not supported for sparse products.
+
+        other may also be a PackedMatrix, whose stored triangle is read directly.
+        out and strassen are not supported for packed products.
+
+        If other is a DiagonalMatrix, the columns of this matrix are scaled by
+        its diagonal values instead. out, bias and activation are not supported.
+
+        :param other: Matrix, SparseMatrix, DiagonalMatrix or PackedMatrix to compute matrix product with
+        :param transA: Use the transpose of this matrix
+        :param transB: Use the transpose of the other matrix
+        :param out: Matrix to accumulate the result into
+        :param alpha: Scale factor for the product
+        :param beta: Scale factor for the existing values of out. Ignored if out is None
+        :param bias: Matrix added to the product. May be a single column or row, which is added to every column or row
+        :param activation: SIGMOID, TANH, RELU or LEAKY_RELU, applied after the bias
+        :param strassen: True to use Strassen-Winograd whenever the product is above the cutoff, False to never use it
+        :return: Result of matrix product calculation (out, if it was given)
         """
 
-        if isinstance(other, Matrix) and self.matrix.cols == other.matrix.rows:
-            return Matrix._internal_new(self.matrix.matrixProduct(other.matrix, self.threads), self._dtype, self.threads)
-        else:
-            raise TypeError("Invalid matrix size for matrix product")
+        if isinstance(other, SparseMatrix):
+            if out is not None:
+                raise NotImplementedError("The product with a SparseMatrix cannot be accumulated into out")
+
+            if transB:
+                other = other.T
+
+            inner = self.matrix.rows if transA else self.matrix.cols
+
+            if inner == other.rows:
+                biasMatrix, activationCode = _epilogueArgs(bias, activation)
+                return Matrix._internal_new(other.matrix.sparseProductLeft(self.matrix, self.threads, transA, alpha,
+                                                                           biasMatrix, activationCode),
+                                            "float64", self.threads)
+
+        if isinstance(other, PackedMatrix):
+            if out is not None:
+                raise NotImplementedError("The product with a PackedMatrix cannot be accumulated into out")
+
+            if transB:
+                other = other.T
+
+            if (self.matrix.rows if transA else self.matrix.cols) == other.rows:
+                biasMatrix, activationCode = _epilogueArgs(bias, activation)
+                return Matrix._internal_new(other.matrix.packedProductLeft(self.matrix, self.threads, transA, alpha,
+                                                                           biasMatrix, activationCode),
+                                            "float64", self.threads)
+
+        if isinstance(other, DiagonalMatrix):
+            if out is not None or bias is not None or activation is not None:
+                raise NotImplementedError("The product with a DiagonalMatrix does not support out, bias or activation")
+
+            if (self.matrix.rows if transA else self.matrix.cols) == other.rows:
+                return Matrix._internal_new(self.matrix.matrixScaleDiagonal(other._values.matrix, True, alpha,
+                                                                            self.threads, transA),
+                                            self._dtype, self.threads)
+
+        if isinstance(other, Matrix):
+            inner = self.matrix.rows if transA else self.matrix.cols
+            otherInner = other.matrix.cols if transB else other.matrix.rows
+
+            if inner == otherInner:
+                if out is not None:
+                    return addmm(out, self, other, alpha, beta, transA, transB, bias, activation)
+
+                biasMatrix, activationCode = _epilogueArgs(bias, activation)
+                return Matrix._internal_new(self.matrix.matrixProduct(other.matrix, self.threads, transA, transB, alpha,
+                                                                      biasMatrix, activationCode,
+                                                                      -1 if strassen is None else int(bool(strassen))),
+                                            self._dtype, self.threads)
+
+        raise TypeError("Invalid matrix size for matrix product")
+
+    def addOuter(self, x, y, alpha=1.0):
+        """
+        Add alpha * x @ y.T to the matrix in place, where x and y are vectors.
+
+        This is the rank 1 update used for single sample weight updates. Unlike
+        self += alpha * (x @ y.T) it does not create any temporary matrices.
+
+        :param x: Vector with as many elements as the matrix has rows
+        :param y: Vector with as many elements as the matrix has columns
+        :param alpha: Scale factor for the outer product
+        :return: None
+        """
+
+        if not isinstance(x, Matrix) or not isinstance(y, Matrix):
+            raise TypeError("Outer product requires two Matrix objects")
+
+        self.matrix.matrixAddOuter(x.matrix, y.matrix, alpha, self.threads)
+
+    def gram(self):
+        """
+        Compute the Gram matrix self.T @ self of the columns of the matrix.
+
+        The result is symmetric, so only one triangle is computed and the
+        other is copied from it. This takes about half the time of
+        self.T @ self and does not transpose the matrix first.
+
+        :return: Symmetric matrix with as many rows and columns as the matrix has columns
+        """
+
+        return Matrix._internal_new(self.matrix.matrixGram(self.threads, False), self._dtype, self.threads)
+
+    def outerGram(self):
+        """
+        Compute the Gram matrix self @ self.T of the rows of the matrix, such
+        as the covariance of a matrix of centred samples. See Matrix.gram()
+
+        :return: Symmetric matrix with as many rows and columns as the matrix has rows
+        """
+
+        return Matrix._internal_new(self.matrix.matrixGram(self.threads, True), self._dtype, self.threads)
+
+    def prepack(self):
+        """
+        Keep a copy of the matrix in the packed layout used by matrix products,
+        so later products with this matrix on the left (self @ x or self.dot(x))
+        skip packing it. Worth it for a matrix reused in many large products,
+        such as the weights of a network during inference.
+
+        The packed copy is dropped as soon as the matrix is modified in place,
+        after which prepack has to be called again. Only "float64" matrices can
+        be prepacked.
+
+        :return: None
+        """
+
+        self.matrix.matrixPrepack()
+
+    @property
+    def prepacked(self):
+        """
+        :return: True if the matrix holds a packed copy made by Matrix.prepack()
+        """
+
+        return self.matrix.prepacked
+
+    def quantize(self):
+        """
+        Keep a copy of the matrix quantized to int8, with one scale per row, and
+        compute later products with this matrix on the left (self @ x or
+        self.dot(x)) from that copy. The other matrix is quantized to int8 with
+        one scale per column as part of each product, and the int8 values are
+        multiplied with exact int32 sums before being scaled back to float64.
+
+        This is faster and uses an eighth of the memory, at the cost of a small
+        error in the result, and is meant for the weights of a trained network.
+        The int8 copy is dropped as soon as the matrix is modified in place, or
+        by Matrix.dequantize(). Only "float64" matrices can be quantized.
+
+        :return: None
+        """
+
+        self.matrix.matrixQuantize()
+
+    def dequantize(self):
+        """
+        Drop the int8 copy made by Matrix.quantize(), so products use the
+        float64 values again
+
+        :return: None
+        """
+
+        self.matrix.matrixDequantize()
+
+    @property
+    def quantized(self):
+        """
+        :return: True if the matrix holds an int8 copy made by Matrix.quantize()
+        """
+
+        return self.matrix.quantized
 
     def __matmul__(self, other):
         """
@@ -346,21 +601,181 @@ class Matrix:
 
         return self.dot(other)
 
-    def sum(self):
-        return self.matrix.matrixSum()
+    def _reduce(self, op, axis):
+        """
+        Reduce the matrix along an axis with one of the C reductions
+
+        :param op: Reduction code
+        :param axis: 0 to reduce every column to a single value, or 1 to reduce every row
+        :return: Matrix of the results, 1 x cols for axis 0 and rows x 1 for axis 1
+        """
+
+        if axis not in (0, 1):
+            raise ValueError("Axis must be 0 (along the rows), 1 (along the columns) or None, not {}".format(axis))
+
+        dtype = "float64" if op in (_REDUCE_ARGMIN, _REDUCE_ARGMAX) else self.dtype
+        return Matrix._internal_new(self.matrix.matrixReduce(op, axis, self.threads), dtype=dtype,
+                                    threads=self.threads)
+
+    def sum(self, mode="fast", axis=None):
+        """
+        Calculate the sum of every value in the matrix. The matrix is split
+        between the threads, and each of them sums its part on its own.
+
+        mode chooses how the values are added up. "fast" keeps 16 running sums,
+        and its error grows with the number of values. "pairwise" adds blocks
+        of values in pairs, for an error that grows with the logarithm of the
+        number of values at almost the same speed, and "kahan" carries the
+        rounding error of every addition along, for an error that does not
+        grow at all, at about twice the cost. "float32" matrices are always
+        summed in double precision, so mode makes no difference to them.
+
+        If axis is 0, the sum of every column is returned as a 1 x cols matrix,
+        and if axis is 1, the sum of every row as a rows x 1 matrix. Sums along
+        an axis are always accumulated in double precision in the order the
+        values are stored, and mode is ignored.
+
+        :param mode: "fast", "pairwise" or "kahan". Defaults to "fast"
+        :param axis: None, 0 or 1. Defaults to None
+        :return: Sum of the values in the matrix, or a Matrix of sums along the axis
+        """
+
+        if mode not in _SUM_MODES:
+            raise ValueError("Summation mode must be one of {}, not {}".format(", ".join(_SUM_MODES), mode))
+
+        if axis is not None:
+            return self._reduce(_REDUCE_SUM, axis)
+
+        return self.matrix.matrixSum(self.threads, _SUM_MODES[mode])
+
+    def mean(self, mode="fast", axis=None):
+        """
+        Calculate the mean of every value in the matrix, or of every column
+        (axis 0) or row (axis 1) as a Matrix. See Matrix.sum()
+
+        :param mode: "fast", "pairwise" or "kahan". Defaults to "fast"
+        :param axis: None, 0 or 1. Defaults to None
+        :return: Mean of the values in the matrix, or a Matrix of means along the axis
+        """
+
+        if mode not in _SUM_MODES:
+            raise ValueError("Summation mode must be one of {}, not {}".format(", ".join(_SUM_MODES), mode))
+
+        if axis is not None:
+            return self._reduce(_REDUCE_MEAN, axis)
+
+        return self.matrix.matrixMean(self.threads, _SUM_MODES[mode])
+
+    def min(self, axis=None):
+        """
+        Find the smallest value in the matrix, or in every column (axis 0) or
+        row (axis 1) as a 1 x cols or rows x 1 Matrix
+
+        Like in NumPy, the result is NaN wherever a NaN is among the values
+
+        :param axis: None, 0 or 1. Defaults to None
+        :return: Smallest value, or a Matrix of the smallest values along the axis
+        """
+
+        if axis is not None:
+            return self._reduce(_REDUCE_MIN, axis)
+
+        rows = self.matrix.matrixReduce(_REDUCE_MIN, 1, self.threads)
+        return rows.matrixReduce(_REDUCE_MIN, 0, self.threads).get(0, 0)
+
+    def max(self, axis=None):
+        """
+        Find the largest value in the matrix, or in every column (axis 0) or
+        row (axis 1) as a 1 x cols or rows x 1 Matrix
+
+        Like in NumPy, the result is NaN wherever a NaN is among the values
+
+        :param axis: None, 0 or 1. Defaults to None
+        :return: Largest value, or a Matrix of the largest values along the axis
+        """
+
+        if axis is not None:
+            return self._reduce(_REDUCE_MAX, axis)
+
+        rows = self.matrix.matrixReduce(_REDUCE_MAX, 1, self.threads)
+        return rows.matrixReduce(_REDUCE_MAX, 0, self.threads).get(0, 0)
+
+    def _argExtreme(self, op, extreme, axis):
+        """
+        Find the index of the first smallest or largest value in the matrix
+
+        :param op: _REDUCE_ARGMIN or _REDUCE_ARGMAX
+        :param extreme: _REDUCE_MIN or _REDUCE_MAX
+        :param axis: None, 0 or 1
+        :return: (row, column) of the value, or a Matrix of indices along the axis
+        """
+
+        if axis is not None:
+            return self._reduce(op, axis)
+
+        # The first row holding the extreme value, then the first column of it within that row
+        values = self.matrix.matrixReduce(extreme, 1, self.threads)
+        row = int(values.matrixReduce(op, 0, self.threads).get(0, 0))
+        cols = self.matrix.matrixReduce(op, 1, self.threads)
+        return row, int(cols.get(row, 0))
+
+    def argmin(self, axis=None):
+        """
+        Find the index of the first smallest value in the matrix, counting row
+        by row, or of the first smallest value in every column (axis 0) or row
+        (axis 1). Indices along an axis are returned as a "float64" Matrix
+
+        Like in NumPy, the index of the first NaN is returned wherever a NaN is
+        among the values
+
+        :param axis: None, 0 or 1. Defaults to None
+        :return: (row, column) tuple, or a Matrix of row (axis 0) or column (axis 1) indices
+        """
+
+        return self._argExtreme(_REDUCE_ARGMIN, _REDUCE_MIN, axis)
+
+    def argmax(self, axis=None):
+        """
+        Find the index of the first largest value in the matrix, counting row
+        by row, or of the first largest value in every column (axis 0) or row
+        (axis 1). Indices along an axis are returned as a "float64" Matrix
+
+        Like in NumPy, the index of the first NaN is returned wherever a NaN is
+        among the values
+
+        :param axis: None, 0 or 1. Defaults to None
+        :return: (row, column) tuple, or a Matrix of row (axis 0) or column (axis 1) indices
+        """
+
+        return self._argExtreme(_REDUCE_ARGMAX, _REDUCE_MAX, axis)
+
+    def _broadcastable(self, other):
+        """
+        Check whether other can be combined elementwise with this matrix. Each
+        dimension must either match, or be 1 in one of the matrices, in which
+        case the single row or column is applied to every row or column of the
+        other matrix, like in NumPy. The C routines read a broadcast row or
+        column again for every row or column, and never expand it
+
+        :param other: Matrix
+        :return: True if the shapes are compatible
+        """
 
-    def mean(self):
-        return self.matrix.matrixMean()
+        return ((self.matrix.rows == other.matrix.rows or self.matrix.rows == 1 or other.matrix.rows == 1) and
+                (self.matrix.cols == other.matrix.cols or self.matrix.cols == 1 or other.matrix.cols == 1))
 
     def __add__(self, other):
         """
-        Add a matrix to another matrix elementwise, or add a scalar to every value
+        Add a matrix to another matrix elementwise, or add a scalar to every value.
+        A 1 x cols or rows x 1 matrix is broadcast, see Matrix._broadcastable()
 
         :param other: Matrix or scalar
         :return: Result of addition
         """
 
-        if isinstance(other, Matrix) and self.matrix.rows == other.matrix.rows and self.matrix.cols == other.matrix.cols:
+        if isinstance(other, (DiagonalMatrix, PackedMatrix)):
+            return NotImplemented
+        elif isinstance(other, Matrix) and self._broadcastable(other):
             return Matrix._internal_new(self.matrix.matrixAddMatrixReturn(other.matrix, self.threads), self._dtype, self.threads)
         elif isinstance(other, (int, float)):
             return Matrix._internal_new(self.matrix.matrixAddScalarReturn(other, self.threads), self._dtype, self.threads)
@@ -369,13 +784,16 @@ class Matrix:
 
     def __sub__(self, other):
         """
-        Subtract a matrix from another matrix elementwise, or subtract a scalar from every value
+        Subtract a matrix from another matrix elementwise, or subtract a scalar from every value.
+        A 1 x cols or rows x 1 matrix is broadcast, see Matrix._broadcastable()
 
         :param other: Matrix or scalar
         :return: Result of subtraction
         """
 
-        if isinstance(other, Matrix) and self.matrix.rows == other.matrix.rows and self.matrix.cols == other.matrix.cols:
+        if isinstance(other, (DiagonalMatrix, PackedMatrix)):
+            return NotImplemented
+        elif isinstance(other, Matrix) and self._broadcastable(other):
             return Matrix._internal_new(self.matrix.matrixSubMatrixReturn(other.matrix, self.threads), self._dtype, self.threads)
         elif isinstance(other, (int, float)):
             return Matrix._internal_new(self.matrix.matrixSubScalarReturn(other, self.threads), self._dtype, self.threads)
@@ -384,13 +802,16 @@ class Matrix:
 
     def __mul__(self, other):
         """
-        Multiply a matrix by another matrix elementwise, or multiply every value by a scalar
+        Multiply a matrix by another matrix elementwise, or multiply every value by a scalar.
+        A 1 x cols or rows x 1 matrix is broadcast, see Matrix._broadcastable()
 
         :param other: Matrix or scalar
         :return: Result of multiplication
         """
 
-        if isinstance(other, Matrix) and self.matrix.rows == other.matrix.rows and self.matrix.cols == other.matrix.cols:
+        if isinstance(other, (DiagonalMatrix, PackedMatrix)):
+            return NotImplemented
+        elif isinstance(other, Matrix) and self._broadcastable(other):
             return Matrix._internal_new(self.matrix.matrixMulMatrixReturn(other.matrix, self.threads), self._dtype, self.threads)
         elif isinstance(other, (int, float)):
             return Matrix._internal_new(self.matrix.matrixMulScalarReturn(other, self.threads), self._dtype, self.threads)
@@ -399,13 +820,14 @@ class Matrix:
 
     def __truediv__(self, other):
         """
-        Divide a matrix by another matrix elementwise, or divide every value by a scalar
+        Divide a matrix by another matrix elementwise, or divide every value by a scalar.
+        A 1 x cols or rows x 1 matrix is broadcast, see Matrix._broadcastable()
 
         :param other: Matrix or scalar
         :return: Result of division
         """
 
-        if isinstance(other, Matrix) and self.matrix.rows == other.matrix.rows and self.matrix.cols == other.matrix.cols:
+        if isinstance(other, Matrix) and self._broadcastable(other):
             return Matrix._internal_new(self.matrix.matrixDivMatrixReturn(other.matrix, self.threads), self._dtype, self.threads)
         elif isinstance(other, (int, float)):
             return Matrix._internal_new(self.matrix.matrixDivScalarReturn(other, self.threads), self._dtype, self.threads)
@@ -508,7 +930,7 @@ class Matrix:
         else:
             raise TypeError("Invalid fill type")
 
-    def map(self, mapType):
+    def map(self, mapType, accuracy="full"):
         """
         Apply a function to every element of the matrix.
 
@@ -517,20 +939,38 @@ class Matrix:
         TANH
         RELU
         LEAKY_RELU
+        EXP
 
         D_SIGMOID
         D_TANH
         D_RELU
         D_LEAKY_RELU
 
+        SIGMOID, TANH and EXP are evaluated with vectorised approximations.
+        With accuracy="full" EXP is within 1 unit in the last place (ULP) of
+        the exact result, and SIGMOID and TANH within 2 ULP, like the C
+        library. accuracy="fast" rounds the values to single precision for
+        SIGMOID and TANH, and is within 2 single precision ULP of the result
+        for the rounded value at 1.5 to 3 times the speed, which is plenty for
+        the activations of a network. Results below the single precision
+        range, such as the SIGMOID of values below about -103, are 0. EXP
+        keeps double precision in both modes, with a relative error below
+        1e-8 for accuracy="fast".
+
         :param mapType: Function to map with
+        :param accuracy: "full" or "fast". Defaults to "full"
         :return: None
         """
 
+        if accuracy not in _MAP_ACCURACIES:
+            raise ValueError("Accuracy must be one of {}, not {}".format(", ".join(_MAP_ACCURACIES), accuracy))
+
         if mapType == SIGMOID:
-            self.matrix.matrixMapSigmoid()
+            self.matrix.matrixMapSigmoid(self.threads, _MAP_ACCURACIES[accuracy])
         elif mapType == TANH:
-            self.matrix.matrixMapTanh()
+            self.matrix.matrixMapTanh(self.threads, _MAP_ACCURACIES[accuracy])
+        elif mapType == EXP:
+            self.matrix.matrixMapExp(self.threads, _MAP_ACCURACIES[accuracy])
         elif mapType == RELU:
             self.matrix.matrixMapRELU()
         elif mapType == LEAKY_RELU:
@@ -546,16 +986,17 @@ class Matrix:
         else:
             raise TypeError("Invalid mapping type")
 
-    def mapped(self, mapType):
+    def mapped(self, mapType, accuracy="full"):
         """
         See Matrix.map()
 
         :param mapType: Function to map with
+        :param accuracy: "full" or "fast". Defaults to "full"
         :return: Mapped matrix
         """
 
         res = self.copy()
-        res.map(mapType)
+        res.map(mapType, accuracy)
         return res
 
     def fillScalar(self, x):
@@ -774,3 +1215,973 @@ class Matrix:
         res._threads = self._threads
 
         return res
+
+    def astype(self, dtype):
+        """
+        Return a copy of the matrix holding values of another datatype. Converting
+        to "float32" rounds every value to the nearest single precision float, which
+        halves the memory used by the matrix and roughly doubles the speed of its
+        products. Converting back to "float64" is exact.
+
+        :param dtype: The datatype of the result, "float64" or "float32"
+        :return: Converted matrix
+        """
+
+        if dtype not in _DTYPES:
+            raise NotImplementedError("Matrix supports the datatypes {}. {} is invalid".format(", ".join(_DTYPES), dtype))
+
+        return Matrix._internal_new(self.matrix.matrixAsType(_DTYPES[dtype], self.threads), dtype, self.threads)
+
+
+class SparseMatrix:
+    def __init__(self, *args, threads=None):
+        """
+        Create a sparse matrix in compressed sparse row (CSR) format, which only
+        stores the non-zero values. Memory use and the cost of products grow with
+        the number of non-zero values instead of rows * cols, so matrices that are
+        mostly zeros are far cheaper to store and multiply than a dense Matrix.
+
+        A sparse matrix can be created from a dense Matrix, keeping its non-zero
+        values, or from the CSR arrays: row i holds values[p] in column
+        columns[p] for rowPointers[i] <= p < rowPointers[i + 1], with the columns
+        of every row in increasing order.
+
+        Sparse matrices hold "float64" values and cannot be changed once created.
+
+        SparseMatrix(matrix)
+        SparseMatrix(rows, cols, values, columns, rowPointers)
+
+        :param threads: The number of threads to use for products. Defaults to LPM_OPTIMAL_MATRIX_THREADS
+        """
+
+        self._threads = _threadInfo.LPM_OPTIMAL_MATRIX_THREADS if threads is None else threads
+
+        if len(args) == 1 and isinstance(args[0], Matrix):
+            if threads is None:
+                self._threads = args[0].threads
+
+            self.matrix = _matrix.sparseFromDense(args[0].matrix, self._threads)
+        elif len(args) == 5:
+            self.matrix = _matrix.SparseMatrix(*args)
+        else:
+            raise TypeError("SparseMatrix requires a Matrix, or rows, cols, values, columns and rowPointers")
+
+    @staticmethod
+    def _internal_new(matrix, threads=_threadInfo.LPM_OPTIMAL_MATRIX_THREADS):
+        """
+        FOR INTERNAL USE ONLY
+
+        Wrap a sparse matrix core object without going through __init__
+
+        :param matrix: Sparse matrix core object to use as the result's matrix
+        :param threads: Number of threads to use
+        :return: SparseMatrix object from supplied information
+        """
+
+        res = SparseMatrix.__new__(SparseMatrix)
+        res.matrix = matrix
+        res._threads = threads
+
+        return res
+
+    @property
+    def rows(self):
+        """
+        :return: Number of rows in the matrix
+        """
+
+        return self.matrix.rows
+
+    @property
+    def cols(self):
+        """
+        :return: Number of columns in the matrix
+        """
+
+        return self.matrix.cols
+
+    @property
+    def shape(self):
+        """
+        :return: A tuple containing the rows and columns of the matrix
+        """
+
+        return self.matrix.rows, self.matrix.cols
+
+    @property
+    def nnz(self):
+        """
+        :return: Number of non-zero values stored in the matrix
+        """
+
+        return self.matrix.nnz
+
+    @property
+    def density(self):
+        """
+        :return: Fraction of the values of the matrix that are stored
+        """
+
+        return self.matrix.nnz / max(1, self.matrix.rows * self.matrix.cols)
+
+    @property
+    def threads(self):
+        """
+        :return: Number of threads used for products
+        """
+
+        return self._threads
+
+    def transposed(self):
+        """
+        Return the transpose of the matrix. This copies the non-zero values into
+        the new row order, which takes O(nnz) time.
+
+        :return: Transposed sparse matrix
+        """
+
+        return SparseMatrix._internal_new(self.matrix.transpose(), self._threads)
+
+    @property
+    def T(self):
+        """
+        See SparseMatrix.transposed()
+
+        :return: Transposed sparse matrix
+        """
+
+        return self.transposed()
+
+    def dot(self, other, transB=False, alpha=1.0, bias=None, activation=None):
+        """
+        Compute the matrix product of this sparse matrix with a dense Matrix.
+        A single column is computed as a sparse matrix-vector product. Rows are
+        split between threads so that every thread gets the same number of
+        non-zero values.
+
+        :param other: Matrix to compute matrix product with
+        :param transB: Use the transpose of the other matrix
+        :param alpha: Scale factor for the product
+        :param bias: Matrix added to the product. May be a single column or row, which is added to every column or row
+        :param activation: SIGMOID, TANH, RELU or LEAKY_RELU, applied after the bias
+        :return: Dense Matrix holding the result
+        """
+
+        if isinstance(other, Matrix):
+            otherInner = other.matrix.cols if transB else other.matrix.rows
+
+            if self.matrix.cols == otherInner:
+                biasMatrix, activationCode = _epilogueArgs(bias, activation)
+                return Matrix._internal_new(self.matrix.sparseProduct(other.matrix, self.threads, transB, alpha,
+                                                                      biasMatrix, activationCode),
+                                            "float64", self.threads)
+
+            raise TypeError("Invalid matrix size for matrix product")
+
+        raise TypeError("A SparseMatrix can only be multiplied with a Matrix")
+
+    def __matmul__(self, other):
+        """
+        See SparseMatrix.dot()
+
+        :param other: Matrix to compute matrix product with
+        :return: Result of matrix product calculation
+        """
+
+        return self.dot(other)
+
+    def toDense(self):
+        """
+        Convert the sparse matrix to a dense Matrix
+
+        :return: Dense Matrix with zeros everywhere but at the stored values
+        """
+
+        return Matrix._internal_new(self.matrix.toDense(self.threads), "float64", self.threads)
+
+    def toLists(self):
+        """
+        :return: A tuple of the values, columns and row pointers of the matrix in CSR format
+        """
+
+        return self.matrix.toLists()
+
+    def toList(self):
+        """
+        Convert the sparse matrix into a dense 2d Python list
+
+        :return: 2d Python list
+        """
+
+        return self.toDense().toList()
+
+    def __str__(self):
+        """
+        :return: String showing the shape and number of non-zero values of the matrix
+        """
+
+        return "SparseMatrix(rows={}, cols={}, nnz={})".format(self.rows, self.cols, self.nnz)
+
+    def __repr__(self):
+        """
+        See SparseMatrix.__str__()
+
+        :return: String representation of the sparse matrix
+        """
+
+        return str(self)
+
+    def __reduce__(self):
+        """
+        For the pickle module
+
+        :return: Pickle-able object
+        """
+
+        return (
+            SparseMatrix,
+            (self.rows, self.cols) + self.toLists()
+        )
+
+
+class DiagonalMatrix:
+    def __init__(self, values, threads=None, dtype="float64"):
+        """
+        Create a square diagonal matrix from its diagonal values. Only the
+        diagonal is stored, and products, sums and elementwise products with a
+        dense Matrix scale its rows or columns or touch its diagonal, instead of
+        building the dense diagonal matrix and computing a full matrix product.
+
+        d @ a scales row i of a by the i-th diagonal value, and a @ d scales
+        column i. d + a and a - d only change the diagonal of a, and d * a only
+        reads it, so the result of an elementwise product is diagonal as well.
+
+        :param values: List of diagonal values, or a Matrix with a single row or column
+        :param threads: The number of threads to use for calculations. Defaults to LPM_OPTIMAL_MATRIX_THREADS
+        :param dtype: The datatype of the matrix, "float64" or "float32". Ignored if values is a Matrix
+        """
+
+        if isinstance(values, Matrix):
+            if values.rows != 1 and values.cols != 1:
+                raise ValueError("Diagonal values must be a Matrix with a single row or column")
+
+            self._values = values.copy() if values.cols == 1 else values.T
+            self._threads = values.threads if threads is None else threads
+        elif isinstance(values, (list, tuple)) and len(values) > 0:
+            self._threads = _threadInfo.LPM_OPTIMAL_MATRIX_THREADS if threads is None else threads
+            self._values = Matrix(len(values), 1, data=[[v] for v in values], dtype=dtype, threads=self._threads)
+        else:
+            raise TypeError("DiagonalMatrix requires a non-empty list of values or a vector Matrix")
+
+        self._n = self._values.rows
+
+    @staticmethod
+    def _internal_new(values, threads=_threadInfo.LPM_OPTIMAL_MATRIX_THREADS):
+        """
+        FOR INTERNAL USE ONLY
+
+        Wrap a column vector of diagonal values without going through __init__
+
+        :param values: Matrix with a single column holding the diagonal
+        :param threads: Number of threads to use
+        :return: DiagonalMatrix object from supplied information
+        """
+
+        res = DiagonalMatrix.__new__(DiagonalMatrix)
+        res._values = values
+        res._threads = threads
+        res._n = values.rows
+
+        return res
+
+    @property
+    def rows(self):
+        """
+        :return: Number of rows in the matrix
+        """
+
+        return self._n
+
+    @property
+    def cols(self):
+        """
+        :return: Number of columns in the matrix
+        """
+
+        return self._n
+
+    @property
+    def shape(self):
+        """
+        :return: A tuple containing the rows and columns of the matrix
+        """
+
+        return self._n, self._n
+
+    @property
+    def dtype(self):
+        """
+        :return: The datatype of the matrix
+        """
+
+        return self._values.dtype
+
+    @property
+    def threads(self):
+        """
+        :return: Number of threads used for calculations
+        """
+
+        return self._threads
+
+    @property
+    def diagonal(self):
+        """
+        :return: Column vector Matrix holding the diagonal values
+        """
+
+        return self._values.copy()
+
+    def transposed(self):
+        """
+        A diagonal matrix is its own transpose
+
+        :return: The matrix itself
+        """
+
+        return self
+
+    @property
+    def T(self):
+        """
+        See DiagonalMatrix.transposed()
+
+        :return: The matrix itself
+        """
+
+        return self
+
+    def _checkShape(self, other, operation):
+        # Structured operands must match exactly, as nothing is broadcast
+        if other.rows != self._n or other.cols != self._n:
+            raise TypeError("Invalid matrix size for matrix {}".format(operation))
+
+    def _scaled(self, other, alpha=1.0):
+        # Elementwise product of two diagonals, which is also their matrix product. The vector of whichever operand
+        # stores one is scaled by the other, which may be a single value
+        if isinstance(self, ScaledIdentity) and isinstance(other, ScaledIdentity):
+            return ScaledIdentity(self._n, self.scale * other.scale * alpha, self._threads, self.dtype)
+
+        vector, diag = (other, self) if isinstance(self, ScaledIdentity) else (self, other)
+        return DiagonalMatrix._internal_new(Matrix._internal_new(
+            vector._values.matrix.matrixScaleDiagonal(diag._values.matrix, False, alpha, self._threads),
+            self.dtype, self._threads), self._threads)
+
+    def dot(self, other, transB=False, alpha=1.0):
+        """
+        Compute the matrix product with a dense Matrix by scaling its rows by the
+        diagonal values, which takes a single pass over the other matrix. The
+        product of two diagonal matrices multiplies their diagonals.
+
+        :param other: Matrix or DiagonalMatrix to compute matrix product with
+        :param transB: Use the transpose of the other matrix
+        :param alpha: Scale factor for the product
+        :return: Result of matrix product calculation. Diagonal if other is diagonal
+        """
+
+        if isinstance(other, DiagonalMatrix):
+            self._checkShape(other, "product")
+            return self._scaled(other, alpha)
+
+        if isinstance(other, Matrix):
+            if (other.cols if transB else other.rows) != self._n:
+                raise TypeError("Invalid matrix size for matrix product")
+
+            return Matrix._internal_new(other.matrix.matrixScaleDiagonal(self._values.matrix, False, alpha,
+                                                                         self._threads, transB),
+                                        other.dtype, self._threads)
+
+        raise TypeError("A DiagonalMatrix can only be multiplied with a Matrix or a DiagonalMatrix")
+
+    def __matmul__(self, other):
+        """
+        See DiagonalMatrix.dot()
+
+        :param other: Matrix or DiagonalMatrix to compute matrix product with
+        :return: Result of matrix product calculation
+        """
+
+        return self.dot(other)
+
+    def _addDiagonal(self, other, alpha, beta, operation):
+        # beta * other + alpha * self, touching only the diagonal of a dense matrix
+        self._checkShape(other, operation)
+
+        if isinstance(other, DiagonalMatrix):
+            if isinstance(self, ScaledIdentity) and isinstance(other, ScaledIdentity):
+                return ScaledIdentity(self._n, alpha * self.scale + beta * other.scale, self._threads, self.dtype)
+
+            return DiagonalMatrix._internal_new(self.diagonal * alpha + other.diagonal * beta, self._threads)
+
+        return Matrix._internal_new(other.matrix.matrixAddDiagonal(self._values.matrix, alpha, beta, self._threads),
+                                    other.dtype, other.threads)
+
+    def __add__(self, other):
+        """
+        Add a Matrix or a DiagonalMatrix. Only the diagonal of a dense matrix
+        is changed, after it is copied into the result
+
+        :param other: Matrix or DiagonalMatrix
+        :return: Result of addition. Diagonal if other is diagonal
+        """
+
+        if isinstance(other, (Matrix, DiagonalMatrix)):
+            return self._addDiagonal(other, 1.0, 1.0, "addition")
+
+        return NotImplemented
+
+    def __radd__(self, other):
+        """
+        See DiagonalMatrix.__add__()
+
+        :param other: Matrix
+        :return: Result of addition
+        """
+
+        return self.__add__(other)
+
+    def __sub__(self, other):
+        """
+        Subtract a Matrix or a DiagonalMatrix
+
+        :param other: Matrix or DiagonalMatrix
+        :return: Result of subtraction. Diagonal if other is diagonal
+        """
+
+        if isinstance(other, (Matrix, DiagonalMatrix)):
+            return self._addDiagonal(other, 1.0, -1.0, "subtraction")
+
+        return NotImplemented
+
+    def __rsub__(self, other):
+        """
+        Subtract the diagonal matrix from a Matrix, which only changes its diagonal
+
+        :param other: Matrix
+        :return: Result of subtraction
+        """
+
+        if isinstance(other, Matrix):
+            return self._addDiagonal(other, -1.0, 1.0, "subtraction")
+
+        return NotImplemented
+
+    def __mul__(self, other):
+        """
+        Multiply by a Matrix or a DiagonalMatrix elementwise, which only reads
+        the diagonal of the other matrix, or multiply every value by a scalar
+
+        :param other: Matrix, DiagonalMatrix or scalar
+        :return: Diagonal result of multiplication
+        """
+
+        if isinstance(other, (int, float)):
+            return self._scaled(ScaledIdentity(self._n, other, self._threads, self.dtype))
+
+        if isinstance(other, Matrix):
+            self._checkShape(other, "multiplication")
+            return self._scaled(DiagonalMatrix._internal_new(
+                Matrix._internal_new(other.matrix.matrixDiagonal(), other.dtype, self._threads), self._threads))
+
+        if isinstance(other, DiagonalMatrix):
+            self._checkShape(other, "multiplication")
+            return self._scaled(other)
+
+        return NotImplemented
+
+    def __rmul__(self, other):
+        """
+        See DiagonalMatrix.__mul__()
+
+        :param other: Matrix or scalar
+        :return: Diagonal result of multiplication
+        """
+
+        return self.__mul__(other)
+
+    def toDense(self):
+        """
+        Convert the diagonal matrix to a dense Matrix
+
+        :return: Dense Matrix with zeros everywhere but on the diagonal
+        """
+
+        res = Matrix(self._n, self._n, dtype=self.dtype, threads=self._threads)
+        res.matrix = res.matrix.matrixAddDiagonal(self._values.matrix, 1.0, 0.0, self._threads)
+        return res
+
+    def toList(self):
+        """
+        Convert the diagonal matrix into a dense 2d Python list
+
+        :return: 2d Python list
+        """
+
+        return self.toDense().toList()
+
+    def __str__(self):
+        """
+        :return: String showing the size of the matrix
+        """
+
+        return "DiagonalMatrix(n={})".format(self._n)
+
+    def __repr__(self):
+        """
+        See DiagonalMatrix.__str__()
+
+        :return: String representation of the diagonal matrix
+        """
+
+        return str(self)
+
+
+class ScaledIdentity(DiagonalMatrix):
+    def __init__(self, n, scale=1.0, threads=None, dtype="float64"):
+        """
+        Create an n x n identity matrix multiplied by a scalar, which behaves as
+        a DiagonalMatrix but stores a single value. Products with a dense Matrix
+        scale every value, and sums only change its diagonal.
+
+        :param n: The rows and columns of the matrix
+        :param scale: The value of every element on the diagonal
+        :param threads: The number of threads to use for calculations. Defaults to LPM_OPTIMAL_MATRIX_THREADS
+        :param dtype: The datatype of the matrix, "float64" or "float32"
+        """
+
+        if not isinstance(n, int):
+            raise TypeError("Matrix rows must be an integer")
+        if n <= 0:
+            raise ValueError("Matrix must have positive dimensions")
+
+        super().__init__([float(scale)], threads, dtype)
+        self._n = n
+
+    @property
+    def scale(self):
+        """
+        :return: The value of every element on the diagonal
+        """
+
+        return self._values.toList()[0][0]
+
+    @property
+    def diagonal(self):
+        """
+        :return: Column vector Matrix holding the diagonal values
+        """
+
+        res = Matrix(self._n, 1, dtype=self.dtype, threads=self._threads)
+        res.fillScalar(self.scale)
+        return res
+
+    def __str__(self):
+        """
+        :return: String showing the size and the scale of the matrix
+        """
+
+        return "ScaledIdentity(n={}, scale={})".format(self._n, self.scale)
+
+
+class PackedMatrix:
+    def __init__(self, *args, kind="symmetric", threads=None):
+        """
+        Create a square symmetric or triangular matrix that only stores one
+        triangle, packed row by row into n * (n + 1) / 2 values. This halves the
+        memory used by matrices such as covariance and kernel matrices or
+        Cholesky factors, and products and elementwise operations read the
+        packed values directly, so they move half as much data as well.
+
+        kind is "symmetric", "lower" or "upper". A packed matrix can be created
+        from a square Matrix, of which only the triangle named by kind is read
+        (the lower one for symmetric matrices), or from the stored values of the
+        lower triangle, row by row. An upper triangular matrix is given by the
+        values of its transpose.
+
+        Packed matrices hold "float64" values and cannot be changed once created.
+
+        PackedMatrix(matrix, kind="symmetric")
+        PackedMatrix(n, values, kind="symmetric")
+
+        :param kind: "symmetric", "lower" or "upper". Defaults to "symmetric"
+        :param threads: The number of threads to use for calculations. Defaults to LPM_OPTIMAL_MATRIX_THREADS
+        """
+
+        if kind not in _PACKED_KINDS:
+            raise ValueError("Packed matrix kind must be one of {}, not {}".format(", ".join(_PACKED_KINDS), kind))
+
+        self._threads = _threadInfo.LPM_OPTIMAL_MATRIX_THREADS if threads is None else threads
+
+        if len(args) == 1 and isinstance(args[0], Matrix):
+            if threads is None:
+                self._threads = args[0].threads
+
+            self.matrix = _matrix.packedFromDense(args[0].matrix, _PACKED_KINDS[kind], self._threads)
+        elif len(args) == 2:
+            self.matrix = _matrix.PackedMatrix(args[0], args[1], _PACKED_KINDS[kind])
+        else:
+            raise TypeError("PackedMatrix requires a Matrix, or n and a list of values")
+
+    @staticmethod
+    def _internal_new(matrix, threads=_threadInfo.LPM_OPTIMAL_MATRIX_THREADS):
+        """
+        FOR INTERNAL USE ONLY
+
+        Wrap a packed matrix core object without going through __init__
+
+        :param matrix: Packed matrix core object to use as the result's matrix
+        :param threads: Number of threads to use
+        :return: PackedMatrix object from supplied information
+        """
+
+        res = PackedMatrix.__new__(PackedMatrix)
+        res.matrix = matrix
+        res._threads = threads
+
+        return res
+
+    @property
+    def rows(self):
+        """
+        :return: Number of rows in the matrix
+        """
+
+        return self.matrix.rows
+
+    @property
+    def cols(self):
+        """
+        :return: Number of columns in the matrix
+        """
+
+        return self.matrix.cols
+
+    @property
+    def shape(self):
+        """
+        :return: A tuple containing the rows and columns of the matrix
+        """
+
+        return self.matrix.rows, self.matrix.cols
+
+    @property
+    def kind(self):
+        """
+        :return: "symmetric", "lower" or "upper"
+        """
+
+        return _PACKED_KIND_NAMES[self.matrix.kind]
+
+    @property
+    def dtype(self):
+        """
+        :return: The datatype of the matrix, which is always "float64"
+        """
+
+        return "float64"
+
+    @property
+    def threads(self):
+        """
+        :return: Number of threads used for calculations
+        """
+
+        return self._threads
+
+    def transposed(self):
+        """
+        Return the transpose of the matrix. A symmetric matrix is its own
+        transpose, and a triangular one keeps its values and swaps between
+        lower and upper
+
+        :return: Transposed packed matrix
+        """
+
+        return PackedMatrix._internal_new(self.matrix.transpose(), self._threads)
+
+    @property
+    def T(self):
+        """
+        See PackedMatrix.transposed()
+
+        :return: Transposed packed matrix
+        """
+
+        return self.transposed()
+
+    def dot(self, other, transB=False, alpha=1.0, bias=None, activation=None):
+        """
+        Compute the matrix product of this packed matrix with a dense Matrix.
+        The stored triangle is read once for every block of rows of the result,
+        so the product never expands it into a dense matrix.
+
+        :param other: Matrix to compute matrix product with
+        :param transB: Use the transpose of the other matrix
+        :param alpha: Scale factor for the product
+        :param bias: Matrix added to the product. May be a single column or row, which is added to every column or row
+        :param activation: SIGMOID, TANH, RELU or LEAKY_RELU, applied after the bias
+        :return: Dense Matrix holding the result
+        """
+
+        if isinstance(other, Matrix):
+            if (other.matrix.cols if transB else other.matrix.rows) == self.matrix.cols:
+                biasMatrix, activationCode = _epilogueArgs(bias, activation)
+                return Matrix._internal_new(self.matrix.packedProduct(other.matrix, self.threads, transB, alpha,
+                                                                      biasMatrix, activationCode),
+                                            "float64", self.threads)
+
+            raise TypeError("Invalid matrix size for matrix product")
+
+        raise TypeError("A PackedMatrix can only be multiplied with a Matrix")
+
+    def __matmul__(self, other):
+        """
+        See PackedMatrix.dot()
+
+        :param other: Matrix to compute matrix product with
+        :return: Result of matrix product calculation
+        """
+
+        return self.dot(other)
+
+    def _elementwise(self, other, op, operation):
+        # Apply an operation to the stored values, with another packed matrix of the same kind or a scalar
+        if isinstance(other, PackedMatrix):
+            if self.shape != other.shape or self.matrix.kind != other.matrix.kind:
+                raise TypeError("Invalid matrix size or kind for matrix {}".format(operation))
+
+            return PackedMatrix._internal_new(self.matrix.packedElementwise(other.matrix, op, self.threads),
+                                              self.threads)
+
+        if isinstance(other, (int, float)):
+            return PackedMatrix._internal_new(self.matrix.packedScalar(other, op, self.threads), self.threads)
+
+        return NotImplemented
+
+    def __add__(self, other):
+        """
+        Add a packed matrix of the same kind or a dense Matrix elementwise, or
+        add a scalar to every value of a symmetric matrix
+
+        :param other: PackedMatrix, Matrix or scalar
+        :return: Result of addition. Dense if other is a Matrix
+        """
+
+        if isinstance(other, Matrix):
+            return Matrix._internal_new(self.matrix.packedAddDense(other.matrix, 1.0, 1.0, self.threads),
+                                        "float64", self.threads)
+
+        return self._elementwise(other, _PACKED_ADD, "addition")
+
+    def __radd__(self, other):
+        """
+        See PackedMatrix.__add__()
+
+        :param other: Matrix or scalar
+        :return: Result of addition
+        """
+
+        return self.__add__(other)
+
+    def __sub__(self, other):
+        """
+        Subtract a packed matrix of the same kind or a dense Matrix elementwise,
+        or subtract a scalar from every value of a symmetric matrix
+
+        :param other: PackedMatrix, Matrix or scalar
+        :return: Result of subtraction. Dense if other is a Matrix
+        """
+
+        if isinstance(other, Matrix):
+            return Matrix._internal_new(self.matrix.packedAddDense(other.matrix, 1.0, -1.0, self.threads),
+                                        "float64", self.threads)
+
+        return self._elementwise(other, _PACKED_SUB, "subtraction")
+
+    def __rsub__(self, other):
+        """
+        Subtract the packed matrix from a dense Matrix
+
+        :param other: Matrix
+        :return: Dense result of subtraction
+        """
+
+        if isinstance(other, Matrix):
+            return Matrix._internal_new(self.matrix.packedAddDense(other.matrix, -1.0, 1.0, self.threads),
+                                        "float64", self.threads)
+
+        return NotImplemented
+
+    def __mul__(self, other):
+        """
+        Multiply by a packed matrix of the same kind elementwise, or multiply
+        every value by a scalar
+
+        :param other: PackedMatrix or scalar
+        :return: Result of multiplication
+        """
+
+        return self._elementwise(other, _PACKED_MUL, "multiplication")
+
+    def __rmul__(self, other):
+        """
+        See PackedMatrix.__mul__()
+
+        :param other: Scalar
+        :return: Result of multiplication
+        """
+
+        return self.__mul__(other)
+
+    def __truediv__(self, other):
+        """
+        Divide every value by a scalar
+
+        :param other: Scalar
+        :return: Result of division
+        """
+
+        if isinstance(other, (int, float)):
+            return self._elementwise(other, _PACKED_DIV, "division")
+
+        return NotImplemented
+
+    def toDense(self):
+        """
+        Convert the packed matrix to a dense Matrix, mirroring a symmetric
+        matrix and filling the empty triangle of a triangular one with zeros
+
+        :return: Dense Matrix
+        """
+
+        return Matrix._internal_new(self.matrix.toDense(self.threads), "float64", self.threads)
+
+    def toList(self):
+        """
+        Convert the packed matrix into a dense 2d Python list
+
+        :return: 2d Python list
+        """
+
+        return self.toDense().toList()
+
+    def __str__(self):
+        """
+        :return: String showing the size and kind of the matrix
+        """
+
+        return "PackedMatrix(n={}, kind={})".format(self.rows, self.kind)
+
+    def __repr__(self):
+        """
+        See PackedMatrix.__str__()
+
+        :return: String representation of the packed matrix
+        """
+
+        return str(self)
+
+    def __reduce__(self):
+        """
+        For the pickle module
+
+        :return: Pickle-able object
+        """
+
+        # The stored values of an upper matrix are those of its transpose, so it is rebuilt from them as one
+        return (
+            _packedFromValues,
+            (self.rows, self.matrix.toList(), self.kind, self.threads)
+        )
+
+
+def _packedFromValues(n, values, kind, threads):
+    # Rebuild a pickled packed matrix from its stored values
+    return PackedMatrix(n, values, kind=kind, threads=threads)
+
+
+def addmm(c, a, b, alpha=1.0, beta=1.0, transA=False, transB=False, bias=None, activation=None):
+    """
+    Accumulate a matrix product into an existing matrix in place, computing
+    c = alpha * a @ b + beta * c in a single pass without allocating anything.
+    The optional bias and activation are applied as for Matrix.dot.
+
+    :param c: Matrix to accumulate the result into. Must not share memory with a or b
+    :param a: Left operand of the product
+    :param b: Right operand of the product
+    :param alpha: Scale factor for the product
+    :param beta: Scale factor for the existing values of c
+    :param transA: Use the transpose of a
+    :param transB: Use the transpose of b
+    :param bias: Matrix added to the result, or a single column or row of it
+    :param activation: SIGMOID, TANH, RELU or LEAKY_RELU, applied after the bias
+    :return: c
+    """
+
+    if not isinstance(c, Matrix) or not isinstance(a, Matrix) or not isinstance(b, Matrix):
+        raise TypeError("addmm requires three Matrix objects")
+
+    biasMatrix, activationCode = _epilogueArgs(bias, activation)
+    c.matrix.matrixAddmm(a.matrix, b.matrix, alpha, beta, c.threads, transA, transB, biasMatrix, activationCode)
+    return c
+
+
+def dotBatched(listA, listB, transA=False, transB=False, threads=None):
+    """
+    Compute the matrix product of every pair of matrices in two lists in a
+    single call. The products are spread across threads, so a batch of many
+    small products runs far faster than calling Matrix.dot for each.
+
+    :param listA: List of left operands
+    :param listB: List of right operands, the same length as listA
+    :param transA: Use the transpose of every matrix in listA
+    :param transB: Use the transpose of every matrix in listB
+    :param threads: The number of threads to use. Defaults to LPM_OPTIMAL_MATRIX_THREADS
+    :return: List of the products
+    """
+
+    if len(listA) != len(listB):
+        raise ValueError("dotBatched requires two lists of the same length")
+
+    if not all(isinstance(x, Matrix) for x in listA) or not all(isinstance(x, Matrix) for x in listB):
+        raise TypeError("dotBatched requires lists of Matrix objects")
+
+    if threads is None:
+        threads = _threadInfo.LPM_OPTIMAL_MATRIX_THREADS
+
+    results = _matrix.matrixProductBatched([x.matrix for x in listA], [x.matrix for x in listB],
+                                           threads, transA, transB)
+    return [Matrix._internal_new(res, a._dtype, a.threads) for res, a in zip(results, listA)]
+
+
+def dotStridedBatched(a, b, batch, threads=None):
+    """
+    Compute a batch of equally shaped matrix products stored as blocks stacked
+    on top of each other. a holds batch blocks of m x n rows and b holds batch
+    blocks of n x k, and the result holds the batch m x k products in order.
+
+    :param a: Matrix of batch * m rows and n columns
+    :param b: Matrix of batch * n rows and k columns
+    :param batch: The number of products
+    :param threads: The number of threads to use. Defaults to the threads of a
+    :return: Matrix of batch * m rows and k columns
+    """
+
+    if not isinstance(a, Matrix) or not isinstance(b, Matrix):
+        raise TypeError("dotStridedBatched requires two Matrix objects")
+
+    if threads is None:
+        threads = a.threads
+
+    return Matrix._internal_new(_matrix.matrixProductStridedBatched(a.matrix, b.matrix, batch, threads),
+                                a._dtype, a.threads)
@@ -143,12 +143,84 @@ class Network:
             current = self.__parseData(data)
 
         for i in range(len(self._nodeCounts) - 1):
-            current = self._layers[i] @ current
-            current += self._biases[i]
-            current.map(self._activations[i])
+            # The bias and activation are applied by the product itself
+            current = self._layers[i].dot(current, bias=self._biases[i], activation=self._activations[i])
 
         return current
 
+    def quantize(self, inputData=None, targetData=None):
+        """
+        Quantize the weights of every layer to int8 (see Matrix.quantize()), so
+        that feedForward computes its products in int8. Training the network
+        changes the weights, which drops the int8 copies and returns it to the
+        float64 path.
+
+        If input data is given, it is fed forward before and after quantizing
+        and the difference between the outputs of the two paths is returned.
+        With target data as well, the mean squared error of both paths against
+        the targets is included.
+
+        :param inputData: Optional list of inputs to measure the accuracy on
+        :param targetData: Optional list of the expected outputs for inputData
+        :return: None, or a dict with the largest ("maxError") and mean ("meanError") absolute difference between the
+                 outputs, and the "loss" and "quantizedLoss" if targetData was given
+        """
+
+        if inputData is None:
+            for layer in self._layers:
+                layer.quantize()
+
+            return None
+
+        if targetData is not None:
+            samples = self.parseData(inputData, targetData)
+        else:
+            samples = [(self.__parseData(element), None) for element in inputData]
+
+        for layer in self._layers:
+            layer.dequantize()
+
+        outputs = [self.feedForward(element, noCheck=True).toList() for element, _ in samples]
+
+        for layer in self._layers:
+            layer.quantize()
+
+        quantizedOutputs = [self.feedForward(element, noCheck=True).toList() for element, _ in samples]
+
+        errors = [abs(x[0] - y[0]) for a, b in zip(outputs, quantizedOutputs) for x, y in zip(a, b)]
+        res = {
+            "maxError": max(errors),
+            "meanError": sum(errors) / len(errors)
+        }
+
+        if targetData is not None:
+            targets = [target.toList() for _, target in samples]
+
+            res["loss"] = sum((x[0] - y[0]) ** 2 for a, b in zip(outputs, targets) for x, y in zip(a, b)) / len(errors)
+            res["quantizedLoss"] = sum((x[0] - y[0]) ** 2 for a, b in zip(quantizedOutputs, targets)
+                                       for x, y in zip(a, b)) / len(errors)
+
+        return res
+
+    def dequantize(self):
+        """
+        Drop the int8 weights made by Network.quantize(), so feedForward uses
+        the float64 weights again
+
+        :return: None
+        """
+
+        for layer in self._layers:
+            layer.dequantize()
+
+    @property
+    def quantized(self):
+        """
+        :return: True if every layer holds int8 weights made by Network.quantize()
+        """
+
+        return all(layer.quantized for layer in self._layers)
+
     def backpropagate(self, inputData, targetData, **kwargs):
         # For improved speed when one is sure that the data is correct
         if "noCheck" in kwargs:
@@ -163,9 +235,8 @@ class Network:
 
         current = inputs.copy()
         for i in range(len(self._nodeCounts) - 1):
-            current = self._layers[i] @ current
-            current += self._biases[i]
-            current.map(self._activations[i])
+            # The bias and activation are applied by the product itself
+            current = self._layers[i].dot(current, bias=self._biases[i], activation=self._activations[i])
 
             layerData.append(current.copy())
 
@@ -181,19 +252,16 @@ class Network:
             gradient *= errors[i]
             gradient *= self._learningRate
 
+            # The weight delta is the outer product of two vectors, added in place
             if i > 0:
-                transposed = layerData[i - 1].T
+                self._layers[i].addOuter(gradient, layerData[i - 1])
             else:
-                transposed = inputs.T
-
-            weight_deltas = gradient @ transposed
+                self._layers[i].addOuter(gradient, inputs)
 
-            self._layers[i] += weight_deltas
             self._biases[i] += gradient
 
             if i > 0:
-                layerT = self._layers[i].T
-                errors[i - 1] = layerT @ errors[i]
+                errors[i - 1] = self._layers[i].dot(errors[i], transA=True)
 
     def log(self, metric, mod=1):
         if metric == "loss" and self._metrics["loss"] != [None]:
@@ -0,0 +1,175 @@
+#ifndef ULMBLAS_CACHEINFO_H
+#define ULMBLAS_CACHEINFO_H 1
+
+#include "cpufeatures.h"
+#include <stdio.h>
+
+//
+//  Sizes in bytes of the data caches seen by one core.  A size of 0 means
+//  the cache level could not be found.
+//
+struct ulm_cache_info {
+    long int l1;
+    long int l2;
+    long int l3;
+};
+
+#if defined(__linux__)
+//
+//  Read the caches of cpu0 from sysfs, e.g.
+//  /sys/devices/system/cpu/cpu0/cache/index0/{level,type,size}
+//
+static int
+ulm_cache_info_sysfs(struct ulm_cache_info *info) {
+    char path[128];
+    char type[32];
+    char unit;
+    long int level, size;
+    int index, found = 0;
+    FILE *f;
+
+    for (index = 0; index < 16; ++index) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        if ((f = fopen(path, "r")) == NULL) {
+            break;
+        }
+        if (fscanf(f, "%ld", &level) != 1) {
+            level = 0;
+        }
+        fclose(f);
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        if ((f = fopen(path, "r")) == NULL) {
+            continue;
+        }
+        if (fscanf(f, "%31s", type) != 1) {
+            type[0] = '\0';
+        }
+        fclose(f);
+
+        if (type[0] == 'I') {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        if ((f = fopen(path, "r")) == NULL) {
+            continue;
+        }
+        unit = '\0';
+        if (fscanf(f, "%ld%c", &size, &unit) < 1) {
+            size = 0;
+        }
+        fclose(f);
+
+        if (unit == 'K') {
+            size *= 1024;
+        } else if (unit == 'M') {
+            size *= 1024 * 1024;
+        }
+
+        if (level == 1) {
+            info->l1 = size;
+        } else if (level == 2) {
+            info->l2 = size;
+        } else if (level == 3) {
+            info->l3 = size;
+        }
+        found = 1;
+    }
+
+    return found;
+}
+#endif
+
+#ifdef ULM_X86
+//
+//  Walk the deterministic cache parameters leaf: 4 on Intel, 0x8000001D on
+//  AMD processors with topology extensions
+//
+static int
+ulm_cache_info_cpuid(struct ulm_cache_info *info) {
+    unsigned int regs[4];
+    unsigned int leaf = 4;
+    unsigned int sub;
+    int found = 0;
+
+    ulm_cpuid(0, 0, regs);
+    if (regs[0] < 4) {
+        ulm_cpuid(0x80000000u, 0, regs);
+        if (regs[0] < 0x8000001Du) {
+            return 0;
+        }
+        leaf = 0x8000001Du;
+    } else if (regs[1] == 0x68747541u) {
+        // "Auth" of "AuthenticAMD" does not implement leaf 4
+        leaf = 0x8000001Du;
+    }
+
+    for (sub = 0; sub < 16; ++sub) {
+        unsigned int type, level;
+        long int size;
+
+        ulm_cpuid(leaf, sub, regs);
+        type = regs[0] & 0x1f;
+        level = (regs[0] >> 5) & 0x7;
+
+        if (type == 0) {
+            break;
+        }
+        if (type == 2) {
+            continue;
+        }
+
+        // ways * partitions * line size * sets
+        size = (long int) (((regs[1] >> 22) & 0x3ff) + 1)
+               * (long int) (((regs[1] >> 12) & 0x3ff) + 1)
+               * (long int) ((regs[1] & 0xfff) + 1)
+               * (long int) (regs[2] + 1);
+
+        if (level == 1) {
+            info->l1 = size;
+        } else if (level == 2) {
+            info->l2 = size;
+        } else if (level == 3) {
+            info->l3 = size;
+        }
+        found = 1;
+    }
+
+    return found;
+}
+#endif
+
+//
+//  Find the cache sizes of the processor, falling back to a small but common
+//  configuration for any level that could not be found
+//
+static struct ulm_cache_info
+ulm_cache_info(void) {
+    struct ulm_cache_info info = {0, 0, 0};
+    int found = 0;
+
+#if defined(__linux__)
+    found = ulm_cache_info_sysfs(&info);
+#endif
+#ifdef ULM_X86
+    if (!found) {
+        found = ulm_cache_info_cpuid(&info);
+    }
+#endif
+    (void) found;
+
+    if (info.l1 <= 0) {
+        info.l1 = 32 * 1024;
+    }
+    if (info.l2 <= 0) {
+        info.l2 = 256 * 1024;
+    }
+    if (info.l3 <= 0) {
+        info.l3 = 4 * info.l2;
+    }
+
+    return info;
+}
+
+#endif // ULMBLAS_CACHEINFO_H
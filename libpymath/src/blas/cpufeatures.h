@@ -0,0 +1,121 @@
+#ifndef ULMBLAS_CPUFEATURES_H
+#define ULMBLAS_CPUFEATURES_H 1
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   define ULM_X86 1
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   else
+#       include <cpuid.h>
+#   endif
+#endif
+
+//
+//  Instruction set extensions the GEMM kernels care about
+//
+enum CpuFeature {
+    CpuSSE2       = 1 << 0,
+    CpuAVX        = 1 << 1,
+    CpuAVX2       = 1 << 2,
+    CpuFMA        = 1 << 3,
+    CpuAVX512F    = 1 << 4,
+    CpuAVX512BW   = 1 << 5,
+    CpuAVX512VNNI = 1 << 6
+};
+
+#ifdef ULM_X86
+static void
+ulm_cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    int tmp[4];
+    __cpuidex(tmp, (int) leaf, (int) subleaf);
+    regs[0] = (unsigned int) tmp[0];
+    regs[1] = (unsigned int) tmp[1];
+    regs[2] = (unsigned int) tmp[2];
+    regs[3] = (unsigned int) tmp[3];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+//
+//  Read XCR0 to find out which register states the OS saves on a context
+//  switch.  Only call this after CPUID reported OSXSAVE.
+//
+static unsigned long long
+ulm_xgetbv(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+#endif
+
+//
+//  Return a mask of enum CpuFeature values supported by both the processor
+//  and the operating system
+//
+static int
+ulm_cpu_features(void) {
+    int features = 0;
+
+#ifdef ULM_X86
+    unsigned int regs[4];
+    unsigned int maxLeaf;
+    unsigned long long xcr0 = 0;
+
+    ulm_cpuid(0, 0, regs);
+    maxLeaf = regs[0];
+
+    if (maxLeaf < 1) {
+        return features;
+    }
+
+    ulm_cpuid(1, 0, regs);
+
+    if (regs[3] & (1u << 26)) {
+        features |= CpuSSE2;
+    }
+
+    // OSXSAVE and AVX, with the YMM state enabled by the OS
+    if ((regs[2] & (1u << 27)) && (regs[2] & (1u << 28))) {
+        xcr0 = ulm_xgetbv();
+
+        if ((xcr0 & 0x6) == 0x6) {
+            features |= CpuAVX;
+
+            if (regs[2] & (1u << 12)) {
+                features |= CpuFMA;
+            }
+        }
+    }
+
+    if (maxLeaf >= 7 && (features & CpuAVX)) {
+        ulm_cpuid(7, 0, regs);
+
+        if (regs[1] & (1u << 5)) {
+            features |= CpuAVX2;
+        }
+
+        // AVX-512F also needs the opmask and upper ZMM states enabled
+        if ((regs[1] & (1u << 16)) && (xcr0 & 0xe6) == 0xe6) {
+            features |= CpuAVX512F;
+
+            // Byte and word instructions, and the dot products of bytes used by the int8 kernels
+            if (regs[1] & (1u << 30)) {
+                features |= CpuAVX512BW;
+            }
+            if (regs[2] & (1u << 11)) {
+                features |= CpuAVX512VNNI;
+            }
+        }
+    }
+#endif
+
+    return features;
+}
+
+#endif // ULMBLAS_CPUFEATURES_H
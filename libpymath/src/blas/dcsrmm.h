@@ -0,0 +1,305 @@
+#ifndef ULMBLAS_DCSRMM_H
+#define ULMBLAS_DCSRMM_H 1
+
+//
+//  Products with a sparse matrix in compressed sparse row (CSR) format.  An
+//  m x n CSR matrix with nnz non-zero elements is stored in three arrays:
+//
+//      values[p], columns[p]    value and column of the p-th non-zero element
+//                               (0 <= p < nnz), row by row
+//      rowPointers[i]           index p of the first element of row i, with
+//                               rowPointers[m] = nnz
+//
+//  Only the non-zero elements are read, so every product costs O(nnz) work for
+//  each column of the dense operand instead of O(m*n).
+//
+#include "ulmblas.h"
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Only start another thread for every this many multiply-adds.  Like dger,
+//  the sparse products are limited by memory bandwidth.
+//
+#define ULM_DCSR_WORK_PER_THREAD  (1L << 16)
+
+static long int
+ulm_dcsr_threads(double work, int threads) {
+    long int nthreads = 1 + (long int) (work / ULM_DCSR_WORK_PER_THREAD);
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+    return nthreads;
+}
+
+//
+//  First row of part `part` out of `parts`, splitting the m rows so that each
+//  part holds about the same number of non-zero elements.  A few dense rows
+//  would otherwise leave one thread with most of the work.
+//
+static long int
+ulm_dcsr_split(long int m, const long int *rowPointers, long int part, long int parts) {
+    long int target = (long int) ((double) rowPointers[m] * (double) part / (double) parts);
+    long int lo = 0, hi = m, mid;
+
+    if (part >= parts) {
+        return m;
+    }
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+
+        if (rowPointers[mid] < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+//
+//  Compute y <- beta*y + alpha*A*x, where A is an m x n CSR matrix, using up to
+//  `threads` threads (the OpenMP default if threads <= 0).  Every thread
+//  computes a block of rows with the same number of non-zero elements.
+//
+static void
+ULMBLAS(dcsrmv)(long int m,
+                double alpha,
+                const double *values,
+                const int *columns,
+                const long int *rowPointers,
+                const double *x,
+                long int incX,
+                double beta,
+                double *y,
+                long int incY,
+                int threads) {
+    long int nthreads;
+
+    if (m <= 0) {
+        return;
+    }
+
+    nthreads = ulm_dcsr_threads((double) rowPointers[m] + (double) m, threads);
+
+#   pragma omp parallel num_threads(nthreads) if(nthreads > 1)
+    {
+        long int part = 0, parts = 1;
+        long int i, i0, i1, p;
+
+#ifdef _OPENMP
+        part = omp_get_thread_num();
+        parts = omp_get_num_threads();
+#endif
+
+        i0 = ulm_dcsr_split(m, rowPointers, part, parts);
+        i1 = ulm_dcsr_split(m, rowPointers, part + 1, parts);
+
+        for (i = i0; i < i1; ++i) {
+            double ax = 0.0;
+
+            if (incX == 1) {
+                for (p = rowPointers[i]; p < rowPointers[i + 1]; ++p) {
+                    ax += values[p] * x[columns[p]];
+                }
+            } else {
+                for (p = rowPointers[i]; p < rowPointers[i + 1]; ++p) {
+                    ax += values[p] * x[columns[p] * incX];
+                }
+            }
+
+            y[i * incY] = (beta == 0.0) ? alpha * ax : beta * y[i * incY] + alpha * ax;
+        }
+    }
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B, where A is an m x k CSR matrix, B is dense
+//  k x n and C is dense m x n.  Every row of C is the sum of the rows of B
+//  picked out by the non-zero elements of the same row of A, so rows of B and C
+//  stored contiguously are combined with vectorised axpy loops.  Rows of C are
+//  split between threads as for dcsrmv.
+//
+static void
+ULMBLAS(dcsrmm)(long int m,
+                long int n,
+                double alpha,
+                const double *values,
+                const int *columns,
+                const long int *rowPointers,
+                const double *B,
+                long int incRowB,
+                long int incColB,
+                double beta,
+                double *C,
+                long int incRowC,
+                long int incColC,
+                int threads) {
+    long int nthreads;
+
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+
+    if (n == 1) {
+        ULMBLAS(dcsrmv)(m, alpha, values, columns, rowPointers, B, incRowB, beta, C, incRowC, threads);
+        return;
+    }
+
+    nthreads = ulm_dcsr_threads(((double) rowPointers[m] + (double) m) * (double) n, threads);
+
+#   pragma omp parallel num_threads(nthreads) if(nthreads > 1)
+    {
+        long int part = 0, parts = 1;
+        long int i, i0, i1, j, p;
+
+#ifdef _OPENMP
+        part = omp_get_thread_num();
+        parts = omp_get_num_threads();
+#endif
+
+        i0 = ulm_dcsr_split(m, rowPointers, part, parts);
+        i1 = ulm_dcsr_split(m, rowPointers, part + 1, parts);
+
+        for (i = i0; i < i1; ++i) {
+            double *c = &C[i * incRowC];
+
+            for (j = 0; j < n; ++j) {
+                c[j * incColC] = (beta == 0.0) ? 0.0 : beta * c[j * incColC];
+            }
+
+            for (p = rowPointers[i]; p < rowPointers[i + 1]; ++p) {
+                const double a = alpha * values[p];
+                const double *b = &B[columns[p] * incRowB];
+
+                if (incColB == 1 && incColC == 1) {
+                    for (j = 0; j < n; ++j) {
+                        c[j] += a * b[j];
+                    }
+                } else {
+                    for (j = 0; j < n; ++j) {
+                        c[j * incColC] += a * b[j * incColB];
+                    }
+                }
+            }
+        }
+    }
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B, where A is dense m x k, B is a k x n CSR
+//  matrix and C is dense m x n.  Row i of C gathers the rows of B scaled by
+//  row i of A, so each thread owns whole rows of C and no two threads write
+//  the same element.  Zeros in A skip their row of B.
+//
+static void
+ULMBLAS(dgecsrmm)(long int m,
+                  long int n,
+                  long int k,
+                  double alpha,
+                  const double *A,
+                  long int incRowA,
+                  long int incColA,
+                  const double *values,
+                  const int *columns,
+                  const long int *rowPointers,
+                  double beta,
+                  double *C,
+                  long int incRowC,
+                  long int incColC,
+                  int threads) {
+    long int nthreads;
+    long int i, j, l, p;
+
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+
+    nthreads = ulm_dcsr_threads(((double) rowPointers[k] + (double) k) * (double) m, threads);
+
+#   pragma omp parallel for num_threads(nthreads) schedule(static) private(j, l, p) if(nthreads > 1)
+    for (i = 0; i < m; ++i) {
+        double *c = &C[i * incRowC];
+
+        for (j = 0; j < n; ++j) {
+            c[j * incColC] = (beta == 0.0) ? 0.0 : beta * c[j * incColC];
+        }
+
+        for (l = 0; l < k; ++l) {
+            const double a = alpha * A[i * incRowA + l * incColA];
+
+            if (a == 0.0) {
+                continue;
+            }
+
+            for (p = rowPointers[l]; p < rowPointers[l + 1]; ++p) {
+                c[columns[p] * incColC] += a * values[p];
+            }
+        }
+    }
+}
+
+//
+//  Store the transpose of the m x n CSR matrix A as an n x m CSR matrix in
+//  tValues, tColumns and tRowPointers, which hold nnz, nnz and n + 1 elements.
+//  The elements are counted per column and then placed in order, so the
+//  columns of each row of the result stay sorted.
+//
+static void
+ulm_dcsr_transpose(long int m,
+                   long int n,
+                   const double *values,
+                   const int *columns,
+                   const long int *rowPointers,
+                   double *tValues,
+                   int *tColumns,
+                   long int *tRowPointers) {
+    long int i, j, p, q, count, next;
+
+    for (j = 0; j <= n; ++j) {
+        tRowPointers[j] = 0;
+    }
+    for (p = 0; p < rowPointers[m]; ++p) {
+        tRowPointers[columns[p] + 1]++;
+    }
+    for (j = 0; j < n; ++j) {
+        tRowPointers[j + 1] += tRowPointers[j];
+    }
+
+//
+//  tRowPointers[j] is used as the next free slot of row j, and moved back to
+//  the start of the row afterwards
+//
+    for (i = 0; i < m; ++i) {
+        for (p = rowPointers[i]; p < rowPointers[i + 1]; ++p) {
+            q = tRowPointers[columns[p]]++;
+            tValues[q] = values[p];
+            tColumns[q] = (int) i;
+        }
+    }
+
+    next = 0;
+    for (j = 0; j <= n; ++j) {
+        count = tRowPointers[j];
+        tRowPointers[j] = next;
+        next = count;
+    }
+}
+
+#endif // ULMBLAS_DCSRMM_H
@@ -0,0 +1,306 @@
+#ifndef ULMBLAS_DELEMENTWISE_H
+#define ULMBLAS_DELEMENTWISE_H 1
+
+//
+//  Elementwise arithmetic on matrices, C <- A op B or C <- A op beta for a
+//  scalar beta, where op is one of +, -, * and /.  Each element is touched
+//  once, so the speed is set by memory bandwidth as long as the loads and
+//  stores are vectorised.  Matrices whose rows are contiguous are handled with
+//  AVX loops over whole rows, or over the whole matrix as a single vector if
+//  there are no gaps between the rows, and any other layout with a plain loop
+//  over the strides.
+//
+#include "ulmblas.h"
+#include "cpufeatures.h"
+#include <immintrin.h>
+#include <stdint.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define ULM_ELEMENTWISE_ADD  0
+#define ULM_ELEMENTWISE_SUB  1
+#define ULM_ELEMENTWISE_MUL  2
+#define ULM_ELEMENTWISE_DIV  3
+
+//
+//  Only start another thread for every this many elements, as for dsum
+//
+#define ULM_DELEMENTWISE_WORK_PER_THREAD  (1L << 16)
+
+static long int
+ulm_delementwise_threads(double work, int threads) {
+    long int nthreads = 1 + (long int) (work / ULM_DELEMENTWISE_WORK_PER_THREAD);
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+    return nthreads;
+}
+
+//
+//  1 if the processor supports AVX, checked on the first call
+//
+static int
+ulm_delementwise_avx(void) {
+    static int avx = -1;
+
+    if (avx < 0) {
+        avx = (ulm_cpu_features() & CpuAVX) != 0;
+    }
+
+    return avx;
+}
+
+//
+//  z[i] = x[i] op y[i] for 0 <= i < n, or z[i] = x[i] op beta if y is NULL.
+//  The first elements are peeled off until z is aligned to 32 bytes, so every
+//  store of the main loop is aligned; x and y may be aligned differently and
+//  are loaded unaligned.
+//
+#define ULM_DELEMENTWISE_AVX_KERNEL(name, VOP, OP)                              \
+ULM_TARGET("avx")                                                              \
+static void                                                                    \
+name(long int n, const double *x, const double *y, double beta, double *z) {   \
+    long int i = 0;                                                            \
+                                                                               \
+    while (i < n && ((uintptr_t) &z[i] & 31) != 0) {                           \
+        z[i] = x[i] OP (y ? y[i] : beta);                                      \
+        ++i;                                                                   \
+    }                                                                          \
+                                                                               \
+    if (y) {                                                                   \
+        for (; i + 16 <= n; i += 16) {                                         \
+            __m256d z0 = VOP(_mm256_loadu_pd(&x[i]), _mm256_loadu_pd(&y[i]));  \
+            __m256d z1 = VOP(_mm256_loadu_pd(&x[i + 4]),                       \
+                             _mm256_loadu_pd(&y[i + 4]));                      \
+            __m256d z2 = VOP(_mm256_loadu_pd(&x[i + 8]),                       \
+                             _mm256_loadu_pd(&y[i + 8]));                      \
+            __m256d z3 = VOP(_mm256_loadu_pd(&x[i + 12]),                      \
+                             _mm256_loadu_pd(&y[i + 12]));                     \
+            _mm256_store_pd(&z[i], z0);                                        \
+            _mm256_store_pd(&z[i + 4], z1);                                    \
+            _mm256_store_pd(&z[i + 8], z2);                                    \
+            _mm256_store_pd(&z[i + 12], z3);                                   \
+        }                                                                      \
+        for (; i + 4 <= n; i += 4) {                                           \
+            _mm256_store_pd(&z[i], VOP(_mm256_loadu_pd(&x[i]),                 \
+                                       _mm256_loadu_pd(&y[i])));               \
+        }                                                                      \
+        for (; i < n; ++i) {                                                   \
+            z[i] = x[i] OP y[i];                                               \
+        }                                                                      \
+    } else {                                                                   \
+        __m256d b = _mm256_set1_pd(beta);                                      \
+                                                                               \
+        for (; i + 16 <= n; i += 16) {                                         \
+            __m256d z0 = VOP(_mm256_loadu_pd(&x[i]), b);                       \
+            __m256d z1 = VOP(_mm256_loadu_pd(&x[i + 4]), b);                   \
+            __m256d z2 = VOP(_mm256_loadu_pd(&x[i + 8]), b);                   \
+            __m256d z3 = VOP(_mm256_loadu_pd(&x[i + 12]), b);                  \
+            _mm256_store_pd(&z[i], z0);                                        \
+            _mm256_store_pd(&z[i + 4], z1);                                    \
+            _mm256_store_pd(&z[i + 8], z2);                                    \
+            _mm256_store_pd(&z[i + 12], z3);                                   \
+        }                                                                      \
+        for (; i + 4 <= n; i += 4) {                                           \
+            _mm256_store_pd(&z[i], VOP(_mm256_loadu_pd(&x[i]), b));            \
+        }                                                                      \
+        for (; i < n; ++i) {                                                   \
+            z[i] = x[i] OP beta;                                               \
+        }                                                                      \
+    }                                                                          \
+}
+
+ULM_DELEMENTWISE_AVX_KERNEL(delementwise_add_avx, _mm256_add_pd, +)
+ULM_DELEMENTWISE_AVX_KERNEL(delementwise_sub_avx, _mm256_sub_pd, -)
+ULM_DELEMENTWISE_AVX_KERNEL(delementwise_mul_avx, _mm256_mul_pd, *)
+ULM_DELEMENTWISE_AVX_KERNEL(delementwise_div_avx, _mm256_div_pd, /)
+
+#undef ULM_DELEMENTWISE_AVX_KERNEL
+
+//
+//  z[i*incZ] = x[i*incX] op y[i*incY] for 0 <= i < n, or x[i*incX] op beta if
+//  y is NULL.  Used for strided vectors and processors without AVX.
+//
+static void
+delementwise_ref(int op,
+                 long int n,
+                 const double *x,
+                 long int incX,
+                 const double *y,
+                 long int incY,
+                 double beta,
+                 double *z,
+                 long int incZ) {
+    long int i;
+
+    if (y == NULL) {
+        y = &beta;
+        incY = 0;
+    }
+
+    switch (op) {
+        case ULM_ELEMENTWISE_ADD:
+            for (i = 0; i < n; ++i) {
+                z[i * incZ] = x[i * incX] + y[i * incY];
+            }
+            break;
+        case ULM_ELEMENTWISE_SUB:
+            for (i = 0; i < n; ++i) {
+                z[i * incZ] = x[i * incX] - y[i * incY];
+            }
+            break;
+        case ULM_ELEMENTWISE_MUL:
+            for (i = 0; i < n; ++i) {
+                z[i * incZ] = x[i * incX] * y[i * incY];
+            }
+            break;
+        default:
+            for (i = 0; i < n; ++i) {
+                z[i * incZ] = x[i * incX] / y[i * incY];
+            }
+            break;
+    }
+}
+
+//
+//  z = x op y (or x op beta) for vectors of n elements, with the AVX kernels
+//  if all of them are contiguous
+//
+static void
+ulm_delementwise_vector(int op,
+                        long int n,
+                        const double *x,
+                        long int incX,
+                        const double *y,
+                        long int incY,
+                        double beta,
+                        double *z,
+                        long int incZ) {
+    if (incX == 1 && (y == NULL || incY == 1) && incZ == 1 && ulm_delementwise_avx()) {
+        switch (op) {
+            case ULM_ELEMENTWISE_ADD:
+                delementwise_add_avx(n, x, y, beta, z);
+                return;
+            case ULM_ELEMENTWISE_SUB:
+                delementwise_sub_avx(n, x, y, beta, z);
+                return;
+            case ULM_ELEMENTWISE_MUL:
+                delementwise_mul_avx(n, x, y, beta, z);
+                return;
+            default:
+                delementwise_div_avx(n, x, y, beta, z);
+                return;
+        }
+    }
+
+    delementwise_ref(op, n, x, incX, y, incY, beta, z, incZ);
+}
+
+//
+//  Compute C <- A op B for m x n matrices A, B and C, or C <- A op beta if B
+//  is NULL, using up to `threads` threads (the OpenMP default if threads <= 0).
+//  If the three matrices are all stored without gaps in the same order, they
+//  are processed as single vectors split evenly between the threads, and
+//  otherwise row by row, along the direction of C with the smaller stride.
+//
+//  A stride of 0 broadcasts a single row or column of A or B over the whole
+//  matrix, without expanding it first.
+//
+static void
+ULMBLAS(delementwise)(int op,
+                      long int m,
+                      long int n,
+                      const double *A,
+                      long int incRowA,
+                      long int incColA,
+                      const double *B,
+                      long int incRowB,
+                      long int incColB,
+                      double beta,
+                      double *C,
+                      long int incRowC,
+                      long int incColC,
+                      int threads) {
+    long int nthreads, parts, p;
+    int flat;
+
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+
+    if (labs(incRowC) < labs(incColC)) {
+        long int tmp = m;
+        m = n;
+        n = tmp;
+        tmp = incRowA;
+        incRowA = incColA;
+        incColA = tmp;
+        tmp = incRowB;
+        incRowB = incColB;
+        incColB = tmp;
+        tmp = incRowC;
+        incRowC = incColC;
+        incColC = tmp;
+    }
+
+    flat = (incColA == 1 && incRowA == n && incColC == 1 && incRowC == n
+            && (B == NULL || (incColB == 1 && incRowB == n)));
+
+    nthreads = ulm_delementwise_threads((double) m * (double) n, threads);
+    if (!flat && nthreads > m) {
+        nthreads = m;
+    }
+
+    parts = nthreads;
+
+#   pragma omp parallel for num_threads(nthreads) schedule(static) if(nthreads > 1)
+    for (p = 0; p < parts; ++p) {
+        if (flat) {
+            long int length = m * n;
+            long int i0 = (long int) ((double) length * (double) p / (double) parts);
+            long int i1 = (long int) ((double) length * (double) (p + 1) / (double) parts);
+
+            // Split on multiples of 4 elements, so that the parts of an aligned C all start aligned
+            i0 = (p == 0) ? 0 : (i0 & ~3L);
+            i1 = (p == parts - 1) ? length : (i1 & ~3L);
+
+            ulm_delementwise_vector(op, i1 - i0, &A[i0], 1, B ? &B[i0] : NULL, 1, beta, &C[i0], 1);
+        } else {
+            long int i;
+
+            for (i = m * p / parts; i < m * (p + 1) / parts; ++i) {
+                const double *a = &A[i * incRowA];
+                const double *b = B ? &B[i * incRowB] : NULL;
+                double *c = &C[i * incRowC];
+
+//
+//              A row of B or A that is a single broadcast element is the
+//              scalar of the row.  Addition and multiplication commute, so a
+//              broadcast A swaps places with B as well.
+//
+                if (b != NULL && incColB == 0) {
+                    ulm_delementwise_vector(op, n, a, incColA, NULL, 0, *b, c, incColC);
+                } else if (b != NULL && incColA == 0 && (op == ULM_ELEMENTWISE_ADD || op == ULM_ELEMENTWISE_MUL)) {
+                    ulm_delementwise_vector(op, n, b, incColB, NULL, 0, *a, c, incColC);
+                } else {
+                    ulm_delementwise_vector(op, n, a, incColA, b, incColB, beta, c, incColC);
+                }
+            }
+        }
+    }
+}
+
+#endif // ULMBLAS_DELEMENTWISE_H
@@ -2,6 +2,7 @@
 #include "ulmblas.h"
 #include "xerbla.h"
 #include "dgemm_nn.h"
+#include "dgemm_small.h"
 
 void ULMBLAS(dgemm)(const enum Trans transA,
                const enum Trans transB,
@@ -87,7 +88,8 @@ void ULMBLAS(dgemm)(const enum Trans transA,
                               A, 1, ldA,
                               B, 1, ldB,
                               beta,
-                              C, 1, ldC);
+                              C, 1, ldC,
+                              0);
 #else
 #error      "no implementation specified!\n"
 #endif
@@ -115,7 +117,8 @@ void ULMBLAS(dgemm)(const enum Trans transA,
                               A, ldA, 1,
                               B, 1, ldB,
                               beta,
-                              C, 1, ldC);
+                              C, 1, ldC,
+                              0);
 #else
 #error      "no implementation specified!\n"
 #endif
@@ -151,7 +154,8 @@ void ULMBLAS(dgemm)(const enum Trans transA,
                               A, 1, ldA,
                               B, ldB, 1,
                               beta,
-                              C, 1, ldC);
+                              C, 1, ldC,
+                              0);
 #else
 #error      "no implementation specified!\n"
 #endif
@@ -179,7 +183,8 @@ void ULMBLAS(dgemm)(const enum Trans transA,
                               A, ldA, 1,
                               B, ldB, 1,
                               beta,
-                              C, 1, ldC);
+                              C, 1, ldC,
+                              0);
 #else
 #error      "no implementation specified!\n"
 #endif
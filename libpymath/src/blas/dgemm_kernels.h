@@ -0,0 +1,402 @@
+#ifndef ULMBLAS_DGEMM_KERNELS_H
+#define ULMBLAS_DGEMM_KERNELS_H 1
+
+#include "ulmblas.h"
+#include "cpufeatures.h"
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+//
+//  Largest micro tile of any kernel below.  Packing buffers and the local
+//  buffers used for partial tiles are sized with these.
+//
+#define MR_MAX  16
+#define NR_MAX  8
+
+//
+//  A micro kernel computes C <- beta*C + alpha*A*B for one MR x NR tile of C,
+//  where A is a packed MR x kc panel and B is a packed kc x NR panel.
+//
+typedef void (*ulm_dgemm_micro_kernel)(long kc,
+                                       double alpha, const double *A, const double *B,
+                                       double beta,
+                                       double *C, long incRowC, long incColC);
+
+struct ulm_dgemm_kernel {
+    const char *name;
+    long mr;
+    long nr;
+    int features;
+    ulm_dgemm_micro_kernel kernel;
+};
+
+//
+//  Update C <- beta*C + alpha*AB for an mr x nr tile, where AB is stored
+//  column major with leading dimension mr.
+//
+static void
+dgemm_update_tile(long mr, long nr,
+                  double alpha, const double *AB,
+                  double beta,
+                  double *C, long incRowC, long incColC) {
+    long i, j;
+
+    if (beta == 0.0) {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; ++i) {
+                C[i * incRowC + j * incColC] = alpha * AB[i + j * mr];
+            }
+        }
+    } else {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; ++i) {
+                C[i * incRowC + j * incColC] = beta * C[i * incRowC + j * incColC] + alpha * AB[i + j * mr];
+            }
+        }
+    }
+}
+
+//
+//  Same as dgemm_update_tile, for tiles where the columns of C are contiguous
+//  (incRowC == 1) and mr is a multiple of 4
+//
+ULM_TARGET("avx")
+static void
+dgemm_update_tile_avx(long mr, long nr,
+                      double alpha, const double *AB,
+                      double beta,
+                      double *C, long incColC) {
+    __m256d alpha_ = _mm256_set1_pd(alpha);
+    __m256d beta_ = _mm256_set1_pd(beta);
+    long i, j;
+
+    if (beta == 0.0) {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; i += 4) {
+                _mm256_storeu_pd(&C[i + j * incColC], _mm256_mul_pd(alpha_, _mm256_load_pd(&AB[i + j * mr])));
+            }
+        }
+    } else {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; i += 4) {
+                __m256d c = _mm256_mul_pd(beta_, _mm256_loadu_pd(&C[i + j * incColC]));
+                c = _mm256_add_pd(c, _mm256_mul_pd(alpha_, _mm256_load_pd(&AB[i + j * mr])));
+                _mm256_storeu_pd(&C[i + j * incColC], c);
+            }
+        }
+    }
+}
+
+//
+//  4x4 SSE2 micro kernel.  This is the original ulmBLAS kernel and runs on
+//  every x86-64 processor.
+//
+static void
+dgemm_micro_kernel_sse2(long kc,
+                        double alpha, const double *A, const double *B,
+                        double beta,
+                        double *C, long incRowC, long incColC) {
+    double ULM_ALIGNED(16) AB[4 * 4];
+
+    long l;
+
+//
+//  Compute AB = A*B
+//
+    register __m128d ab_00_11, ab_20_31;
+    register __m128d ab_01_10, ab_21_30;
+    register __m128d ab_02_13, ab_22_33;
+    register __m128d ab_03_12, ab_23_32;
+
+    register __m128d tmp0, tmp1, tmp2, tmp3;
+    register __m128d tmp4, tmp5, tmp6, tmp7;
+
+    tmp0 = _mm_load_pd(A);                                      // (1)
+    tmp1 = _mm_load_pd(A + 2);                                  // (2)
+    tmp2 = _mm_load_pd(B);                                      // (3)
+
+    ab_00_11 = _mm_setzero_pd();
+    ab_20_31 = _mm_setzero_pd();
+    ab_01_10 = _mm_setzero_pd();
+    ab_21_30 = _mm_setzero_pd();
+    ab_02_13 = _mm_setzero_pd();
+    ab_22_33 = _mm_setzero_pd();
+    ab_03_12 = _mm_setzero_pd();
+    ab_23_32 = _mm_setzero_pd();
+
+    for (l = 0; l < kc; ++l) {
+        tmp3 = _mm_load_pd(B + 2);
+
+        tmp4 = _mm_shuffle_pd(tmp2, tmp2, _MM_SHUFFLE2(0, 1));
+        tmp5 = _mm_shuffle_pd(tmp3, tmp3, _MM_SHUFFLE2(0, 1));
+
+        tmp6 = tmp2;
+        tmp2 = _mm_mul_pd(tmp2, tmp0);
+        tmp6 = _mm_mul_pd(tmp6, tmp1);
+        ab_00_11 = _mm_add_pd(ab_00_11, tmp2);
+        ab_20_31 = _mm_add_pd(ab_20_31, tmp6);
+
+        tmp7 = tmp4;
+        tmp4 = _mm_mul_pd(tmp4, tmp0);
+        tmp7 = _mm_mul_pd(tmp7, tmp1);
+        ab_01_10 = _mm_add_pd(ab_01_10, tmp4);
+        ab_21_30 = _mm_add_pd(ab_21_30, tmp7);
+
+        tmp2 = _mm_load_pd(B + 4);                              // (6)
+        tmp6 = tmp3;
+        tmp3 = _mm_mul_pd(tmp3, tmp0);
+        tmp6 = _mm_mul_pd(tmp6, tmp1);
+        ab_02_13 = _mm_add_pd(ab_02_13, tmp3);
+        ab_22_33 = _mm_add_pd(ab_22_33, tmp6);
+
+        tmp7 = tmp5;
+        tmp5 = _mm_mul_pd(tmp5, tmp0);
+        tmp0 = _mm_load_pd(A + 4);                              // (4)
+        tmp7 = _mm_mul_pd(tmp7, tmp1);
+        tmp1 = _mm_load_pd(A + 6);                              // (5)
+        ab_03_12 = _mm_add_pd(ab_03_12, tmp5);
+        ab_23_32 = _mm_add_pd(ab_23_32, tmp7);
+
+        A += 4;
+        B += 4;
+    }
+
+    _mm_storel_pd(&AB[0 + 0 * 4], ab_00_11);
+    _mm_storeh_pd(&AB[1 + 0 * 4], ab_01_10);
+    _mm_storel_pd(&AB[2 + 0 * 4], ab_20_31);
+    _mm_storeh_pd(&AB[3 + 0 * 4], ab_21_30);
+
+    _mm_storel_pd(&AB[0 + 1 * 4], ab_01_10);
+    _mm_storeh_pd(&AB[1 + 1 * 4], ab_00_11);
+    _mm_storel_pd(&AB[2 + 1 * 4], ab_21_30);
+    _mm_storeh_pd(&AB[3 + 1 * 4], ab_20_31);
+
+    _mm_storel_pd(&AB[0 + 2 * 4], ab_02_13);
+    _mm_storeh_pd(&AB[1 + 2 * 4], ab_03_12);
+    _mm_storel_pd(&AB[2 + 2 * 4], ab_22_33);
+    _mm_storeh_pd(&AB[3 + 2 * 4], ab_23_32);
+
+    _mm_storel_pd(&AB[0 + 3 * 4], ab_03_12);
+    _mm_storeh_pd(&AB[1 + 3 * 4], ab_02_13);
+    _mm_storel_pd(&AB[2 + 3 * 4], ab_23_32);
+    _mm_storeh_pd(&AB[3 + 3 * 4], ab_22_33);
+
+//
+//  Update C <- beta*C + alpha*AB (note: the case alpha==0.0 was already
+//                                 treated in the above layer dgemm_nn)
+//
+    dgemm_update_tile(4, 4, alpha, AB, beta, C, incRowC, incColC);
+}
+
+//
+//  8x6 AVX2 micro kernel.  Two YMM registers hold a column of the A panel and
+//  every element of the B panel is broadcast once, giving 12 FMA accumulators.
+//
+ULM_TARGET("avx2,fma")
+static void
+dgemm_micro_kernel_avx2(long kc,
+                        double alpha, const double *A, const double *B,
+                        double beta,
+                        double *C, long incRowC, long incColC) {
+    double ULM_ALIGNED(32) AB[8 * 6];
+
+    __m256d ab_0_0, ab_0_1, ab_0_2, ab_0_3, ab_0_4, ab_0_5;
+    __m256d ab_1_0, ab_1_1, ab_1_2, ab_1_3, ab_1_4, ab_1_5;
+    __m256d a0, a1, b;
+
+    long l;
+
+    ab_0_0 = ab_0_1 = ab_0_2 = ab_0_3 = ab_0_4 = ab_0_5 = _mm256_setzero_pd();
+    ab_1_0 = ab_1_1 = ab_1_2 = ab_1_3 = ab_1_4 = ab_1_5 = _mm256_setzero_pd();
+
+    for (l = 0; l < kc; ++l) {
+        a0 = _mm256_load_pd(A);
+        a1 = _mm256_load_pd(A + 4);
+
+        b = _mm256_broadcast_sd(B);
+        ab_0_0 = _mm256_fmadd_pd(a0, b, ab_0_0);
+        ab_1_0 = _mm256_fmadd_pd(a1, b, ab_1_0);
+
+        b = _mm256_broadcast_sd(B + 1);
+        ab_0_1 = _mm256_fmadd_pd(a0, b, ab_0_1);
+        ab_1_1 = _mm256_fmadd_pd(a1, b, ab_1_1);
+
+        b = _mm256_broadcast_sd(B + 2);
+        ab_0_2 = _mm256_fmadd_pd(a0, b, ab_0_2);
+        ab_1_2 = _mm256_fmadd_pd(a1, b, ab_1_2);
+
+        b = _mm256_broadcast_sd(B + 3);
+        ab_0_3 = _mm256_fmadd_pd(a0, b, ab_0_3);
+        ab_1_3 = _mm256_fmadd_pd(a1, b, ab_1_3);
+
+        b = _mm256_broadcast_sd(B + 4);
+        ab_0_4 = _mm256_fmadd_pd(a0, b, ab_0_4);
+        ab_1_4 = _mm256_fmadd_pd(a1, b, ab_1_4);
+
+        b = _mm256_broadcast_sd(B + 5);
+        ab_0_5 = _mm256_fmadd_pd(a0, b, ab_0_5);
+        ab_1_5 = _mm256_fmadd_pd(a1, b, ab_1_5);
+
+        A += 8;
+        B += 6;
+    }
+
+    _mm256_store_pd(&AB[0 + 0 * 8], ab_0_0);
+    _mm256_store_pd(&AB[4 + 0 * 8], ab_1_0);
+    _mm256_store_pd(&AB[0 + 1 * 8], ab_0_1);
+    _mm256_store_pd(&AB[4 + 1 * 8], ab_1_1);
+    _mm256_store_pd(&AB[0 + 2 * 8], ab_0_2);
+    _mm256_store_pd(&AB[4 + 2 * 8], ab_1_2);
+    _mm256_store_pd(&AB[0 + 3 * 8], ab_0_3);
+    _mm256_store_pd(&AB[4 + 3 * 8], ab_1_3);
+    _mm256_store_pd(&AB[0 + 4 * 8], ab_0_4);
+    _mm256_store_pd(&AB[4 + 4 * 8], ab_1_4);
+    _mm256_store_pd(&AB[0 + 5 * 8], ab_0_5);
+    _mm256_store_pd(&AB[4 + 5 * 8], ab_1_5);
+
+    if (incRowC == 1) {
+        dgemm_update_tile_avx(8, 6, alpha, AB, beta, C, incColC);
+    } else {
+        dgemm_update_tile(8, 6, alpha, AB, beta, C, incRowC, incColC);
+    }
+}
+
+//
+//  16x8 AVX-512 micro kernel.  Two ZMM registers hold a column of the A panel,
+//  giving 16 FMA accumulators out of the 32 ZMM registers.
+//
+ULM_TARGET("avx512f")
+static void
+dgemm_micro_kernel_avx512(long kc,
+                          double alpha, const double *A, const double *B,
+                          double beta,
+                          double *C, long incRowC, long incColC) {
+    double ULM_ALIGNED(64) AB[16 * 8];
+
+    __m512d ab_0_0, ab_0_1, ab_0_2, ab_0_3, ab_0_4, ab_0_5, ab_0_6, ab_0_7;
+    __m512d ab_1_0, ab_1_1, ab_1_2, ab_1_3, ab_1_4, ab_1_5, ab_1_6, ab_1_7;
+    __m512d a0, a1, b;
+
+    long l;
+
+    ab_0_0 = ab_0_1 = ab_0_2 = ab_0_3 = ab_0_4 = ab_0_5 = ab_0_6 = ab_0_7 = _mm512_setzero_pd();
+    ab_1_0 = ab_1_1 = ab_1_2 = ab_1_3 = ab_1_4 = ab_1_5 = ab_1_6 = ab_1_7 = _mm512_setzero_pd();
+
+    for (l = 0; l < kc; ++l) {
+        a0 = _mm512_load_pd(A);
+        a1 = _mm512_load_pd(A + 8);
+
+        b = _mm512_set1_pd(B[0]);
+        ab_0_0 = _mm512_fmadd_pd(a0, b, ab_0_0);
+        ab_1_0 = _mm512_fmadd_pd(a1, b, ab_1_0);
+
+        b = _mm512_set1_pd(B[1]);
+        ab_0_1 = _mm512_fmadd_pd(a0, b, ab_0_1);
+        ab_1_1 = _mm512_fmadd_pd(a1, b, ab_1_1);
+
+        b = _mm512_set1_pd(B[2]);
+        ab_0_2 = _mm512_fmadd_pd(a0, b, ab_0_2);
+        ab_1_2 = _mm512_fmadd_pd(a1, b, ab_1_2);
+
+        b = _mm512_set1_pd(B[3]);
+        ab_0_3 = _mm512_fmadd_pd(a0, b, ab_0_3);
+        ab_1_3 = _mm512_fmadd_pd(a1, b, ab_1_3);
+
+        b = _mm512_set1_pd(B[4]);
+        ab_0_4 = _mm512_fmadd_pd(a0, b, ab_0_4);
+        ab_1_4 = _mm512_fmadd_pd(a1, b, ab_1_4);
+
+        b = _mm512_set1_pd(B[5]);
+        ab_0_5 = _mm512_fmadd_pd(a0, b, ab_0_5);
+        ab_1_5 = _mm512_fmadd_pd(a1, b, ab_1_5);
+
+        b = _mm512_set1_pd(B[6]);
+        ab_0_6 = _mm512_fmadd_pd(a0, b, ab_0_6);
+        ab_1_6 = _mm512_fmadd_pd(a1, b, ab_1_6);
+
+        b = _mm512_set1_pd(B[7]);
+        ab_0_7 = _mm512_fmadd_pd(a0, b, ab_0_7);
+        ab_1_7 = _mm512_fmadd_pd(a1, b, ab_1_7);
+
+        A += 16;
+        B += 8;
+    }
+
+    _mm512_store_pd(&AB[0 + 0 * 16], ab_0_0);
+    _mm512_store_pd(&AB[8 + 0 * 16], ab_1_0);
+    _mm512_store_pd(&AB[0 + 1 * 16], ab_0_1);
+    _mm512_store_pd(&AB[8 + 1 * 16], ab_1_1);
+    _mm512_store_pd(&AB[0 + 2 * 16], ab_0_2);
+    _mm512_store_pd(&AB[8 + 2 * 16], ab_1_2);
+    _mm512_store_pd(&AB[0 + 3 * 16], ab_0_3);
+    _mm512_store_pd(&AB[8 + 3 * 16], ab_1_3);
+    _mm512_store_pd(&AB[0 + 4 * 16], ab_0_4);
+    _mm512_store_pd(&AB[8 + 4 * 16], ab_1_4);
+    _mm512_store_pd(&AB[0 + 5 * 16], ab_0_5);
+    _mm512_store_pd(&AB[8 + 5 * 16], ab_1_5);
+    _mm512_store_pd(&AB[0 + 6 * 16], ab_0_6);
+    _mm512_store_pd(&AB[8 + 6 * 16], ab_1_6);
+    _mm512_store_pd(&AB[0 + 7 * 16], ab_0_7);
+    _mm512_store_pd(&AB[8 + 7 * 16], ab_1_7);
+
+    if (incRowC == 1) {
+        dgemm_update_tile_avx(16, 8, alpha, AB, beta, C, incColC);
+    } else {
+        dgemm_update_tile(16, 8, alpha, AB, beta, C, incRowC, incColC);
+    }
+}
+
+//
+//  All kernels, best first.  The first kernel whose features are supported by
+//  the running processor is used.
+//
+static const struct ulm_dgemm_kernel ULM_DGEMM_KERNELS[] = {
+        {"avx512", 16, 8, CpuAVX512F,          dgemm_micro_kernel_avx512},
+        {"avx2",   8,  6, CpuAVX2 | CpuFMA,    dgemm_micro_kernel_avx2},
+        {"sse2",   4,  4, 0,                   dgemm_micro_kernel_sse2},
+};
+
+#define ULM_DGEMM_KERNEL_COUNT ((long) (sizeof(ULM_DGEMM_KERNELS) / sizeof(ULM_DGEMM_KERNELS[0])))
+
+//
+//  The kernel in use.  Set once when the module is imported.
+//
+static const struct ulm_dgemm_kernel *ULM_DGEMM_KERNEL = &ULM_DGEMM_KERNELS[ULM_DGEMM_KERNEL_COUNT - 1];
+
+//
+//  Pick the fastest kernel the processor supports.  The environment variable
+//  LIBPYMATH_GEMM_KERNEL can name a kernel to use instead (e.g. "sse2"), as
+//  long as the processor supports it.
+//
+static void
+ULMBLAS(dgemm_select_kernel)(void) {
+    int features = ulm_cpu_features();
+    const char *requested = getenv("LIBPYMATH_GEMM_KERNEL");
+    const struct ulm_dgemm_kernel *best = NULL;
+    long i;
+
+    for (i = 0; i < ULM_DGEMM_KERNEL_COUNT; ++i) {
+        const struct ulm_dgemm_kernel *kernel = &ULM_DGEMM_KERNELS[i];
+
+        if ((kernel->features & features) != kernel->features) {
+            continue;
+        }
+
+        if (best == NULL) {
+            best = kernel;
+        }
+
+        if (requested != NULL && strcmp(requested, kernel->name) == 0) {
+            ULM_DGEMM_KERNEL = kernel;
+            return;
+        }
+    }
+
+    if (best != NULL) {
+        ULM_DGEMM_KERNEL = best;
+    }
+}
+
+#endif // ULMBLAS_DGEMM_KERNELS_H
@@ -1,37 +1,47 @@
 #include "ulmblas.h"
+#include "dgemm_kernels.h"
+#include "workspace.h"
+#include "cacheinfo.h"
+#include "epilogue.h"
 #include <stdio.h>
-#include <emmintrin.h>
-#include <immintrin.h>
 
-#if defined(_MSC_VER) || (defined(WIN32) || defined(WIN64) || defined(_WIN32) || defined(_WIN64))
+//
+//  Block sizes of the three loops around the macro kernel.  A packed MC x KC
+//  block of A is reused for every micro panel of B, and a packed KC x NC block
+//  of B for every block of A, so they are sized to stay in L2 and L3.
+//
+struct ulm_dgemm_blocking {
+    long int mc;
+    long int kc;
+    long int nc;
+};
 
-#define MC  384
-#define KC  384
-#define NC  4096
+static struct ulm_dgemm_blocking ULM_DGEMM_BLOCKING = {384, 384, 4096};
 
-#define MR  4
-#define NR  4
+#define ULM_DGEMM_KC_MIN    32
+#define ULM_DGEMM_KC_MAX    2048
+#define ULM_DGEMM_MC_MAX    4096
+#define ULM_DGEMM_NC_MAX    16384
 
 //
-//  Local buffers for storing panels from A, B and C
+//  Only start another thread for every this many multiply-adds.  Smaller
+//  products finish before the extra threads would have started.
 //
-static double __declspec(align(16)) A_BUFFER[MC * KC];
-static double __declspec(align(16)) B_BUFFER[KC * NC];
-static double __declspec(align(16)) C_BUFFER[MR * NR];
+#define ULM_DGEMM_WORK_PER_THREAD  (1L << 18)
 
 //
 //  Packing complete panels from A (i.e. without padding)
 //
 static void
-pack_MRxk(long int k, const double *A, long int incRowA, long int incColA,
+pack_MRxk(long int mr, long int k, const double *A, long int incRowA, long int incColA,
           double *buffer) {
     long int i, j;
 
     for (j = 0; j < k; ++j) {
-        for (i = 0; i < MR; ++i) {
+        for (i = 0; i < mr; ++i) {
             buffer[i] = A[i * incRowA];
         }
-        buffer += MR;
+        buffer += mr;
         A += incColA;
     }
 }
@@ -40,27 +50,27 @@ pack_MRxk(long int k, const double *A, long int incRowA, long int incColA,
 //  Packing panels from A with padding if required
 //
 static void
-pack_A(long int mc, long int kc, const double *A, long int incRowA, long int incColA,
+pack_A(long int mr, long int mc, long int kc, const double *A, long int incRowA, long int incColA,
        double *buffer) {
-    long int mp = mc / MR;
-    long int _mr = mc % MR;
+    long int mp = mc / mr;
+    long int _mr = mc % mr;
 
     long int i, j;
 
     for (i = 0; i < mp; ++i) {
-        pack_MRxk(kc, A, incRowA, incColA, buffer);
-        buffer += kc * MR;
-        A += MR * incRowA;
+        pack_MRxk(mr, kc, A, incRowA, incColA, buffer);
+        buffer += kc * mr;
+        A += mr * incRowA;
     }
     if (_mr > 0) {
         for (j = 0; j < kc; ++j) {
             for (i = 0; i < _mr; ++i) {
                 buffer[i] = A[i * incRowA];
             }
-            for (i = _mr; i < MR; ++i) {
+            for (i = _mr; i < mr; ++i) {
                 buffer[i] = 0.0;
             }
-            buffer += MR;
+            buffer += mr;
             A += incColA;
         }
     }
@@ -70,15 +80,15 @@ pack_A(long int mc, long int kc, const double *A, long int incRowA, long int inc
 //  Packing complete panels from B (i.e. without padding)
 //
 static void
-pack_kxNR(long int k, const double *B, long int incRowB, long int incColB,
+pack_kxNR(long int nr, long int k, const double *B, long int incRowB, long int incColB,
           double *buffer) {
     long int i, j;
 
     for (i = 0; i < k; ++i) {
-        for (j = 0; j < NR; ++j) {
+        for (j = 0; j < nr; ++j) {
             buffer[j] = B[j * incColB];
         }
-        buffer += NR;
+        buffer += nr;
         B += incRowB;
     }
 }
@@ -87,161 +97,135 @@ pack_kxNR(long int k, const double *B, long int incRowB, long int incColB,
 //  Packing panels from B with padding if required
 //
 static void
-pack_B(long int kc, long int nc, const double *B, long int incRowB, long int incColB,
+pack_B(long int nr, long int kc, long int nc, const double *B, long int incRowB, long int incColB,
        double *buffer) {
-    long int np = nc / NR;
-    long int _nr = nc % NR;
+    long int np = nc / nr;
+    long int _nr = nc % nr;
 
     long int i, j;
 
     for (j = 0; j < np; ++j) {
-        pack_kxNR(kc, B, incRowB, incColB, buffer);
-        buffer += kc * NR;
-        B += NR * incColB;
+        pack_kxNR(nr, kc, B, incRowB, incColB, buffer);
+        buffer += kc * nr;
+        B += nr * incColB;
     }
     if (_nr > 0) {
         for (i = 0; i < kc; ++i) {
             for (j = 0; j < _nr; ++j) {
                 buffer[j] = B[j * incColB];
             }
-            for (j = _nr; j < NR; ++j) {
+            for (j = _nr; j < nr; ++j) {
                 buffer[j] = 0.0;
             }
-            buffer += NR;
+            buffer += nr;
             B += incRowB;
         }
     }
 }
 
 //
-//  Micro kernel for multiplying panels from A and B.
-//
-static void
-dgemm_micro_kernel(long kc,
-                   double alpha, const double *A, const double *B,
-                   double beta,
-                   double *C, long incRowC, long incColC) {
-    double __declspec(align(16)) AB[MR * NR];
-
-    long int i, j, l;
-
-//
-//  Compute AB = A*B
-//
-    register __m128d ab_00_11, ab_20_31;
-    register __m128d ab_01_10, ab_21_30;
-    register __m128d ab_02_13, ab_22_33;
-    register __m128d ab_03_12, ab_23_32;
-
-    register __m128d tmp0, tmp1, tmp2, tmp3;
-    register __m128d tmp4, tmp5, tmp6, tmp7;
-
-    tmp0 = _mm_load_pd(A);                                      // (1)
-    tmp1 = _mm_load_pd(A + 2);                                    // (2)
-    tmp2 = _mm_load_pd(B);                                      // (3)
-
-    ab_00_11 = _mm_setzero_pd();
-    ab_20_31 = _mm_setzero_pd();
-    ab_01_10 = _mm_setzero_pd();
-    ab_21_30 = _mm_setzero_pd();
-    ab_02_13 = _mm_setzero_pd();
-    ab_22_33 = _mm_setzero_pd();
-    ab_03_12 = _mm_setzero_pd();
-    ab_23_32 = _mm_setzero_pd();
-
-    for (l = 0; l < kc; ++l) {
-        tmp3 = _mm_load_pd(B + 2);
-
-        tmp4 = _mm_shuffle_pd(tmp2, tmp2, _MM_SHUFFLE2(0, 1));
-        tmp5 = _mm_shuffle_pd(tmp3, tmp3, _MM_SHUFFLE2(0, 1));
-
-        tmp6 = tmp2;
-        tmp2 = _mm_mul_pd(tmp2, tmp0);
-        tmp6 = _mm_mul_pd(tmp6, tmp1);
-        ab_00_11 = _mm_add_pd(ab_00_11, tmp2);
-        ab_20_31 = _mm_add_pd(ab_20_31, tmp6);
-
-        tmp7 = tmp4;
-        tmp4 = _mm_mul_pd(tmp4, tmp0);
-        tmp7 = _mm_mul_pd(tmp7, tmp1);
-        ab_01_10 = _mm_add_pd(ab_01_10, tmp4);
-        ab_21_30 = _mm_add_pd(ab_21_30, tmp7);
-
-        tmp2 = _mm_load_pd(B + 4);                                // (6)
-        tmp6 = tmp3;
-        tmp3 = _mm_mul_pd(tmp3, tmp0);
-        tmp6 = _mm_mul_pd(tmp6, tmp1);
-        ab_02_13 = _mm_add_pd(ab_02_13, tmp3);
-        ab_22_33 = _mm_add_pd(ab_22_33, tmp6);
-
-        tmp7 = tmp5;
-        tmp5 = _mm_mul_pd(tmp5, tmp0);
-        tmp0 = _mm_load_pd(A + 4);                                // (4)
-        tmp7 = _mm_mul_pd(tmp7, tmp1);
-        tmp1 = _mm_load_pd(A + 6);                                // (5)
-        ab_03_12 = _mm_add_pd(ab_03_12, tmp5);
-        ab_23_32 = _mm_add_pd(ab_23_32, tmp7);
-
-        A += 4;
-        B += 4;
+//  An operand packed ahead of time, for matrices used in many products.  The
+//  m x k matrix X is cut into blocks of mc rows and kc columns, and every block
+//  is stored as pack_A would store it with micro panels of r rows.  The blocks
+//  of a row follow each other, so all blocks before row block i hold mc rows
+//  and k columns.
+//
+//  The same layout serves both sides of a product: with r = MR and mc = MC it
+//  is the packed A, and with r = NR and mc = NC it is the packed B of a product
+//  with X = B^T.  A packed operand is only used while its geometry matches the
+//  current kernel and blocking, otherwise it is packed again as usual.
+//
+struct ulm_dgemm_packed {
+    long int m;
+    long int k;
+    long int r;
+    long int mc;
+    long int kc;
+    long int refs;
+    double *data;
+};
+
+//
+//  Pack X for the given micro panel height and block sizes.  Returns NULL if
+//  there is not enough memory.  The result starts with one reference.
+//
+static struct ulm_dgemm_packed *
+ulm_dgemm_pack(long int m, long int k, const double *X, long int incRowX, long int incColX,
+               long int r, long int mc, long int kc) {
+    struct ulm_dgemm_packed *packed;
+    long int mb = (m + mc - 1) / mc;
+    long int kb = (k + kc - 1) / kc;
+    long int i, l, rows, depth;
+    double *buffer;
+
+    packed = malloc(sizeof(struct ulm_dgemm_packed));
+    if (packed == NULL) {
+        return NULL;
     }
 
-    _mm_storel_pd(&AB[0 + 0 * 4], ab_00_11);
-    _mm_storeh_pd(&AB[1 + 0 * 4], ab_01_10);
-    _mm_storel_pd(&AB[2 + 0 * 4], ab_20_31);
-    _mm_storeh_pd(&AB[3 + 0 * 4], ab_21_30);
+    // Rows padded to whole panels, and the SSE2 kernel reads one step past the end
+    packed->data = ulm_malloc_aligned((size_t) ((m + r - 1) / r * r * k + MR_MAX + NR_MAX));
+    if (packed->data == NULL) {
+        free(packed);
+        return NULL;
+    }
 
-    _mm_storel_pd(&AB[0 + 1 * 4], ab_01_10);
-    _mm_storeh_pd(&AB[1 + 1 * 4], ab_00_11);
-    _mm_storel_pd(&AB[2 + 1 * 4], ab_21_30);
-    _mm_storeh_pd(&AB[3 + 1 * 4], ab_20_31);
+    packed->m = m;
+    packed->k = k;
+    packed->r = r;
+    packed->mc = mc;
+    packed->kc = kc;
+    packed->refs = 1;
 
-    _mm_storel_pd(&AB[0 + 2 * 4], ab_02_13);
-    _mm_storeh_pd(&AB[1 + 2 * 4], ab_03_12);
-    _mm_storel_pd(&AB[2 + 2 * 4], ab_22_33);
-    _mm_storeh_pd(&AB[3 + 2 * 4], ab_23_32);
+    buffer = packed->data;
+    for (i = 0; i < mb; ++i) {
+        rows = (i != mb - 1 || m % mc == 0) ? mc : m % mc;
 
-    _mm_storel_pd(&AB[0 + 3 * 4], ab_03_12);
-    _mm_storeh_pd(&AB[1 + 3 * 4], ab_02_13);
-    _mm_storel_pd(&AB[2 + 3 * 4], ab_23_32);
-    _mm_storeh_pd(&AB[3 + 3 * 4], ab_22_33);
+        for (l = 0; l < kb; ++l) {
+            depth = (l != kb - 1 || k % kc == 0) ? kc : k % kc;
 
-//
-//  Update C <- beta*C
-//
-    if (beta == 0.0) {
-        for (j = 0; j < NR; ++j) {
-            for (i = 0; i < MR; ++i) {
-                C[i * incRowC + j * incColC] = 0.0;
-            }
-        }
-    } else if (beta != 1.0) {
-        for (j = 0; j < NR; ++j) {
-            for (i = 0; i < MR; ++i) {
-                C[i * incRowC + j * incColC] *= beta;
-            }
+            pack_A(r, rows, depth, &X[i * mc * incRowX + l * kc * incColX], incRowX, incColX, buffer);
+            buffer += (rows + r - 1) / r * r * depth;
         }
     }
 
+    return packed;
+}
+
 //
-//  Update C <- C + alpha*AB (note: the case alpha==0.0 was already treated in
-//                                  the above layer dgemm_nn)
+//  Drop a reference to a packed operand, freeing it with the last one
 //
-    if (alpha == 1.0) {
-        for (j = 0; j < NR; ++j) {
-            for (i = 0; i < MR; ++i) {
-                C[i * incRowC + j * incColC] += AB[i + j * MR];
-            }
-        }
-    } else {
-        for (j = 0; j < NR; ++j) {
-            for (i = 0; i < MR; ++i) {
-                C[i * incRowC + j * incColC] += alpha * AB[i + j * MR];
-            }
-        }
+static void
+ulm_dgemm_packed_release(struct ulm_dgemm_packed *packed) {
+    if (packed != NULL && --packed->refs == 0) {
+        ulm_free_aligned(packed->data);
+        free(packed);
     }
 }
 
+//
+//  Whether a packed m x k operand can stand in for packing with panels of r
+//  rows and the given block sizes
+//
+static int
+ulm_dgemm_packed_matches(const struct ulm_dgemm_packed *packed, long int m, long int k,
+                         long int r, long int mc, long int kc) {
+    return packed != NULL && packed->m == m && packed->k == k
+           && packed->r == r && packed->mc == mc && packed->kc == kc;
+}
+
+//
+//  The packed block in row block i and column block l
+//
+static const double *
+ulm_dgemm_packed_block(const struct ulm_dgemm_packed *packed, long int i, long int l) {
+    long int mb = (packed->m + packed->mc - 1) / packed->mc;
+    long int rows = (i != mb - 1 || packed->m % packed->mc == 0) ? packed->mc : packed->m % packed->mc;
+    long int r = packed->r;
+
+    return &packed->data[i * packed->mc * packed->k + (rows + r - 1) / r * r * l * packed->kc];
+}
+
 //
 //  Compute Y += alpha*X
 //
@@ -302,17 +286,29 @@ dgescal(long int m,
 
 //
 //  Macro Kernel for the multiplication of blocks of A and B.  We assume that
-//  these blocks were previously packed to buffers A_BUFFER and B_BUFFER.
+//  these blocks were previously packed to the buffers _A and _B.  Only the
+//  micro panels j0 <= j < j1 of B are used, so that threads sharing the same
+//  packed blocks can split the columns of C between them.
 //
 static void
-dgemm_macro_kernel(long int mc,
+dgemm_macro_kernel(const struct ulm_dgemm_kernel *kernel,
+                   long int mc,
                    long int nc,
                    long int kc,
+                   long int j0,
+                   long int j1,
                    double alpha,
+                   const double *_A,
+                   const double *_B,
                    double beta,
                    double *C,
                    long int incRowC,
                    long int incColC) {
+    const long int MR = kernel->mr;
+    const long int NR = kernel->nr;
+
+    double ULM_ALIGNED(64) _C[MR_MAX * NR_MAX];
+
     long int mp = (mc + MR - 1) / MR;
     long int np = (nc + NR - 1) / NR;
 
@@ -322,25 +318,24 @@ dgemm_macro_kernel(long int mc,
     long int mr, nr;
     long int i, j;
 
-#   pragma omp parallel for private(j, nr, i, mr) shared(np, _nr, mp, _mr, kc, alpha, A_BUFFER, B_BUFFER, C_BUFFER, C, beta, incRowC, incColC) default(none)
-    for (j = 0; j < np; ++j) {
+    for (j = j0; j < j1; ++j) {
         nr = (j != np - 1 || _nr == 0) ? NR : _nr;
 
         for (i = 0; i < mp; ++i) {
             mr = (i != mp - 1 || _mr == 0) ? MR : _mr;
 
             if (mr == MR && nr == NR) {
-                dgemm_micro_kernel(kc, alpha, &A_BUFFER[i * kc * MR], &B_BUFFER[j * kc * NR],
-                                   beta,
-                                   &C[i * MR * incRowC + j * NR * incColC],
-                                   incRowC, incColC);
+                kernel->kernel(kc, alpha, &_A[i * kc * MR], &_B[j * kc * NR],
+                               beta,
+                               &C[i * MR * incRowC + j * NR * incColC],
+                               incRowC, incColC);
             } else {
-                dgemm_micro_kernel(kc, alpha, &A_BUFFER[i * kc * MR], &B_BUFFER[j * kc * NR],
-                                   0.0,
-                                   C_BUFFER, 1, MR);
+                kernel->kernel(kc, alpha, &_A[i * kc * MR], &_B[j * kc * NR],
+                               0.0,
+                               _C, 1, MR);
                 dgescal(mr, nr, beta,
                         &C[i * MR * incRowC + j * NR * incColC], incRowC, incColC);
-                dgeaxpy(mr, nr, 1.0, C_BUFFER, 1, MR,
+                dgeaxpy(mr, nr, 1.0, _C, 1, MR,
                         &C[i * MR * incRowC + j * NR * incColC], incRowC, incColC);
             }
         }
@@ -348,475 +343,357 @@ dgemm_macro_kernel(long int mc,
 }
 
 //
-//  Compute C <- beta*C + alpha*A*B
+//  Round the block size b to whole micro tiles of R rows or columns, between R
+//  and max.  b is rounded up, unless that would take it past max, in which
+//  case it is rounded down instead.
 //
-void
-ULMBLAS(dgemm_nn)(long int m,
-                  long int n,
-                  long int k,
-                  double alpha,
-                  const double *A,
-                  long int incRowA,
-                  long int incColA,
-                  const double *B,
-                  long int incRowB,
-                  long int incColB,
-                  double beta,
-                  double *C,
-                  long int incRowC,
-                  long int incColC) {
-    long int mb = (m + MC - 1) / MC;
-    long int nb = (n + NC - 1) / NC;
-    long int kb = (k + KC - 1) / KC;
-
-    long int _mc = m % MC;
-    long int _nc = n % NC;
-    long int _kc = k % KC;
-
-    long int mc, nc, kc;
-    long int i, j, l;
-
-    double _beta;
+static long int
+ulm_dgemm_round_block(long int b, long int R, long int max) {
+    b = (b < R) ? R : (b > max) ? max : b;
+    b = (b + R - 1) / R * R;
 
-    if (alpha == 0.0 || k == 0) {
-        dgescal(m, n, beta, C, incRowC, incColC);
-        return;
-    }
-
-    for (j = 0; j < nb; ++j) {
-        nc = (j != nb - 1 || _nc == 0) ? NC : _nc;
-
-        for (l = 0; l < kb; ++l) {
-            kc = (l != kb - 1 || _kc == 0) ? KC : _kc;
-            _beta = (l == 0) ? beta : 1.0;
-
-            pack_B(kc, nc,
-                   &B[l * KC * incRowB + j * NC * incColB], incRowB, incColB,
-                   B_BUFFER);
-
-            for (i = 0; i < mb; ++i) {
-                mc = (i != mb - 1 || _mc == 0) ? MC : _mc;
-
-                pack_A(mc, kc,
-                       &A[i * MC * incRowA + l * KC * incColA], incRowA, incColA,
-                       A_BUFFER);
-
-                dgemm_macro_kernel(mc, nc, kc, alpha, _beta,
-                                   &C[i * MC * incRowC + j * NC * incColC],
-                                   incRowC, incColC);
-            }
-        }
-    }
+    return (b > max) ? max / R * R : b;
 }
 
-#else
+//
+//  Set the block sizes used by dgemm_nn.  mc and nc are rounded to whole micro
+//  tiles of the current kernel, and all three are clamped to a range the
+//  packing buffers are happy with.
+//
+static void
+ULMBLAS(dgemm_set_blocking)(long int mc, long int kc, long int nc) {
+    const long int MR = ULM_DGEMM_KERNEL->mr;
+    const long int NR = ULM_DGEMM_KERNEL->nr;
 
-#define MC  384
-#define KC  384
-#define NC  4096
+    kc = (kc < ULM_DGEMM_KC_MIN) ? ULM_DGEMM_KC_MIN : (kc > ULM_DGEMM_KC_MAX) ? ULM_DGEMM_KC_MAX : kc;
 
-#define MR  4
-#define NR  4
+    ULM_DGEMM_BLOCKING.mc = ulm_dgemm_round_block(mc, MR, ULM_DGEMM_MC_MAX);
+    ULM_DGEMM_BLOCKING.kc = kc;
+    ULM_DGEMM_BLOCKING.nc = ulm_dgemm_round_block(nc, NR, ULM_DGEMM_NC_MAX);
+}
 
 //
-//  Local buffers for storing panels from A, B and C
+//  Derive the block sizes from the cache sizes and the current kernel:
 //
-static double _A[MC*KC] __attribute__ ((aligned (16)));
-static double _B[KC*NC] __attribute__ ((aligned (16)));
-static double _C[MR*NR] __attribute__ ((aligned (16)));
-
+//    - a KC x NR micro panel of B fills half of L1, leaving the rest for the
+//      streamed micro panel of A and the tile of C
+//    - the packed MC x KC block of A fills half of L2
+//    - the packed KC x NC block of B fills half of L3
 //
-//  Packing complete panels from A (i.e. without padding)
+//  Must be called again whenever ULM_DGEMM_KERNEL changes.
 //
 static void
-pack_MRxk(int k, const double *A, int incRowA, int incColA,
-          double *buffer)
-{
-    int i, j;
-
-    for (j=0; j<k; ++j) {
-        for (i=0; i<MR; ++i) {
-            buffer[i] = A[i*incRowA];
-        }
-        buffer += MR;
-        A      += incColA;
-    }
-}
+ULMBLAS(dgemm_auto_blocking)(void) {
+    struct ulm_cache_info cache = ulm_cache_info();
+    const long int NR = ULM_DGEMM_KERNEL->nr;
+    long int mc, kc, nc;
 
-//
-//  Packing panels from A with padding if required
-//
-static void
-pack_A(int mc, int kc, const double *A, int incRowA, int incColA,
-       double *buffer)
-{
-    int mp  = mc / MR;
-    int _mr = mc % MR;
-
-    int i, j;
-
-    for (i=0; i<mp; ++i) {
-        pack_MRxk(kc, A, incRowA, incColA, buffer);
-        buffer += kc*MR;
-        A      += MR*incRowA;
-    }
-    if (_mr>0) {
-        for (j=0; j<kc; ++j) {
-            for (i=0; i<_mr; ++i) {
-                buffer[i] = A[i*incRowA];
-            }
-            for (i=_mr; i<MR; ++i) {
-                buffer[i] = 0.0;
-            }
-            buffer += MR;
-            A      += incColA;
-        }
-    }
+    kc = cache.l1 / 2 / (NR * (long int) sizeof(double));
+    kc = kc / 8 * 8;
+    kc = (kc < ULM_DGEMM_KC_MIN) ? ULM_DGEMM_KC_MIN : (kc > ULM_DGEMM_KC_MAX) ? ULM_DGEMM_KC_MAX : kc;
+
+    mc = cache.l2 / 2 / (kc * (long int) sizeof(double));
+    nc = cache.l3 / 2 / (kc * (long int) sizeof(double));
+
+    ULMBLAS(dgemm_set_blocking)(mc, kc, nc);
 }
 
 //
-//  Packing complete panels from B (i.e. without padding)
+//  Largest divisor of n that is at most limit
 //
-static void
-pack_kxNR(int k, const double *B, int incRowB, int incColB,
-          double *buffer)
-{
-    int i, j;
-
-    for (i=0; i<k; ++i) {
-        for (j=0; j<NR; ++j) {
-            buffer[j] = B[j*incColB];
+static long int
+ulm_divisor_at_most(long int n, long int limit) {
+    long int d;
+
+    for (d = (limit < n) ? limit : n; d > 1; --d) {
+        if (n % d == 0) {
+            return d;
         }
-        buffer += NR;
-        B      += incRowB;
     }
+    return 1;
 }
 
 //
-//  Packing panels from B with padding if required
+//  Split a team of threads over the three loops around the macro kernel:
+//  jcWays groups take different NC column blocks (each with its own packed B),
+//  each of those is split into icWays groups taking different MC row blocks
+//  (each with its own packed A) and the jrWays threads of a group share the
+//  micro panels of B.  Whole blocks are handed out first, as they need no
+//  synchronisation between threads, and jc is only split when C is wide enough
+//  for more than one block.
 //
 static void
-pack_B(int kc, int nc, const double *B, int incRowB, int incColB,
-       double *buffer)
-{
-    int np  = nc / NR;
-    int _nr = nc % NR;
-
-    int i, j;
-
-    for (j=0; j<np; ++j) {
-        pack_kxNR(kc, B, incRowB, incColB, buffer);
-        buffer += kc*NR;
-        B      += NR*incColB;
-    }
-    if (_nr>0) {
-        for (i=0; i<kc; ++i) {
-            for (j=0; j<_nr; ++j) {
-                buffer[j] = B[j*incColB];
-            }
-            for (j=_nr; j<NR; ++j) {
-                buffer[j] = 0.0;
-            }
-            buffer += NR;
-            B      += incRowB;
-        }
-    }
+ulm_dgemm_partition(long int threads, long int mb, long int nb,
+                    long int maxJcWays, long int maxIcWays,
+                    long int *jcWays, long int *icWays, long int *jrWays) {
+    long int rest, limit;
+
+    *jcWays = ulm_divisor_at_most(threads, (nb < maxJcWays) ? nb : maxJcWays);
+    rest = threads / *jcWays;
+
+    limit = maxIcWays / *jcWays;
+    *icWays = ulm_divisor_at_most(rest, (mb < limit) ? mb : limit);
+    *jrWays = rest / *icWays;
 }
 
 //
-//  Micro kernel for multiplying panels from A and B.
-//
-static void
-dgemm_micro_kernel(long kc,
-                   double alpha, const double *A, const double *B,
-                   double beta,
-                   double *C, long incRowC, long incColC)
-{
-    double AB[MR*NR] __attribute__ ((aligned (16)));
-
-    int i, j, l;
-
-//
-//  Compute AB = A*B
-//
-    register __m128d ab_00_11, ab_20_31;
-    register __m128d ab_01_10, ab_21_30;
-    register __m128d ab_02_13, ab_22_33;
-    register __m128d ab_03_12, ab_23_32;
-
-    register __m128d tmp0, tmp1, tmp2, tmp3;
-    register __m128d tmp4, tmp5, tmp6, tmp7;
-
-    tmp0     = _mm_load_pd(A);                                      // (1)
-    tmp1     = _mm_load_pd(A+2);                                    // (2)
-    tmp2     = _mm_load_pd(B);                                      // (3)
-
-    ab_00_11 = _mm_setzero_pd(); ab_20_31 = _mm_setzero_pd();
-    ab_01_10 = _mm_setzero_pd(); ab_21_30 = _mm_setzero_pd();
-    ab_02_13 = _mm_setzero_pd(); ab_22_33 = _mm_setzero_pd();
-    ab_03_12 = _mm_setzero_pd(); ab_23_32 = _mm_setzero_pd();
-
-    for (l=0; l<kc; ++l) {
-        tmp3     = _mm_load_pd(B+2);
-
-        tmp4     = _mm_shuffle_pd(tmp2, tmp2, _MM_SHUFFLE2(0, 1));
-        tmp5     = _mm_shuffle_pd(tmp3, tmp3, _MM_SHUFFLE2(0, 1));
-
-        tmp6     = tmp2;
-        tmp2     = _mm_mul_pd(tmp2, tmp0);
-        tmp6     = _mm_mul_pd(tmp6, tmp1);
-        ab_00_11 = _mm_add_pd(ab_00_11, tmp2);
-        ab_20_31 = _mm_add_pd(ab_20_31, tmp6);
-
-        tmp7     = tmp4;
-        tmp4     = _mm_mul_pd(tmp4, tmp0);
-        tmp7     = _mm_mul_pd(tmp7, tmp1);
-        ab_01_10 = _mm_add_pd(ab_01_10, tmp4);
-        ab_21_30 = _mm_add_pd(ab_21_30, tmp7);
-
-        tmp2     = _mm_load_pd(B+4);                                // (6)
-        tmp6     = tmp3;
-        tmp3     = _mm_mul_pd(tmp3, tmp0);
-        tmp6     = _mm_mul_pd(tmp6, tmp1);
-        ab_02_13 = _mm_add_pd(ab_02_13, tmp3);
-        ab_22_33 = _mm_add_pd(ab_22_33, tmp6);
-
-        tmp7     = tmp5;
-        tmp5     = _mm_mul_pd(tmp5, tmp0);
-        tmp0     = _mm_load_pd(A+4);                                // (4)
-        tmp7     = _mm_mul_pd(tmp7, tmp1);
-        tmp1     = _mm_load_pd(A+6);                                // (5)
-        ab_03_12 = _mm_add_pd(ab_03_12, tmp5);
-        ab_23_32 = _mm_add_pd(ab_23_32, tmp7);
-
-        A += 4;
-        B += 4;
-    }
+//  Compute C <- act(beta*C + alpha*A*B + bias) using up to `threads` threads
+//  (the OpenMP default if threads <= 0), where the bias and activation come
+//  from the epilogue ep (nothing is done if ep is NULL).  Each thread applies
+//  the epilogue to its own micro panels of C as soon as their last KC block
+//  has been added, so C is not read a second time after the product.
+//
+//  packedA and packedB may hold A and B^T packed ahead of time, see
+//  ulm_dgemm_pack, and are used instead of packing them here if their geometry
+//  matches.  Either may be NULL.
+//
+//  The packed panels of A and B live in buffers owned by this call, so any
+//  number of threads may run dgemm_nn at the same time.  Returns 0 on success
+//  and -1 if the buffers could not be allocated, in which case C is unchanged.
+//
+int
+ULMBLAS(dgemm_nn_ep)(long int m,
+                     long int n,
+                     long int k,
+                     double alpha,
+                     const double *A,
+                     long int incRowA,
+                     long int incColA,
+                     const double *B,
+                     long int incRowB,
+                     long int incColB,
+                     double beta,
+                     double *C,
+                     long int incRowC,
+                     long int incColC,
+                     int threads,
+                     const struct ulm_epilogue *ep,
+                     const struct ulm_dgemm_packed *packedA,
+                     const struct ulm_dgemm_packed *packedB) {
+    const struct ulm_dgemm_kernel *kernel = ULM_DGEMM_KERNEL;
+    const struct ulm_dgemm_blocking blocking = ULM_DGEMM_BLOCKING;
+    const long int MC = blocking.mc;
+    const long int KC = blocking.kc;
+    const long int NC = blocking.nc;
+
+    double *_A, *_B;
 
-    _mm_storel_pd(&AB[0+0*4], ab_00_11);
-    _mm_storeh_pd(&AB[1+0*4], ab_01_10);
-    _mm_storel_pd(&AB[2+0*4], ab_20_31);
-    _mm_storeh_pd(&AB[3+0*4], ab_21_30);
+    long int mb = (m + MC - 1) / MC;
+    long int nb = (n + NC - 1) / NC;
+    long int kb = (k + KC - 1) / KC;
 
-    _mm_storel_pd(&AB[0+1*4], ab_01_10);
-    _mm_storeh_pd(&AB[1+1*4], ab_00_11);
-    _mm_storel_pd(&AB[2+1*4], ab_21_30);
-    _mm_storeh_pd(&AB[3+1*4], ab_20_31);
+    long int _mc = m % MC;
+    long int _nc = n % NC;
+    long int _kc = k % KC;
 
-    _mm_storel_pd(&AB[0+2*4], ab_02_13);
-    _mm_storeh_pd(&AB[1+2*4], ab_03_12);
-    _mm_storel_pd(&AB[2+2*4], ab_22_33);
-    _mm_storeh_pd(&AB[3+2*4], ab_23_32);
+    long int mcMax, ncMax, kcMax;
+    long int sizeA, sizeB;
+    long int jcWays, icWays, jrWays;
+    long int nthreads;
+    struct ulm_epilogue epT;
 
-    _mm_storel_pd(&AB[0+3*4], ab_03_12);
-    _mm_storeh_pd(&AB[1+3*4], ab_02_13);
-    _mm_storel_pd(&AB[2+3*4], ab_23_32);
-    _mm_storeh_pd(&AB[3+3*4], ab_22_33);
+    if (alpha == 0.0 || k == 0) {
+        dgescal(m, n, beta, C, incRowC, incColC);
+        ulm_epilogue_apply(ep, m, n, 0, 0, C, incRowC, incColC);
+        return 0;
+    }
 
 //
-//  Update C <- beta*C
+//  The micro kernels write whole columns of a tile at once, so a row major C
+//  is handled as C^T <- beta*C^T + alpha*B^T*A^T
 //
-    if (beta==0.0) {
-        for (j=0; j<NR; ++j) {
-            for (i=0; i<MR; ++i) {
-                C[i*incRowC+j*incColC] = 0.0;
-            }
-        }
-    } else if (beta!=1.0) {
-        for (j=0; j<NR; ++j) {
-            for (i=0; i<MR; ++i) {
-                C[i*incRowC+j*incColC] *= beta;
-            }
-        }
+    if (incColC == 1 && incRowC != 1) {
+        return ULMBLAS(dgemm_nn_ep)(n, m, k,
+                                    alpha,
+                                    B, incColB, incRowB,
+                                    A, incColA, incRowA,
+                                    beta,
+                                    C, incColC, incRowC,
+                                    threads,
+                                    ulm_epilogue_transposed(ep, &epT),
+                                    packedB, packedA);
     }
 
-//
-//  Update C <- C + alpha*AB (note: the case alpha==0.0 was already treated in
-//                                  the above layer dgemm_nn)
-//
-    if (alpha==1.0) {
-        for (j=0; j<NR; ++j) {
-            for (i=0; i<MR; ++i) {
-                C[i*incRowC+j*incColC] += AB[i+j*MR];
-            }
-        }
-    } else {
-        for (j=0; j<NR; ++j) {
-            for (i=0; i<MR; ++i) {
-                C[i*incRowC+j*incColC] += alpha*AB[i+j*MR];
-            }
-        }
+    if (!ulm_dgemm_packed_matches(packedA, m, k, kernel->mr, MC, KC)) {
+        packedA = NULL;
+    }
+    if (!ulm_dgemm_packed_matches(packedB, n, k, kernel->nr, NC, KC)) {
+        packedB = NULL;
     }
-}
 
-//
-//  Compute Y += alpha*X
-//
-static void
-dgeaxpy(int           m,
-        int           n,
-        double        alpha,
-        const double  *X,
-        int           incRowX,
-        int           incColX,
-        double        *Y,
-        int           incRowY,
-        int           incColY)
-{
-    int i, j;
-
-
-    if (alpha!=1.0) {
-        for (j=0; j<n; ++j) {
-            for (i=0; i<m; ++i) {
-                Y[i*incRowY+j*incColY] += alpha*X[i*incRowX+j*incColX];
-            }
-        }
-    } else {
-        for (j=0; j<n; ++j) {
-            for (i=0; i<m; ++i) {
-                Y[i*incRowY+j*incColY] += X[i*incRowX+j*incColX];
-            }
-        }
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
     }
-}
+#endif
 
-//
-//  Compute X *= alpha
-//
-static void
-dgescal(int     m,
-        int     n,
-        double  alpha,
-        double  *X,
-        int     incRowX,
-        int     incColX)
-{
-    int i, j;
-
-    if (alpha!=0.0) {
-        for (j=0; j<n; ++j) {
-            for (i=0; i<m; ++i) {
-                X[i*incRowX+j*incColX] *= alpha;
-            }
-        }
-    } else {
-        for (j=0; j<n; ++j) {
-            for (i=0; i<m; ++i) {
-                X[i*incRowX+j*incColX] = 0.0;
-            }
-        }
+    nthreads = 1 + (long int) ((double) m * (double) n * (double) k / ULM_DGEMM_WORK_PER_THREAD);
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
     }
-}
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+    ulm_dgemm_partition(nthreads, mb, nb, nb, mb * nb, &jcWays, &icWays, &jrWays);
 
 //
-//  Macro Kernel for the multiplication of blocks of A and B.  We assume that
-//  these blocks were previously packed to buffers _A and _B.
+//  Only allocate what the largest block of this product needs.  The panels
+//  are padded up to a whole micro tile, and the SSE2 kernel reads one step
+//  past the end of its panels.
 //
-static void
-dgemm_macro_kernel(int     mc,
-                   int     nc,
-                   int     kc,
-                   double  alpha,
-                   double  beta,
-                   double  *C,
-                   int     incRowC,
-                   int     incColC)
-{
-    int mp = (mc+MR-1) / MR;
-    int np = (nc+NR-1) / NR;
-
-    int _mr = mc % MR;
-    int _nr = nc % NR;
-
-    int mr, nr;
-    int i, j;
-
-    for (j=0; j<np; ++j) {
-        nr    = (j!=np-1 || _nr==0) ? NR : _nr;
-
-        for (i=0; i<mp; ++i) {
-            mr    = (i!=mp-1 || _mr==0) ? MR : _mr;
-
-            if (mr==MR && nr==NR) {
-                dgemm_micro_kernel(kc, alpha, &_A[i*kc*MR], &_B[j*kc*NR],
-                                   beta,
-                                   &C[i*MR*incRowC+j*NR*incColC],
-                                   incRowC, incColC);
-            } else {
-                dgemm_micro_kernel(kc, alpha, &_A[i*kc*MR], &_B[j*kc*NR],
-                                   0.0,
-                                   _C, 1, MR);
-                dgescal(mr, nr, beta,
-                        &C[i*MR*incRowC+j*NR*incColC], incRowC, incColC);
-                dgeaxpy(mr, nr, 1.0, _C, 1, MR,
-                        &C[i*MR*incRowC+j*NR*incColC], incRowC, incColC);
-            }
-        }
+    mcMax = (mb > 1) ? MC : m;
+    ncMax = (nb > 1) ? NC : n;
+    kcMax = (kb > 1) ? KC : k;
+
+    sizeA = (mcMax + kernel->mr) * kcMax + MR_MAX;
+    sizeB = kcMax * (ncMax + kernel->nr) + NR_MAX;
+
+    _A = ulm_malloc_aligned((size_t) ((packedA != NULL) ? 0 : sizeA * jcWays * icWays));
+    _B = ulm_malloc_aligned((size_t) ((packedB != NULL) ? 0 : sizeB * jcWays));
+
+    if (_A == NULL || _B == NULL) {
+        ulm_free_aligned(_A);
+        ulm_free_aligned(_B);
+        return -1;
     }
-}
+
+#   pragma omp parallel num_threads(nthreads) default(shared)
+    {
+        const long int MR = kernel->mr;
+        const long int NR = kernel->nr;
+
+        long int team = 1, tid = 0;
+        long int jcw = jcWays, icw = icWays, jrw = jrWays;
+        long int jcGroup, icGroup, jrIndex;
+        long int jRounds, iRounds;
+        long int jr, ir, i, j, l, p;
+        long int mc, nc, kc, mp, np;
+        double _beta;
+        double *myA, *myB;
+        const double *curA, *curB;
+
+#ifdef _OPENMP
+        team = omp_get_num_threads();
+        tid = omp_get_thread_num();
+
+        // The runtime may give us fewer threads than asked for
+        if (team != nthreads) {
+            ulm_dgemm_partition(team, mb, nb, jcWays, jcWays * icWays, &jcw, &icw, &jrw);
+        }
+#endif
+
+        jcGroup = tid / (icw * jrw);
+        icGroup = (tid / jrw) % icw;
+        jrIndex = tid % jrw;
+
+        myB = (packedB != NULL) ? _B : &_B[jcGroup * sizeB];
+        myA = (packedA != NULL) ? _A : &_A[(jcGroup * icw + icGroup) * sizeA];
+
+        jRounds = (nb + jcw - 1) / jcw;
+        iRounds = (mb + icw - 1) / icw;
 
 //
-//  Compute C <- beta*C + alpha*A*B
-//
-void
-ULMBLAS(dgemm_nn)(int            m,
-                  int            n,
-                  int            k,
-                  double         alpha,
-                  const double   *A,
-                  int            incRowA,
-                  int            incColA,
-                  const double   *B,
-                  int            incRowB,
-                  int            incColB,
-                  double         beta,
-                  double         *C,
-                  int            incRowC,
-                  int            incColC)
-{
-    int mb = (m+MC-1) / MC;
-    int nb = (n+NC-1) / NC;
-    int kb = (k+KC-1) / KC;
-
-    int _mc = m % MC;
-    int _nc = n % NC;
-    int _kc = k % KC;
-
-    int mc, nc, kc;
-    int i, j, l;
-
-    double _beta;
-
-    if (alpha==0.0 || k==0) {
-        dgescal(m, n, beta, C, incRowC, incColC);
-        return;
-    }
+//      Every thread runs the same number of rounds, so all of them reach each
+//      barrier.  Groups left without a block in a round just wait.
+//
+        for (jr = 0; jr < jRounds; ++jr) {
+            j = jr * jcw + jcGroup;
+            nc = (j >= nb) ? 0 : (j != nb - 1 || _nc == 0) ? NC : _nc;
+            np = (nc + NR - 1) / NR;
+
+            for (l = 0; l < kb; ++l) {
+                kc = (l != kb - 1 || _kc == 0) ? KC : _kc;
+                _beta = (l == 0) ? beta : 1.0;
+
+                // The icw * jrw threads of a jc group pack B together
+                curB = (packedB != NULL && nc > 0) ? ulm_dgemm_packed_block(packedB, j, l) : myB;
+                for (p = tid % (icw * jrw); p < np && curB == myB; p += icw * jrw) {
+                    pack_B(NR, kc, (p != np - 1 || nc % NR == 0) ? NR : nc % NR,
+                           &B[l * KC * incRowB + (j * NC + p * NR) * incColB], incRowB, incColB,
+                           &myB[p * kc * NR]);
+                }
+
+#               pragma omp barrier
 
-    for (j=0; j<nb; ++j) {
-        nc = (j!=nb-1 || _nc==0) ? NC : _nc;
+                for (ir = 0; ir < iRounds; ++ir) {
+                    i = ir * icw + icGroup;
+                    mc = (i >= mb || nc == 0) ? 0 : (i != mb - 1 || _mc == 0) ? MC : _mc;
+                    mp = (mc + MR - 1) / MR;
 
-        for (l=0; l<kb; ++l) {
-            kc    = (l!=kb-1 || _kc==0) ? KC   : _kc;
-            _beta = (l==0) ? beta : 1.0;
+                    // The jrw threads of an ic group pack A together
+                    curA = (packedA != NULL && mc > 0) ? ulm_dgemm_packed_block(packedA, i, l) : myA;
+                    for (p = jrIndex; p < mp && curA == myA; p += jrw) {
+                        pack_A(MR, (p != mp - 1 || mc % MR == 0) ? MR : mc % MR, kc,
+                               &A[(i * MC + p * MR) * incRowA + l * KC * incColA], incRowA, incColA,
+                               &myA[p * kc * MR]);
+                    }
 
-            pack_B(kc, nc,
-                   &B[l*KC*incRowB+j*NC*incColB], incRowB, incColB,
-                   _B);
+#                   pragma omp barrier
 
-            for (i=0; i<mb; ++i) {
-                mc = (i!=mb-1 || _mc==0) ? MC : _mc;
+                    if (mc > 0) {
+                        long int p0 = jrIndex * np / jrw;
+                        long int p1 = (jrIndex + 1) * np / jrw;
 
-                pack_A(mc, kc,
-                       &A[i*MC*incRowA+l*KC*incColA], incRowA, incColA,
-                       _A);
+                        dgemm_macro_kernel(kernel, mc, nc, kc, p0, p1,
+                                           alpha, curA, curB, _beta,
+                                           &C[i * MC * incRowC + j * NC * incColC],
+                                           incRowC, incColC);
 
-                dgemm_macro_kernel(mc, nc, kc, alpha, _beta,
-                                   &C[i*MC*incRowC+j*NC*incColC],
-                                   incRowC, incColC);
+                        // This thread's panels of C are final after the last KC block
+                        if (l == kb - 1 && p1 > p0) {
+                            long int j0 = p0 * NR;
+                            long int j1 = (p1 * NR < nc) ? p1 * NR : nc;
+
+                            ulm_epilogue_apply(ep, mc, j1 - j0, i * MC, j * NC + j0,
+                                               &C[i * MC * incRowC + (j * NC + j0) * incColC],
+                                               incRowC, incColC);
+                        }
+                    }
+
+#                   pragma omp barrier
+                }
             }
         }
     }
+
+    ulm_free_aligned(_A);
+    ulm_free_aligned(_B);
+
+    return 0;
 }
 
-#endif
+//
+//  Compute C <- beta*C + alpha*A*B, see dgemm_nn_ep
+//
+int
+ULMBLAS(dgemm_nn)(long int m,
+                  long int n,
+                  long int k,
+                  double alpha,
+                  const double *A,
+                  long int incRowA,
+                  long int incColA,
+                  const double *B,
+                  long int incRowB,
+                  long int incColB,
+                  double beta,
+                  double *C,
+                  long int incRowC,
+                  long int incColC,
+                  int threads) {
+    return ULMBLAS(dgemm_nn_ep)(m, n, k, alpha, A, incRowA, incColA, B, incRowB, incColB,
+                                beta, C, incRowC, incColC, threads, NULL, NULL, NULL);
+}
+
+//
+//  Pack the m x k matrix A ahead of time for products A*B with a C stored by
+//  rows.  Such products are computed as C^T = B^T*A^T, so A is packed the way
+//  dgemm_nn packs B for the current kernel and blocking.  Returns NULL if there
+//  is not enough memory.
+//
+static struct ulm_dgemm_packed *
+ULMBLAS(dgemm_prepack)(long int m, long int k, const double *A, long int incRowA, long int incColA) {
+    return ulm_dgemm_pack(m, k, A, incRowA, incColA,
+                          ULM_DGEMM_KERNEL->nr, ULM_DGEMM_BLOCKING.nc, ULM_DGEMM_BLOCKING.kc);
+}
@@ -0,0 +1,452 @@
+#ifndef ULMBLAS_DGEMM_SMALL_H
+#define ULMBLAS_DGEMM_SMALL_H 1
+
+#include "ulmblas.h"
+#include "cpufeatures.h"
+#include "epilogue.h"
+#include <immintrin.h>
+
+//
+//  Kernels for products too small to be worth packing.  They read A, B and C
+//  in place and keep a SMALL_MR x SMALL_NR tile of C in registers, two YMM
+//  registers per row of the tile.
+//
+#define SMALL_MR  4
+#define SMALL_NR  8
+
+//
+//  Products with at most this many multiply-adds (m*n*k) go to dgemm_small
+//  instead of dgemm_nn.  The default is replaced at import by a value measured
+//  on the machine.
+//
+static long int ULM_DGEMM_SMALL_CROSSOVER = 32768;
+
+//
+//  Use the FMA variants of the kernels below.  Set by dgemm_small_select.
+//
+static int ULM_DGEMM_SMALL_FMA = 0;
+
+//
+//  Scalar tile for a B or C without unit stride rows
+//
+static void
+dgemm_small_edge(long int mr, long int nr, long int k,
+                 double alpha,
+                 const double *A, long int incRowA, long int incColA,
+                 const double *B, long int incRowB, long int incColB,
+                 double beta,
+                 double *C, long int incRowC, long int incColC) {
+    double AB[SMALL_MR][SMALL_NR];
+    long int i, j, l;
+
+    for (i = 0; i < mr; ++i) {
+        for (j = 0; j < nr; ++j) {
+            AB[i][j] = 0.0;
+        }
+    }
+
+    for (l = 0; l < k; ++l) {
+        for (i = 0; i < mr; ++i) {
+            const double a = A[i * incRowA + l * incColA];
+
+            for (j = 0; j < nr; ++j) {
+                AB[i][j] += a * B[l * incRowB + j * incColB];
+            }
+        }
+    }
+
+    for (i = 0; i < mr; ++i) {
+        for (j = 0; j < nr; ++j) {
+            if (beta == 0.0) {
+                C[i * incRowC + j * incColC] = alpha * AB[i][j];
+            } else {
+                C[i * incRowC + j * incColC] = beta * C[i * incRowC + j * incColC] + alpha * AB[i][j];
+            }
+        }
+    }
+}
+
+#define SMALL_MADD_AVX(a, b, c)  _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#define SMALL_MADD_FMA(a, b, c)  _mm256_fmadd_pd(a, b, c)
+
+#define SMALL_TILE_ROW(MADD, i)                                             \
+    a = _mm256_broadcast_sd(&A[(i) * incRowA]);                             \
+    ab_##i##_0 = MADD(a, b0, ab_##i##_0);                                   \
+    ab_##i##_1 = MADD(a, b1, ab_##i##_1);
+
+#define SMALL_STORE_ROW(MADD, i)                                            \
+    ab_##i##_0 = _mm256_mul_pd(_alpha, ab_##i##_0);                         \
+    ab_##i##_1 = _mm256_mul_pd(_alpha, ab_##i##_1);                         \
+    if (beta != 0.0) {                                                      \
+        ab_##i##_0 = MADD(_beta, _mm256_loadu_pd(&C[(i) * incRowC]), ab_##i##_0); \
+        ab_##i##_1 = MADD(_beta, _mm256_loadu_pd(&C[(i) * incRowC + 4]), ab_##i##_1); \
+    }                                                                       \
+    _mm256_storeu_pd(&C[(i) * incRowC], ab_##i##_0);                        \
+    _mm256_storeu_pd(&C[(i) * incRowC + 4], ab_##i##_1);
+
+#define SMALL_EDGE_ROW(MADD, i)                                             \
+    a = _mm256_broadcast_sd(&a_##i[l * incColA]);                           \
+    ab_##i##_0 = MADD(a, b0, ab_##i##_0);                                   \
+    ab_##i##_1 = MADD(a, b1, ab_##i##_1);
+
+#define SMALL_MASKSTORE_ROW(MADD, i)                                        \
+    ab_##i##_0 = _mm256_mul_pd(_alpha, ab_##i##_0);                         \
+    ab_##i##_1 = _mm256_mul_pd(_alpha, ab_##i##_1);                         \
+    if (beta != 0.0) {                                                      \
+        ab_##i##_0 = MADD(_beta, _mm256_maskload_pd(&C[(i) * incRowC], mask0), ab_##i##_0); \
+        ab_##i##_1 = MADD(_beta, _mm256_maskload_pd(&C[(i) * incRowC + 4], mask1), ab_##i##_1); \
+    }                                                                       \
+    _mm256_maskstore_pd(&C[(i) * incRowC], mask0, ab_##i##_0);              \
+    _mm256_maskstore_pd(&C[(i) * incRowC + 4], mask1, ab_##i##_1);
+
+//
+//  Full SMALL_MR x SMALL_NR tile of C, for a B with unit stride rows.  Every
+//  step loads one row of B and broadcasts one column of A, giving 8
+//  accumulators.
+//
+#define ULM_DGEMM_SMALL_TILE(NAME, TARGET, MADD)                            \
+TARGET                                                                      \
+static inline void                                                          \
+dgemm_small_tile_##NAME(long int k,                                         \
+                        double alpha,                                       \
+                        const double *A, long int incRowA, long int incColA, \
+                        const double *B, long int incRowB,                  \
+                        double beta,                                        \
+                        double *C, long int incRowC, long int incColC) {    \
+    __m256d ab_0_0, ab_0_1, ab_1_0, ab_1_1, ab_2_0, ab_2_1, ab_3_0, ab_3_1; \
+    __m256d a, b0, b1, _alpha, _beta;                                       \
+    double ULM_ALIGNED(32) AB[SMALL_MR * SMALL_NR];                         \
+    long int i, j, l;                                                       \
+                                                                            \
+    ab_0_0 = ab_0_1 = ab_1_0 = ab_1_1 = _mm256_setzero_pd();                \
+    ab_2_0 = ab_2_1 = ab_3_0 = ab_3_1 = _mm256_setzero_pd();                \
+                                                                            \
+    for (l = 0; l < k; ++l) {                                               \
+        b0 = _mm256_loadu_pd(B);                                            \
+        b1 = _mm256_loadu_pd(B + 4);                                        \
+                                                                            \
+        SMALL_TILE_ROW(MADD, 0)                                             \
+        SMALL_TILE_ROW(MADD, 1)                                             \
+        SMALL_TILE_ROW(MADD, 2)                                             \
+        SMALL_TILE_ROW(MADD, 3)                                             \
+                                                                            \
+        A += incColA;                                                       \
+        B += incRowB;                                                       \
+    }                                                                       \
+                                                                            \
+    if (incColC == 1) {                                                     \
+        _alpha = _mm256_set1_pd(alpha);                                     \
+        _beta = _mm256_set1_pd(beta);                                       \
+                                                                            \
+        SMALL_STORE_ROW(MADD, 0)                                            \
+        SMALL_STORE_ROW(MADD, 1)                                            \
+        SMALL_STORE_ROW(MADD, 2)                                            \
+        SMALL_STORE_ROW(MADD, 3)                                            \
+        return;                                                             \
+    }                                                                       \
+                                                                            \
+    _mm256_store_pd(&AB[0 * SMALL_NR], ab_0_0);                             \
+    _mm256_store_pd(&AB[0 * SMALL_NR + 4], ab_0_1);                         \
+    _mm256_store_pd(&AB[1 * SMALL_NR], ab_1_0);                             \
+    _mm256_store_pd(&AB[1 * SMALL_NR + 4], ab_1_1);                         \
+    _mm256_store_pd(&AB[2 * SMALL_NR], ab_2_0);                             \
+    _mm256_store_pd(&AB[2 * SMALL_NR + 4], ab_2_1);                         \
+    _mm256_store_pd(&AB[3 * SMALL_NR], ab_3_0);                             \
+    _mm256_store_pd(&AB[3 * SMALL_NR + 4], ab_3_1);                         \
+                                                                            \
+    for (i = 0; i < SMALL_MR; ++i) {                                        \
+        for (j = 0; j < SMALL_NR; ++j) {                                    \
+            if (beta == 0.0) {                                              \
+                C[i * incRowC + j * incColC] = alpha * AB[i * SMALL_NR + j]; \
+            } else {                                                        \
+                C[i * incRowC + j * incColC] = beta * C[i * incRowC + j * incColC] \
+                                               + alpha * AB[i * SMALL_NR + j]; \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+}
+
+//
+//  Partial tile of C at the bottom or right edge, for a B with unit stride
+//  rows and a C with unit stride columns.  The columns past nr are masked off,
+//  and the rows past mr repeat the last row of A and are not stored.
+//
+#define ULM_DGEMM_SMALL_EDGE(NAME, TARGET, MADD)                            \
+TARGET                                                                      \
+static inline void                                                          \
+dgemm_small_edge_##NAME(long int mr, long int nr, long int k,               \
+                        double alpha,                                       \
+                        const double *A, long int incRowA, long int incColA, \
+                        const double *B, long int incRowB,                  \
+                        double beta,                                        \
+                        double *C, long int incRowC) {                      \
+    const __m256i mask0 = _mm256_set_epi64x(-(nr > 3), -(nr > 2), -(nr > 1), -(nr > 0)); \
+    const __m256i mask1 = _mm256_set_epi64x(-(nr > 7), -(nr > 6), -(nr > 5), -(nr > 4)); \
+    const double *a_0 = A;                                                  \
+    const double *a_1 = A + ((mr > 1) ? 1 : 0) * incRowA;                   \
+    const double *a_2 = A + ((mr > 2) ? 2 : mr - 1) * incRowA;              \
+    const double *a_3 = A + ((mr > 3) ? 3 : mr - 1) * incRowA;              \
+    __m256d ab_0_0, ab_0_1, ab_1_0, ab_1_1, ab_2_0, ab_2_1, ab_3_0, ab_3_1; \
+    __m256d a, b0, b1, _alpha, _beta;                                       \
+    long int l;                                                             \
+                                                                            \
+    ab_0_0 = ab_0_1 = ab_1_0 = ab_1_1 = _mm256_setzero_pd();                \
+    ab_2_0 = ab_2_1 = ab_3_0 = ab_3_1 = _mm256_setzero_pd();                \
+                                                                            \
+    for (l = 0; l < k; ++l) {                                               \
+        b0 = _mm256_maskload_pd(B, mask0);                                  \
+        b1 = _mm256_maskload_pd(B + 4, mask1);                              \
+                                                                            \
+        SMALL_EDGE_ROW(MADD, 0)                                             \
+        SMALL_EDGE_ROW(MADD, 1)                                             \
+        SMALL_EDGE_ROW(MADD, 2)                                             \
+        SMALL_EDGE_ROW(MADD, 3)                                             \
+                                                                            \
+        B += incRowB;                                                       \
+    }                                                                       \
+                                                                            \
+    _alpha = _mm256_set1_pd(alpha);                                         \
+    _beta = _mm256_set1_pd(beta);                                           \
+                                                                            \
+    SMALL_MASKSTORE_ROW(MADD, 0)                                            \
+    if (mr > 1) {                                                           \
+        SMALL_MASKSTORE_ROW(MADD, 1)                                        \
+    }                                                                       \
+    if (mr > 2) {                                                           \
+        SMALL_MASKSTORE_ROW(MADD, 2)                                        \
+    }                                                                       \
+    if (mr > 3) {                                                           \
+        SMALL_MASKSTORE_ROW(MADD, 3)                                        \
+    }                                                                       \
+}
+
+//
+//  Tile the whole of C, with partial tiles at the edges
+//
+#define ULM_DGEMM_SMALL_BLOCKED(NAME, TARGET)                               \
+TARGET                                                                      \
+static void                                                                 \
+dgemm_small_blocked_##NAME(long int m, long int n, long int k,              \
+                           double alpha,                                    \
+                           const double *A, long int incRowA, long int incColA, \
+                           const double *B, long int incRowB, long int incColB, \
+                           double beta,                                     \
+                           double *C, long int incRowC, long int incColC) { \
+    long int mp = m / SMALL_MR;                                             \
+    long int np = n / SMALL_NR;                                             \
+    long int _mr = m % SMALL_MR;                                            \
+    long int _nr = n % SMALL_NR;                                            \
+    long int i, j;                                                          \
+                                                                            \
+    for (i = 0; i < mp; ++i) {                                              \
+        for (j = 0; j < np; ++j) {                                          \
+            if (incColB == 1) {                                             \
+                dgemm_small_tile_##NAME(k, alpha,                           \
+                                        &A[i * SMALL_MR * incRowA], incRowA, incColA, \
+                                        &B[j * SMALL_NR], incRowB,          \
+                                        beta,                               \
+                                        &C[i * SMALL_MR * incRowC + j * SMALL_NR * incColC], \
+                                        incRowC, incColC);                  \
+            } else {                                                        \
+                dgemm_small_edge(SMALL_MR, SMALL_NR, k, alpha,              \
+                                 &A[i * SMALL_MR * incRowA], incRowA, incColA, \
+                                 &B[j * SMALL_NR * incColB], incRowB, incColB, \
+                                 beta,                                      \
+                                 &C[i * SMALL_MR * incRowC + j * SMALL_NR * incColC], \
+                                 incRowC, incColC);                         \
+            }                                                               \
+        }                                                                   \
+        if (_nr > 0 && incColB == 1 && incColC == 1) {                      \
+            dgemm_small_edge_##NAME(SMALL_MR, _nr, k, alpha,                \
+                                    &A[i * SMALL_MR * incRowA], incRowA, incColA, \
+                                    &B[np * SMALL_NR], incRowB,             \
+                                    beta,                                   \
+                                    &C[i * SMALL_MR * incRowC + np * SMALL_NR], incRowC); \
+        } else if (_nr > 0) {                                               \
+            dgemm_small_edge(SMALL_MR, _nr, k, alpha,                       \
+                             &A[i * SMALL_MR * incRowA], incRowA, incColA,  \
+                             &B[np * SMALL_NR * incColB], incRowB, incColB, \
+                             beta,                                          \
+                             &C[i * SMALL_MR * incRowC + np * SMALL_NR * incColC], \
+                             incRowC, incColC);                             \
+        }                                                                   \
+    }                                                                       \
+    if (_mr > 0) {                                                          \
+        for (j = 0; j < np + (_nr > 0); ++j) {                              \
+            if (incColB == 1 && incColC == 1) {                             \
+                dgemm_small_edge_##NAME(_mr, (j < np) ? SMALL_NR : _nr, k, alpha, \
+                                        &A[mp * SMALL_MR * incRowA], incRowA, incColA, \
+                                        &B[j * SMALL_NR], incRowB,          \
+                                        beta,                               \
+                                        &C[mp * SMALL_MR * incRowC + j * SMALL_NR], incRowC); \
+                continue;                                                   \
+            }                                                               \
+            dgemm_small_edge(_mr, (j < np) ? SMALL_NR : _nr, k, alpha,      \
+                             &A[mp * SMALL_MR * incRowA], incRowA, incColA, \
+                             &B[j * SMALL_NR * incColB], incRowB, incColB,  \
+                             beta,                                          \
+                             &C[mp * SMALL_MR * incRowC + j * SMALL_NR * incColC], \
+                             incRowC, incColC);                             \
+        }                                                                   \
+    }                                                                       \
+}
+
+//
+//  Row major S x S products for S a multiple of SMALL_NR.  With k and all
+//  strides known at compile time the tiles are fully unrolled.
+//
+#define ULM_DGEMM_SMALL_SQUARE(NAME, TARGET, S)                             \
+TARGET                                                                      \
+static void                                                                 \
+dgemm_small_##NAME##_##S(double alpha, const double *A, const double *B,    \
+                         double beta, double *C) {                          \
+    long int i, j;                                                          \
+                                                                            \
+    for (i = 0; i < S; i += SMALL_MR) {                                     \
+        for (j = 0; j < S; j += SMALL_NR) {                                 \
+            dgemm_small_tile_##NAME(S, alpha, &A[i * S], S, 1, &B[j], S,    \
+                                    beta, &C[i * S + j], S, 1);             \
+        }                                                                   \
+    }                                                                       \
+}
+
+//
+//  Row major S x S products for S below SMALL_NR, where a tile would be mostly
+//  padding.  The loops have constant bounds and are unrolled completely.
+//
+#define ULM_DGEMM_SMALL_TINY(S)                                             \
+static void                                                                 \
+dgemm_small_tiny_##S(double alpha, const double *A, const double *B,        \
+                     double beta, double *C) {                              \
+    double AB[S][S];                                                        \
+    long int i, j, l;                                                       \
+                                                                            \
+    for (i = 0; i < S; ++i) {                                               \
+        for (j = 0; j < S; ++j) {                                           \
+            AB[i][j] = 0.0;                                                 \
+        }                                                                   \
+        for (l = 0; l < S; ++l) {                                           \
+            for (j = 0; j < S; ++j) {                                       \
+                AB[i][j] += A[i * S + l] * B[l * S + j];                    \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    for (i = 0; i < S; ++i) {                                               \
+        for (j = 0; j < S; ++j) {                                           \
+            C[i * S + j] = (beta == 0.0) ? alpha * AB[i][j]                 \
+                                         : beta * C[i * S + j] + alpha * AB[i][j]; \
+        }                                                                   \
+    }                                                                       \
+}
+
+ULM_DGEMM_SMALL_TILE(avx, ULM_TARGET("avx"), SMALL_MADD_AVX)
+ULM_DGEMM_SMALL_TILE(fma, ULM_TARGET("avx2,fma"), SMALL_MADD_FMA)
+
+ULM_DGEMM_SMALL_EDGE(avx, ULM_TARGET("avx"), SMALL_MADD_AVX)
+ULM_DGEMM_SMALL_EDGE(fma, ULM_TARGET("avx2,fma"), SMALL_MADD_FMA)
+
+ULM_DGEMM_SMALL_BLOCKED(avx, ULM_TARGET("avx"))
+ULM_DGEMM_SMALL_BLOCKED(fma, ULM_TARGET("avx2,fma"))
+
+ULM_DGEMM_SMALL_SQUARE(avx, ULM_TARGET("avx"), 8)
+ULM_DGEMM_SMALL_SQUARE(avx, ULM_TARGET("avx"), 16)
+ULM_DGEMM_SMALL_SQUARE(avx, ULM_TARGET("avx"), 32)
+ULM_DGEMM_SMALL_SQUARE(fma, ULM_TARGET("avx2,fma"), 8)
+ULM_DGEMM_SMALL_SQUARE(fma, ULM_TARGET("avx2,fma"), 16)
+ULM_DGEMM_SMALL_SQUARE(fma, ULM_TARGET("avx2,fma"), 32)
+
+ULM_DGEMM_SMALL_TINY(2)
+ULM_DGEMM_SMALL_TINY(3)
+ULM_DGEMM_SMALL_TINY(4)
+
+#undef SMALL_TILE_ROW
+#undef SMALL_STORE_ROW
+#undef SMALL_EDGE_ROW
+#undef SMALL_MASKSTORE_ROW
+
+//
+//  Use the FMA kernels if the processor has them
+//
+static void
+ULMBLAS(dgemm_small_select)(void) {
+    int features = ulm_cpu_features();
+
+    ULM_DGEMM_SMALL_FMA = (features & (CpuAVX2 | CpuFMA)) == (CpuAVX2 | CpuFMA);
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B without packing.  Meant for products below
+//  ULM_DGEMM_SMALL_CROSSOVER, for which dgemm_nn spends more time packing and
+//  starting threads than multiplying.
+//
+static void
+ULMBLAS(dgemm_small)(long int m,
+                     long int n,
+                     long int k,
+                     double alpha,
+                     const double *A,
+                     long int incRowA,
+                     long int incColA,
+                     const double *B,
+                     long int incRowB,
+                     long int incColB,
+                     double beta,
+                     double *C,
+                     long int incRowC,
+                     long int incColC) {
+    const int fma = ULM_DGEMM_SMALL_FMA;
+
+    if (alpha == 0.0 || k == 0) {
+        dgescal(m, n, beta, C, incRowC, incColC);
+        return;
+    }
+
+    if (m == n && n == k && incColA == 1 && incColB == 1 && incColC == 1
+        && incRowA == m && incRowB == m && incRowC == m) {
+        switch (m) {
+            case 2: dgemm_small_tiny_2(alpha, A, B, beta, C); return;
+            case 3: dgemm_small_tiny_3(alpha, A, B, beta, C); return;
+            case 4: dgemm_small_tiny_4(alpha, A, B, beta, C); return;
+            case 8: (fma ? dgemm_small_fma_8 : dgemm_small_avx_8)(alpha, A, B, beta, C); return;
+            case 16: (fma ? dgemm_small_fma_16 : dgemm_small_avx_16)(alpha, A, B, beta, C); return;
+            case 32: (fma ? dgemm_small_fma_32 : dgemm_small_avx_32)(alpha, A, B, beta, C); return;
+            default: break;
+        }
+    }
+
+    if (fma) {
+        dgemm_small_blocked_fma(m, n, k, alpha, A, incRowA, incColA, B, incRowB, incColB,
+                                beta, C, incRowC, incColC);
+    } else {
+        dgemm_small_blocked_avx(m, n, k, alpha, A, incRowA, incColA, B, incRowB, incColB,
+                                beta, C, incRowC, incColC);
+    }
+}
+
+//
+//  Compute C <- act(beta*C + alpha*A*B + bias) for the epilogue ep.  C is
+//  below the crossover, so it is still in cache when the epilogue runs over it.
+//
+static void
+ULMBLAS(dgemm_small_ep)(long int m,
+                        long int n,
+                        long int k,
+                        double alpha,
+                        const double *A,
+                        long int incRowA,
+                        long int incColA,
+                        const double *B,
+                        long int incRowB,
+                        long int incColB,
+                        double beta,
+                        double *C,
+                        long int incRowC,
+                        long int incColC,
+                        const struct ulm_epilogue *ep) {
+    ULMBLAS(dgemm_small)(m, n, k, alpha, A, incRowA, incColA, B, incRowB, incColB,
+                         beta, C, incRowC, incColC);
+    ulm_epilogue_apply(ep, m, n, 0, 0, C, incRowC, incColC);
+}
+
+#endif // ULMBLAS_DGEMM_SMALL_H
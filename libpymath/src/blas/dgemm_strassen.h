@@ -0,0 +1,294 @@
+#ifndef ULMBLAS_DGEMM_STRASSEN_H
+#define ULMBLAS_DGEMM_STRASSEN_H 1
+
+//
+//  Needs dgemm_nn, dgemv and dger, which must be included first
+//
+#include "ulmblas.h"
+#include "workspace.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Strassen-Winograd recursion for very large products.  Each level replaces
+//  the 8 half size products of the blocked algorithm by 7, at the price of 15
+//  additions of half size blocks, so it only pays off once the blocks are far
+//  larger than the caches.  The recursion stops as soon as one dimension is at
+//  most ULM_DGEMM_STRASSEN_CUTOFF, and the products below it are done by
+//  dgemm_nn.
+//
+//  Accuracy: the result is not as accurate as that of dgemm_nn.  For n x n
+//  matrices and a cutoff of n0, the error of the computed product satisfies
+//
+//      max |C - fl(C)| <= [(n/n0)^log2(18) * (n0^2 + 6*n0) - 6*n] * u
+//                         * max |A| * max |B| + O(u^2)
+//
+//  with the unit roundoff u = 2^-53 (Higham, Accuracy and Stability of
+//  Numerical Algorithms, 2nd ed., section 23.2.2).  In the same norm the bound
+//  of dgemm_nn is n^2 * u * max |A| * max |B|, so each level of recursion makes
+//  the worst case about 18/4 = 4.5 times worse.  The bound is normwise: unlike
+//  with dgemm_nn, elements much smaller than the largest element of the product
+//  can lose many digits.
+//
+static long int ULM_DGEMM_STRASSEN_CUTOFF = 1024;
+
+//
+//  Products whose dimensions are all at least this large use the recursion
+//  unless the caller asks otherwise.  0 disables it.
+//
+static long int ULM_DGEMM_STRASSEN_AUTO = 8192;
+
+//
+//  Compute Z <- X + s*Y for m x n matrices.  Z may be X or Y.
+//
+static void
+dgeadd(long int m, long int n,
+       const double *X, long int incRowX, long int incColX,
+       double s,
+       const double *Y, long int incRowY, long int incColY,
+       double *Z, long int incRowZ, long int incColZ,
+       int threads) {
+    long int i, j;
+
+    if (incColX == 1 && incColY == 1 && incColZ == 1) {
+#       pragma omp parallel for num_threads(threads) schedule(static) private(j) if(threads > 1)
+        for (i = 0; i < m; ++i) {
+            const double *x = &X[i * incRowX];
+            const double *y = &Y[i * incRowY];
+            double *z = &Z[i * incRowZ];
+
+            for (j = 0; j < n; ++j) {
+                z[j] = x[j] + s * y[j];
+            }
+        }
+        return;
+    }
+
+#   pragma omp parallel for num_threads(threads) schedule(static) private(j) if(threads > 1)
+    for (i = 0; i < m; ++i) {
+        for (j = 0; j < n; ++j) {
+            Z[i * incRowZ + j * incColZ] = X[i * incRowX + j * incColX] + s * Y[i * incRowY + j * incColY];
+        }
+    }
+}
+
+//
+//  Number of doubles of workspace needed by dgemm_strassen_rec for an m x n x k
+//  product: two temporaries on every level of the recursion
+//
+static long int
+dgemm_strassen_workspace(long int m, long int n, long int k, long int cutoff) {
+    long int mh = m / 2, nh = n / 2, kh = k / 2;
+
+    if (m <= cutoff || n <= cutoff || k <= cutoff) {
+        return 0;
+    }
+
+    return mh * (kh > nh ? kh : nh) + kh * nh + dgemm_strassen_workspace(mh, nh, kh, cutoff);
+}
+
+//
+//  Compute C <- A*B, where A is m x k and B is k x n, with the Winograd variant
+//  of Strassen's algorithm.  The schedule is the one of DGEFMM (Douglas et al.,
+//  1994): C holds four of the seven products while they are combined, so the
+//  only workspace is X (m/2 x max(k/2, n/2)) and Y (k/2 x n/2) per level.  An
+//  odd last row, column or inner index is peeled off and added with the vector
+//  kernels.  Returns 0 on success and -1 if a kernel could not allocate.
+//
+static int
+dgemm_strassen_rec(long int m, long int n, long int k,
+                   const double *A, long int incRowA, long int incColA,
+                   const double *B, long int incRowB, long int incColB,
+                   double *C, long int incRowC, long int incColC,
+                   double *work, long int cutoff, int threads) {
+    long int mh = m / 2, nh = n / 2, kh = k / 2;
+    long int ldX = (kh > nh) ? kh : nh;
+    long int ldY = nh;
+    double *X, *Y, *next;
+    int status = 0;
+
+    const double *A11, *A12, *A21, *A22;
+    const double *B11, *B12, *B21, *B22;
+    double *C11, *C12, *C21, *C22;
+
+    if (m <= cutoff || n <= cutoff || k <= cutoff) {
+        return ULMBLAS(dgemm_nn)(m, n, k, 1.0, A, incRowA, incColA, B, incRowB, incColB,
+                                 0.0, C, incRowC, incColC, threads);
+    }
+
+    X = work;
+    Y = X + mh * ldX;
+    next = Y + kh * ldY;
+
+    A11 = A;
+    A12 = &A[kh * incColA];
+    A21 = &A[mh * incRowA];
+    A22 = &A[mh * incRowA + kh * incColA];
+
+    B11 = B;
+    B12 = &B[nh * incColB];
+    B21 = &B[kh * incRowB];
+    B22 = &B[kh * incRowB + nh * incColB];
+
+    C11 = C;
+    C12 = &C[nh * incColC];
+    C21 = &C[mh * incRowC];
+    C22 = &C[mh * incRowC + nh * incColC];
+
+#define STRASSEN_PRODUCT(Q, incRowQ, incColQ, R, incRowR, incColR, S, incRowS, incColS)  \
+    status |= dgemm_strassen_rec(mh, nh, kh, Q, incRowQ, incColQ, R, incRowR, incColR,   \
+                                 S, incRowS, incColS, next, cutoff, threads)
+
+    // C21 = (A11 - A21) * (B22 - B12)
+    dgeadd(mh, kh, A11, incRowA, incColA, -1.0, A21, incRowA, incColA, X, ldX, 1, threads);
+    dgeadd(kh, nh, B22, incRowB, incColB, -1.0, B12, incRowB, incColB, Y, ldY, 1, threads);
+    STRASSEN_PRODUCT(X, ldX, 1, Y, ldY, 1, C21, incRowC, incColC);
+
+    // C22 = (A21 + A22) * (B12 - B11)
+    dgeadd(mh, kh, A21, incRowA, incColA, 1.0, A22, incRowA, incColA, X, ldX, 1, threads);
+    dgeadd(kh, nh, B12, incRowB, incColB, -1.0, B11, incRowB, incColB, Y, ldY, 1, threads);
+    STRASSEN_PRODUCT(X, ldX, 1, Y, ldY, 1, C22, incRowC, incColC);
+
+    // C12 = (A21 + A22 - A11) * (B22 - B12 + B11)
+    dgeadd(mh, kh, X, ldX, 1, -1.0, A11, incRowA, incColA, X, ldX, 1, threads);
+    dgeadd(kh, nh, B22, incRowB, incColB, -1.0, Y, ldY, 1, Y, ldY, 1, threads);
+    STRASSEN_PRODUCT(X, ldX, 1, Y, ldY, 1, C12, incRowC, incColC);
+
+    // C11 = (A12 - A21 - A22 + A11) * B22
+    dgeadd(mh, kh, A12, incRowA, incColA, -1.0, X, ldX, 1, X, ldX, 1, threads);
+    STRASSEN_PRODUCT(X, ldX, 1, B22, incRowB, incColB, C11, incRowC, incColC);
+
+    // X = A11 * B11
+    STRASSEN_PRODUCT(A11, incRowA, incColA, B11, incRowB, incColB, X, ldX, 1);
+
+    dgeadd(mh, nh, X, ldX, 1, 1.0, C12, incRowC, incColC, C12, incRowC, incColC, threads);
+    dgeadd(mh, nh, C12, incRowC, incColC, 1.0, C21, incRowC, incColC, C21, incRowC, incColC, threads);
+    dgeadd(mh, nh, C12, incRowC, incColC, 1.0, C22, incRowC, incColC, C12, incRowC, incColC, threads);
+    dgeadd(mh, nh, C21, incRowC, incColC, 1.0, C22, incRowC, incColC, C22, incRowC, incColC, threads);
+    dgeadd(mh, nh, C12, incRowC, incColC, 1.0, C11, incRowC, incColC, C12, incRowC, incColC, threads);
+
+    // C21 -= A22 * (B22 - B12 + B11 - B21)
+    dgeadd(kh, nh, Y, ldY, 1, -1.0, B21, incRowB, incColB, Y, ldY, 1, threads);
+    STRASSEN_PRODUCT(A22, incRowA, incColA, Y, ldY, 1, C11, incRowC, incColC);
+    dgeadd(mh, nh, C21, incRowC, incColC, -1.0, C11, incRowC, incColC, C21, incRowC, incColC, threads);
+
+    // C11 = A11 * B11 + A12 * B21
+    STRASSEN_PRODUCT(A12, incRowA, incColA, B21, incRowB, incColB, C11, incRowC, incColC);
+    dgeadd(mh, nh, X, ldX, 1, 1.0, C11, incRowC, incColC, C11, incRowC, incColC, threads);
+
+#undef STRASSEN_PRODUCT
+
+//
+//  Peel off what the even sized core left out
+//
+    if (k % 2 != 0) {
+        status |= ULMBLAS(dger)(2 * mh, 2 * nh, 1.0,
+                                &A[(k - 1) * incColA], incRowA,
+                                &B[(k - 1) * incRowB], incColB,
+                                C, incRowC, incColC, threads);
+    }
+    if (n % 2 != 0) {
+        status |= ULMBLAS(dgemv)(2 * mh, k, 1.0, A, incRowA, incColA,
+                                 &B[(n - 1) * incColB], incRowB,
+                                 0.0, &C[(n - 1) * incColC], incRowC, threads, NULL);
+    }
+    if (m % 2 != 0) {
+        status |= ULMBLAS(dgemv_t)(k, n, 1.0, B, incRowB, incColB,
+                                   &A[(m - 1) * incRowA], incColA,
+                                   0.0, &C[(m - 1) * incRowC], incColC, threads, NULL);
+    }
+
+    return status == 0 ? 0 : -1;
+}
+
+//
+//  Whether a product should use dgemm_strassen.  strassen > 0 asks for it
+//  whenever the product is large enough for one level of recursion, 0 never
+//  and strassen < 0 leaves it to ULM_DGEMM_STRASSEN_AUTO.
+//
+static int
+ULMBLAS(dgemm_strassen_wanted)(long int m, long int n, long int k, int strassen) {
+    long int smallest = (m < n) ? ((m < k) ? m : k) : ((n < k) ? n : k);
+
+    if (strassen > 0) {
+        return smallest > ULM_DGEMM_STRASSEN_CUTOFF;
+    } else if (strassen < 0) {
+        return ULM_DGEMM_STRASSEN_AUTO > 0 && smallest >= ULM_DGEMM_STRASSEN_AUTO
+               && smallest > ULM_DGEMM_STRASSEN_CUTOFF;
+    }
+    return 0;
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B with the Strassen-Winograd recursion, using
+//  up to `threads` threads in the products and additions.  See the top of this
+//  file for the accuracy of the result.
+//
+//  The workspace is allocated once for the whole recursion and takes about
+//  (m*k + k*n) / 3 doubles, plus m*n if beta != 0.  Returns 0 on success and
+//  -1 if it or the buffers of a product could not be allocated.  C is
+//  unchanged if the workspace could not be allocated, and undefined if a
+//  product failed.
+//
+static int
+ULMBLAS(dgemm_strassen)(long int m,
+                        long int n,
+                        long int k,
+                        double alpha,
+                        const double *A,
+                        long int incRowA,
+                        long int incColA,
+                        const double *B,
+                        long int incRowB,
+                        long int incColB,
+                        double beta,
+                        double *C,
+                        long int incRowC,
+                        long int incColC,
+                        int threads) {
+    const long int cutoff = ULM_DGEMM_STRASSEN_CUTOFF;
+    long int size;
+    double *work, *P;
+    int status;
+
+    if (alpha == 0.0 || k == 0) {
+        dgescal(m, n, beta, C, incRowC, incColC);
+        return 0;
+    }
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    size = dgemm_strassen_workspace(m, n, k, cutoff);
+    work = ulm_malloc_aligned((size_t) (size + ((beta != 0.0) ? m * n : 0)));
+    if (work == NULL) {
+        return -1;
+    }
+
+    if (beta == 0.0) {
+        status = dgemm_strassen_rec(m, n, k, A, incRowA, incColA, B, incRowB, incColB,
+                                    C, incRowC, incColC, work, cutoff, threads);
+        if (alpha != 1.0) {
+            dgescal(m, n, alpha, C, incRowC, incColC);
+        }
+    } else {
+        // The recursion overwrites its result, so the product goes to P first
+        P = work + size;
+        status = dgemm_strassen_rec(m, n, k, A, incRowA, incColA, B, incRowB, incColB,
+                                    P, n, 1, work, cutoff, threads);
+        if (status == 0) {
+            dgescal(m, n, beta, C, incRowC, incColC);
+            dgeaxpy(m, n, alpha, P, n, 1, C, incRowC, incColC);
+        }
+    }
+
+    ulm_free_aligned(work);
+    return status;
+}
+
+#endif // ULMBLAS_DGEMM_STRASSEN_H
@@ -0,0 +1,309 @@
+#ifndef ULMBLAS_DGEMV_H
+#define ULMBLAS_DGEMV_H 1
+
+#include "ulmblas.h"
+#include "workspace.h"
+#include "epilogue.h"
+#include <immintrin.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Only start another thread for every this many elements of A.  A product
+//  with a vector does one multiply-add per element loaded, so it is limited by
+//  memory bandwidth long before the cores are busy.
+//
+#define ULM_DGEMV_WORK_PER_THREAD  (1L << 16)
+
+//
+//  Rows of y handled together when A is stored by columns.  The block of y
+//  stays in L1 while every column of A streams past it.
+//
+#define ULM_DGEMV_ROW_BLOCK  512
+
+//
+//  y[0..3] <- beta*y + alpha * (A[0..3][:] . x) for four rows of A stored with
+//  unit stride and a contiguous x.  Each load of x is shared by four rows.
+//
+ULM_TARGET("avx")
+static void
+dgemv_dot_4(long int n, double alpha,
+            const double *A, long int incRowA,
+            const double *x,
+            double beta, double *y, long int incY) {
+    const double *a0 = A;
+    const double *a1 = A + incRowA;
+    const double *a2 = A + 2 * incRowA;
+    const double *a3 = A + 3 * incRowA;
+
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+    __m256d xv;
+    double ULM_ALIGNED(32) sum[4][4];
+    double dot[4];
+    long int i, j;
+
+    for (j = 0; j + 4 <= n; j += 4) {
+        xv = _mm256_loadu_pd(&x[j]);
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(&a0[j]), xv));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(&a1[j]), xv));
+        s2 = _mm256_add_pd(s2, _mm256_mul_pd(_mm256_loadu_pd(&a2[j]), xv));
+        s3 = _mm256_add_pd(s3, _mm256_mul_pd(_mm256_loadu_pd(&a3[j]), xv));
+    }
+
+    _mm256_store_pd(sum[0], s0);
+    _mm256_store_pd(sum[1], s1);
+    _mm256_store_pd(sum[2], s2);
+    _mm256_store_pd(sum[3], s3);
+
+    for (i = 0; i < 4; ++i) {
+        dot[i] = (sum[i][0] + sum[i][1]) + (sum[i][2] + sum[i][3]);
+    }
+
+    for (; j < n; ++j) {
+        dot[0] += a0[j] * x[j];
+        dot[1] += a1[j] * x[j];
+        dot[2] += a2[j] * x[j];
+        dot[3] += a3[j] * x[j];
+    }
+
+    for (i = 0; i < 4; ++i) {
+        y[i * incY] = (beta == 0.0) ? alpha * dot[i] : beta * y[i * incY] + alpha * dot[i];
+    }
+}
+
+//
+//  Same for a single row
+//
+ULM_TARGET("avx")
+static void
+dgemv_dot_1(long int n, double alpha,
+            const double *A,
+            const double *x,
+            double beta, double *y) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    double ULM_ALIGNED(32) sum[4];
+    double dot;
+    long int j;
+
+    for (j = 0; j + 8 <= n; j += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_mul_pd(_mm256_loadu_pd(&A[j]), _mm256_loadu_pd(&x[j])));
+        s1 = _mm256_add_pd(s1, _mm256_mul_pd(_mm256_loadu_pd(&A[j + 4]), _mm256_loadu_pd(&x[j + 4])));
+    }
+
+    _mm256_store_pd(sum, _mm256_add_pd(s0, s1));
+    dot = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+
+    for (; j < n; ++j) {
+        dot += A[j] * x[j];
+    }
+
+    *y = (beta == 0.0) ? alpha * dot : beta * *y + alpha * dot;
+}
+
+//
+//  y <- beta*y + alpha*A*x for an A stored by rows (incColA == 1) and a
+//  contiguous x.  Every row is a dot product, and threads take whole rows.
+//  The epilogue is applied to each group of four elements of y as soon as
+//  they are written.
+//
+static void
+dgemv_rows(long int m, long int n, double alpha,
+           const double *A, long int incRowA,
+           const double *x,
+           double beta, double *y, long int incY,
+           int threads, const struct ulm_epilogue *ep) {
+    long int mp = m / 4;
+    long int i;
+
+#   pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+    for (i = 0; i < mp; ++i) {
+        dgemv_dot_4(n, alpha, &A[4 * i * incRowA], incRowA, x, beta, &y[4 * i * incY], incY);
+        ulm_epilogue_apply(ep, 4, 1, 4 * i, 0, &y[4 * i * incY], incY, 1);
+    }
+
+    for (i = 4 * mp; i < m; ++i) {
+        dgemv_dot_1(n, alpha, &A[i * incRowA], x, beta, &y[i * incY]);
+        ulm_epilogue_apply(ep, 1, 1, i, 0, &y[i * incY], incY, 1);
+    }
+}
+
+//
+//  y <- beta*y + alpha*A*x for an A stored by columns (incRowA == 1).  Every
+//  column is an axpy into y, and threads take whole blocks of y so that no two
+//  of them write the same element.  The epilogue is applied to each block of y
+//  once every column has been added to it.
+//
+static void
+dgemv_cols(long int m, long int n, double alpha,
+           const double *A, long int incColA,
+           const double *x, long int incX,
+           double beta, double *y,
+           int threads, const struct ulm_epilogue *ep) {
+    long int blocks = (m + ULM_DGEMV_ROW_BLOCK - 1) / ULM_DGEMV_ROW_BLOCK;
+    long int b;
+
+#   pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+    for (b = 0; b < blocks; ++b) {
+        long int i0 = b * ULM_DGEMV_ROW_BLOCK;
+        long int i1 = (i0 + ULM_DGEMV_ROW_BLOCK < m) ? i0 + ULM_DGEMV_ROW_BLOCK : m;
+        long int i, j;
+
+        if (beta == 0.0) {
+            for (i = i0; i < i1; ++i) {
+                y[i] = 0.0;
+            }
+        } else if (beta != 1.0) {
+            for (i = i0; i < i1; ++i) {
+                y[i] *= beta;
+            }
+        }
+
+        // Four columns at a time, so each element of y is loaded and stored
+        // once for every four columns
+        for (j = 0; j + 4 <= n; j += 4) {
+            const double ax0 = alpha * x[j * incX];
+            const double ax1 = alpha * x[(j + 1) * incX];
+            const double ax2 = alpha * x[(j + 2) * incX];
+            const double ax3 = alpha * x[(j + 3) * incX];
+            const double *a0 = &A[j * incColA];
+            const double *a1 = a0 + incColA;
+            const double *a2 = a1 + incColA;
+            const double *a3 = a2 + incColA;
+
+            for (i = i0; i < i1; ++i) {
+                y[i] += ax0 * a0[i] + ax1 * a1[i] + ax2 * a2[i] + ax3 * a3[i];
+            }
+        }
+
+        for (; j < n; ++j) {
+            const double ax = alpha * x[j * incX];
+            const double *a = &A[j * incColA];
+
+            for (i = i0; i < i1; ++i) {
+                y[i] += ax * a[i];
+            }
+        }
+
+        ulm_epilogue_apply(ep, i1 - i0, 1, i0, 0, &y[i0], 1, 1);
+    }
+}
+
+//
+//  Compute y <- act(beta*y + alpha*A*x + bias), where A is m x n, using up to
+//  `threads` threads (the OpenMP default if threads <= 0).  y is treated as an
+//  m x 1 matrix by the epilogue ep, which may be NULL.  A transposed product
+//  y <- beta*y + alpha*A^T*x is the same call with m, n and the strides of A
+//  swapped, see dgemv_t.
+//
+//  Returns 0 on success and -1 if a contiguous copy of x was needed but could
+//  not be allocated, in which case y is unchanged.
+//
+static int
+ULMBLAS(dgemv)(long int m,
+               long int n,
+               double alpha,
+               const double *A,
+               long int incRowA,
+               long int incColA,
+               const double *x,
+               long int incX,
+               double beta,
+               double *y,
+               long int incY,
+               int threads,
+               const struct ulm_epilogue *ep) {
+    double *_x = NULL;
+    long int nthreads;
+    long int i, j;
+
+    if (m <= 0) {
+        return 0;
+    }
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    nthreads = 1 + (long int) ((double) m * (double) n / ULM_DGEMV_WORK_PER_THREAD);
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+    if (alpha == 0.0 || n == 0) {
+        for (i = 0; i < m; ++i) {
+            y[i * incY] = (beta == 0.0) ? 0.0 : beta * y[i * incY];
+        }
+        ulm_epilogue_apply(ep, m, 1, 0, 0, y, incY, 1);
+        return 0;
+    }
+
+    if (incColA == 1) {
+        if (incX != 1) {
+            _x = ulm_malloc_aligned((size_t) n);
+            if (_x == NULL) {
+                return -1;
+            }
+            for (j = 0; j < n; ++j) {
+                _x[j] = x[j * incX];
+            }
+            x = _x;
+        }
+
+        dgemv_rows(m, n, alpha, A, incRowA, x, beta, y, incY, (int) nthreads, ep);
+
+        ulm_free_aligned(_x);
+        return 0;
+    }
+
+    if (incRowA == 1 && incY == 1) {
+        dgemv_cols(m, n, alpha, A, incColA, x, incX, beta, y, (int) nthreads, ep);
+        return 0;
+    }
+
+//
+//  Neither the rows nor the columns of A are contiguous
+//
+#   pragma omp parallel for num_threads(nthreads) schedule(static) private(j) if(nthreads > 1)
+    for (i = 0; i < m; ++i) {
+        double dot = 0.0;
+
+        for (j = 0; j < n; ++j) {
+            dot += A[i * incRowA + j * incColA] * x[j * incX];
+        }
+        y[i * incY] = (beta == 0.0) ? alpha * dot : beta * y[i * incY] + alpha * dot;
+        ulm_epilogue_apply(ep, 1, 1, i, 0, &y[i * incY], incY, 1);
+    }
+
+    return 0;
+}
+
+//
+//  Compute y <- act(beta*y + alpha*A^T*x + bias), where A is m x n and y is
+//  treated as an n x 1 matrix by the epilogue ep, which may be NULL
+//
+static int
+ULMBLAS(dgemv_t)(long int m,
+                 long int n,
+                 double alpha,
+                 const double *A,
+                 long int incRowA,
+                 long int incColA,
+                 const double *x,
+                 long int incX,
+                 double beta,
+                 double *y,
+                 long int incY,
+                 int threads,
+                 const struct ulm_epilogue *ep) {
+    return ULMBLAS(dgemv)(n, m, alpha, A, incColA, incRowA, x, incX, beta, y, incY, threads, ep);
+}
+
+#endif // ULMBLAS_DGEMV_H
@@ -0,0 +1,134 @@
+#ifndef ULMBLAS_DGER_H
+#define ULMBLAS_DGER_H 1
+
+#include "ulmblas.h"
+#include "workspace.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Only start another thread for every this many elements of A.  Like a
+//  product with a vector, a rank 1 update is limited by memory bandwidth.
+//
+#define ULM_DGER_WORK_PER_THREAD  (1L << 16)
+
+//
+//  Compute A <- A + alpha*x*y^T in place, where A is m x n, using up to
+//  `threads` threads (the OpenMP default if threads <= 0).  Every element of A
+//  is read and written once.  The rows of A are split between threads if they
+//  are contiguous, otherwise the columns are, so no two threads write the
+//  same cache line of A.
+//
+//  Returns 0 on success and -1 if a contiguous copy of x or y was needed but
+//  could not be allocated, in which case A is unchanged.
+//
+static int
+ULMBLAS(dger)(long int m,
+              long int n,
+              double alpha,
+              const double *x,
+              long int incX,
+              const double *y,
+              long int incY,
+              double *A,
+              long int incRowA,
+              long int incColA,
+              int threads) {
+    double *_v = NULL;
+    long int nthreads;
+    long int i, j;
+
+    if (m <= 0 || n <= 0 || alpha == 0.0) {
+        return 0;
+    }
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    nthreads = 1 + (long int) ((double) m * (double) n / ULM_DGER_WORK_PER_THREAD);
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+//
+//  Row major A: A[i][:] += (alpha*x[i]) * y, with y contiguous
+//
+    if (incColA == 1) {
+        if (incY != 1) {
+            _v = ulm_malloc_aligned((size_t) n);
+            if (_v == NULL) {
+                return -1;
+            }
+            for (j = 0; j < n; ++j) {
+                _v[j] = y[j * incY];
+            }
+            y = _v;
+        }
+
+#       pragma omp parallel for num_threads(nthreads) schedule(static) private(j) if(nthreads > 1)
+        for (i = 0; i < m; ++i) {
+            const double ax = alpha * x[i * incX];
+            double *a = &A[i * incRowA];
+
+            for (j = 0; j < n; ++j) {
+                a[j] += ax * y[j];
+            }
+        }
+
+        ulm_free_aligned(_v);
+        return 0;
+    }
+
+//
+//  Column major A: A[:][j] += (alpha*y[j]) * x, with x contiguous
+//
+    if (incRowA == 1) {
+        if (incX != 1) {
+            _v = ulm_malloc_aligned((size_t) m);
+            if (_v == NULL) {
+                return -1;
+            }
+            for (i = 0; i < m; ++i) {
+                _v[i] = x[i * incX];
+            }
+            x = _v;
+        }
+
+#       pragma omp parallel for num_threads(nthreads) schedule(static) private(i) if(nthreads > 1)
+        for (j = 0; j < n; ++j) {
+            const double ay = alpha * y[j * incY];
+            double *a = &A[j * incColA];
+
+            for (i = 0; i < m; ++i) {
+                a[i] += ay * x[i];
+            }
+        }
+
+        ulm_free_aligned(_v);
+        return 0;
+    }
+
+//
+//  Neither the rows nor the columns of A are contiguous
+//
+#   pragma omp parallel for num_threads(nthreads) schedule(static) private(j) if(nthreads > 1)
+    for (i = 0; i < m; ++i) {
+        const double ax = alpha * x[i * incX];
+
+        for (j = 0; j < n; ++j) {
+            A[i * incRowA + j * incColA] += ax * y[j * incY];
+        }
+    }
+
+    return 0;
+}
+
+#endif // ULMBLAS_DGER_H
@@ -0,0 +1,606 @@
+#ifndef ULMBLAS_DPACKMM_H
+#define ULMBLAS_DPACKMM_H 1
+
+//
+//  Products with an n x n symmetric or triangular matrix in packed storage.
+//  Only one triangle is stored, row by row, in n*(n+1)/2 elements:
+//
+//      AP[i*(i+1)/2 + j]        element (i, j) of the lower triangle L,
+//                               0 <= j <= i < n
+//
+//  A symmetric matrix A is stored as its lower triangle (A = L + L^T - diag),
+//  a lower triangular matrix as itself and an upper triangular matrix U as its
+//  transpose L = U^T.  Transposing a packed matrix therefore only swaps the
+//  lower and upper kinds and leaves the stored elements as they are.
+//
+//  Needs dgemm_nn and dgemm_small, which come in through dgemm.c
+//
+#include "ulmblas.h"
+#include "dgemm_small.h"
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define ULM_PACKED_SYMMETRIC  0
+#define ULM_PACKED_LOWER      1
+#define ULM_PACKED_UPPER      2
+
+//
+//  Rows of the result computed together.  The elements of the stored triangle
+//  below a block of rows are read a row segment at a time, so that the part of
+//  A that is only stored transposed is still read contiguously.
+//
+#define ULM_DPACK_MB  64
+
+//
+//  Only start another thread for every this many multiply-adds
+//
+#define ULM_DPACK_WORK_PER_THREAD  (1L << 16)
+
+#define ulm_dpack_length(n)  ((n) * ((n) + 1) / 2)
+
+static long int
+ulm_dpack_threads(double work, int threads) {
+    long int nthreads = 1 + (long int) (work / ULM_DPACK_WORK_PER_THREAD);
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+    return nthreads;
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B for a narrow B, where A is an m x m packed
+//  matrix of the given kind, B is dense m x n and C is dense m x n.  Row i of
+//  C gathers
+//
+//      sum_{j <= i} L[i][j] * B[j]     from row i of the stored triangle
+//                                      (symmetric and lower)
+//      sum_{j >= i} L[j][i] * B[j]     from column i of the stored triangle
+//                                      (symmetric for j > i, and upper)
+//
+//  Blocks of ULM_DPACK_MB rows of C are shared out between threads, so every
+//  thread only writes its own rows.  Triangular kinds give rows different
+//  amounts of work, so the blocks are handed out dynamically.
+//
+static void
+ulm_dpackmm_gather(int kind,
+                   long int m,
+                   long int n,
+                   double alpha,
+                   const double *AP,
+                   const double *B,
+                   long int incRowB,
+                   long int incColB,
+                   double beta,
+                   double *C,
+                   long int incRowC,
+                   long int incColC,
+                   int threads) {
+    long int nthreads, blocks, ib;
+    int rowPart = (kind != ULM_PACKED_UPPER);
+    int colPart = (kind != ULM_PACKED_LOWER);
+    int colDiag = (kind == ULM_PACKED_UPPER);
+
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+
+    blocks = (m + ULM_DPACK_MB - 1) / ULM_DPACK_MB;
+    nthreads = ulm_dpack_threads((double) ulm_dpack_length(m) * (double) (1 + colPart) * (double) n, threads);
+
+#   pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1) if(nthreads > 1)
+    for (ib = 0; ib < blocks; ++ib) {
+        long int i0 = ib * ULM_DPACK_MB;
+        long int i1 = (i0 + ULM_DPACK_MB < m) ? i0 + ULM_DPACK_MB : m;
+        long int i, j, l, hi;
+
+        for (i = i0; i < i1; ++i) {
+            double *c = &C[i * incRowC];
+
+            for (l = 0; l < n; ++l) {
+                c[l * incColC] = (beta == 0.0) ? 0.0 : beta * c[l * incColC];
+            }
+        }
+
+        if (rowPart) {
+            for (i = i0; i < i1; ++i) {
+                const double *row = &AP[ulm_dpack_length(i)];
+                double *c = &C[i * incRowC];
+
+                if (n == 1) {
+                    double ab = 0.0;
+
+                    for (j = 0; j <= i; ++j) {
+                        ab += row[j] * B[j * incRowB];
+                    }
+                    c[0] += alpha * ab;
+                    continue;
+                }
+
+                for (j = 0; j <= i; ++j) {
+                    const double a = alpha * row[j];
+                    const double *b = &B[j * incRowB];
+
+                    if (incColB == 1 && incColC == 1) {
+                        for (l = 0; l < n; ++l) {
+                            c[l] += a * b[l];
+                        }
+                    } else {
+                        for (l = 0; l < n; ++l) {
+                            c[l * incColC] += a * b[l * incColB];
+                        }
+                    }
+                }
+            }
+        }
+
+        if (colPart) {
+            for (j = i0; j < m; ++j) {
+                const double *row = &AP[ulm_dpack_length(j)];
+                const double *b = &B[j * incRowB];
+
+//
+//              Row j holds L[j][i] for i <= j, of which the block uses
+//              i0 <= i < min(i1, j), and i = j as well for an upper matrix
+//
+                hi = colDiag ? j + 1 : j;
+                hi = (hi < i1) ? hi : i1;
+
+                if (n == 1) {
+                    const double ab = alpha * b[0];
+
+                    for (i = i0; i < hi; ++i) {
+                        C[i * incRowC] += ab * row[i];
+                    }
+                    continue;
+                }
+
+                for (i = i0; i < hi; ++i) {
+                    const double a = alpha * row[i];
+                    double *c = &C[i * incRowC];
+
+                    if (incColB == 1 && incColC == 1) {
+                        for (l = 0; l < n; ++l) {
+                            c[l] += a * b[l];
+                        }
+                    } else {
+                        for (l = 0; l < n; ++l) {
+                            c[l * incColC] += a * b[l * incColB];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B for a short A, where A is dense m x n, B is
+//  an n x n packed matrix of the given kind and C is dense m x n.  Row i of C
+//  is
+//
+//      C[i][0..l] += A[i][l] * L[l][0..l]       for every row l of the stored
+//                                               triangle (symmetric and lower)
+//      C[i][l]    += A[i][0..l) . L[l][0..l)    the same row read as column l
+//                                               (symmetric, and upper with the
+//                                               diagonal included)
+//
+//  so every row of L is read contiguously, and used for ULM_DPACK_GE_MB rows of
+//  A while it is in cache.  Each thread owns whole rows of C.
+//
+#define ULM_DPACK_GE_MB  8
+
+static void
+ulm_dgepackmm_gather(int kind,
+                     long int m,
+                     long int n,
+                     double alpha,
+                     const double *A,
+                     long int incRowA,
+                     long int incColA,
+                     const double *BP,
+                     double beta,
+                     double *C,
+                     long int incRowC,
+                     long int incColC,
+                     int threads) {
+    long int nthreads, blocks, ib;
+    int rowPart = (kind != ULM_PACKED_UPPER);
+    int colPart = (kind != ULM_PACKED_LOWER);
+    int colDiag = (kind == ULM_PACKED_UPPER);
+
+    if (m <= 0 || n <= 0) {
+        return;
+    }
+
+    blocks = (m + ULM_DPACK_GE_MB - 1) / ULM_DPACK_GE_MB;
+    nthreads = ulm_dpack_threads((double) ulm_dpack_length(n) * (double) (1 + colPart) * (double) m, threads);
+
+#   pragma omp parallel for num_threads(nthreads) schedule(static) if(nthreads > 1)
+    for (ib = 0; ib < blocks; ++ib) {
+        long int i0 = ib * ULM_DPACK_GE_MB;
+        long int i1 = (i0 + ULM_DPACK_GE_MB < m) ? i0 + ULM_DPACK_GE_MB : m;
+        long int i, j, l, len;
+
+        for (i = i0; i < i1; ++i) {
+            double *c = &C[i * incRowC];
+
+            for (j = 0; j < n; ++j) {
+                c[j * incColC] = (beta == 0.0) ? 0.0 : beta * c[j * incColC];
+            }
+        }
+
+        for (l = 0; l < n; ++l) {
+            const double *row = &BP[ulm_dpack_length(l)];
+            len = colDiag ? l + 1 : l;
+
+            for (i = i0; i < i1; ++i) {
+                const double *a = &A[i * incRowA];
+                double *c = &C[i * incRowC];
+
+                if (rowPart) {
+                    const double al = alpha * a[l * incColA];
+
+                    if (al != 0.0) {
+                        if (incColC == 1) {
+                            for (j = 0; j <= l; ++j) {
+                                c[j] += al * row[j];
+                            }
+                        } else {
+                            for (j = 0; j <= l; ++j) {
+                                c[j * incColC] += al * row[j];
+                            }
+                        }
+                    }
+                }
+
+                if (colPart) {
+                    double ab = 0.0;
+
+                    if (incColA == 1) {
+                        for (j = 0; j < len; ++j) {
+                            ab += a[j] * row[j];
+                        }
+                    } else {
+                        for (j = 0; j < len; ++j) {
+                            ab += a[j * incColA] * row[j];
+                        }
+                    }
+                    c[l * incColC] += alpha * ab;
+                }
+            }
+        }
+    }
+}
+
+//
+//  Side of the tiles of a packed matrix expanded for the dense kernels, and the
+//  narrowest dense operand for which they are used instead of the gather
+//  kernels above
+//
+#define ULM_DPACK_NB        256
+#define ULM_DPACK_GEMM_MIN  2
+
+//
+//  Expand the tile A[i0:i1, j0:j1] of an n x n packed matrix of the given kind
+//  into T and set the strides it is stored with.  A tile below the diagonal is
+//  copied from the rows of the stored triangle as it is, and one above it from
+//  the rows of its transpose, so that both are read contiguously.  Returns 0 if
+//  the tile is zero, which is the case above the diagonal of a lower matrix and
+//  below the diagonal of an upper one.
+//
+static int
+ulm_dpack_tile(int kind,
+               const double *AP,
+               long int i0,
+               long int i1,
+               long int j0,
+               long int j1,
+               double *T,
+               long int *incRowT,
+               long int *incColT) {
+    long int rows = i1 - i0, cols = j1 - j0;
+    long int i, j;
+
+    if (i0 == j0) {
+        for (i = i0; i < i1; ++i) {
+            for (j = j0; j < j1; ++j) {
+                double a;
+
+                if (j <= i) {
+                    a = (kind == ULM_PACKED_UPPER && j < i) ? 0.0 : AP[ulm_dpack_length(i) + j];
+                } else {
+                    a = (kind == ULM_PACKED_LOWER) ? 0.0 : AP[ulm_dpack_length(j) + i];
+                }
+                T[(i - i0) * cols + (j - j0)] = a;
+            }
+        }
+
+        *incRowT = cols;
+        *incColT = 1;
+        return 1;
+    }
+
+    if (i0 > j0) {
+        if (kind == ULM_PACKED_UPPER) {
+            return 0;
+        }
+
+        for (i = i0; i < i1; ++i) {
+            const double *row = &AP[ulm_dpack_length(i) + j0];
+
+            for (j = 0; j < cols; ++j) {
+                T[(i - i0) * cols + j] = row[j];
+            }
+        }
+
+        *incRowT = cols;
+        *incColT = 1;
+        return 1;
+    }
+
+    if (kind == ULM_PACKED_LOWER) {
+        return 0;
+    }
+
+    for (j = j0; j < j1; ++j) {
+        const double *row = &AP[ulm_dpack_length(j) + i0];
+
+        for (i = 0; i < rows; ++i) {
+            T[(j - j0) * rows + i] = row[i];
+        }
+    }
+
+    *incRowT = 1;
+    *incColT = rows;
+    return 1;
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B for the product of a tile, with dgemm_nn,
+//  or with dgemm_small if it is too small to be worth packing
+//
+static int
+ulm_dpack_gemm(long int m,
+               long int n,
+               long int k,
+               double alpha,
+               const double *A,
+               long int incRowA,
+               long int incColA,
+               const double *B,
+               long int incRowB,
+               long int incColB,
+               double beta,
+               double *C,
+               long int incRowC,
+               long int incColC,
+               int threads) {
+    if (m * n * k > ULM_DGEMM_SMALL_CROSSOVER) {
+        return ULMBLAS(dgemm_nn)(m, n, k, alpha, A, incRowA, incColA, B, incRowB, incColB,
+                                 beta, C, incRowC, incColC, threads);
+    }
+
+    ULMBLAS(dgemm_small)(m, n, k, alpha, A, incRowA, incColA, B, incRowB, incColB, beta, C, incRowC, incColC);
+    return 0;
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B, where A is an m x m packed matrix of the
+//  given kind, B is dense m x n and C is dense m x n, using up to `threads`
+//  threads (the OpenMP default if threads <= 0).
+//
+//  Narrow products are computed by the gather kernel.  Wider ones expand A a
+//  tile at a time and multiply the tiles with the dense kernels, so that only
+//  a single tile is ever held unpacked, and the zero tiles of a triangular A
+//  are skipped.  Returns 0 on success and -1 if a buffer could not be
+//  allocated, in which case C is left partly updated.
+//
+static int
+ULMBLAS(dpackmm)(int kind,
+                 long int m,
+                 long int n,
+                 double alpha,
+                 const double *AP,
+                 const double *B,
+                 long int incRowB,
+                 long int incColB,
+                 double beta,
+                 double *C,
+                 long int incRowC,
+                 long int incColC,
+                 int threads) {
+    long int i0, i1, j0, j1, incRowT, incColT;
+    double *T;
+
+    if (n < ULM_DPACK_GEMM_MIN) {
+        ulm_dpackmm_gather(kind, m, n, alpha, AP, B, incRowB, incColB, beta, C, incRowC, incColC, threads);
+        return 0;
+    }
+
+    T = malloc(sizeof(double) * ULM_DPACK_NB * ULM_DPACK_NB);
+    if (T == NULL) {
+        return -1;
+    }
+
+    for (i0 = 0; i0 < m; i0 += ULM_DPACK_NB) {
+        double b = beta;
+        i1 = (i0 + ULM_DPACK_NB < m) ? i0 + ULM_DPACK_NB : m;
+
+        for (j0 = 0; j0 < m; j0 += ULM_DPACK_NB) {
+            j1 = (j0 + ULM_DPACK_NB < m) ? j0 + ULM_DPACK_NB : m;
+
+            if (!ulm_dpack_tile(kind, AP, i0, i1, j0, j1, T, &incRowT, &incColT)) {
+                continue;
+            }
+
+            // C[i0:i1, :] <- b*C[i0:i1, :] + alpha*A[i0:i1, j0:j1]*B[j0:j1, :]
+            if (ulm_dpack_gemm(i1 - i0, n, j1 - j0, alpha, T, incRowT, incColT,
+                               &B[j0 * incRowB], incRowB, incColB,
+                               b, &C[i0 * incRowC], incRowC, incColC, threads) != 0) {
+                free(T);
+                return -1;
+            }
+            b = 1.0;
+        }
+    }
+
+    free(T);
+    return 0;
+}
+
+//
+//  Compute C <- beta*C + alpha*A*B, where A is dense m x n, B is an n x n
+//  packed matrix of the given kind and C is dense m x n, by the gather kernel
+//  for a short A and a tile at a time as for dpackmm otherwise
+//
+static int
+ULMBLAS(dgepackmm)(int kind,
+                   long int m,
+                   long int n,
+                   double alpha,
+                   const double *A,
+                   long int incRowA,
+                   long int incColA,
+                   const double *BP,
+                   double beta,
+                   double *C,
+                   long int incRowC,
+                   long int incColC,
+                   int threads) {
+    long int i0, i1, j0, j1, incRowT, incColT;
+    double *T;
+
+    if (m < ULM_DPACK_GEMM_MIN) {
+        ulm_dgepackmm_gather(kind, m, n, alpha, A, incRowA, incColA, BP, beta, C, incRowC, incColC, threads);
+        return 0;
+    }
+
+    T = malloc(sizeof(double) * ULM_DPACK_NB * ULM_DPACK_NB);
+    if (T == NULL) {
+        return -1;
+    }
+
+    for (j0 = 0; j0 < n; j0 += ULM_DPACK_NB) {
+        double b = beta;
+        j1 = (j0 + ULM_DPACK_NB < n) ? j0 + ULM_DPACK_NB : n;
+
+        for (i0 = 0; i0 < n; i0 += ULM_DPACK_NB) {
+            i1 = (i0 + ULM_DPACK_NB < n) ? i0 + ULM_DPACK_NB : n;
+
+            if (!ulm_dpack_tile(kind, BP, i0, i1, j0, j1, T, &incRowT, &incColT)) {
+                continue;
+            }
+
+            // C[:, j0:j1] <- b*C[:, j0:j1] + alpha*A[:, i0:i1]*B[i0:i1, j0:j1]
+            if (ulm_dpack_gemm(m, j1 - j0, i1 - i0, alpha, &A[i0 * incColA], incRowA, incColA,
+                               T, incRowT, incColT,
+                               b, &C[j0 * incColC], incRowC, incColC, threads) != 0) {
+                free(T);
+                return -1;
+            }
+            b = 1.0;
+        }
+    }
+
+    free(T);
+    return 0;
+}
+
+//
+//  Store the triangle of the dense n x n matrix A that a packed matrix of the
+//  given kind keeps in AP: the lower triangle for symmetric and lower matrices,
+//  and the transposed upper triangle for upper matrices.
+//
+static void
+ulm_dpack_pack(int kind,
+               long int n,
+               const double *A,
+               long int incRowA,
+               long int incColA,
+               double *AP,
+               int threads) {
+    long int nthreads, i;
+
+    if (kind == ULM_PACKED_UPPER) {
+        long int tmp = incRowA;
+        incRowA = incColA;
+        incColA = tmp;
+    }
+
+    nthreads = ulm_dpack_threads((double) ulm_dpack_length(n), threads);
+
+#   pragma omp parallel for num_threads(nthreads) schedule(static) if(nthreads > 1)
+    for (i = 0; i < n; ++i) {
+        double *row = &AP[ulm_dpack_length(i)];
+        long int j;
+
+        for (j = 0; j <= i; ++j) {
+            row[j] = A[i * incRowA + j * incColA];
+        }
+    }
+}
+
+//
+//  Expand the packed matrix AP of the given kind into the dense n x n matrix
+//  C, mirroring a symmetric matrix and filling the empty triangle of a
+//  triangular one with zeros
+//
+static void
+ulm_dpack_unpack(int kind,
+                 long int n,
+                 const double *AP,
+                 double *C,
+                 long int incRowC,
+                 long int incColC,
+                 int threads) {
+    long int nthreads, i;
+
+    if (kind == ULM_PACKED_UPPER) {
+        long int tmp = incRowC;
+        incRowC = incColC;
+        incColC = tmp;
+    }
+
+    nthreads = ulm_dpack_threads((double) n * (double) n, threads);
+
+#   pragma omp parallel for num_threads(nthreads) schedule(static) if(nthreads > 1)
+    for (i = 0; i < n; ++i) {
+        const double *row = &AP[ulm_dpack_length(i)];
+        double *c = &C[i * incRowC];
+        long int j;
+
+        for (j = 0; j <= i; ++j) {
+            c[j * incColC] = row[j];
+        }
+
+//
+//      Row i of the stored triangle is also column i of a symmetric matrix.
+//      No other row writes these elements, as they lie above the diagonal.
+//
+        if (kind == ULM_PACKED_SYMMETRIC) {
+            for (j = 0; j < i; ++j) {
+                C[j * incRowC + i * incColC] = row[j];
+            }
+        } else {
+            for (j = i + 1; j < n; ++j) {
+                c[j * incColC] = 0.0;
+            }
+        }
+    }
+}
+
+#endif // ULMBLAS_DPACKMM_H
@@ -0,0 +1,319 @@
+#ifndef ULMBLAS_DSUM_H
+#define ULMBLAS_DSUM_H 1
+
+//
+//  Sum of the elements of a matrix.  Every thread sums its own part of the
+//  matrix into a private partial sum, and the partial sums are added up in a
+//  fixed order at the end, so the threads never share an accumulator and the
+//  result only depends on the number of threads.
+//
+//  Three ways of adding up the elements trade speed for accuracy:
+//
+//      ULM_SUM_FAST        16 running sums in 4 AVX registers.  The error
+//                          grows with the number of elements, n*eps at worst.
+//      ULM_SUM_PAIRWISE    blocks of ULM_DSUM_BLOCK elements are summed as for
+//                          ULM_SUM_FAST, and then added in pairs, halves of
+//                          halves, for an error of about log2(n)*eps.
+//      ULM_SUM_KAHAN       compensated summation, which carries the rounding
+//                          error of every addition along.  The error does not
+//                          grow with n, at about twice the cost.
+//
+#include "ulmblas.h"
+#include <immintrin.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define ULM_SUM_FAST      0
+#define ULM_SUM_PAIRWISE  1
+#define ULM_SUM_KAHAN     2
+
+//
+//  Only start another thread for every this many elements.  Summing is limited
+//  by memory bandwidth, like a product with a vector.
+//
+#define ULM_DSUM_WORK_PER_THREAD  (1L << 16)
+
+//
+//  Elements summed directly at the leaves of the pairwise summation
+//
+#define ULM_DSUM_BLOCK  128
+
+//
+//  Most threads that can hold a partial sum
+//
+#define ULM_DSUM_MAX_THREADS  256
+
+ULM_TARGET("avx")
+static double
+dsum_fast_avx(long int n, const double *x) {
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd();
+    double s[4];
+    double res;
+    long int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(&x[i]));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(&x[i + 4]));
+        s2 = _mm256_add_pd(s2, _mm256_loadu_pd(&x[i + 8]));
+        s3 = _mm256_add_pd(s3, _mm256_loadu_pd(&x[i + 12]));
+    }
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(&x[i]));
+    }
+
+    s0 = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+    _mm256_storeu_pd(s, s0);
+    res = (s[0] + s[1]) + (s[2] + s[3]);
+
+    for (; i < n; ++i) {
+        res += x[i];
+    }
+
+    return res;
+}
+
+//
+//  Kahan summation with 8 running sums and their compensations, so that the
+//  four dependent additions of every step can overlap between two registers
+//
+ULM_TARGET("avx")
+static double
+dsum_kahan_avx(long int n, const double *x) {
+    __m256d s0 = _mm256_setzero_pd(), c0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd();
+    __m256d y, t;
+    double s[8], c[8];
+    double res = 0.0, comp = 0.0, yy, tt;
+    long int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        y = _mm256_sub_pd(_mm256_loadu_pd(&x[i]), c0);
+        t = _mm256_add_pd(s0, y);
+        c0 = _mm256_sub_pd(_mm256_sub_pd(t, s0), y);
+        s0 = t;
+
+        y = _mm256_sub_pd(_mm256_loadu_pd(&x[i + 4]), c1);
+        t = _mm256_add_pd(s1, y);
+        c1 = _mm256_sub_pd(_mm256_sub_pd(t, s1), y);
+        s1 = t;
+    }
+
+    _mm256_storeu_pd(s, s0);
+    _mm256_storeu_pd(&s[4], s1);
+    _mm256_storeu_pd(c, c0);
+    _mm256_storeu_pd(&c[4], c1);
+
+    for (; i < n; ++i) {
+        yy = x[i] - comp;
+        tt = res + yy;
+        comp = (tt - res) - yy;
+        res = tt;
+    }
+
+    for (i = 0; i < 8; ++i) {
+        yy = s[i] - (c[i] + comp);
+        tt = res + yy;
+        comp = (tt - res) - yy;
+        res = tt;
+    }
+
+    return res;
+}
+
+static double
+dsum_fast_strided(long int n, const double *x, long int incX) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    long int i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        s0 += x[i * incX];
+        s1 += x[(i + 1) * incX];
+        s2 += x[(i + 2) * incX];
+        s3 += x[(i + 3) * incX];
+    }
+    for (; i < n; ++i) {
+        s0 += x[i * incX];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static double
+dsum_kahan_strided(long int n, const double *x, long int incX) {
+    double res = 0.0, comp = 0.0, y, t;
+    long int i;
+
+    for (i = 0; i < n; ++i) {
+        y = x[i * incX] - comp;
+        t = res + y;
+        comp = (t - res) - y;
+        res = t;
+    }
+
+    return res;
+}
+
+static double
+dsum_pairwise(long int n, const double *x, long int incX) {
+    long int half;
+
+    if (n <= ULM_DSUM_BLOCK) {
+        return (incX == 1) ? dsum_fast_avx(n, x) : dsum_fast_strided(n, x, incX);
+    }
+
+    // Split on a multiple of the block, so the leaves are full blocks
+    half = ((n / 2 + ULM_DSUM_BLOCK - 1) / ULM_DSUM_BLOCK) * ULM_DSUM_BLOCK;
+    return dsum_pairwise(half, x, incX) + dsum_pairwise(n - half, &x[half * incX], incX);
+}
+
+//
+//  Sum of the n elements x[0], x[incX], ..., x[(n-1)*incX] by the given mode
+//
+static double
+ulm_dsum_vector(long int n, const double *x, long int incX, int mode) {
+    if (n <= 0) {
+        return 0.0;
+    }
+
+    if (mode == ULM_SUM_PAIRWISE) {
+        return dsum_pairwise(n, x, incX);
+    } else if (mode == ULM_SUM_KAHAN) {
+        return (incX == 1) ? dsum_kahan_avx(n, x) : dsum_kahan_strided(n, x, incX);
+    }
+
+    return (incX == 1) ? dsum_fast_avx(n, x) : dsum_fast_strided(n, x, incX);
+}
+
+//
+//  Sum of rows r0 to r1 - 1 of the m x n matrix A, where the rows are the
+//  vectors with stride incColA.  Pairwise summation splits the rows in halves
+//  as well, and Kahan summation carries the compensation from row to row.
+//
+static double
+dsum_rows(long int r0,
+          long int r1,
+          long int n,
+          const double *A,
+          long int incRowA,
+          long int incColA,
+          int mode) {
+    double res = 0.0, comp = 0.0, y, t;
+    long int i, half;
+
+    if (mode == ULM_SUM_PAIRWISE && r1 - r0 > 1) {
+        half = r0 + (r1 - r0) / 2;
+        return dsum_rows(r0, half, n, A, incRowA, incColA, mode) + dsum_rows(half, r1, n, A, incRowA, incColA, mode);
+    }
+
+    for (i = r0; i < r1; ++i) {
+        y = ulm_dsum_vector(n, &A[i * incRowA], incColA, mode) - comp;
+
+        if (mode == ULM_SUM_KAHAN) {
+            t = res + y;
+            comp = (t - res) - y;
+            res = t;
+        } else {
+            res += y;
+        }
+    }
+
+    return res;
+}
+
+//
+//  Return the sum of the elements of the m x n matrix A by the given mode,
+//  using up to `threads` threads (the OpenMP default if threads <= 0).  A
+//  contiguous matrix is summed as a single vector that is split evenly between
+//  the threads, and any other matrix by rows or by columns, whichever of them
+//  are closer together in memory, with whole rows or columns to every thread.
+//
+static double
+ULMBLAS(dsum)(long int m,
+              long int n,
+              const double *A,
+              long int incRowA,
+              long int incColA,
+              int mode,
+              int threads) {
+    double partial[ULM_DSUM_MAX_THREADS];
+    double res = 0.0, comp = 0.0, y, t;
+    long int nthreads, parts, p;
+    int flat;
+
+    if (m <= 0 || n <= 0) {
+        return 0.0;
+    }
+
+//
+//  Sum along the direction with the smaller stride, as rows of the matrix
+//
+    if (labs(incRowA) < labs(incColA)) {
+        long int tmp = m;
+        m = n;
+        n = tmp;
+        tmp = incRowA;
+        incRowA = incColA;
+        incColA = tmp;
+    }
+
+    flat = (incColA == 1 && incRowA == n);
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    nthreads = 1 + (long int) ((double) m * (double) n / ULM_DSUM_WORK_PER_THREAD);
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+    if (nthreads > ULM_DSUM_MAX_THREADS) {
+        nthreads = ULM_DSUM_MAX_THREADS;
+    }
+    if (!flat && nthreads > m) {
+        nthreads = m;
+    }
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+    parts = nthreads;
+
+#   pragma omp parallel for num_threads(nthreads) schedule(static) if(nthreads > 1)
+    for (p = 0; p < parts; ++p) {
+        if (flat) {
+            long int length = m * n;
+            long int i0 = (long int) ((double) length * (double) p / (double) parts);
+            long int i1 = (long int) ((double) length * (double) (p + 1) / (double) parts);
+
+            partial[p] = ulm_dsum_vector(i1 - i0, &A[i0], 1, mode);
+        } else {
+            long int r0 = m * p / parts;
+            long int r1 = m * (p + 1) / parts;
+
+            partial[p] = dsum_rows(r0, r1, n, A, incRowA, incColA, mode);
+        }
+    }
+
+    for (p = 0; p < parts; ++p) {
+        y = partial[p] - comp;
+
+        if (mode == ULM_SUM_KAHAN) {
+            t = res + y;
+            comp = (t - res) - y;
+            res = t;
+        } else {
+            res += y;
+        }
+    }
+
+    return res;
+}
+
+#endif // ULMBLAS_DSUM_H
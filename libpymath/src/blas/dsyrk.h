@@ -0,0 +1,128 @@
+#ifndef ULMBLAS_DSYRK_H
+#define ULMBLAS_DSYRK_H 1
+
+//
+//  Needs dgemm_nn and dgemm_small, which come in through dgemm.c
+//
+#include "ulmblas.h"
+#include "dgemm_small.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Width of the column blocks of C.  The diagonal block of every column block
+//  is computed in full, so about ULM_DSYRK_NB / n of the work is wasted on the
+//  upper triangle, while narrower blocks give dgemm_nn less to work with.
+//
+#define ULM_DSYRK_NB  256
+
+//
+//  Side of the tiles copied from the lower to the upper triangle
+//
+#define ULM_DSYRK_MIRROR_TILE  32
+
+//
+//  Copy the strictly lower triangle of the n x n matrix C to the upper one, a
+//  tile at a time so that both the reads and the writes stay in cache
+//
+static void
+dsyrk_mirror(long int n, double *C, long int incRowC, long int incColC, int threads) {
+    long int tiles = (n + ULM_DSYRK_MIRROR_TILE - 1) / ULM_DSYRK_MIRROR_TILE;
+    long int ti;
+
+#   pragma omp parallel for num_threads(threads) schedule(dynamic) if(threads > 1)
+    for (ti = 0; ti < tiles; ++ti) {
+        long int i0 = ti * ULM_DSYRK_MIRROR_TILE;
+        long int i1 = (i0 + ULM_DSYRK_MIRROR_TILE < n) ? i0 + ULM_DSYRK_MIRROR_TILE : n;
+        long int j0, j1, i, j;
+
+        for (j0 = 0; j0 <= i0; j0 += ULM_DSYRK_MIRROR_TILE) {
+            j1 = (j0 + ULM_DSYRK_MIRROR_TILE < n) ? j0 + ULM_DSYRK_MIRROR_TILE : n;
+
+            for (i = i0; i < i1; ++i) {
+                for (j = j0; j < j1 && j < i; ++j) {
+                    C[j * incRowC + i * incColC] = C[i * incRowC + j * incColC];
+                }
+            }
+        }
+    }
+}
+
+//
+//  Compute C <- beta*C + alpha*A*A^T, where A is n x k and C is a symmetric
+//  n x n matrix, using up to `threads` threads (the OpenMP default if
+//  threads <= 0).  A product with A^T*A is the same call with n, k and the
+//  strides of A swapped.
+//
+//  Only the column blocks on and below the diagonal are computed, each one by
+//  a single product with the existing kernels, which takes about half the work
+//  of the full product.  The upper triangle is then copied from the lower one,
+//  so if beta != 0 C must be symmetric on entry.
+//
+//  Returns 0 on success and -1 if the buffers of a product could not be
+//  allocated, in which case C is left partly updated.
+//
+static int
+ULMBLAS(dsyrk)(long int n,
+               long int k,
+               double alpha,
+               const double *A,
+               long int incRowA,
+               long int incColA,
+               double beta,
+               double *C,
+               long int incRowC,
+               long int incColC,
+               int threads) {
+    long int j, nb, rows;
+    long int nthreads;
+
+    if (n <= 0) {
+        return 0;
+    }
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    for (j = 0; j < n; j += ULM_DSYRK_NB) {
+        nb = (j + ULM_DSYRK_NB < n) ? ULM_DSYRK_NB : n - j;
+        rows = n - j;
+
+        // C[j:n, j:j+nb] <- beta*C[j:n, j:j+nb] + alpha*A[j:n, :]*A[j:j+nb, :]^T
+        if (rows * nb * k > ULM_DGEMM_SMALL_CROSSOVER) {
+            if (ULMBLAS(dgemm_nn)(rows, nb, k, alpha,
+                                  &A[j * incRowA], incRowA, incColA,
+                                  &A[j * incRowA], incColA, incRowA,
+                                  beta,
+                                  &C[j * incRowC + j * incColC], incRowC, incColC,
+                                  threads) != 0) {
+                return -1;
+            }
+        } else {
+            ULMBLAS(dgemm_small)(rows, nb, k, alpha,
+                                 &A[j * incRowA], incRowA, incColA,
+                                 &A[j * incRowA], incColA, incRowA,
+                                 beta,
+                                 &C[j * incRowC + j * incColC], incRowC, incColC);
+        }
+    }
+
+    nthreads = 1 + n * n / (1L << 16);
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+#ifndef _OPENMP
+    nthreads = 1;
+#endif
+
+    dsyrk_mirror(n, C, incRowC, incColC, (int) nthreads);
+
+    return 0;
+}
+
+#endif // ULMBLAS_DSYRK_H
@@ -0,0 +1,438 @@
+#ifndef ULMBLAS_DVMATH_H
+#define ULMBLAS_DVMATH_H 1
+
+//
+//  Vectorised exp, tanh and sigmoid for the activation functions, evaluated
+//  with AVX2 and FMA.  Processors without them fall back to libm.
+//
+//  exp(x) is reduced to 2^k * exp(r) with k = round(x / ln 2) and |r| below
+//  ln(2) / 2, where exp(r) is a Taylor polynomial.  tanh(x) is computed as
+//  expm1(2x) / (expm1(2x) + 2), which keeps the relative error small for small
+//  x as well.  sigmoid(x) is computed from e = exp(-|x|) as 1 / (1 + e) for
+//  x >= 0 and e / (1 + e) for x < 0, so that it follows exp(x) into the
+//  subnormals instead of becoming 1 / inf = 0 below x = -709.78.  Two
+//  accuracies are available:
+//
+//      ULM_MATH_FULL   four doubles at a time with a polynomial of degree 13.
+//                      exp is within 1 unit in the last place (ULP) of the
+//                      exact result and tanh and sigmoid within 2 ULP, as
+//                      checked by tests/test_vmath.py.
+//      ULM_MATH_FAST   tanh and sigmoid round x to float32 and are evaluated
+//                      eight at a time, within 2 float32 ULP of the result for
+//                      the rounded x.  Results below the float32 range, from
+//                      about x = -103.3 for sigmoid, are 0.  exp keeps doubles
+//                      with a polynomial of degree 7, for a relative error
+//                      below 1e-8.
+//
+//  float32 vectors are evaluated in double precision by ULM_MATH_FULL, and in
+//  single precision by ULM_MATH_FAST.
+//
+#include "ulmblas.h"
+#include "cpufeatures.h"
+#include <immintrin.h>
+#include <math.h>
+
+#define ULM_MATH_FULL  0
+#define ULM_MATH_FAST  1
+
+#define ULM_VMATH_EXP      0
+#define ULM_VMATH_TANH     1
+#define ULM_VMATH_SIGMOID  2
+
+//
+//  Degree of the polynomials for exp(r) and expm1(r) in each mode
+//
+#define ULM_VMATH_FULL_DEGREE  13
+#define ULM_VMATH_FAST_DEGREE  7
+
+//
+//  Arguments of exp beyond these give inf and 0 in double precision, and |x|
+//  beyond 20 gives a tanh of exactly +-1
+//
+#define ULM_VMATH_EXP_HI   710.0
+#define ULM_VMATH_EXP_LO  -746.0
+#define ULM_VMATH_TANH_HI  20.0
+
+//
+//  1 if the processor supports AVX2 and FMA, checked on the first call
+//
+static int
+ulm_vmath_simd(void) {
+    static int simd = -1;
+
+    if (simd < 0) {
+        int features = ulm_cpu_features();
+
+        simd = (features & CpuAVX2) && (features & CpuFMA);
+    }
+
+    return simd;
+}
+
+//
+//  r + r^2/2! + ... + r^degree/degree!, which is expm1(r) up to the truncation
+//  error, by Horner's scheme from the highest power down
+//
+ULM_TARGET("avx2,fma")
+static inline __m256d
+vmath_expm1_poly(__m256d r, int degree) {
+    static const double inverseFactorial[] = {
+        1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320, 1.0 / 362880,
+        1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800.0
+    };
+    __m256d p = _mm256_set1_pd(inverseFactorial[degree]);
+    int i;
+
+    for (i = degree - 1; i >= 2; --i) {
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(inverseFactorial[i]));
+    }
+
+    return _mm256_fmadd_pd(_mm256_mul_pd(r, r), p, r);
+}
+
+//
+//  Split x into k * ln(2) + r, with k rounded to the nearest integer.  ln(2)
+//  is split into a high and low part, so r is exact up to the last product.
+//
+ULM_TARGET("avx2,fma")
+static inline __m256d
+vmath_reduce(__m256d x, __m256d *k) {
+    const __m256d log2e = _mm256_set1_pd(1.4426950408889634074);
+    const __m256d ln2Hi = _mm256_set1_pd(6.93147180559945286227e-01);
+    const __m256d ln2Lo = _mm256_set1_pd(2.31904681384629955842e-17);
+    __m256d r;
+
+    *k = _mm256_round_pd(_mm256_mul_pd(x, log2e), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    r = _mm256_fnmadd_pd(*k, ln2Hi, x);
+    return _mm256_fnmadd_pd(*k, ln2Lo, r);
+}
+
+//
+//  2^k for integers k with -1022 <= k <= 1023, built from the exponent bits.
+//  Adding 1.5 * 2^52 leaves the biased exponent k + 1023 in the low bits.
+//
+ULM_TARGET("avx2,fma")
+static inline __m256d
+vmath_pow2(__m256d k) {
+    const __m256d magic = _mm256_set1_pd(6755399441055744.0 + 1023.0);
+
+    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(k, magic)), 52));
+}
+
+ULM_TARGET("avx2,fma")
+static inline __m256d
+vmath_exp_avx2(__m256d x, int degree) {
+    __m256d k, k1, r, p;
+
+    // The first operand is returned for a NaN x, so NaN stays NaN
+    x = _mm256_min_pd(_mm256_set1_pd(ULM_VMATH_EXP_HI), x);
+    x = _mm256_max_pd(_mm256_set1_pd(ULM_VMATH_EXP_LO), x);
+
+    r = vmath_reduce(x, &k);
+    p = _mm256_add_pd(_mm256_set1_pd(1.0), vmath_expm1_poly(r, degree));
+
+//
+//  Scale by 2^k in two steps, so that k can go beyond the exponent range for
+//  results that overflow to inf or are subnormal
+//
+    k1 = _mm256_floor_pd(_mm256_mul_pd(k, _mm256_set1_pd(0.5)));
+    p = _mm256_mul_pd(p, vmath_pow2(k1));
+    return _mm256_mul_pd(p, vmath_pow2(_mm256_sub_pd(k, k1)));
+}
+
+ULM_TARGET("avx2,fma")
+static inline __m256d
+vmath_tanh_avx2(__m256d x, int degree) {
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    __m256d sign = _mm256_and_pd(x, signMask);
+    __m256d y, k, r, s, e;
+
+    // expm1(2|x|) = 2^k * expm1(r) + 2^k - 1, where 2^k - 1 is exact and the
+    // sum has no cancellation
+    y = _mm256_min_pd(_mm256_set1_pd(ULM_VMATH_TANH_HI), _mm256_andnot_pd(signMask, x));
+    y = _mm256_add_pd(y, y);
+    r = vmath_reduce(y, &k);
+    s = vmath_pow2(k);
+    e = _mm256_fmadd_pd(s, vmath_expm1_poly(r, degree), _mm256_sub_pd(s, _mm256_set1_pd(1.0)));
+
+    return _mm256_or_pd(_mm256_div_pd(e, _mm256_add_pd(e, _mm256_set1_pd(2.0))), sign);
+}
+
+//
+//  1 / (1 + e) for x >= 0 and e / (1 + e) for x < 0, with e = exp(-|x|).  The
+//  blend picks the numerator by the sign bit of x.
+//
+ULM_TARGET("avx2,fma")
+static inline __m256d
+vmath_sigmoid_avx2(__m256d x, int degree) {
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d e = vmath_exp_avx2(_mm256_or_pd(x, _mm256_set1_pd(-0.0)), degree);
+
+    return _mm256_div_pd(_mm256_blendv_pd(one, e, x), _mm256_add_pd(one, e));
+}
+
+ULM_TARGET("avx2,fma")
+static inline __m256d
+vmath_apply_avx2(int fn, __m256d x, int degree) {
+    if (fn == ULM_VMATH_TANH) {
+        return vmath_tanh_avx2(x, degree);
+    } else if (fn == ULM_VMATH_SIGMOID) {
+        return vmath_sigmoid_avx2(x, degree);
+    }
+
+    return vmath_exp_avx2(x, degree);
+}
+
+//
+//  The same functions for eight floats at a time, used by ULM_MATH_FAST.  The
+//  Taylor polynomial of degree 7 is accurate to float32 rounding, and the
+//  clamps are those of the float32 range.
+//
+ULM_TARGET("avx2,fma")
+static inline __m256
+vmath_expm1_poly_ps(__m256 r) {
+    __m256 p = _mm256_set1_ps(1.0f / 5040);
+
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 720));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 120));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 24));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 6));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.0f / 2));
+
+    return _mm256_fmadd_ps(_mm256_mul_ps(r, r), p, r);
+}
+
+ULM_TARGET("avx2,fma")
+static inline __m256
+vmath_reduce_ps(__m256 x, __m256 *k) {
+    *k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_fnmadd_ps(*k, _mm256_set1_ps(0.693145752f), x);
+    return _mm256_fnmadd_ps(*k, _mm256_set1_ps(1.42860677e-06f), x);
+}
+
+ULM_TARGET("avx2,fma")
+static inline __m256
+vmath_pow2_ps(__m256 k) {
+    const __m256 magic = _mm256_set1_ps(12582912.0f + 127.0f);
+
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_castps_si256(_mm256_add_ps(k, magic)), 23));
+}
+
+ULM_TARGET("avx2,fma")
+static inline __m256
+vmath_exp_ps(__m256 x) {
+    __m256 k, k1, p;
+
+    x = _mm256_min_ps(_mm256_set1_ps(89.0f), x);
+    x = _mm256_max_ps(_mm256_set1_ps(-104.0f), x);
+
+    x = vmath_reduce_ps(x, &k);
+    p = _mm256_add_ps(_mm256_set1_ps(1.0f), vmath_expm1_poly_ps(x));
+
+    k1 = _mm256_floor_ps(_mm256_mul_ps(k, _mm256_set1_ps(0.5f)));
+    p = _mm256_mul_ps(p, vmath_pow2_ps(k1));
+    return _mm256_mul_ps(p, vmath_pow2_ps(_mm256_sub_ps(k, k1)));
+}
+
+ULM_TARGET("avx2,fma")
+static inline __m256
+vmath_apply_ps(int fn, __m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    if (fn == ULM_VMATH_TANH) {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256 sign = _mm256_and_ps(x, signMask);
+        __m256 y, k, s, e;
+
+        y = _mm256_min_ps(_mm256_set1_ps(9.5f), _mm256_andnot_ps(signMask, x));
+        y = vmath_reduce_ps(_mm256_add_ps(y, y), &k);
+        s = vmath_pow2_ps(k);
+        e = _mm256_fmadd_ps(s, vmath_expm1_poly_ps(y), _mm256_sub_ps(s, one));
+
+        return _mm256_or_ps(_mm256_div_ps(e, _mm256_add_ps(e, _mm256_set1_ps(2.0f))), sign);
+    } else if (fn == ULM_VMATH_SIGMOID) {
+        __m256 e = vmath_exp_ps(_mm256_or_ps(x, _mm256_set1_ps(-0.0f)));
+
+        return _mm256_div_ps(_mm256_blendv_ps(one, e, x), _mm256_add_ps(one, e));
+    }
+
+    return vmath_exp_ps(x);
+}
+
+//
+//  out[0..7] = fn(in[0..7]).  ULM_MATH_FAST rounds tanh and sigmoid to floats
+//  and back, which doubles the number of lanes, while exp keeps the double
+//  range with a polynomial of lower degree.
+//
+ULM_TARGET("avx2,fma")
+static inline void
+dvmath_block8(int fn, const double *in, double *out, int mode) {
+    __m256d lo = _mm256_loadu_pd(in);
+    __m256d hi = _mm256_loadu_pd(&in[4]);
+
+    if (mode == ULM_MATH_FAST && fn != ULM_VMATH_EXP) {
+        __m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+
+        v = vmath_apply_ps(fn, v);
+        _mm256_storeu_pd(out, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+        _mm256_storeu_pd(&out[4], _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+    } else if (mode == ULM_MATH_FAST) {
+        _mm256_storeu_pd(out, vmath_apply_avx2(fn, lo, ULM_VMATH_FAST_DEGREE));
+        _mm256_storeu_pd(&out[4], vmath_apply_avx2(fn, hi, ULM_VMATH_FAST_DEGREE));
+    } else {
+        _mm256_storeu_pd(out, vmath_apply_avx2(fn, lo, ULM_VMATH_FULL_DEGREE));
+        _mm256_storeu_pd(&out[4], vmath_apply_avx2(fn, hi, ULM_VMATH_FULL_DEGREE));
+    }
+}
+
+//
+//  y[i*incY] = fn(x[i*incX]) for 0 <= i < n.  Strided elements and the last
+//  n % 8 elements go through a buffer, so every element gets the same result
+//  whatever the layout.  x and y may be the same vector.
+//
+ULM_TARGET("avx2,fma")
+static void
+dvmath_avx2(int fn, long int n, const double *x, long int incX, double *y, long int incY, int mode) {
+    double buffer[8];
+    long int i, l;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        if (incX == 1 && incY == 1) {
+            dvmath_block8(fn, &x[i], &y[i], mode);
+        } else {
+            for (l = 0; l < 8; ++l) {
+                buffer[l] = x[(i + l) * incX];
+            }
+            dvmath_block8(fn, buffer, buffer, mode);
+            for (l = 0; l < 8; ++l) {
+                y[(i + l) * incY] = buffer[l];
+            }
+        }
+    }
+
+    if (i < n) {
+        for (l = 0; l < 8; ++l) {
+            buffer[l] = (i + l < n) ? x[(i + l) * incX] : 0.0;
+        }
+        dvmath_block8(fn, buffer, buffer, mode);
+        for (l = 0; i + l < n; ++l) {
+            y[(i + l) * incY] = buffer[l];
+        }
+    }
+}
+
+//
+//  The same for float32 vectors.  ULM_MATH_FULL evaluates them in double
+//  precision, which rounds to the nearest float32 in all but a handful of cases.
+//
+ULM_TARGET("avx2,fma")
+static inline void
+svmath_block8(int fn, const float *in, float *out, int mode) {
+    __m256 v = _mm256_loadu_ps(in);
+
+    if (mode == ULM_MATH_FAST) {
+        _mm256_storeu_ps(out, vmath_apply_ps(fn, v));
+    } else {
+        __m256d lo = vmath_apply_avx2(fn, _mm256_cvtps_pd(_mm256_castps256_ps128(v)), ULM_VMATH_FULL_DEGREE);
+        __m256d hi = vmath_apply_avx2(fn, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), ULM_VMATH_FULL_DEGREE);
+
+        _mm256_storeu_ps(out, _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1));
+    }
+}
+
+ULM_TARGET("avx2,fma")
+static void
+svmath_avx2(int fn, long int n, const float *x, long int incX, float *y, long int incY, int mode) {
+    float buffer[8];
+    long int i, l;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        if (incX == 1 && incY == 1) {
+            svmath_block8(fn, &x[i], &y[i], mode);
+        } else {
+            for (l = 0; l < 8; ++l) {
+                buffer[l] = x[(i + l) * incX];
+            }
+            svmath_block8(fn, buffer, buffer, mode);
+            for (l = 0; l < 8; ++l) {
+                y[(i + l) * incY] = buffer[l];
+            }
+        }
+    }
+
+    if (i < n) {
+        for (l = 0; l < 8; ++l) {
+            buffer[l] = (i + l < n) ? x[(i + l) * incX] : 0.0f;
+        }
+        svmath_block8(fn, buffer, buffer, mode);
+        for (l = 0; i + l < n; ++l) {
+            y[(i + l) * incY] = buffer[l];
+        }
+    }
+}
+
+//
+//  y[i*incY] = fn(x[i*incX]) for 0 <= i < n, where fn is ULM_VMATH_EXP,
+//  ULM_VMATH_TANH or ULM_VMATH_SIGMOID and mode is ULM_MATH_FULL or
+//  ULM_MATH_FAST
+//
+static void
+ulm_dvmath(int fn, long int n, const double *x, long int incX, double *y, long int incY, int mode) {
+    long int i;
+
+    if (n <= 0) {
+        return;
+    }
+
+    if (ulm_vmath_simd()) {
+        dvmath_avx2(fn, n, x, incX, y, incY, mode);
+        return;
+    }
+
+    for (i = 0; i < n; ++i) {
+        double v = x[i * incX];
+
+        if (fn == ULM_VMATH_TANH) {
+            y[i * incY] = tanh(v);
+        } else if (fn == ULM_VMATH_SIGMOID) {
+            double e = exp(-fabs(v));
+
+            y[i * incY] = (v < 0.0 ? e : 1.0) / (1.0 + e);
+        } else {
+            y[i * incY] = exp(v);
+        }
+    }
+}
+
+//
+//  Single precision version of ulm_dvmath
+//
+static void
+ulm_svmath(int fn, long int n, const float *x, long int incX, float *y, long int incY, int mode) {
+    long int i;
+
+    if (n <= 0) {
+        return;
+    }
+
+    if (ulm_vmath_simd()) {
+        svmath_avx2(fn, n, x, incX, y, incY, mode);
+        return;
+    }
+
+    for (i = 0; i < n; ++i) {
+        float v = x[i * incX];
+
+        if (fn == ULM_VMATH_TANH) {
+            y[i * incY] = tanhf(v);
+        } else if (fn == ULM_VMATH_SIGMOID) {
+            float e = expf(-fabsf(v));
+
+            y[i * incY] = (v < 0.0f ? e : 1.0f) / (1.0f + e);
+        } else {
+            y[i * incY] = expf(v);
+        }
+    }
+}
+
+#endif // ULMBLAS_DVMATH_H
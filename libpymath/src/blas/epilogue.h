@@ -0,0 +1,213 @@
+#ifndef ULMBLAS_EPILOGUE_H
+#define ULMBLAS_EPILOGUE_H 1
+
+#include "dvmath.h"
+#include <math.h>
+#include <stddef.h>
+
+//
+//  Activation applied by an epilogue.  The formulas match the matrix map
+//  functions, so a fused product gives the same result as a product followed
+//  by a map in ULM_MATH_FULL (see dvmath.h).
+//
+enum UlmActivation {
+    UlmActNone      = 0,
+    UlmActSigmoid   = 1,
+    UlmActTanh      = 2,
+    UlmActRelu      = 3,
+    UlmActLeakyRelu = 4
+};
+
+#define ULM_LEAKY_RELU_SLOPE 0.2
+
+//
+//  Work done on each block of C right after it has been computed, while it is
+//  still in cache: C <- act(C + bias).  A bias of NULL adds nothing.  A
+//  broadcast bias (one row or one column) has a stride of 0 along the
+//  broadcast dimension.
+//
+struct ulm_epilogue {
+    const double *bias;
+    long int incRowBias;
+    long int incColBias;
+    enum UlmActivation activation;
+};
+
+//
+//  The same for products in single precision
+//
+struct ulm_sepilogue {
+    const float *bias;
+    long int incRowBias;
+    long int incColBias;
+    enum UlmActivation activation;
+};
+
+//
+//  The epilogue of the transposed product C^T
+//
+static const struct ulm_epilogue *
+ulm_epilogue_transposed(const struct ulm_epilogue *ep, struct ulm_epilogue *buffer) {
+    if (ep == NULL) {
+        return NULL;
+    }
+
+    buffer->bias = ep->bias;
+    buffer->incRowBias = ep->incColBias;
+    buffer->incColBias = ep->incRowBias;
+    buffer->activation = ep->activation;
+
+    return buffer;
+}
+
+//
+//  Apply a function of dvmath.h to every row of C, along its contiguous
+//  dimension, once the bias has been added
+//
+#define ULM_EPILOGUE_VMATH(vmath, fn)                                       \
+    for (i = 0; i < m; ++i) {                                               \
+        vmath(fn, n, &C[i * incRowC], incColC, &C[i * incRowC], incColC,   \
+              ULM_MATH_FULL);                                               \
+    }
+
+#define ULM_EPILOGUE_LOOP(T, f)                                             \
+    for (i = 0; i < m; ++i) {                                               \
+        for (j = 0; j < n; ++j) {                                           \
+            T *c = &C[i * incRowC + j * incColC];                           \
+            T x = *c;                                                       \
+                                                                            \
+            if (bias != NULL) {                                             \
+                x += bias[i * incRowBias + j * incColBias];                 \
+            }                                                               \
+            *c = f;                                                         \
+        }                                                                   \
+    }
+
+//
+//  Apply the epilogue to the m x n block of C that starts at row i0 and column
+//  j0 of the whole result.  C points at the first element of the block.
+//
+static void
+ulm_epilogue_apply(const struct ulm_epilogue *ep,
+                   long int m, long int n,
+                   long int i0, long int j0,
+                   double *C, long int incRowC, long int incColC) {
+    const double *bias;
+    long int incRowBias, incColBias;
+    long int i, j;
+
+    if (ep == NULL || m <= 0 || n <= 0) {
+        return;
+    }
+
+    incRowBias = ep->incRowBias;
+    incColBias = ep->incColBias;
+    bias = (ep->bias != NULL) ? &ep->bias[i0 * incRowBias + j0 * incColBias] : NULL;
+
+//
+//  Walk C along its contiguous dimension
+//
+    if (incRowC < incColC) {
+        long int t;
+
+        t = m; m = n; n = t;
+        t = incRowC; incRowC = incColC; incColC = t;
+        t = incRowBias; incRowBias = incColBias; incColBias = t;
+    }
+
+    switch (ep->activation) {
+        case UlmActSigmoid:
+            if (bias != NULL) {
+                ULM_EPILOGUE_LOOP(double, x)
+            }
+            ULM_EPILOGUE_VMATH(ulm_dvmath, ULM_VMATH_SIGMOID)
+            break;
+        case UlmActTanh:
+            if (bias != NULL) {
+                ULM_EPILOGUE_LOOP(double, x)
+            }
+            ULM_EPILOGUE_VMATH(ulm_dvmath, ULM_VMATH_TANH)
+            break;
+        case UlmActRelu:
+            ULM_EPILOGUE_LOOP(double, x > 0 ? x : 0.0)
+            break;
+        case UlmActLeakyRelu:
+            ULM_EPILOGUE_LOOP(double, x > 0 ? x : x * ULM_LEAKY_RELU_SLOPE)
+            break;
+        default:
+            ULM_EPILOGUE_LOOP(double, x)
+            break;
+    }
+}
+
+static const struct ulm_sepilogue *
+ulm_sepilogue_transposed(const struct ulm_sepilogue *ep, struct ulm_sepilogue *buffer) {
+    if (ep == NULL) {
+        return NULL;
+    }
+
+    buffer->bias = ep->bias;
+    buffer->incRowBias = ep->incColBias;
+    buffer->incColBias = ep->incRowBias;
+    buffer->activation = ep->activation;
+
+    return buffer;
+}
+
+//
+//  Single precision version of ulm_epilogue_apply
+//
+static void
+ulm_sepilogue_apply(const struct ulm_sepilogue *ep,
+                    long int m, long int n,
+                    long int i0, long int j0,
+                    float *C, long int incRowC, long int incColC) {
+    const float *bias;
+    long int incRowBias, incColBias;
+    long int i, j;
+
+    if (ep == NULL || m <= 0 || n <= 0) {
+        return;
+    }
+
+    incRowBias = ep->incRowBias;
+    incColBias = ep->incColBias;
+    bias = (ep->bias != NULL) ? &ep->bias[i0 * incRowBias + j0 * incColBias] : NULL;
+
+    if (incRowC < incColC) {
+        long int t;
+
+        t = m; m = n; n = t;
+        t = incRowC; incRowC = incColC; incColC = t;
+        t = incRowBias; incRowBias = incColBias; incColBias = t;
+    }
+
+    switch (ep->activation) {
+        case UlmActSigmoid:
+            if (bias != NULL) {
+                ULM_EPILOGUE_LOOP(float, x)
+            }
+            ULM_EPILOGUE_VMATH(ulm_svmath, ULM_VMATH_SIGMOID)
+            break;
+        case UlmActTanh:
+            if (bias != NULL) {
+                ULM_EPILOGUE_LOOP(float, x)
+            }
+            ULM_EPILOGUE_VMATH(ulm_svmath, ULM_VMATH_TANH)
+            break;
+        case UlmActRelu:
+            ULM_EPILOGUE_LOOP(float, x > 0 ? x : 0.0f)
+            break;
+        case UlmActLeakyRelu:
+            ULM_EPILOGUE_LOOP(float, x > 0 ? x : x * (float) ULM_LEAKY_RELU_SLOPE)
+            break;
+        default:
+            ULM_EPILOGUE_LOOP(float, x)
+            break;
+    }
+}
+
+#undef ULM_EPILOGUE_LOOP
+#undef ULM_EPILOGUE_VMATH
+
+#endif // ULMBLAS_EPILOGUE_H
@@ -0,0 +1,450 @@
+#ifndef ULMBLAS_QGEMM_H
+#define ULMBLAS_QGEMM_H 1
+
+//
+//  Quantised matrix product for inference.  A is quantised once to int8 with
+//  one scale per row, and every column of B is quantised to int8 with its own
+//  scale when the product is computed.  The int8 x int8 products are summed
+//  exactly in int32, and each element of C is scaled back to double:
+//
+//      C(i,j) = alpha * scaleA(i) * scaleB(j) * sum_l qA(i,l) * qB(l,j)
+//
+//  Values are rounded to the nearest of -127 ... 127 times the scale, so the
+//  largest absolute value of a row or column is represented exactly.
+//
+#include "ulmblas.h"
+#include "cpufeatures.h"
+#include "workspace.h"
+#include "epilogue.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Rows of A handled by one call of a kernel, and the multiple the depth of
+//  the quantised operands is padded to with zeros, so that every kernel works
+//  on whole registers
+//
+#define ULM_QGEMM_MR    4
+#define ULM_QGEMM_KPAD  64
+
+//
+//  Bytes of quantised columns of B worked on at a time, so that they stay in
+//  the L2 cache while they are multiplied with every row of A
+//
+#define ULM_QGEMM_NC_BYTES  (1L << 17)
+
+//
+//  Only start another thread for every this many multiply-adds
+//
+#define ULM_QGEMM_WORK_PER_THREAD  (1L << 20)
+
+//
+//  A quantised m x k operand.  The rows are stored one after the other with
+//  kp >= k bytes each, and the rows and columns past m and k are zero.  rowSum
+//  holds the sum of the quantised values of every row, which the kernels that
+//  multiply unsigned with signed bytes need to correct their result.
+//
+struct ulm_qgemm_weights {
+    long int m;
+    long int k;
+    long int kp;
+    long int refs;
+    int8_t *data;
+    float *scale;
+    int32_t *rowSum;
+};
+
+//
+//  Compute the ULM_QGEMM_MR dot products of kp bytes between the rows of A,
+//  which are kp bytes apart, and x
+//
+typedef void (*ulm_qgemm_dot_kernel)(long kp, const int8_t *A, const int32_t *rowSum, const int8_t *x,
+                                     int32_t *dot);
+
+struct ulm_qgemm_kernel {
+    const char *name;
+    int features;
+    ulm_qgemm_dot_kernel kernel;
+};
+
+//
+//  Quantise the n values of x to q and return the scale.  q is padded with
+//  zeros to np values.
+//
+static float
+qgemm_quantize_vector(long int n, const double *x, long int incX, int8_t *q, long int np) {
+    double maxAbs = 0.0;
+    double scale, inv, v;
+    long int i;
+
+    for (i = 0; i < n; ++i) {
+        v = fabs(x[i * incX]);
+        maxAbs = (v > maxAbs) ? v : maxAbs;
+    }
+
+    scale = maxAbs / 127.0;
+    inv = (maxAbs > 0.0) ? 127.0 / maxAbs : 0.0;
+
+    for (i = 0; i < n; ++i) {
+        v = nearbyint(x[i * incX] * inv);
+        q[i] = (int8_t) ((v > 127.0) ? 127.0 : (v < -127.0) ? -127.0 : v);
+    }
+    for (i = n; i < np; ++i) {
+        q[i] = 0;
+    }
+
+    return (float) scale;
+}
+
+//
+//  Load bytes and widen them to words, for the kernels below
+//
+ULM_TARGET("avx")
+static inline __m128i
+qgemm_widen_avx(const int8_t *p) {
+    return _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *) p));
+}
+
+ULM_TARGET("avx2")
+static inline __m256i
+qgemm_widen_avx2(const int8_t *p) {
+    return _mm256_cvtepi8_epi16(_mm_load_si128((const __m128i *) p));
+}
+
+ULM_TARGET("avx512f,avx512bw")
+static inline __m512i
+qgemm_widen_avx512(const int8_t *p) {
+    return _mm512_cvtepi8_epi16(_mm256_load_si256((const __m256i *) p));
+}
+
+//
+//  SSE4.1 kernel.  Eight bytes of each row are widened to words and multiplied
+//  in pairs with pmaddwd, which cannot overflow as no value is -128.
+//
+ULM_TARGET("avx")
+static void
+qgemm_dot_kernel_avx(long kp, const int8_t *A, const int32_t *rowSum, const int8_t *x, int32_t *dot) {
+    __m128i ab_0 = _mm_setzero_si128();
+    __m128i ab_1 = _mm_setzero_si128();
+    __m128i ab_2 = _mm_setzero_si128();
+    __m128i ab_3 = _mm_setzero_si128();
+    const int8_t *a_1 = &A[kp], *a_2 = &A[2 * kp], *a_3 = &A[3 * kp];
+    __m128i x_;
+    long l;
+
+    (void) rowSum;
+
+    for (l = 0; l < kp; l += 8) {
+        x_ = qgemm_widen_avx(&x[l]);
+
+        ab_0 = _mm_add_epi32(ab_0, _mm_madd_epi16(qgemm_widen_avx(&A[l]), x_));
+        ab_1 = _mm_add_epi32(ab_1, _mm_madd_epi16(qgemm_widen_avx(&a_1[l]), x_));
+        ab_2 = _mm_add_epi32(ab_2, _mm_madd_epi16(qgemm_widen_avx(&a_2[l]), x_));
+        ab_3 = _mm_add_epi32(ab_3, _mm_madd_epi16(qgemm_widen_avx(&a_3[l]), x_));
+    }
+
+    ab_0 = _mm_hadd_epi32(_mm_hadd_epi32(ab_0, ab_1), _mm_hadd_epi32(ab_2, ab_3));
+    _mm_storeu_si128((__m128i *) dot, ab_0);
+}
+
+//
+//  AVX2 kernel, the same with 16 bytes of each row per step.  pmaddubsw would
+//  take twice as many bytes, but it saturates the sum of two products of an
+//  unsigned and a signed byte at 16 bits, which the full int8 range overflows.
+//
+ULM_TARGET("avx2")
+static void
+qgemm_dot_kernel_avx2(long kp, const int8_t *A, const int32_t *rowSum, const int8_t *x, int32_t *dot) {
+    __m256i ab_0 = _mm256_setzero_si256();
+    __m256i ab_1 = _mm256_setzero_si256();
+    __m256i ab_2 = _mm256_setzero_si256();
+    __m256i ab_3 = _mm256_setzero_si256();
+    const int8_t *a_1 = &A[kp], *a_2 = &A[2 * kp], *a_3 = &A[3 * kp];
+    __m256i x_;
+    long l;
+
+    (void) rowSum;
+
+    for (l = 0; l < kp; l += 16) {
+        x_ = qgemm_widen_avx2(&x[l]);
+
+        ab_0 = _mm256_add_epi32(ab_0, _mm256_madd_epi16(qgemm_widen_avx2(&A[l]), x_));
+        ab_1 = _mm256_add_epi32(ab_1, _mm256_madd_epi16(qgemm_widen_avx2(&a_1[l]), x_));
+        ab_2 = _mm256_add_epi32(ab_2, _mm256_madd_epi16(qgemm_widen_avx2(&a_2[l]), x_));
+        ab_3 = _mm256_add_epi32(ab_3, _mm256_madd_epi16(qgemm_widen_avx2(&a_3[l]), x_));
+    }
+
+    ab_0 = _mm256_hadd_epi32(_mm256_hadd_epi32(ab_0, ab_1), _mm256_hadd_epi32(ab_2, ab_3));
+    _mm_storeu_si128((__m128i *) dot, _mm_add_epi32(_mm256_castsi256_si128(ab_0), _mm256_extracti128_si256(ab_0, 1)));
+}
+
+//
+//  AVX-512 kernel, the same with 32 bytes of each row per step
+//
+ULM_TARGET("avx512f,avx512bw")
+static void
+qgemm_dot_kernel_avx512(long kp, const int8_t *A, const int32_t *rowSum, const int8_t *x, int32_t *dot) {
+    __m512i ab_0 = _mm512_setzero_si512();
+    __m512i ab_1 = _mm512_setzero_si512();
+    __m512i ab_2 = _mm512_setzero_si512();
+    __m512i ab_3 = _mm512_setzero_si512();
+    const int8_t *a_1 = &A[kp], *a_2 = &A[2 * kp], *a_3 = &A[3 * kp];
+    __m512i x_;
+    long l;
+
+    (void) rowSum;
+
+    for (l = 0; l < kp; l += 32) {
+        x_ = qgemm_widen_avx512(&x[l]);
+
+        ab_0 = _mm512_add_epi32(ab_0, _mm512_madd_epi16(qgemm_widen_avx512(&A[l]), x_));
+        ab_1 = _mm512_add_epi32(ab_1, _mm512_madd_epi16(qgemm_widen_avx512(&a_1[l]), x_));
+        ab_2 = _mm512_add_epi32(ab_2, _mm512_madd_epi16(qgemm_widen_avx512(&a_2[l]), x_));
+        ab_3 = _mm512_add_epi32(ab_3, _mm512_madd_epi16(qgemm_widen_avx512(&a_3[l]), x_));
+    }
+
+    dot[0] = _mm512_reduce_add_epi32(ab_0);
+    dot[1] = _mm512_reduce_add_epi32(ab_1);
+    dot[2] = _mm512_reduce_add_epi32(ab_2);
+    dot[3] = _mm512_reduce_add_epi32(ab_3);
+}
+
+//
+//  AVX-512 VNNI kernel.  vpdpbusd adds the products of 64 unsigned bytes of x
+//  and signed bytes of a row straight to int32, four at a time, without any
+//  saturation.  x is made unsigned by flipping its sign bit, which adds 128 to
+//  every value, and 128 times the sum of the row is taken off again at the end.
+//
+ULM_TARGET("avx512f,avx512bw,avx512vnni")
+static void
+qgemm_dot_kernel_avx512vnni(long kp, const int8_t *A, const int32_t *rowSum, const int8_t *x, int32_t *dot) {
+    const __m512i flip = _mm512_set1_epi8((char) 0x80);
+    __m512i ab_0 = _mm512_setzero_si512();
+    __m512i ab_1 = _mm512_setzero_si512();
+    __m512i ab_2 = _mm512_setzero_si512();
+    __m512i ab_3 = _mm512_setzero_si512();
+    const int8_t *a_1 = &A[kp], *a_2 = &A[2 * kp], *a_3 = &A[3 * kp];
+    __m512i x_;
+    long l;
+
+    for (l = 0; l < kp; l += 64) {
+        x_ = _mm512_xor_si512(_mm512_load_si512((const void *) &x[l]), flip);
+
+        ab_0 = _mm512_dpbusd_epi32(ab_0, x_, _mm512_load_si512((const void *) &A[l]));
+        ab_1 = _mm512_dpbusd_epi32(ab_1, x_, _mm512_load_si512((const void *) &a_1[l]));
+        ab_2 = _mm512_dpbusd_epi32(ab_2, x_, _mm512_load_si512((const void *) &a_2[l]));
+        ab_3 = _mm512_dpbusd_epi32(ab_3, x_, _mm512_load_si512((const void *) &a_3[l]));
+    }
+
+    dot[0] = _mm512_reduce_add_epi32(ab_0) - 128 * rowSum[0];
+    dot[1] = _mm512_reduce_add_epi32(ab_1) - 128 * rowSum[1];
+    dot[2] = _mm512_reduce_add_epi32(ab_2) - 128 * rowSum[2];
+    dot[3] = _mm512_reduce_add_epi32(ab_3) - 128 * rowSum[3];
+}
+
+//
+//  All kernels, best first, chosen like the dgemm kernels
+//
+static const struct ulm_qgemm_kernel ULM_QGEMM_KERNELS[] = {
+        {"avx512vnni", CpuAVX512F | CpuAVX512BW | CpuAVX512VNNI, qgemm_dot_kernel_avx512vnni},
+        {"avx512",     CpuAVX512F | CpuAVX512BW,                 qgemm_dot_kernel_avx512},
+        {"avx2",       CpuAVX2,                                  qgemm_dot_kernel_avx2},
+        {"avx",        0,                                        qgemm_dot_kernel_avx},
+};
+
+#define ULM_QGEMM_KERNEL_COUNT ((long) (sizeof(ULM_QGEMM_KERNELS) / sizeof(ULM_QGEMM_KERNELS[0])))
+
+static const struct ulm_qgemm_kernel *ULM_QGEMM_KERNEL = &ULM_QGEMM_KERNELS[ULM_QGEMM_KERNEL_COUNT - 1];
+
+//
+//  Pick the fastest kernel the processor supports, honouring the kernel named
+//  by LIBPYMATH_GEMM_KERNEL if it has an int8 version
+//
+static void
+ULMBLAS(qgemm_select_kernel)(void) {
+    int features = ulm_cpu_features();
+    const char *requested = getenv("LIBPYMATH_GEMM_KERNEL");
+    const struct ulm_qgemm_kernel *best = NULL;
+    long int i;
+
+    for (i = 0; i < ULM_QGEMM_KERNEL_COUNT; ++i) {
+        const struct ulm_qgemm_kernel *kernel = &ULM_QGEMM_KERNELS[i];
+
+        if ((kernel->features & features) != kernel->features) {
+            continue;
+        }
+
+        if (best == NULL || (requested != NULL && strcmp(requested, kernel->name) == 0)) {
+            best = kernel;
+        }
+    }
+
+    if (best != NULL) {
+        ULM_QGEMM_KERNEL = best;
+    }
+}
+
+//
+//  Drop a reference to a quantised operand, freeing it with the last one
+//
+static void
+ulm_qgemm_weights_release(struct ulm_qgemm_weights *weights) {
+    if (weights != NULL && --weights->refs == 0) {
+        ulm_free_aligned(weights->data);
+        free(weights->scale);
+        free(weights->rowSum);
+        free(weights);
+    }
+}
+
+//
+//  Quantise the m x k matrix A with one scale per row.  Returns NULL if there
+//  is not enough memory.  The result starts with one reference.
+//
+static struct ulm_qgemm_weights *
+ULMBLAS(qgemm_quantize)(long int m, long int k, const double *A, long int incRowA, long int incColA) {
+    struct ulm_qgemm_weights *weights;
+    long int mp = (m + ULM_QGEMM_MR - 1) / ULM_QGEMM_MR * ULM_QGEMM_MR;
+    long int kp = (k > 0) ? (k + ULM_QGEMM_KPAD - 1) / ULM_QGEMM_KPAD * ULM_QGEMM_KPAD : ULM_QGEMM_KPAD;
+    long int i, l;
+
+    weights = malloc(sizeof(struct ulm_qgemm_weights));
+    if (weights == NULL) {
+        return NULL;
+    }
+
+    weights->m = m;
+    weights->k = k;
+    weights->kp = kp;
+    weights->refs = 1;
+    weights->data = (int8_t *) ulm_malloc_aligned((size_t) ((mp * kp + 7) / 8));
+    weights->scale = calloc((size_t) (mp > 0 ? mp : 1), sizeof(float));
+    weights->rowSum = calloc((size_t) (mp > 0 ? mp : 1), sizeof(int32_t));
+
+    if (weights->data == NULL || weights->scale == NULL || weights->rowSum == NULL) {
+        ulm_qgemm_weights_release(weights);
+        return NULL;
+    }
+
+    memset(weights->data, 0, (size_t) (mp * kp));
+
+    for (i = 0; i < m; ++i) {
+        int8_t *row = &weights->data[i * kp];
+
+        weights->scale[i] = qgemm_quantize_vector(k, &A[i * incRowA], incColA, row, kp);
+
+        for (l = 0; l < k; ++l) {
+            weights->rowSum[i] += row[l];
+        }
+    }
+
+    return weights;
+}
+
+//
+//  Compute C <- act(beta*C + alpha*A*B + bias) with the quantised m x k matrix
+//  A, using up to `threads` threads (the OpenMP default if threads <= 0).  The
+//  threads first quantise the columns of B together, and then share the rows
+//  of A for each block of columns, applying the epilogue to every block of C
+//  they finish.  Returns 0 on success and -1 if the buffers could not be
+//  allocated, in which case C is unchanged.
+//
+static int
+ULMBLAS(qgemm)(long int m,
+               long int n,
+               long int k,
+               double alpha,
+               const struct ulm_qgemm_weights *A,
+               const double *B,
+               long int incRowB,
+               long int incColB,
+               double beta,
+               double *C,
+               long int incRowC,
+               long int incColC,
+               int threads,
+               const struct ulm_epilogue *ep) {
+    const struct ulm_qgemm_kernel *kernel = ULM_QGEMM_KERNEL;
+    const long int kp = A->kp;
+    const long int mp = (m + ULM_QGEMM_MR - 1) / ULM_QGEMM_MR;
+
+    long int nc, nthreads;
+    int8_t *_B;
+    float *scaleB;
+
+    if (m <= 0 || n <= 0) {
+        return 0;
+    }
+
+    nc = ULM_QGEMM_NC_BYTES / kp;
+    nc = (nc < 1) ? 1 : (nc > n) ? n : nc;
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    nthreads = 1 + (long int) ((double) m * (double) n * (double) k / ULM_QGEMM_WORK_PER_THREAD);
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+
+    _B = (int8_t *) ulm_malloc_aligned((size_t) ((n * kp + 7) / 8));
+    scaleB = malloc(sizeof(float) * (size_t) n);
+
+    if (_B == NULL || scaleB == NULL) {
+        ulm_free_aligned(_B);
+        free(scaleB);
+        return -1;
+    }
+
+#   pragma omp parallel num_threads(nthreads) if(nthreads > 1) default(shared)
+    {
+        int32_t dot[ULM_QGEMM_MR];
+        long int i, j, j0, p, rows, cols;
+
+#       pragma omp for schedule(static)
+        for (j = 0; j < n; ++j) {
+            scaleB[j] = qgemm_quantize_vector(k, &B[j * incColB], incRowB, &_B[j * kp], kp);
+        }
+
+        for (j0 = 0; j0 < n; j0 += nc) {
+            cols = (j0 + nc < n) ? nc : n - j0;
+
+#           pragma omp for schedule(static) nowait
+            for (p = 0; p < mp; ++p) {
+                rows = (p != mp - 1 || m % ULM_QGEMM_MR == 0) ? ULM_QGEMM_MR : m % ULM_QGEMM_MR;
+
+                for (j = j0; j < j0 + cols; ++j) {
+                    kernel->kernel(kp, &A->data[p * ULM_QGEMM_MR * kp], &A->rowSum[p * ULM_QGEMM_MR], &_B[j * kp],
+                                   dot);
+
+                    for (i = 0; i < rows; ++i) {
+                        double *c = &C[(p * ULM_QGEMM_MR + i) * incRowC + j * incColC];
+                        double ab = alpha * (double) A->scale[p * ULM_QGEMM_MR + i] * (double) scaleB[j] * dot[i];
+
+                        *c = (beta == 0.0) ? ab : beta * *c + ab;
+                    }
+                }
+
+                ulm_epilogue_apply(ep, rows, cols, p * ULM_QGEMM_MR, j0,
+                                   &C[p * ULM_QGEMM_MR * incRowC + j0 * incColC], incRowC, incColC);
+            }
+        }
+    }
+
+    ulm_free_aligned(_B);
+    free(scaleB);
+
+    return 0;
+}
+
+#endif // ULMBLAS_QGEMM_H
@@ -0,0 +1,692 @@
+#ifndef ULMBLAS_SGEMM_H
+#define ULMBLAS_SGEMM_H 1
+
+//
+//  Single precision matrix product.  It follows dgemm_nn: A and B are packed
+//  into micro panels and a micro kernel computes one MR x NR tile of C at a
+//  time, but a YMM register holds eight floats instead of four doubles, so
+//  each instruction does twice the work and every panel takes half the
+//  memory traffic.
+//
+//  Needs the blocking limits of dgemm_nn, which come in through dgemm.c
+//
+#include "ulmblas.h"
+#include "cpufeatures.h"
+#include "cacheinfo.h"
+#include "workspace.h"
+#include "epilogue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+//  Largest micro tile of any kernel below
+//
+#define SMR_MAX  32
+#define SNR_MAX  8
+
+//
+//  Only start another thread for every this many multiply-adds
+//
+#define ULM_SGEMM_WORK_PER_THREAD  (1L << 19)
+
+typedef void (*ulm_sgemm_micro_kernel)(long kc,
+                                       float alpha, const float *A, const float *B,
+                                       float beta,
+                                       float *C, long incRowC, long incColC);
+
+struct ulm_sgemm_kernel {
+    const char *name;
+    long mr;
+    long nr;
+    int features;
+    ulm_sgemm_micro_kernel kernel;
+};
+
+//
+//  Update C <- beta*C + alpha*AB for an mr x nr tile, where AB is stored
+//  column major with leading dimension mr.
+//
+static void
+sgemm_update_tile(long mr, long nr,
+                  float alpha, const float *AB,
+                  float beta,
+                  float *C, long incRowC, long incColC) {
+    long i, j;
+
+    if (beta == 0.0f) {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; ++i) {
+                C[i * incRowC + j * incColC] = alpha * AB[i + j * mr];
+            }
+        }
+    } else {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; ++i) {
+                C[i * incRowC + j * incColC] = beta * C[i * incRowC + j * incColC] + alpha * AB[i + j * mr];
+            }
+        }
+    }
+}
+
+//
+//  Same as sgemm_update_tile, for tiles where the columns of C are contiguous
+//  (incRowC == 1) and mr is a multiple of 8
+//
+ULM_TARGET("avx")
+static void
+sgemm_update_tile_avx(long mr, long nr,
+                      float alpha, const float *AB,
+                      float beta,
+                      float *C, long incColC) {
+    __m256 alpha_ = _mm256_set1_ps(alpha);
+    __m256 beta_ = _mm256_set1_ps(beta);
+    long i, j;
+
+    if (beta == 0.0f) {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; i += 8) {
+                _mm256_storeu_ps(&C[i + j * incColC], _mm256_mul_ps(alpha_, _mm256_load_ps(&AB[i + j * mr])));
+            }
+        }
+    } else {
+        for (j = 0; j < nr; ++j) {
+            for (i = 0; i < mr; i += 8) {
+                __m256 c = _mm256_mul_ps(beta_, _mm256_loadu_ps(&C[i + j * incColC]));
+                c = _mm256_add_ps(c, _mm256_mul_ps(alpha_, _mm256_load_ps(&AB[i + j * mr])));
+                _mm256_storeu_ps(&C[i + j * incColC], c);
+            }
+        }
+    }
+}
+
+#define SGEMM_STORE_TILE(MR, NR)                                            \
+    if (incRowC == 1) {                                                     \
+        sgemm_update_tile_avx(MR, NR, alpha, AB, beta, C, incColC);         \
+    } else {                                                                \
+        sgemm_update_tile(MR, NR, alpha, AB, beta, C, incRowC, incColC);    \
+    }
+
+//
+//  8x8 AVX micro kernel.  One YMM register holds a column of the A panel and
+//  every element of the B panel is broadcast once, giving 8 accumulators.
+//
+ULM_TARGET("avx")
+static void
+sgemm_micro_kernel_avx(long kc,
+                       float alpha, const float *A, const float *B,
+                       float beta,
+                       float *C, long incRowC, long incColC) {
+    float ULM_ALIGNED(32) AB[8 * 8];
+
+    __m256 ab_0, ab_1, ab_2, ab_3, ab_4, ab_5, ab_6, ab_7;
+    __m256 a;
+
+    long l;
+
+    ab_0 = ab_1 = ab_2 = ab_3 = ab_4 = ab_5 = ab_6 = ab_7 = _mm256_setzero_ps();
+
+    for (l = 0; l < kc; ++l) {
+        a = _mm256_load_ps(A);
+
+        ab_0 = _mm256_add_ps(ab_0, _mm256_mul_ps(a, _mm256_broadcast_ss(B)));
+        ab_1 = _mm256_add_ps(ab_1, _mm256_mul_ps(a, _mm256_broadcast_ss(B + 1)));
+        ab_2 = _mm256_add_ps(ab_2, _mm256_mul_ps(a, _mm256_broadcast_ss(B + 2)));
+        ab_3 = _mm256_add_ps(ab_3, _mm256_mul_ps(a, _mm256_broadcast_ss(B + 3)));
+        ab_4 = _mm256_add_ps(ab_4, _mm256_mul_ps(a, _mm256_broadcast_ss(B + 4)));
+        ab_5 = _mm256_add_ps(ab_5, _mm256_mul_ps(a, _mm256_broadcast_ss(B + 5)));
+        ab_6 = _mm256_add_ps(ab_6, _mm256_mul_ps(a, _mm256_broadcast_ss(B + 6)));
+        ab_7 = _mm256_add_ps(ab_7, _mm256_mul_ps(a, _mm256_broadcast_ss(B + 7)));
+
+        A += 8;
+        B += 8;
+    }
+
+    _mm256_store_ps(&AB[0 * 8], ab_0);
+    _mm256_store_ps(&AB[1 * 8], ab_1);
+    _mm256_store_ps(&AB[2 * 8], ab_2);
+    _mm256_store_ps(&AB[3 * 8], ab_3);
+    _mm256_store_ps(&AB[4 * 8], ab_4);
+    _mm256_store_ps(&AB[5 * 8], ab_5);
+    _mm256_store_ps(&AB[6 * 8], ab_6);
+    _mm256_store_ps(&AB[7 * 8], ab_7);
+
+    SGEMM_STORE_TILE(8, 8)
+}
+
+//
+//  16x6 AVX2 micro kernel, the single precision version of the 8x6 dgemm
+//  kernel.  Two YMM registers hold a column of the A panel, giving 12 FMA
+//  accumulators.
+//
+ULM_TARGET("avx2,fma")
+static void
+sgemm_micro_kernel_avx2(long kc,
+                        float alpha, const float *A, const float *B,
+                        float beta,
+                        float *C, long incRowC, long incColC) {
+    float ULM_ALIGNED(32) AB[16 * 6];
+
+    __m256 ab_0_0, ab_0_1, ab_0_2, ab_0_3, ab_0_4, ab_0_5;
+    __m256 ab_1_0, ab_1_1, ab_1_2, ab_1_3, ab_1_4, ab_1_5;
+    __m256 a0, a1, b;
+
+    long l;
+
+    ab_0_0 = ab_0_1 = ab_0_2 = ab_0_3 = ab_0_4 = ab_0_5 = _mm256_setzero_ps();
+    ab_1_0 = ab_1_1 = ab_1_2 = ab_1_3 = ab_1_4 = ab_1_5 = _mm256_setzero_ps();
+
+    for (l = 0; l < kc; ++l) {
+        a0 = _mm256_load_ps(A);
+        a1 = _mm256_load_ps(A + 8);
+
+        b = _mm256_broadcast_ss(B);
+        ab_0_0 = _mm256_fmadd_ps(a0, b, ab_0_0);
+        ab_1_0 = _mm256_fmadd_ps(a1, b, ab_1_0);
+
+        b = _mm256_broadcast_ss(B + 1);
+        ab_0_1 = _mm256_fmadd_ps(a0, b, ab_0_1);
+        ab_1_1 = _mm256_fmadd_ps(a1, b, ab_1_1);
+
+        b = _mm256_broadcast_ss(B + 2);
+        ab_0_2 = _mm256_fmadd_ps(a0, b, ab_0_2);
+        ab_1_2 = _mm256_fmadd_ps(a1, b, ab_1_2);
+
+        b = _mm256_broadcast_ss(B + 3);
+        ab_0_3 = _mm256_fmadd_ps(a0, b, ab_0_3);
+        ab_1_3 = _mm256_fmadd_ps(a1, b, ab_1_3);
+
+        b = _mm256_broadcast_ss(B + 4);
+        ab_0_4 = _mm256_fmadd_ps(a0, b, ab_0_4);
+        ab_1_4 = _mm256_fmadd_ps(a1, b, ab_1_4);
+
+        b = _mm256_broadcast_ss(B + 5);
+        ab_0_5 = _mm256_fmadd_ps(a0, b, ab_0_5);
+        ab_1_5 = _mm256_fmadd_ps(a1, b, ab_1_5);
+
+        A += 16;
+        B += 6;
+    }
+
+    _mm256_store_ps(&AB[0 + 0 * 16], ab_0_0);
+    _mm256_store_ps(&AB[8 + 0 * 16], ab_1_0);
+    _mm256_store_ps(&AB[0 + 1 * 16], ab_0_1);
+    _mm256_store_ps(&AB[8 + 1 * 16], ab_1_1);
+    _mm256_store_ps(&AB[0 + 2 * 16], ab_0_2);
+    _mm256_store_ps(&AB[8 + 2 * 16], ab_1_2);
+    _mm256_store_ps(&AB[0 + 3 * 16], ab_0_3);
+    _mm256_store_ps(&AB[8 + 3 * 16], ab_1_3);
+    _mm256_store_ps(&AB[0 + 4 * 16], ab_0_4);
+    _mm256_store_ps(&AB[8 + 4 * 16], ab_1_4);
+    _mm256_store_ps(&AB[0 + 5 * 16], ab_0_5);
+    _mm256_store_ps(&AB[8 + 5 * 16], ab_1_5);
+
+    SGEMM_STORE_TILE(16, 6)
+}
+
+//
+//  32x8 AVX-512 micro kernel.  Two ZMM registers hold a column of the A panel,
+//  giving 16 FMA accumulators.
+//
+ULM_TARGET("avx512f")
+static void
+sgemm_micro_kernel_avx512(long kc,
+                          float alpha, const float *A, const float *B,
+                          float beta,
+                          float *C, long incRowC, long incColC) {
+    float ULM_ALIGNED(64) AB[32 * 8];
+
+    __m512 ab_0_0, ab_0_1, ab_0_2, ab_0_3, ab_0_4, ab_0_5, ab_0_6, ab_0_7;
+    __m512 ab_1_0, ab_1_1, ab_1_2, ab_1_3, ab_1_4, ab_1_5, ab_1_6, ab_1_7;
+    __m512 a0, a1, b;
+
+    long l;
+
+    ab_0_0 = ab_0_1 = ab_0_2 = ab_0_3 = ab_0_4 = ab_0_5 = ab_0_6 = ab_0_7 = _mm512_setzero_ps();
+    ab_1_0 = ab_1_1 = ab_1_2 = ab_1_3 = ab_1_4 = ab_1_5 = ab_1_6 = ab_1_7 = _mm512_setzero_ps();
+
+    for (l = 0; l < kc; ++l) {
+        a0 = _mm512_load_ps(A);
+        a1 = _mm512_load_ps(A + 16);
+
+        b = _mm512_set1_ps(B[0]);
+        ab_0_0 = _mm512_fmadd_ps(a0, b, ab_0_0);
+        ab_1_0 = _mm512_fmadd_ps(a1, b, ab_1_0);
+
+        b = _mm512_set1_ps(B[1]);
+        ab_0_1 = _mm512_fmadd_ps(a0, b, ab_0_1);
+        ab_1_1 = _mm512_fmadd_ps(a1, b, ab_1_1);
+
+        b = _mm512_set1_ps(B[2]);
+        ab_0_2 = _mm512_fmadd_ps(a0, b, ab_0_2);
+        ab_1_2 = _mm512_fmadd_ps(a1, b, ab_1_2);
+
+        b = _mm512_set1_ps(B[3]);
+        ab_0_3 = _mm512_fmadd_ps(a0, b, ab_0_3);
+        ab_1_3 = _mm512_fmadd_ps(a1, b, ab_1_3);
+
+        b = _mm512_set1_ps(B[4]);
+        ab_0_4 = _mm512_fmadd_ps(a0, b, ab_0_4);
+        ab_1_4 = _mm512_fmadd_ps(a1, b, ab_1_4);
+
+        b = _mm512_set1_ps(B[5]);
+        ab_0_5 = _mm512_fmadd_ps(a0, b, ab_0_5);
+        ab_1_5 = _mm512_fmadd_ps(a1, b, ab_1_5);
+
+        b = _mm512_set1_ps(B[6]);
+        ab_0_6 = _mm512_fmadd_ps(a0, b, ab_0_6);
+        ab_1_6 = _mm512_fmadd_ps(a1, b, ab_1_6);
+
+        b = _mm512_set1_ps(B[7]);
+        ab_0_7 = _mm512_fmadd_ps(a0, b, ab_0_7);
+        ab_1_7 = _mm512_fmadd_ps(a1, b, ab_1_7);
+
+        A += 32;
+        B += 8;
+    }
+
+    _mm512_store_ps(&AB[0 + 0 * 32], ab_0_0);
+    _mm512_store_ps(&AB[16 + 0 * 32], ab_1_0);
+    _mm512_store_ps(&AB[0 + 1 * 32], ab_0_1);
+    _mm512_store_ps(&AB[16 + 1 * 32], ab_1_1);
+    _mm512_store_ps(&AB[0 + 2 * 32], ab_0_2);
+    _mm512_store_ps(&AB[16 + 2 * 32], ab_1_2);
+    _mm512_store_ps(&AB[0 + 3 * 32], ab_0_3);
+    _mm512_store_ps(&AB[16 + 3 * 32], ab_1_3);
+    _mm512_store_ps(&AB[0 + 4 * 32], ab_0_4);
+    _mm512_store_ps(&AB[16 + 4 * 32], ab_1_4);
+    _mm512_store_ps(&AB[0 + 5 * 32], ab_0_5);
+    _mm512_store_ps(&AB[16 + 5 * 32], ab_1_5);
+    _mm512_store_ps(&AB[0 + 6 * 32], ab_0_6);
+    _mm512_store_ps(&AB[16 + 6 * 32], ab_1_6);
+    _mm512_store_ps(&AB[0 + 7 * 32], ab_0_7);
+    _mm512_store_ps(&AB[16 + 7 * 32], ab_1_7);
+
+    SGEMM_STORE_TILE(32, 8)
+}
+
+#undef SGEMM_STORE_TILE
+
+//
+//  All kernels, best first, chosen like the dgemm kernels
+//
+static const struct ulm_sgemm_kernel ULM_SGEMM_KERNELS[] = {
+        {"avx512", 32, 8, CpuAVX512F,       sgemm_micro_kernel_avx512},
+        {"avx2",   16, 6, CpuAVX2 | CpuFMA, sgemm_micro_kernel_avx2},
+        {"avx",    8,  8, 0,                sgemm_micro_kernel_avx},
+};
+
+#define ULM_SGEMM_KERNEL_COUNT ((long) (sizeof(ULM_SGEMM_KERNELS) / sizeof(ULM_SGEMM_KERNELS[0])))
+
+static const struct ulm_sgemm_kernel *ULM_SGEMM_KERNEL = &ULM_SGEMM_KERNELS[ULM_SGEMM_KERNEL_COUNT - 1];
+
+//
+//  Block sizes of the single precision product, see ULM_DGEMM_BLOCKING
+//
+static struct ulm_dgemm_blocking ULM_SGEMM_BLOCKING = {768, 384, 8192};
+
+//
+//  Pick the fastest kernel the processor supports, honouring the kernel named
+//  by LIBPYMATH_GEMM_KERNEL if it has a single precision version.  The block
+//  sizes are then derived from the caches as for dgemm, with twice as many
+//  floats fitting in each level.
+//
+static void
+ULMBLAS(sgemm_select_kernel)(void) {
+    struct ulm_cache_info cache = ulm_cache_info();
+    int features = ulm_cpu_features();
+    const char *requested = getenv("LIBPYMATH_GEMM_KERNEL");
+    const struct ulm_sgemm_kernel *best = NULL;
+    long int i, MR, NR, mc, kc, nc;
+
+    for (i = 0; i < ULM_SGEMM_KERNEL_COUNT; ++i) {
+        const struct ulm_sgemm_kernel *kernel = &ULM_SGEMM_KERNELS[i];
+
+        if ((kernel->features & features) != kernel->features) {
+            continue;
+        }
+
+        if (best == NULL || (requested != NULL && strcmp(requested, kernel->name) == 0)) {
+            best = kernel;
+        }
+    }
+
+    if (best != NULL) {
+        ULM_SGEMM_KERNEL = best;
+    }
+
+    MR = ULM_SGEMM_KERNEL->mr;
+    NR = ULM_SGEMM_KERNEL->nr;
+
+    kc = cache.l1 / 2 / (NR * (long int) sizeof(float));
+    kc = kc / 8 * 8;
+    kc = (kc < ULM_DGEMM_KC_MIN) ? ULM_DGEMM_KC_MIN : (kc > ULM_DGEMM_KC_MAX) ? ULM_DGEMM_KC_MAX : kc;
+
+    mc = cache.l2 / 2 / (kc * (long int) sizeof(float));
+    nc = cache.l3 / 2 / (kc * (long int) sizeof(float));
+
+    ULM_SGEMM_BLOCKING.mc = ulm_dgemm_round_block(mc, MR, ULM_DGEMM_MC_MAX);
+    ULM_SGEMM_BLOCKING.kc = kc;
+    ULM_SGEMM_BLOCKING.nc = ulm_dgemm_round_block(nc, NR, ULM_DGEMM_NC_MAX);
+}
+
+//
+//  Pack an mc x kc block of A into panels of mr rows, padding the last one
+//  with zeros
+//
+static void
+spack_A(long int mr, long int mc, long int kc, const float *A, long int incRowA, long int incColA,
+        float *buffer) {
+    long int mp = (mc + mr - 1) / mr;
+    long int i, j, p, rows;
+
+    for (p = 0; p < mp; ++p) {
+        rows = (p != mp - 1 || mc % mr == 0) ? mr : mc % mr;
+
+        for (j = 0; j < kc; ++j) {
+            for (i = 0; i < rows; ++i) {
+                buffer[i] = A[(p * mr + i) * incRowA + j * incColA];
+            }
+            for (i = rows; i < mr; ++i) {
+                buffer[i] = 0.0f;
+            }
+            buffer += mr;
+        }
+    }
+}
+
+//
+//  Pack a kc x nc block of B into panels of nr columns, padding the last one
+//  with zeros
+//
+static void
+spack_B(long int nr, long int kc, long int nc, const float *B, long int incRowB, long int incColB,
+        float *buffer) {
+    long int np = (nc + nr - 1) / nr;
+    long int i, j, p, cols;
+
+    for (p = 0; p < np; ++p) {
+        cols = (p != np - 1 || nc % nr == 0) ? nr : nc % nr;
+
+        for (i = 0; i < kc; ++i) {
+            for (j = 0; j < cols; ++j) {
+                buffer[j] = B[i * incRowB + (p * nr + j) * incColB];
+            }
+            for (j = cols; j < nr; ++j) {
+                buffer[j] = 0.0f;
+            }
+            buffer += nr;
+        }
+    }
+}
+
+//
+//  Multiply the packed mc x kc block of A with the micro panels j0 <= j < j1
+//  of the packed kc x nc block of B
+//
+static void
+sgemm_macro_kernel(const struct ulm_sgemm_kernel *kernel,
+                   long int mc,
+                   long int nc,
+                   long int kc,
+                   long int j0,
+                   long int j1,
+                   float alpha,
+                   const float *_A,
+                   const float *_B,
+                   float beta,
+                   float *C,
+                   long int incRowC,
+                   long int incColC) {
+    const long int MR = kernel->mr;
+    const long int NR = kernel->nr;
+
+    float ULM_ALIGNED(64) _C[SMR_MAX * SNR_MAX];
+
+    long int mp = (mc + MR - 1) / MR;
+    long int np = (nc + NR - 1) / NR;
+
+    long int _mr = mc % MR;
+    long int _nr = nc % NR;
+
+    long int mr, nr;
+    long int i, j, ii, jj;
+
+    for (j = j0; j < j1; ++j) {
+        nr = (j != np - 1 || _nr == 0) ? NR : _nr;
+
+        for (i = 0; i < mp; ++i) {
+            float *Cij = &C[i * MR * incRowC + j * NR * incColC];
+
+            mr = (i != mp - 1 || _mr == 0) ? MR : _mr;
+
+            if (mr == MR && nr == NR) {
+                kernel->kernel(kc, alpha, &_A[i * kc * MR], &_B[j * kc * NR], beta, Cij, incRowC, incColC);
+            } else {
+                kernel->kernel(kc, alpha, &_A[i * kc * MR], &_B[j * kc * NR], 0.0f, _C, 1, MR);
+
+                for (jj = 0; jj < nr; ++jj) {
+                    for (ii = 0; ii < mr; ++ii) {
+                        float *c = &Cij[ii * incRowC + jj * incColC];
+
+                        *c = (beta == 0.0f) ? _C[ii + jj * MR] : beta * *c + _C[ii + jj * MR];
+                    }
+                }
+            }
+        }
+    }
+}
+
+//
+//  Compute C <- act(beta*C + alpha*A*B + bias) in single precision using up to
+//  `threads` threads (the OpenMP default if threads <= 0).  The threads pack
+//  the panels of each block together and then split the micro panels of B
+//  between them, and the epilogue is applied to each panel of C after its
+//  last KC block.  Returns 0 on success and -1 if the buffers could not be
+//  allocated, in which case C is unchanged.
+//
+static int
+ULMBLAS(sgemm_nn_ep)(long int m,
+                     long int n,
+                     long int k,
+                     float alpha,
+                     const float *A,
+                     long int incRowA,
+                     long int incColA,
+                     const float *B,
+                     long int incRowB,
+                     long int incColB,
+                     float beta,
+                     float *C,
+                     long int incRowC,
+                     long int incColC,
+                     int threads,
+                     const struct ulm_sepilogue *ep) {
+    const struct ulm_sgemm_kernel *kernel = ULM_SGEMM_KERNEL;
+    const struct ulm_dgemm_blocking blocking = ULM_SGEMM_BLOCKING;
+    const long int MC = blocking.mc;
+    const long int KC = blocking.kc;
+    const long int NC = blocking.nc;
+
+    long int mb = (m + MC - 1) / MC;
+    long int nb = (n + NC - 1) / NC;
+    long int kb = (k + KC - 1) / KC;
+
+    long int mcMax, ncMax, kcMax;
+    long int nthreads;
+    struct ulm_sepilogue epT;
+    float *_A, *_B;
+
+    if (m <= 0 || n <= 0) {
+        return 0;
+    }
+
+    if (alpha == 0.0f || k == 0) {
+        long int i, j;
+
+        for (i = 0; i < m; ++i) {
+            for (j = 0; j < n; ++j) {
+                C[i * incRowC + j * incColC] = (beta == 0.0f) ? 0.0f : beta * C[i * incRowC + j * incColC];
+            }
+        }
+        ulm_sepilogue_apply(ep, m, n, 0, 0, C, incRowC, incColC);
+        return 0;
+    }
+
+//
+//  The micro kernels write whole columns of a tile at once, so a row major C
+//  is handled as C^T <- beta*C^T + alpha*B^T*A^T
+//
+    if (incColC == 1 && incRowC != 1) {
+        return ULMBLAS(sgemm_nn_ep)(n, m, k, alpha,
+                                    B, incColB, incRowB,
+                                    A, incColA, incRowA,
+                                    beta,
+                                    C, incColC, incRowC,
+                                    threads,
+                                    ulm_sepilogue_transposed(ep, &epT));
+    }
+
+#ifdef _OPENMP
+    if (threads <= 0) {
+        threads = omp_get_max_threads();
+    }
+#endif
+
+    nthreads = 1 + (long int) ((double) m * (double) n * (double) k / ULM_SGEMM_WORK_PER_THREAD);
+    if (threads > 0 && nthreads > threads) {
+        nthreads = threads;
+    }
+
+    mcMax = (mb > 1) ? MC : m;
+    ncMax = (nb > 1) ? NC : n;
+    kcMax = (kb > 1) ? KC : k;
+
+    _A = ulm_smalloc_aligned((size_t) ((mcMax + kernel->mr) * kcMax));
+    _B = ulm_smalloc_aligned((size_t) (kcMax * (ncMax + kernel->nr)));
+
+    if (_A == NULL || _B == NULL) {
+        ulm_free_aligned(_A);
+        ulm_free_aligned(_B);
+        return -1;
+    }
+
+#   pragma omp parallel num_threads(nthreads) if(nthreads > 1) default(shared)
+    {
+        const long int MR = kernel->mr;
+        const long int NR = kernel->nr;
+
+        long int i, j, l, p;
+        long int mc, nc, kc, mp, np;
+        float _beta;
+
+        for (j = 0; j < nb; ++j) {
+            nc = (j != nb - 1 || n % NC == 0) ? NC : n % NC;
+            np = (nc + NR - 1) / NR;
+
+            for (l = 0; l < kb; ++l) {
+                kc = (l != kb - 1 || k % KC == 0) ? KC : k % KC;
+                _beta = (l == 0) ? beta : 1.0f;
+
+#               pragma omp for schedule(static)
+                for (p = 0; p < np; ++p) {
+                    spack_B(NR, kc, (p != np - 1 || nc % NR == 0) ? NR : nc % NR,
+                            &B[l * KC * incRowB + (j * NC + p * NR) * incColB], incRowB, incColB,
+                            &_B[p * kc * NR]);
+                }
+
+                for (i = 0; i < mb; ++i) {
+                    mc = (i != mb - 1 || m % MC == 0) ? MC : m % MC;
+                    mp = (mc + MR - 1) / MR;
+
+#                   pragma omp for schedule(static)
+                    for (p = 0; p < mp; ++p) {
+                        spack_A(MR, (p != mp - 1 || mc % MR == 0) ? MR : mc % MR, kc,
+                                &A[(i * MC + p * MR) * incRowA + l * KC * incColA], incRowA, incColA,
+                                &_A[p * kc * MR]);
+                    }
+
+#                   pragma omp for schedule(static)
+                    for (p = 0; p < np; ++p) {
+                        sgemm_macro_kernel(kernel, mc, nc, kc, p, p + 1, alpha, _A, _B, _beta,
+                                           &C[i * MC * incRowC + j * NC * incColC], incRowC, incColC);
+
+                        // The panel of C is final after the last KC block
+                        if (l == kb - 1) {
+                            long int j0 = p * NR;
+                            long int j1 = (j0 + NR < nc) ? j0 + NR : nc;
+
+                            ulm_sepilogue_apply(ep, mc, j1 - j0, i * MC, j * NC + j0,
+                                                &C[i * MC * incRowC + (j * NC + j0) * incColC],
+                                                incRowC, incColC);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    ulm_free_aligned(_A);
+    ulm_free_aligned(_B);
+
+    return 0;
+}
+
+//
+//  Single precision product without packing, for products too small to pay
+//  for it.  A row of C at a time is accumulated from the rows of B, which the
+//  compiler vectorises when B and C are stored by rows.
+//
+static void
+ULMBLAS(sgemm_small_ep)(long int m,
+                        long int n,
+                        long int k,
+                        float alpha,
+                        const float *A,
+                        long int incRowA,
+                        long int incColA,
+                        const float *B,
+                        long int incRowB,
+                        long int incColB,
+                        float beta,
+                        float *C,
+                        long int incRowC,
+                        long int incColC,
+                        const struct ulm_sepilogue *ep) {
+    long int i, j, l;
+
+    for (i = 0; i < m; ++i) {
+        float *c = &C[i * incRowC];
+
+        if (incColC == 1 && incColB == 1) {
+            for (j = 0; j < n; ++j) {
+                c[j] = (beta == 0.0f) ? 0.0f : beta * c[j];
+            }
+            for (l = 0; l < k; ++l) {
+                const float a = alpha * A[i * incRowA + l * incColA];
+                const float *b = &B[l * incRowB];
+
+                for (j = 0; j < n; ++j) {
+                    c[j] += a * b[j];
+                }
+            }
+        } else {
+            for (j = 0; j < n; ++j) {
+                float ab = 0.0f;
+
+                for (l = 0; l < k; ++l) {
+                    ab += A[i * incRowA + l * incColA] * B[l * incRowB + j * incColB];
+                }
+                c[j * incColC] = (beta == 0.0f) ? alpha * ab : beta * c[j * incColC] + alpha * ab;
+            }
+        }
+    }
+
+    ulm_sepilogue_apply(ep, m, n, 0, 0, C, incRowC, incColC);
+}
+
+#endif // ULMBLAS_SGEMM_H
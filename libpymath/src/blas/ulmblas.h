@@ -61,4 +61,25 @@ enum UpLo  {
 #define max(x,y)  (((x)<(y)) ? (y) : (x))
 #endif
 
+//
+//  Portable alignment for local and static buffers.  The attribute goes
+//  between the type and the name, e.g. "double ULM_ALIGNED(32) AB[16];"
+//
+#if defined(_MSC_VER)
+#   define ULM_ALIGNED(n) __declspec(align(n))
+#else
+#   define ULM_ALIGNED(n) __attribute__ ((aligned (n)))
+#endif
+
+//
+//  Compile a single function for an instruction set that is not enabled for
+//  the whole module.  MSVC allows any intrinsic without extra flags, so the
+//  macro is empty there.
+//
+#if defined(__GNUC__) || defined(__clang__)
+#   define ULM_TARGET(x) __attribute__ ((target (x)))
+#else
+#   define ULM_TARGET(x)
+#endif
+
 #endif // ULM_BLAS_H
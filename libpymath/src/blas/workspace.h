@@ -0,0 +1,52 @@
+#ifndef ULMBLAS_WORKSPACE_H
+#define ULMBLAS_WORKSPACE_H 1
+
+#include <stdlib.h>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+//
+//  Alignment of every workspace buffer.  One cache line, which also covers
+//  the widest (AVX-512) aligned loads.
+//
+#define ULM_WORKSPACE_ALIGN 64
+
+//
+//  Allocate an aligned buffer of `count` doubles.  Returns NULL if there is
+//  not enough memory.  Release it with ulm_free_aligned.
+//
+static double *
+ulm_malloc_aligned(size_t count) {
+    void *res = NULL;
+    size_t bytes = (count > 0 ? count : 1) * sizeof(double);
+
+#if defined(_MSC_VER)
+    res = _aligned_malloc(bytes, ULM_WORKSPACE_ALIGN);
+#else
+    if (posix_memalign(&res, ULM_WORKSPACE_ALIGN, bytes) != 0) {
+        res = NULL;
+    }
+#endif
+
+    return (double *) res;
+}
+
+//
+//  Allocate an aligned buffer of `count` floats
+//
+static float *
+ulm_smalloc_aligned(size_t count) {
+    return (float *) ulm_malloc_aligned((count + 1) / 2);
+}
+
+static void
+ulm_free_aligned(void *buffer) {
+#if defined(_MSC_VER)
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
+#endif // ULMBLAS_WORKSPACE_H
@@ -25,6 +25,20 @@ void pythonPrint(const char *text) {
 
 #define internalGet(i, j, r, c) ((j) * (c) + (i) * (r))
 
+// Release the GIL around a kernel that touches at least LPM_GIL_THRESHOLD
+// elements, so other Python threads can run while it computes. Smaller
+// kernels keep the GIL, as releasing and reacquiring it would cost more than
+// the work itself. Everything the kernel reads from a Python object must be
+// copied into locals before the block, and no Python API may be used inside.
+#define LPM_GIL_THRESHOLD 8192
+
+#define LPM_BEGIN_ALLOW_THREADS(work) { \
+    PyThreadState *_lpmSave = ((work) >= LPM_GIL_THRESHOLD) ? PyEval_SaveThread() : NULL;
+
+#define LPM_END_ALLOW_THREADS \
+    if (_lpmSave != NULL) PyEval_RestoreThread(_lpmSave); \
+}
+
 #ifndef _OPENMP
 // A routine to give access to a high precision timer on most systems.
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -75,7 +89,7 @@ double seconds() {
 // ==================================================== Function Definitions ==================================================== //
 // ****************************************************************************************************************************** //
 
-static double *allocateMemory(long long length) {
+static inline double *allocateMemory(long long length) {
     double *res;
 
     if (length < 0) {
@@ -93,6 +107,24 @@ static double *allocateMemory(long long length) {
     return res;
 }
 
+static inline float *allocateMemoryFloat(long long length) {
+    float *res;
+
+    if (length < 0) {
+        PyErr_SetString(PyExc_ValueError, "Cannot allocate negative length");
+        return NULL;
+    }
+
+    res = malloc(sizeof(float) * length);
+
+    if (res == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        return NULL;
+    }
+
+    return res;
+}
+
 double randomRange(double min, double max) {
     if (firstRand == 1) {
         srand((unsigned int) (TIME * 10000));
@@ -2,384 +2,53 @@
 #define LIBPYMATHMODULES_DOUBLEFUNCTIONS_H
 
 #include <libpymath/src/internal.h>
+#include <libpymath/src/blas/dsum.h>
+#include <libpymath/src/blas/delementwise.h>
+#include <libpymath/src/blas/dvmath.h>
 
 
-double doubleMatrixSum(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    double res = 0;
-
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 1];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 2];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 3];
-            }
-
-            for (; j < cols; j++) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#       pragma omp parallel for private(i, j) shared(a, res, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 1];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 2];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 3];
-            }
-
-            for (; j < cols; j++) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-            }
-        }
-    }
-
-    return res;
+// Every thread sums its part of the matrix into its own partial sum, which are added up once all threads are done. mode
+// is ULM_SUM_FAST, ULM_SUM_PAIRWISE or ULM_SUM_KAHAN (see dsum.h)
+double doubleMatrixSum(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    return ULMBLAS(dsum)(rows, cols, a, rowStrideA, colStrideA, mode, threads > 1 ? threads : 1);
 }
 
-double doubleMatrixMean(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    double res = 0;
-
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 1];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 2];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 3];
-            }
-
-            for (; j < cols; j++) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#       pragma omp parallel for private(i, j) shared(a, res, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 1];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 2];
-                res += a[internalGet(i, j, rowStrideA, colStrideA) + 3];
-            }
-
-            for (; j < cols; j++) {
-                res += a[internalGet(i, j, rowStrideA, colStrideA)];
-            }
-        }
-    }
-
-    return res / (double) (rows * cols);
+double doubleMatrixMean(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    return doubleMatrixSum(a, rows, cols, rowStrideA, colStrideA, mode, threads) / (double) (rows * cols);
 }
 
+// c = a op b elementwise, or a op b for a scalar b, with c a new rows x cols matrix stored row by row. Contiguous
+// operands run through the AVX loops of delementwise.h, and strided ones through a loop over the strides
 void doubleMatrixAddMatrix(double *a, double *b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] + b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] + b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] + b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA, rowStrideB, colStrideB) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] + b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] + b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] + b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_ADD, rows, cols, a, rowStrideA, colStrideA, b, rowStrideB, colStrideB, 0.0, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixSubMatrix(double *a, double *b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] - b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] - b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] - b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA, rowStrideB, colStrideB) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] - b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] - b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] - b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_SUB, rows, cols, a, rowStrideA, colStrideA, b, rowStrideB, colStrideB, 0.0, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixMulMatrix(double *a, double *b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] * b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] * b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] * b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA, rowStrideB, colStrideB) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] * b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] * b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] * b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_MUL, rows, cols, a, rowStrideA, colStrideA, b, rowStrideB, colStrideB, 0.0, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixDivMatrix(double *a, double *b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] / b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] / b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] / b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA, rowStrideB, colStrideB) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b[internalGet(i, j, rowStrideB, colStrideB)];
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] / b[internalGet(i, j, rowStrideB, colStrideB) + 1];
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] / b[internalGet(i, j, rowStrideB, colStrideB) + 2];
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] / b[internalGet(i, j, rowStrideB, colStrideB) + 3];
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b[internalGet(i, j, rowStrideB, colStrideB)];
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_DIV, rows, cols, a, rowStrideA, colStrideA, b, rowStrideB, colStrideB, 0.0, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixAddScalar(double *a, double b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] + b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] + b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] + b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b;
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] + b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] + b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] + b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b;
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_ADD, rows, cols, a, rowStrideA, colStrideA, NULL, 0, 0, b, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixSubScalar(double *a, double b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] - b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] - b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] - b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b;
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] - b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] - b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] - b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b;
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_SUB, rows, cols, a, rowStrideA, colStrideA, NULL, 0, 0, b, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixMulScalar(double *a, double b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] * b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] * b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] * b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b;
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] * b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] * b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] * b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b;
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_MUL, rows, cols, a, rowStrideA, colStrideA, NULL, 0, 0, b, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixDivScalar(double *a, double b, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] / b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] / b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] / b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b;
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, b, c, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b;
-                c[j + i * cols + 1] = a[internalGet(i, j, rowStrideA, colStrideA) + 1] / b;
-                c[j + i * cols + 2] = a[internalGet(i, j, rowStrideA, colStrideA) + 2] / b;
-                c[j + i * cols + 3] = a[internalGet(i, j, rowStrideA, colStrideA) + 3] / b;
-            }
-
-            for (; j < cols; j++) {
-                c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b;
-            }
-        }
-    }
+    ULMBLAS(delementwise)(ULM_ELEMENTWISE_DIV, rows, cols, a, rowStrideA, colStrideA, NULL, 0, 0, b, c, cols, 1, threads > 1 ? threads : 1);
 }
 
 void doubleMatrixFillScalar(double *a, const double scalar, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
@@ -403,7 +72,7 @@ void doubleMatrixFillScalar(double *a, const double scalar, long int rows, long
         omp_set_num_threads(threads);
 #       endif
 
-#		pragma omp parallel for private(i, j) shared(a, rows, cols, rowStrideA, colStrideA) default(none)
+#		pragma omp parallel for private(i, j) shared(a, scalar, rows, cols, rowStrideA, colStrideA) default(none)
         for (i = 0; i < rows; i++) {
             for (j = 0; j < cols - 3; j += 4) {
                 a[internalGet(i, j, rowStrideA, colStrideA)] = scalar;
@@ -540,8 +209,6 @@ void doubleMatrixFillRandomRange(double *a, double min, double max, long int row
     }
 }
 
-#define SIGMOID(x) (1 / (1 + exp((-(x)))))
-#define TANH(x) (tanh((x)))
 #define RELU(x) ((x) > 0 ? (x) : 0)
 #define LEAKY_RELU(x) ((x) > 0 ? (x) : ((x) * 0.2))
 
@@ -550,78 +217,36 @@ void doubleMatrixFillRandomRange(double *a, double min, double max, long int row
 #define D_RELU(y) ((y) > 0 ? 1 : 0)
 #define D_LEAKY_RELU(y) ((y) > 0 ? 1 : 0.2)
 
-void doubleMatrixMapSigmoid(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA)]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 1] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA) + 1]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 2] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA) + 2]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 3] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA) + 3]);
-            }
-
-            for (; j < cols; j++) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA)]);
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
-
-#		pragma omp parallel for private(i, j) shared(a, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA)]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 1] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA) + 1]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 2] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA) + 2]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 3] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA) + 3]);
-            }
+// Apply fn of dvmath.h (ULM_VMATH_SIGMOID, ULM_VMATH_TANH or ULM_VMATH_EXP) to every element of a, with the accuracy mode
+// ULM_MATH_FULL or ULM_MATH_FAST. Each thread maps whole rows or columns, whichever are closer together in memory
+void doubleMatrixMapVector(int fn, double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    long long i;
+
+    if (labs(rowStrideA) < labs(colStrideA)) {
+        long long tmp = rows;
+        rows = (long int) cols;
+        cols = tmp;
+        tmp = rowStrideA;
+        rowStrideA = colStrideA;
+        colStrideA = (long int) tmp;
+    }
 
-            for (; j < cols; j++) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = SIGMOID(a[internalGet(i, j, rowStrideA, colStrideA)]);
-            }
-        }
+#   pragma omp parallel for num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        ulm_dvmath(fn, cols, &a[i * rowStrideA], colStrideA, &a[i * rowStrideA], colStrideA, mode);
     }
 }
 
-void doubleMatrixMapTanh(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
-    if (rows * cols < 90000) {
-        long long i, j;
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = TANH(a[internalGet(i, j, rowStrideA, colStrideA)]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 1] = TANH(a[internalGet(i, j, rowStrideA, colStrideA) + 1]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 2] = TANH(a[internalGet(i, j, rowStrideA, colStrideA) + 2]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 3] = TANH(a[internalGet(i, j, rowStrideA, colStrideA) + 3]);
-            }
-
-            for (; j < cols; j++) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = TANH(a[internalGet(i, j, rowStrideA, colStrideA)]);
-            }
-        }
-    } else {
-        long long i, j;
-#       ifdef _OPENMP
-        omp_set_num_threads(threads);
-#       endif
+void doubleMatrixMapSigmoid(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    doubleMatrixMapVector(ULM_VMATH_SIGMOID, a, rows, cols, rowStrideA, colStrideA, mode, threads);
+}
 
-#		pragma omp parallel for private(i, j) shared(a, rows, cols, rowStrideA, colStrideA) default(none)
-        for (i = 0; i < rows; i++) {
-            for (j = 0; j < cols - 3; j += 4) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = TANH(a[internalGet(i, j, rowStrideA, colStrideA)]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 1] = TANH(a[internalGet(i, j, rowStrideA, colStrideA) + 1]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 2] = TANH(a[internalGet(i, j, rowStrideA, colStrideA) + 2]);
-                a[internalGet(i, j, rowStrideA, colStrideA) + 3] = TANH(a[internalGet(i, j, rowStrideA, colStrideA) + 3]);
-            }
+void doubleMatrixMapTanh(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    doubleMatrixMapVector(ULM_VMATH_TANH, a, rows, cols, rowStrideA, colStrideA, mode, threads);
+}
 
-            for (; j < cols; j++) {
-                a[internalGet(i, j, rowStrideA, colStrideA)] = TANH(a[internalGet(i, j, rowStrideA, colStrideA)]);
-            }
-        }
-    }
+void doubleMatrixMapExp(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    doubleMatrixMapVector(ULM_VMATH_EXP, a, rows, cols, rowStrideA, colStrideA, mode, threads);
 }
 
 void doubleMatrixMapRELU(double *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
@@ -846,4 +471,31 @@ void doubleMatrixMapLeakyRELUDerivative(double *a, long int rows, long long cols
     }
 }
 
+// c = alpha * diag(d) @ a, scaling row i of a by d[i * incD]. An incD of 0 scales every row by d[0], which is the
+// product with a scaled identity
+void doubleMatrixScaleRows(const double *a, double alpha, const double *d, long int incD, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    long long i, j;
+
+#   pragma omp parallel for private(i, j) num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        const double s = alpha * d[i * incD];
+
+        for (j = 0; j < cols; j++) {
+            c[j + i * cols] = s * a[internalGet(i, j, rowStrideA, colStrideA)];
+        }
+    }
+}
+
+// c = alpha * a @ diag(d), scaling column j of a by d[j * incD]
+void doubleMatrixScaleCols(const double *a, double alpha, const double *d, long int incD, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    long long i, j;
+
+#   pragma omp parallel for private(i, j) num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            c[j + i * cols] = alpha * d[j * incD] * a[internalGet(i, j, rowStrideA, colStrideA)];
+        }
+    }
+}
+
 #endif // LIBPYMATHMODULES_DOBLEFUNCT
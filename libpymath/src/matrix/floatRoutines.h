@@ -0,0 +1,178 @@
+#ifndef LIBPYMATHMODULES_FLOATFUNCTIONS_H
+#define LIBPYMATHMODULES_FLOATFUNCTIONS_H
+
+#include <libpymath/src/internal.h>
+
+// Run body for every element (i, j) of a rows x cols matrix. The rows are spread over the threads once the matrix is
+// large enough for that to pay off, like the 90000 element threshold of the double routines
+#define FLOAT_MATRIX_LOOP(body) {                                                                                     \
+    long long i, j;                                                                                                   \
+    _Pragma("omp parallel for private(i, j) num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)")         \
+    for (i = 0; i < rows; i++) {                                                                                      \
+        for (j = 0; j < cols; j++) {                                                                                  \
+            body;                                                                                                     \
+        }                                                                                                             \
+    }                                                                                                                 \
+}
+
+// The elements are summed in double precision, so large float32 matrices do not lose the small values to rounding. This
+// is already far more accurate than float32 values need, so the summation mode of the double routines is ignored
+double floatMatrixSum(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    double res = 0;
+    long long i, j;
+
+#   pragma omp parallel for private(i, j) reduction(+:res) num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            res += a[internalGet(i, j, rowStrideA, colStrideA)];
+        }
+    }
+
+    return res;
+}
+
+double floatMatrixMean(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    return floatMatrixSum(a, rows, cols, rowStrideA, colStrideA, mode, threads) / (double) (rows * cols);
+}
+
+void floatMatrixAddMatrix(float *a, float *b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b[internalGet(i, j, rowStrideB, colStrideB)])
+}
+
+void floatMatrixSubMatrix(float *a, float *b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b[internalGet(i, j, rowStrideB, colStrideB)])
+}
+
+void floatMatrixMulMatrix(float *a, float *b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b[internalGet(i, j, rowStrideB, colStrideB)])
+}
+
+void floatMatrixDivMatrix(float *a, float *b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, long int rowStrideB, long int colStrideB, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b[internalGet(i, j, rowStrideB, colStrideB)])
+}
+
+void floatMatrixAddScalar(float *a, float b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] + b)
+}
+
+void floatMatrixSubScalar(float *a, float b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] - b)
+}
+
+void floatMatrixMulScalar(float *a, float b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] * b)
+}
+
+void floatMatrixDivScalar(float *a, float b, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = a[internalGet(i, j, rowStrideA, colStrideA)] / b)
+}
+
+void floatMatrixFillScalar(float *a, const float scalar, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(a[internalGet(i, j, rowStrideA, colStrideA)] = scalar)
+}
+
+void floatMatrixFillAscending(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(a[internalGet(i, j, rowStrideA, colStrideA)] = (float) (j + i * cols))
+}
+
+void floatMatrixFillDescending(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    long long max = rows * cols - 1;
+
+    FLOAT_MATRIX_LOOP(a[internalGet(i, j, rowStrideA, colStrideA)] = (float) (max - (j + i * cols)))
+}
+
+void floatMatrixFillRandomRange(float *a, float min, float max, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(a[internalGet(i, j, rowStrideA, colStrideA)] = (float) randomRange(min, max))
+}
+
+#define F_RELU(x) ((x) > 0 ? (x) : 0.0f)
+#define F_LEAKY_RELU(x) ((x) > 0 ? (x) : ((x) * 0.2f))
+
+#define F_D_SIGMOID(y) ((y) * (1.0f - (y)))
+#define F_D_TANH(y) (1.0f - ((y) * (y)))
+#define F_D_RELU(y) ((y) > 0 ? 1.0f : 0.0f)
+#define F_D_LEAKY_RELU(y) ((y) > 0 ? 1.0f : 0.2f)
+
+#define FLOAT_MATRIX_MAP(f) FLOAT_MATRIX_LOOP(a[internalGet(i, j, rowStrideA, colStrideA)] = f(a[internalGet(i, j, rowStrideA, colStrideA)]))
+
+// Same as doubleMatrixMapVector. ULM_MATH_FULL evaluates the float32 values in double precision
+void floatMatrixMapVector(int fn, float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    long long i;
+
+    if (labs(rowStrideA) < labs(colStrideA)) {
+        long long tmp = rows;
+        rows = (long int) cols;
+        cols = tmp;
+        tmp = rowStrideA;
+        rowStrideA = colStrideA;
+        colStrideA = (long int) tmp;
+    }
+
+#   pragma omp parallel for num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        ulm_svmath(fn, cols, &a[i * rowStrideA], colStrideA, &a[i * rowStrideA], colStrideA, mode);
+    }
+}
+
+void floatMatrixMapSigmoid(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    floatMatrixMapVector(ULM_VMATH_SIGMOID, a, rows, cols, rowStrideA, colStrideA, mode, threads);
+}
+
+void floatMatrixMapTanh(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    floatMatrixMapVector(ULM_VMATH_TANH, a, rows, cols, rowStrideA, colStrideA, mode, threads);
+}
+
+void floatMatrixMapExp(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int mode, int threads) {
+    floatMatrixMapVector(ULM_VMATH_EXP, a, rows, cols, rowStrideA, colStrideA, mode, threads);
+}
+
+void floatMatrixMapRELU(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_MAP(F_RELU)
+}
+
+void floatMatrixMapLeakyRELU(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_MAP(F_LEAKY_RELU)
+}
+
+void floatMatrixMapSigmoidDerivative(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_MAP(F_D_SIGMOID)
+}
+
+void floatMatrixMapTanhDerivative(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_MAP(F_D_TANH)
+}
+
+void floatMatrixMapRELUDerivative(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_MAP(F_D_RELU)
+}
+
+void floatMatrixMapLeakyRELUDerivative(float *a, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_MAP(F_D_LEAKY_RELU)
+}
+
+// a += alpha * x * y^T, where x has rows elements and y has cols elements
+void floatMatrixAddOuter(float *a, float alpha, const float *x, long int incX, const float *y, long int incY, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(a[internalGet(i, j, rowStrideA, colStrideA)] += alpha * x[i * incX] * y[j * incY])
+}
+
+// Copy a strided matrix of either precision into a row major matrix of the other one
+void floatMatrixFromDouble(const double *a, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = (float) a[internalGet(i, j, rowStrideA, colStrideA)])
+}
+
+void floatMatrixToDouble(const float *a, double *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = (double) a[internalGet(i, j, rowStrideA, colStrideA)])
+}
+
+// c = alpha * diag(d) @ a and c = alpha * a @ diag(d), as for the double routines
+void floatMatrixScaleRows(const float *a, float alpha, const float *d, long int incD, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = alpha * d[i * incD] * a[internalGet(i, j, rowStrideA, colStrideA)])
+}
+
+void floatMatrixScaleCols(const float *a, float alpha, const float *d, long int incD, float *c, long int rows, long long cols, long int rowStrideA, long int colStrideA, int threads) {
+    FLOAT_MATRIX_LOOP(c[j + i * cols] = alpha * d[j * incD] * a[internalGet(i, j, rowStrideA, colStrideA)])
+}
+
+#undef FLOAT_MATRIX_MAP
+
+#endif // LIBPYMATHMODULES_FLOATFUNCTIONS_H
@@ -2,14 +2,34 @@
 
 #include <libpymath/src/internal.h>
 #include <libpymath/src/blas/dgemm.c>
+#include <libpymath/src/blas/dgemv.h>
+#include <libpymath/src/blas/dger.h>
+#include <libpymath/src/blas/dsyrk.h>
+#include <libpymath/src/blas/dgemm_strassen.h>
+#include <libpymath/src/blas/sgemm.h>
+#include <libpymath/src/blas/qgemm.h>
+#include <libpymath/src/blas/dcsrmm.h>
+#include <libpymath/src/blas/dpackmm.h>
+#include <libpymath/src/blas/dsum.h>
 #include <libpymath/src/matrix/doubleRoutines.h>
+#include <libpymath/src/matrix/floatRoutines.h>
+#include <libpymath/src/matrix/reduceRoutines.h>
 
 static PyTypeObject MatrixCoreType;
+static PyTypeObject SparseCoreType;
+static PyTypeObject PackedCoreType;
 
 // ********************************************************************************************************************** //
 // ==================================================== Matrix Class ==================================================== //
 // ********************************************************************************************************************** //
 
+// Type of the values held by a matrix. A float64 matrix keeps them in data and a float32 matrix in dataF, and the other
+// pointer is always NULL, so the kernels can tell the two apart from the pointers alone
+enum LpmDtype {
+    LpmFloat64 = 0,
+    LpmFloat32 = 1
+};
+
 typedef struct {
     PyObject_HEAD
 
@@ -17,11 +37,59 @@ typedef struct {
     long int cols;
     long int rowStride;
     long int colStride;
+    int dtype;
     double *data;
+    float *dataF;
+    struct ulm_dgemm_packed *packed;
+    struct ulm_qgemm_weights *quantized;
 } MatrixCoreObject;
 
+// Drop the packed copy of the matrix made by matrixPrepack and the int8 copy made by matrixQuantize. Must be called
+// before anything changes the values or shape of the matrix, so that no product uses copies that no longer match it
+static void matrixInvalidatePack(MatrixCoreObject *self) {
+    ulm_dgemm_packed_release(self->packed);
+    self->packed = NULL;
+    ulm_qgemm_weights_release(self->quantized);
+    self->quantized = NULL;
+}
+
+// Replace the values of the matrix with an uninitialised buffer of length values of the given type. Returns -1 with a
+// Python error if there is not enough memory
+static int matrixAllocate(MatrixCoreObject *self, long length, int dtype) {
+    free(self->data);
+    free(self->dataF);
+    self->data = NULL;
+    self->dataF = NULL;
+    self->dtype = dtype;
+
+    if (dtype == LpmFloat32) {
+        self->dataF = malloc(sizeof(float) * length);
+    } else {
+        self->data = malloc(sizeof(double) * length);
+    }
+
+    if (self->data == NULL && self->dataF == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "There was not enough memory to allocate an array of this size");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Raise a TypeError and return -1 unless both matrices hold values of the same type
+static int matrixCheckDtypes(MatrixCoreObject *a, MatrixCoreObject *b) {
+    if (a->dtype != b->dtype) {
+        PyErr_SetString(PyExc_TypeError, "Matrices must have the same datatype");
+        return -1;
+    }
+
+    return 0;
+}
+
 static void matrixDealloc(MatrixCoreObject *self) {
+    matrixInvalidatePack(self);
     free(self->data);
+    free(self->dataF);
     Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
@@ -33,6 +101,10 @@ static PyObject *matrixNew(PyTypeObject *type, PyObject *args, PyObject *kwargs)
         self->cols = 0;
         self->rowStride = 0;
         self->colStride = 0;
+        self->packed = NULL;
+        self->quantized = NULL;
+        self->dtype = LpmFloat64;
+        self->dataF = NULL;
         self->data = malloc(sizeof(double));
 
         if (self->data == NULL) {
@@ -48,9 +120,17 @@ static PyObject *matrixNew(PyTypeObject *type, PyObject *args, PyObject *kwargs)
 static int matrixInit(MatrixCoreObject *self, PyObject *args, PyObject *kwargs) {
     long r = -1;
     long c = -1;
+    int dtype = LpmFloat64;
+
+    if (!PyArg_ParseTuple(args, "ll|i", &r, &c, &dtype))
+        return -1;
 
-    if (!PyArg_ParseTuple(args, "ll", &r, &c))
+    if (dtype != LpmFloat64 && dtype != LpmFloat32) {
+        PyErr_SetString(PyExc_ValueError, "Invalid datatype for matrix");
         return -1;
+    }
+
+    matrixInvalidatePack(self);
 
     if (r == -1 && c == -1) {
         return -1;
@@ -62,10 +142,8 @@ static int matrixInit(MatrixCoreObject *self, PyObject *args, PyObject *kwargs)
         self->cols = r;
         self->rowStride = c;
         self->colStride = 1;
-        self->data = malloc(sizeof(double) * r * r);
 
-        if (self->data == NULL) {
-            PyErr_SetString(PyExc_MemoryError, "There was not enough memory to allocate an array of this size");
+        if (matrixAllocate(self, r * r, dtype) != 0) {
             return -1;
         }
     } else {
@@ -76,10 +154,8 @@ static int matrixInit(MatrixCoreObject *self, PyObject *args, PyObject *kwargs)
         self->cols = c;
         self->rowStride = c;
         self->colStride = 1;
-        self->data = malloc(sizeof(double) * r * c);
 
-        if (self->data == NULL) {
-            PyErr_SetString(PyExc_MemoryError, "There was not enough memory to allocate an array of this size");
+        if (matrixAllocate(self, r * c, dtype) != 0) {
             return -1;
         }
     }
@@ -100,6 +176,8 @@ static PyObject *matrixReshape(MatrixCoreObject *self, PyObject *newDims) {
         return NULL;
     }
 
+    matrixInvalidatePack(self);
+
     self->rows = r;
     self->cols = c;
     self->rowStride = c;
@@ -118,7 +196,8 @@ static PyObject *matrixGetVal(MatrixCoreObject *self, PyObject *index) {
     double res;
 
     if (i < self->rows && j < self->cols && i >= 0 && j >= 0) {
-        res = self->data[internalGet(i, j, self->rowStride, self->colStride)];
+        long index = internalGet(i, j, self->rowStride, self->colStride);
+        res = (self->dtype == LpmFloat32) ? self->dataF[index] : self->data[index];
     } else {
         PyErr_SetString(PyExc_IndexError, "Index out of range for matrix get");
         return NULL;
@@ -136,7 +215,15 @@ static PyObject *matrixSetVal(MatrixCoreObject *self, PyObject *index) {
         return NULL;
 
     if (i < self->rows && j < self->cols && i >= 0 && j >= 0) {
-        self->data[internalGet(i, j, self->rowStride, self->colStride)] = val;
+        long index = internalGet(i, j, self->rowStride, self->colStride);
+
+        matrixInvalidatePack(self);
+
+        if (self->dtype == LpmFloat32) {
+            self->dataF[index] = (float) val;
+        } else {
+            self->data[index] = val;
+        }
     } else {
         PyErr_SetString(PyExc_IndexError, "Index out of range for matrix set");
         return NULL;
@@ -153,6 +240,11 @@ static MatrixCoreObject *matrixNewC(double *data, long rows, long cols, int t) {
         return NULL;
     }
 
+    res->packed = NULL;
+    res->quantized = NULL;
+    res->dtype = LpmFloat64;
+    res->dataF = NULL;
+
     if (!t) {
         res->rows = rows;
         res->cols = cols;
@@ -170,7 +262,34 @@ static MatrixCoreObject *matrixNewC(double *data, long rows, long cols, int t) {
     return res;
 }
 
+// Same as matrixNewC, for a float32 matrix
+static MatrixCoreObject *matrixNewCFloat(float *data, long rows, long cols, int t) {
+    MatrixCoreObject *res = matrixNewC(NULL, rows, cols, t);
+
+    if (res != NULL) {
+        res->dtype = LpmFloat32;
+        res->dataF = data;
+    }
+
+    return res;
+}
+
 static PyObject *matrixCopy(MatrixCoreObject *self) {
+    if (self->dtype == LpmFloat32) {
+        float *resF = allocateMemoryFloat(self->rows * self->cols);
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        memcpy(resF, self->dataF, sizeof(float) * self->rows * self->cols);
+
+        if (self->colStride != 1) {
+            return (PyObject *) matrixNewCFloat(resF, self->cols, self->rows, 1);
+        }
+
+        return (PyObject *) matrixNewCFloat(resF, self->rows, self->cols, 0);
+    }
+
     double *res = allocateMemory(self->rows * self->cols);
     if (res == NULL) {
         PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory");
@@ -179,8 +298,12 @@ static PyObject *matrixCopy(MatrixCoreObject *self) {
 
     memcpy(res, self->data, sizeof(double) * self->rows * self->cols);
 
-    // TODO: Ensure this does the correct thing...
-    return (PyObject *) matrixNewC(res, self->rows, self->cols, self->colStride != 1);
+    // A matrix stored column by column holds the row major data of its transpose, which matrixNewC transposes back
+    if (self->colStride != 1) {
+        return (PyObject *) matrixNewC(res, self->cols, self->rows, 1);
+    }
+
+    return (PyObject *) matrixNewC(res, self->rows, self->cols, 0);
 }
 
 static PyMemberDef matrixMembers[] = {
@@ -207,403 +330,2718 @@ static PyObject *matrixGetColStride(MatrixCoreObject *self, void *closure) {
     return PyLong_FromLong(self->colStride);
 }
 
+static PyObject *matrixIsPrepacked(MatrixCoreObject *self, void *closure) {
+    return PyBool_FromLong(self->packed != NULL);
+}
+
+static PyObject *matrixIsQuantized(MatrixCoreObject *self, void *closure) {
+    return PyBool_FromLong(self->quantized != NULL);
+}
+
+static PyObject *matrixGetDtype(MatrixCoreObject *self, void *closure) {
+    return PyUnicode_FromString(self->dtype == LpmFloat32 ? "float32" : "float64");
+}
+
 static PyObject *matrixSum(MatrixCoreObject *self, PyObject *args) {
     int threads = 1;
+    int mode = ULM_SUM_FAST;
+    double res;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (!PyArg_ParseTuple(args, "|ii", &threads, &mode)) {
+        return NULL;
+    }
+
+    if (mode != ULM_SUM_FAST && mode != ULM_SUM_PAIRWISE && mode != ULM_SUM_KAHAN) {
+        PyErr_SetString(PyExc_ValueError, "Invalid summation mode");
         return NULL;
     }
 
-    return Py_BuildValue("d", doubleMatrixSum(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads));
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        res = floatMatrixSum(aF, rows, cols, rs, cs, mode, threads);
+    } else {
+        res = doubleMatrixSum(a, rows, cols, rs, cs, mode, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    return Py_BuildValue("d", res);
 }
 
 static PyObject *matrixMean(MatrixCoreObject *self, PyObject *args) {
     int threads = 1;
+    int mode = ULM_SUM_FAST;
+    double res;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (!PyArg_ParseTuple(args, "|ii", &threads, &mode)) {
         return NULL;
     }
 
-    return Py_BuildValue("d", doubleMatrixMean(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads));
-}
+    if (mode != ULM_SUM_FAST && mode != ULM_SUM_PAIRWISE && mode != ULM_SUM_KAHAN) {
+        PyErr_SetString(PyExc_ValueError, "Invalid summation mode");
+        return NULL;
+    }
 
-static PyObject *matrixTransposeReturn(MatrixCoreObject *self) {
-    double *res = allocateMemory(self->rows * self->cols);
-    long rows, cols, i, j, rs, cs;
-    rows = self->rows;
-    cols = self->cols;
-    rs = self->rowStride;
-    cs = self->colStride;
-    double *data = self->data;
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
 
-#   pragma omp parallel for private(i, j) shared(rows, cols, rs, cs, data, res)
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            res[i + j * rows] = data[internalGet(i, j, rs, cs)];
-        }
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        res = floatMatrixMean(aF, rows, cols, rs, cs, mode, threads);
+    } else {
+        res = doubleMatrixMean(a, rows, cols, rs, cs, mode, threads);
     }
+    LPM_END_ALLOW_THREADS
 
-    return (PyObject *) matrixNewC(res, self->cols, self->rows, 0);
+    return Py_BuildValue("d", res);
 }
 
-static PyObject *matrixProduct(MatrixCoreObject *self, PyObject *args) {
-    MatrixCoreObject *other;
-    double *resData;
+// Reduce the matrix along an axis with one of the LPM_REDUCE operations, to a row of cols results along the rows (axis
+// 0) or to a column of rows results along the columns (axis 1). Sums, means, minima and maxima hold values of the same
+// type as the matrix, while argmin and argmax return the indices of the first minimum or maximum as a float64 matrix
+static PyObject *matrixReduce(MatrixCoreObject *self, PyObject *args) {
+    int op, axis;
     int threads = 1;
+    double *res, *best = NULL;
 
-    if (!PyArg_ParseTuple(args, "O|i", &other, &threads)) {
+    if (!PyArg_ParseTuple(args, "ii|i", &op, &axis, &threads)) {
         return NULL;
     }
 
-    resData = allocateMemory(self->rows * other->cols);
-    long M = self->rows;
-    long N = self->cols;
-    long K = other->cols;
-    double alpha = 1.0;
-    double beta = 0.0;
+    if (op < LPM_REDUCE_SUM || op > LPM_REDUCE_ARGMAX) {
+        PyErr_SetString(PyExc_ValueError, "Invalid reduction");
+        return NULL;
+    }
+
+    if (axis != 0 && axis != 1) {
+        PyErr_SetString(PyExc_ValueError, "Axis must be 0 (along the rows) or 1 (along the columns)");
+        return NULL;
+    }
+
+    int arg = (op == LPM_REDUCE_ARGMIN || op == LPM_REDUCE_ARGMAX);
+    long rows = self->rows, cols = self->cols;
+    long m = axis == 0 ? cols : rows;
+    long n = axis == 0 ? rows : cols;
+    long strideOut = axis == 0 ? self->colStride : self->rowStride;
+    long strideIn = axis == 0 ? self->rowStride : self->colStride;
     const double *a = self->data;
-    const double *b = other->data;
+    const float *aF = self->dataF;
+
+    res = allocateMemory(m);
+    if (res == NULL) {
+        return NULL;
+    }
 
-    PyObject *res;
+    if (arg) {
+        best = allocateMemory(m);
+        if (best == NULL) {
+            free(res);
+            return NULL;
+        }
+    }
 
-    if (M * N * K > 15000) {
-        // dgemm_("N", "N", &M, &K, &N, &alpha, a, &N, b, &K, &beta, resData, &M);
-        dgemm_("N", "N", &M, &K, &N, &alpha, a, &M, b, &N, &beta, resData, &M);
-        res = (PyObject *) matrixNewC(resData, self->rows, other->cols, 0);
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixReduceAxis(aF, op, m, n, strideOut, strideIn, res, best, threads);
     } else {
-        long int i, j, k;
-
-        for (i = 0; i < M; i++) {
-            for (j = 0; j < K; j++) {
-                double tmp = 0;
-                for (k = 0; k < N; k++) {
-                    tmp += a[k + i * N] * b[j + k * K];
-                }
-                resData[j + i * K] = tmp;
-            }
+        doubleMatrixReduceAxis(a, op, m, n, strideOut, strideIn, res, best, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    free(best);
+
+    if (aF != NULL && !arg) {
+        float *resF = allocateMemoryFloat(m);
+        long i;
+
+        if (resF == NULL) {
+            free(res);
+            return NULL;
+        }
+
+        for (i = 0; i < m; i++) {
+            resF[i] = (float) res[i];
         }
+        free(res);
 
-        res = (PyObject *) matrixNewC(resData, self->rows, other->cols, 0);
+        return (PyObject *) matrixNewCFloat(resF, axis == 0 ? 1 : m, axis == 0 ? m : 1, 0);
     }
 
-    return res;
+    return (PyObject *) matrixNewC(res, axis == 0 ? 1 : m, axis == 0 ? m : 1, 0);
 }
 
-static PyObject *matrixAddMatrixReturn(MatrixCoreObject *self, PyObject *args) {
-    MatrixCoreObject *other;
-    double *resData;
-    int threads = 1;
+static PyObject *matrixTransposeReturn(MatrixCoreObject *self) {
+    long rows, cols, i, j, rs, cs;
+    rows = self->rows;
+    cols = self->cols;
+    rs = self->rowStride;
+    cs = self->colStride;
 
-    if (!PyArg_ParseTuple(args, "O|i", &other, &threads)) {
-        return NULL;
-    }
+    if (self->dtype == LpmFloat32) {
+        float *resF = allocateMemoryFloat(rows * cols);
+        float *dataF = self->dataF;
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixAddMatrix(self->data, other->data, resData, self->rows, self->cols, self->rowStride, self->colStride, other->rowStride, other->colStride, threads);
+        if (resF == NULL) {
+            return NULL;
+        }
 
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+#       pragma omp parallel for private(i, j) shared(rows, cols, rs, cs, dataF, resF)
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < cols; j++) {
+                resF[i + j * rows] = dataF[internalGet(i, j, rs, cs)];
+            }
+        }
+        LPM_END_ALLOW_THREADS
 
-    return res;
-}
+        return (PyObject *) matrixNewCFloat(resF, cols, rows, 0);
+    }
 
-static PyObject *matrixSubMatrixReturn(MatrixCoreObject *self, PyObject *args) {
-    MatrixCoreObject *other;
-    double *resData;
-    int threads = 8;
+    double *res = allocateMemory(self->rows * self->cols);
+    double *data = self->data;
 
-    if (!PyArg_ParseTuple(args, "O|i", &other, &threads)) {
+    if (res == NULL) {
         return NULL;
     }
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixSubMatrix(self->data, other->data, resData, self->rows, self->cols, self->rowStride, self->colStride, other->rowStride, other->colStride, threads);
-
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+#   pragma omp parallel for private(i, j) shared(rows, cols, rs, cs, data, res)
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            res[i + j * rows] = data[internalGet(i, j, rs, cs)];
+        }
+    }
+    LPM_END_ALLOW_THREADS
 
-    return res;
+    return (PyObject *) matrixNewC(res, cols, rows, 0);
 }
 
-static PyObject *matrixMulMatrixReturn(MatrixCoreObject *self, PyObject *args) {
-    MatrixCoreObject *other;
-    double *resData;
-    int threads = 8;
+// Copy the matrix into a new one holding the same values stored column by column. Every matrix made from Python is
+// stored row by row, so this gives the tests a way to reach the strided paths of the routines
+static PyObject *matrixColumnMajor(MatrixCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    PyObject *transposed = matrixTransposeReturn(self);
+    MatrixCoreObject *res;
 
-    if (!PyArg_ParseTuple(args, "O|i", &other, &threads)) {
+    if (transposed == NULL) {
         return NULL;
     }
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixMulMatrix(self->data, other->data, resData, self->rows, self->cols, self->rowStride, self->colStride, other->rowStride, other->colStride, threads);
-
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+    // The row major data of the transpose is the column major data of the matrix
+    res = (MatrixCoreObject *) transposed;
+    res->rows = self->rows;
+    res->cols = self->cols;
+    res->rowStride = 1;
+    res->colStride = self->rows;
 
-    return res;
+    return transposed;
 }
 
-static PyObject *matrixDivMatrixReturn(MatrixCoreObject *self, PyObject *args) {
-    MatrixCoreObject *other;
-    double *resData;
-    int threads = 8;
-
-    if (!PyArg_ParseTuple(args, "O|i", &other, &threads)) {
-        return NULL;
+// Compute C = act(alpha * A @ B + beta * C + bias), where A is M x N and B is N x K, choosing between the vector, small
+// and packed kernels by shape. The bias and activation come from the epilogue ep, which may be NULL, and are applied by
+// the kernels while C is still in cache. packedA may hold A packed ahead of time by matrixPrepack, and saves packing A
+// in the packed kernel. Very large products use the Strassen-Winograd recursion if strassen is positive, or if it is
+// negative and the products are above the size set by setGemmStrassen. Every operand is passed with its own strides, so
+// transposed and strided views need no copy. Returns 0 on success and -1 if a kernel could not allocate its buffers.
+// Must not use the Python API, as it runs without the GIL
+static int computeProduct(long M, long N, long K, double alpha,
+                          const double *a, long rsA, long csA,
+                          const double *b, long rsB, long csB,
+                          double beta, double *c, long rsC, long csC, int threads,
+                          const struct ulm_epilogue *ep, const struct ulm_dgemm_packed *packedA, int strassen) {
+    struct ulm_epilogue epT;
+    int status;
+
+    if (K == 1) {
+        // Matrix times column vector
+        return ULMBLAS(dgemv)(M, N, alpha, a, rsA, csA, b, rsB, beta, c, rsC, threads, ep);
+    } else if (M == 1) {
+        // Row vector times matrix, computed as B^T times the vector
+        return ULMBLAS(dgemv_t)(N, K, alpha, b, rsB, csB, a, csA, beta, c, csC, threads,
+                                ulm_epilogue_transposed(ep, &epT));
+    } else if (ULMBLAS(dgemm_strassen_wanted)(M, K, N, strassen)) {
+        status = ULMBLAS(dgemm_strassen)(M, K, N, alpha, a, rsA, csA, b, rsB, csB, beta, c, rsC, csC, threads);
+        if (status == 0) {
+            ulm_epilogue_apply(ep, M, K, 0, 0, c, rsC, csC);
+        }
+        return status;
+    } else if (M * N * K > ULM_DGEMM_SMALL_CROSSOVER) {
+        return ULMBLAS(dgemm_nn_ep)(M, K, N, alpha, a, rsA, csA, b, rsB, csB, beta, c, rsC, csC, threads, ep,
+                                    packedA, NULL);
     }
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixDivMatrix(self->data, other->data, resData, self->rows, self->cols, self->rowStride, self->colStride, other->rowStride, other->colStride, threads);
+    ULMBLAS(dgemm_small_ep)(M, K, N, alpha, a, rsA, csA, b, rsB, csB, beta, c, rsC, csC, ep);
+    return 0;
+}
 
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+// Single precision version of computeProduct, for float32 matrices. Products up to the same crossover as the double
+// kernels skip packing, and everything larger goes to the packed SGEMM kernel
+static int computeProductFloat(long M, long N, long K, float alpha,
+                               const float *a, long rsA, long csA,
+                               const float *b, long rsB, long csB,
+                               float beta, float *c, long rsC, long csC, int threads,
+                               const struct ulm_sepilogue *ep) {
+    if (M * N * K > ULM_DGEMM_SMALL_CROSSOVER) {
+        return ULMBLAS(sgemm_nn_ep)(M, K, N, alpha, a, rsA, csA, b, rsB, csB, beta, c, rsC, csC, threads, ep);
+    }
 
-    return res;
+    ULMBLAS(sgemm_small_ep)(M, K, N, alpha, a, rsA, csA, b, rsB, csB, beta, c, rsC, csC, ep);
+    return 0;
 }
 
-static PyObject *matrixAddScalarReturn(MatrixCoreObject *self, PyObject *args) {
-    double other;
-    double *resData;
-    int threads = 1;
+// Fill in the epilogue of an M x K product from the optional bias and activation arguments. The bias may be None, an
+// M x K matrix, a column of M values added to every column or a row of K values added to every row, and must hold the
+// same type of values as the product. ep is filled in for a float64 product and epF for a float32 one. Returns 1 if
+// the product has an epilogue, 0 if there is nothing to do after the product and -1 with a Python error on bad input
+static int parseEpilogue(PyObject *bias, int activation, long M, long K, int dtype,
+                         struct ulm_epilogue *ep, struct ulm_sepilogue *epF) {
+    MatrixCoreObject *mat;
 
-    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
-        return NULL;
+    if (activation < UlmActNone || activation > UlmActLeakyRelu) {
+        PyErr_SetString(PyExc_ValueError, "Invalid activation for the matrix product");
+        return -1;
     }
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixAddScalar(self->data, other, resData, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    ep->bias = NULL;
+    ep->incRowBias = 0;
+    ep->incColBias = 0;
+    ep->activation = activation;
+    epF->bias = NULL;
+    epF->incRowBias = 0;
+    epF->incColBias = 0;
+    epF->activation = activation;
+
+    if (bias != NULL && bias != Py_None) {
+        if (!PyObject_TypeCheck(bias, &MatrixCoreType)) {
+            PyErr_SetString(PyExc_TypeError, "Bias of a matrix product must be a matrix");
+            return -1;
+        }
+
+        mat = (MatrixCoreObject *) bias;
 
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+        if (!((mat->rows == M || mat->rows == 1) && (mat->cols == K || mat->cols == 1))) {
+            PyErr_SetString(PyExc_ValueError, "Bias has the wrong dimensions for the matrix product");
+            return -1;
+        }
 
-    return res;
+        if (mat->dtype != dtype) {
+            PyErr_SetString(PyExc_TypeError, "Bias must have the same datatype as the matrix product");
+            return -1;
+        }
+
+        ep->bias = mat->data;
+        ep->incRowBias = mat->rows == 1 ? 0 : mat->rowStride;
+        ep->incColBias = mat->cols == 1 ? 0 : mat->colStride;
+        epF->bias = mat->dataF;
+        epF->incRowBias = ep->incRowBias;
+        epF->incColBias = ep->incColBias;
+    }
+
+    return ((bias != NULL && bias != Py_None) || activation != UlmActNone) ? 1 : 0;
 }
 
-static PyObject *matrixSubScalarReturn(MatrixCoreObject *self, PyObject *args) {
-    double other;
+// Calculate act(alpha * op(self) @ op(other) + bias), where op transposes its operand if transA or transB is set.
+// Transposing only swaps the strides, and the strides of both operands are handed to the kernels, so transposed and
+// strided views are multiplied without copying them first. The bias and activation are optional and are applied to
+// each block of the result as the kernels finish it, instead of in two more passes over the result. strassen selects
+// the Strassen-Winograd recursion: 1 to use it, 0 to never use it and -1 to decide by size. If self holds an int8 copy
+// made by matrixQuantize and is not transposed, the product is computed from that copy by the quantised kernel
+static PyObject *matrixProduct(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    PyObject *bias = Py_None;
+    struct ulm_dgemm_packed *packedA;
+    struct ulm_qgemm_weights *quantizedA;
+    const struct ulm_epilogue *ep;
+    struct ulm_epilogue epilogue;
+    struct ulm_sepilogue epilogueF;
     double *resData;
-    int threads = 8;
-
-    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
+    double alpha = 1.0;
+    int threads = 1;
+    int transA = 0;
+    int transB = 0;
+    int activation = 0;
+    int strassen = -1;
+    int status = 0;
+
+    if (!PyArg_ParseTuple(args, "O!|ippdOii", &MatrixCoreType, &other, &threads, &transA, &transB, &alpha, &bias,
+                          &activation, &strassen)) {
         return NULL;
     }
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixSubScalar(self->data, other, resData, self->rows, self->cols, self->rowStride, self->colStride, threads);
-
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+    long M = transA ? self->cols : self->rows;
+    long N = transA ? self->rows : self->cols;
+    long K = transB ? other->rows : other->cols;
+    long rsA = transA ? self->colStride : self->rowStride;
+    long csA = transA ? self->rowStride : self->colStride;
+    long rsB = transB ? other->colStride : other->rowStride;
+    long csB = transB ? other->rowStride : other->colStride;
+    const double *a = self->data;
+    const double *b = other->data;
 
-    return res;
-}
+    if (N != (transB ? other->cols : other->rows)) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix product");
+        return NULL;
+    }
 
-static PyObject *matrixMulScalarReturn(MatrixCoreObject *self, PyObject *args) {
-    double other;
-    double *resData;
-    int threads = 8;
+    if (matrixCheckDtypes(self, other) != 0) {
+        return NULL;
+    }
 
-    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
+    status = parseEpilogue(bias, activation, M, K, self->dtype, &epilogue, &epilogueF);
+    if (status < 0) {
         return NULL;
     }
+    ep = (status > 0) ? &epilogue : NULL;
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixMulScalar(self->data, other, resData, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    if (self->dtype == LpmFloat32) {
+        const struct ulm_sepilogue *epF = (status > 0) ? &epilogueF : NULL;
+        const float *aF = self->dataF;
+        const float *bF = other->dataF;
+        float *resF = allocateMemoryFloat(M * K);
 
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+        if (resF == NULL) {
+            return NULL;
+        }
 
-    return res;
-}
+        LPM_BEGIN_ALLOW_THREADS(M * N * K)
+        status = computeProductFloat(M, N, K, (float) alpha, aF, rsA, csA, bF, rsB, csB, 0.0f, resF, K, 1, threads,
+                                     epF);
+        LPM_END_ALLOW_THREADS
 
-static PyObject *matrixDivScalarReturn(MatrixCoreObject *self, PyObject *args) {
-    double other;
-    double *resData;
-    int threads = 8;
+        if (status != 0) {
+            free(resF);
+            PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+            return NULL;
+        }
 
-    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
+        return (PyObject *) matrixNewCFloat(resF, M, K, 0);
+    }
+
+    resData = allocateMemory(M * K);
+    if (resData == NULL) {
         return NULL;
     }
 
-    resData = allocateMemory(self->rows * self->cols);
-    doubleMatrixDivScalar(self->data, other, resData, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    // The packed panels and the int8 copy hold self as stored, so they only stand in for an untransposed A. The extra
+    // references keep them alive while the GIL is released
+    packedA = transA ? NULL : self->packed;
+    if (packedA != NULL) {
+        packedA->refs++;
+    }
 
-    PyObject *res = (PyObject *) matrixNewC(resData, self->rows, self->cols, self->colStride != 1);
+    quantizedA = transA ? NULL : self->quantized;
+    if (quantizedA != NULL) {
+        quantizedA->refs++;
+    }
 
-    return res;
-}
+    LPM_BEGIN_ALLOW_THREADS(M * N * K)
+    if (quantizedA != NULL) {
+        status = ULMBLAS(qgemm)(M, K, N, alpha, quantizedA, b, rsB, csB, 0.0, resData, K, 1, threads, ep);
+    } else {
+        status = computeProduct(M, N, K, alpha, a, rsA, csA, b, rsB, csB, 0.0, resData, K, 1, threads, ep, packedA,
+                                strassen);
+    }
+    LPM_END_ALLOW_THREADS
 
-static PyObject *matrixFillScalar(MatrixCoreObject *self, PyObject *args) {
-    double scalar;
-    int threads = 8;
+    ulm_dgemm_packed_release(packedA);
+    ulm_qgemm_weights_release(quantizedA);
 
-    if (!PyArg_ParseTuple(args, "d|i", &scalar, &threads)) {
+    if (status != 0) {
+        free(resData);
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
         return NULL;
     }
 
-    doubleMatrixFillScalar(self->data, scalar, self->rows, self->cols, self->rowStride, self->colStride, threads);
-
-    Py_RETURN_NONE;
+    return (PyObject *) matrixNewC(resData, M, K, 0);
 }
 
-static PyObject *matrixFillAscending(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+// Pack the matrix into the panel layout of the packed product kernel and keep the result, so that later products with
+// this matrix as the left operand skip packing it. The panels are dropped as soon as the matrix is changed, and are
+// ignored if the kernel or block sizes have changed since they were made
+static PyObject *matrixPrepack(MatrixCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    struct ulm_dgemm_packed *packed;
+    const double *a = self->data;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (self->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Only float64 matrices can be prepacked");
         return NULL;
     }
 
-    doubleMatrixFillAscending(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
-
-    Py_RETURN_NONE;
-}
-
-static PyObject *matrixFillDescending(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    packed = ULMBLAS(dgemm_prepack)(rows, cols, a, rs, cs);
+    LPM_END_ALLOW_THREADS
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (packed == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the packed matrix");
         return NULL;
     }
 
-    doubleMatrixFillDescending(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    ulm_dgemm_packed_release(self->packed);
+    self->packed = packed;
 
     Py_RETURN_NONE;
 }
 
-static PyObject *matrixFillRandom(MatrixCoreObject *self, PyObject *args) {
-    const double min = -1;
-    const double max = 1;
-    int threads = 8;
+// Keep a copy of the matrix quantised to int8 with one scale per row, so that later products with this matrix as the
+// left operand are computed by the int8 kernel, which quantises the other operand as it goes. This trades accuracy for
+// speed and memory, and is meant for the weights of a trained network. The copy is dropped as soon as the matrix is
+// changed, or by matrixDequantize
+static PyObject *matrixQuantize(MatrixCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    struct ulm_qgemm_weights *quantized;
+    const double *a = self->data;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
 
-    if (!PyArg_ParseTuple(args, "|ddi", &min, &max, &threads)) {
+    if (self->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Only float64 matrices can be quantized");
         return NULL;
     }
 
-    doubleMatrixFillRandomRange(self->data, min, max, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    quantized = ULMBLAS(qgemm_quantize)(rows, cols, a, rs, cs);
+    LPM_END_ALLOW_THREADS
 
-    Py_RETURN_NONE;
-}
-
-static PyObject *matrixMapSigmoid(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
-
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (quantized == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the quantized matrix");
         return NULL;
     }
 
-    doubleMatrixMapSigmoid(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    ulm_qgemm_weights_release(self->quantized);
+    self->quantized = quantized;
 
     Py_RETURN_NONE;
 }
 
-static PyObject *matrixMapTanh(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+static PyObject *matrixDequantize(MatrixCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    ulm_qgemm_weights_release(self->quantized);
+    self->quantized = NULL;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    Py_RETURN_NONE;
+}
+
+// Accumulate a matrix product into this matrix in place: self = act(alpha * op(A) @ op(B) + beta * self + bias), with
+// an optional bias and activation as for matrixProduct. Nothing is allocated, so gradient accumulation and residual
+// updates cost a single GEMM. The result must not share memory with A or B
+static PyObject *matrixAddmm(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *matA, *matB;
+    PyObject *bias = Py_None;
+    const struct ulm_epilogue *ep;
+    struct ulm_epilogue epilogue;
+    struct ulm_sepilogue epilogueF;
+    double alpha = 1.0;
+    double beta = 1.0;
+    int threads = 1;
+    int transA = 0;
+    int transB = 0;
+    int activation = 0;
+    int status = 0;
+
+    if (!PyArg_ParseTuple(args, "O!O!|ddippOi", &MatrixCoreType, &matA, &MatrixCoreType, &matB, &alpha, &beta,
+                          &threads, &transA, &transB, &bias, &activation)) {
+        return NULL;
+    }
+
+    long M = transA ? matA->cols : matA->rows;
+    long N = transA ? matA->rows : matA->cols;
+    long K = transB ? matB->rows : matB->cols;
+    long rsA = transA ? matA->colStride : matA->rowStride;
+    long csA = transA ? matA->rowStride : matA->colStride;
+    long rsB = transB ? matB->colStride : matB->rowStride;
+    long csB = transB ? matB->rowStride : matB->colStride;
+    long rsC = self->rowStride, csC = self->colStride;
+    const double *a = matA->data;
+    const double *b = matB->data;
+    double *c = self->data;
+
+    if (N != (transB ? matB->cols : matB->rows)) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix product");
+        return NULL;
+    }
+
+    if (M != self->rows || K != self->cols) {
+        PyErr_SetString(PyExc_ValueError, "Output matrix has the wrong dimensions for the matrix product");
+        return NULL;
+    }
+
+    if (matrixCheckDtypes(self, matA) != 0 || matrixCheckDtypes(self, matB) != 0) {
+        return NULL;
+    }
+
+    if ((c != NULL && (c == a || c == b)) ||
+        (self->dataF != NULL && (self->dataF == matA->dataF || self->dataF == matB->dataF))) {
+        PyErr_SetString(PyExc_ValueError, "Output matrix must not share memory with an operand of the matrix product");
         return NULL;
     }
 
-    doubleMatrixMapTanh(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    status = parseEpilogue(bias, activation, M, K, self->dtype, &epilogue, &epilogueF);
+    if (status < 0) {
+        return NULL;
+    }
+    ep = (status > 0) ? &epilogue : NULL;
+
+    matrixInvalidatePack(self);
+
+    if (self->dtype == LpmFloat32) {
+        const struct ulm_sepilogue *epF = (status > 0) ? &epilogueF : NULL;
+        const float *aF = matA->dataF, *bF = matB->dataF;
+        float *cF = self->dataF;
+
+        LPM_BEGIN_ALLOW_THREADS(M * N * K)
+        status = computeProductFloat(M, N, K, (float) alpha, aF, rsA, csA, bF, rsB, csB, (float) beta, cF, rsC, csC,
+                                     threads, epF);
+        LPM_END_ALLOW_THREADS
+
+        if (status != 0) {
+            PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+            return NULL;
+        }
+
+        Py_RETURN_NONE;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(M * N * K)
+    status = computeProduct(M, N, K, alpha, a, rsA, csA, b, rsB, csB, beta, c, rsC, csC, threads, ep, NULL, -1);
+    LPM_END_ALLOW_THREADS
+
+    if (status != 0) {
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+        return NULL;
+    }
 
     Py_RETURN_NONE;
 }
 
-static PyObject *matrixMapRELU(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+// Add alpha * x * y^T to the matrix in place, where x and y are vectors (either n x 1 or 1 x n matrices) with as many
+// elements as the matrix has rows and columns. Nothing is allocated, and every element of the matrix is read and
+// written once
+static PyObject *matrixAddOuter(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *x, *y;
+    double alpha = 1.0;
+    int threads = 1;
+    int status;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (!PyArg_ParseTuple(args, "O!O!|di", &MatrixCoreType, &x, &MatrixCoreType, &y, &alpha, &threads)) {
+        return NULL;
+    }
+
+    if ((x->rows != 1 && x->cols != 1) || (y->rows != 1 && y->cols != 1)) {
+        PyErr_SetString(PyExc_ValueError, "Both operands of an outer product must be vectors");
+        return NULL;
+    }
+
+    if (x->rows * x->cols != self->rows || y->rows * y->cols != self->cols) {
+        PyErr_SetString(PyExc_ValueError, "Invalid vector length for outer product");
+        return NULL;
+    }
+
+    if (matrixCheckDtypes(self, x) != 0 || matrixCheckDtypes(self, y) != 0) {
         return NULL;
     }
 
-    doubleMatrixMapRELU(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    double *a = self->data;
+    const double *xData = x->data, *yData = y->data;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+    long incX = (x->cols == 1) ? x->rowStride : x->colStride;
+    long incY = (y->cols == 1) ? y->rowStride : y->colStride;
+
+    matrixInvalidatePack(self);
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF;
+        const float *xF = x->dataF, *yF = y->dataF;
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixAddOuter(aF, (float) alpha, xF, incX, yF, incY, rows, cols, rs, cs, threads);
+        LPM_END_ALLOW_THREADS
+
+        Py_RETURN_NONE;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    status = ULMBLAS(dger)(rows, cols, alpha, xData, incX, yData, incY, a, rs, cs, threads);
+    LPM_END_ALLOW_THREADS
+
+    if (status != 0) {
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the outer product");
+        return NULL;
+    }
 
     Py_RETURN_NONE;
 }
 
-static PyObject *matrixMapLeakyRELU(MatrixCoreObject *self, PyObject *args) {
+// Find the stride between the values of a diagonal given as a vector d of n values, or of a single value repeated n
+// times for a scaled identity, in which case the stride is 0. Returns -1 with a Python error if d does not fit
+static int diagonalStride(MatrixCoreObject *self, MatrixCoreObject *d, long n, long *incD) {
+    if (d->rows != 1 && d->cols != 1) {
+        PyErr_SetString(PyExc_ValueError, "Diagonal must be a vector");
+        return -1;
+    }
+
+    if (d->rows * d->cols != n && d->rows * d->cols != 1) {
+        PyErr_SetString(PyExc_ValueError, "Invalid diagonal length for matrix");
+        return -1;
+    }
+
+    if (matrixCheckDtypes(self, d) != 0) {
+        return -1;
+    }
+
+    *incD = (d->rows * d->cols == 1) ? 0 : (d->cols == 1) ? d->rowStride : d->colStride;
+    return 0;
+}
+
+// Calculate alpha * diag(d) @ op(self) if cols is 0, or alpha * op(self) @ diag(d) if it is set, where op transposes
+// self if trans is set and d holds the diagonal as a vector or is a single value for a scaled identity. Each row or
+// column of self is scaled by its diagonal value, so the product costs one pass over self instead of a full matrix
+// product with the dense diagonal matrix
+static PyObject *matrixScaleDiagonal(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *diag;
+    double alpha = 1.0;
+    int cols = 0;
+    int threads = 1;
+    int trans = 0;
+    long incD;
+
+    if (!PyArg_ParseTuple(args, "O!|pdip", &MatrixCoreType, &diag, &cols, &alpha, &threads, &trans)) {
+        return NULL;
+    }
+
+    const double *a = self->data, *d = diag->data;
+    long rows = trans ? self->cols : self->rows;
+    long n = trans ? self->rows : self->cols;
+    long rs = trans ? self->colStride : self->rowStride;
+    long cs = trans ? self->rowStride : self->colStride;
+
+    if (diagonalStride(self, diag, cols ? n : rows, &incD) != 0) {
+        return NULL;
+    }
+
+    if (self->dtype == LpmFloat32) {
+        const float *aF = self->dataF, *dF = diag->dataF;
+        float *resF = allocateMemoryFloat(rows * n);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * n)
+        if (cols) {
+            floatMatrixScaleCols(aF, (float) alpha, dF, incD, resF, rows, n, rs, cs, threads);
+        } else {
+            floatMatrixScaleRows(aF, (float) alpha, dF, incD, resF, rows, n, rs, cs, threads);
+        }
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, n, 0);
+    }
+
+    double *res = allocateMemory(rows * n);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * n)
+    if (cols) {
+        doubleMatrixScaleCols(a, alpha, d, incD, res, rows, n, rs, cs, threads);
+    } else {
+        doubleMatrixScaleRows(a, alpha, d, incD, res, rows, n, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) matrixNewC(res, rows, n, 0);
+}
+
+// Calculate beta * self + alpha * diag(d) for a square matrix self, where d holds the diagonal as a vector or is a
+// single value for a scaled identity. Only the diagonal is touched after scaling self, and a beta of 0 ignores the
+// values of self, so the result is the dense diagonal matrix
+static PyObject *matrixAddDiagonal(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *diag;
+    double alpha = 1.0;
+    double beta = 1.0;
+    int threads = 1;
+    long incD, i;
+
+    if (!PyArg_ParseTuple(args, "O!|ddi", &MatrixCoreType, &diag, &alpha, &beta, &threads)) {
+        return NULL;
+    }
+
+    if (self->rows != self->cols) {
+        PyErr_SetString(PyExc_ValueError, "Matrix must be square to add a diagonal");
+        return NULL;
+    }
+
+    if (diagonalStride(self, diag, self->rows, &incD) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    const double *d = diag->data;
+    long n = self->rows, rs = self->rowStride, cs = self->colStride;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF;
+        const float *dF = diag->dataF;
+        float *resF = allocateMemoryFloat(n * n);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(n * n)
+        if (beta == 0.0) {
+            floatMatrixFillScalar(resF, 0.0f, n, n, n, 1, threads);
+        } else {
+            floatMatrixMulScalar(aF, (float) beta, resF, n, n, rs, cs, threads);
+        }
+
+        for (i = 0; i < n; i++) {
+            resF[i * n + i] += (float) alpha * dF[i * incD];
+        }
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, n, n, 0);
+    }
+
+    double *res = allocateMemory(n * n);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(n * n)
+    if (beta == 0.0) {
+        memset(res, 0, sizeof(double) * n * n);
+    } else {
+        doubleMatrixMulScalar(a, beta, res, n, n, rs, cs, threads);
+    }
+
+    for (i = 0; i < n; i++) {
+        res[i * n + i] += alpha * d[i * incD];
+    }
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) matrixNewC(res, n, n, 0);
+}
+
+// Return the diagonal of the matrix as a column vector. Together with the elementwise routines on vectors this gives
+// the elementwise product of a diagonal matrix with a dense one in O(n)
+static PyObject *matrixDiagonal(MatrixCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    long n = self->rows < self->cols ? self->rows : self->cols;
+    long inc = self->rowStride + self->colStride;
+    long i;
+
+    if (self->dtype == LpmFloat32) {
+        float *resF = allocateMemoryFloat(n);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        for (i = 0; i < n; i++) {
+            resF[i] = self->dataF[i * inc];
+        }
+
+        return (PyObject *) matrixNewCFloat(resF, n, 1, 0);
+    }
+
+    double *res = allocateMemory(n);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < n; i++) {
+        res[i] = self->data[i * inc];
+    }
+
+    return (PyObject *) matrixNewC(res, n, 1, 0);
+}
+
+// Calculate the Gram matrix self^T @ self, or self @ self^T if outer is set. The result is symmetric, so only its lower
+// triangle is computed and the upper one is copied from it, which takes about half the work of the matrix product
+static PyObject *matrixGram(MatrixCoreObject *self, PyObject *args) {
+    double *resData;
+    int threads = 1;
+    int outer = 0;
+    int status;
+
+    if (!PyArg_ParseTuple(args, "|ip", &threads, &outer)) {
+        return NULL;
+    }
+
+    // The outer product multiplies the rows of self with each other, the inner one the columns
+    long n = outer ? self->rows : self->cols;
+    long k = outer ? self->cols : self->rows;
+    long rsA = outer ? self->rowStride : self->colStride;
+    long csA = outer ? self->colStride : self->rowStride;
+    const double *a = self->data;
+
+    // float32 matrices have no symmetric kernel, so the whole product is computed
+    if (self->dtype == LpmFloat32) {
+        const float *aF = self->dataF;
+        float *resF = allocateMemoryFloat(n * n);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(n * n * k)
+        status = computeProductFloat(n, k, n, 1.0f, aF, rsA, csA, aF, csA, rsA, 0.0f, resF, n, 1, threads, NULL);
+        LPM_END_ALLOW_THREADS
+
+        if (status != 0) {
+            free(resF);
+            PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the Gram matrix");
+            return NULL;
+        }
+
+        return (PyObject *) matrixNewCFloat(resF, n, n, 0);
+    }
+
+    resData = allocateMemory(n * n);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(n * n * k)
+    status = ULMBLAS(dsyrk)(n, k, 1.0, a, rsA, csA, 0.0, resData, n, 1, threads);
+    LPM_END_ALLOW_THREADS
+
+    if (status != 0) {
+        free(resData);
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the Gram matrix");
+        return NULL;
+    }
+
+    return (PyObject *) matrixNewC(resData, n, n, 0);
+}
+
+// Find the shape of an elementwise operation between self and other. A dimension of 1 in either matrix is broadcast
+// against the other one, NumPy style, so a 1 x cols row is applied to every row and a rows x 1 column to every column.
+// Broadcast dimensions get a stride of 0, which makes the kernels read the same element again instead of expanding
+// the matrix into a temporary
+static int matrixBroadcast(MatrixCoreObject *self, MatrixCoreObject *other, long *rows, long *cols, long *rsA,
+                           long *csA, long *rsB, long *csB) {
+    if ((self->rows != other->rows && self->rows != 1 && other->rows != 1) ||
+        (self->cols != other->cols && self->cols != 1 && other->cols != 1)) {
+        PyErr_SetString(PyExc_ValueError, "Matrices must have the same dimensions, or 1 row or column to broadcast");
+        return -1;
+    }
+
+    *rows = self->rows > other->rows ? self->rows : other->rows;
+    *cols = self->cols > other->cols ? self->cols : other->cols;
+    *rsA = self->rows == *rows ? self->rowStride : 0;
+    *csA = self->cols == *cols ? self->colStride : 0;
+    *rsB = other->rows == *rows ? other->rowStride : 0;
+    *csB = other->cols == *cols ? other->colStride : 0;
+
+    return 0;
+}
+
+static PyObject *matrixAddMatrixReturn(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    double *resData;
+    int threads = 1;
+
+    if (!PyArg_ParseTuple(args, "O!|i", &MatrixCoreType, &other, &threads)) {
+        return NULL;
+    }
+
+    long rows, cols, rsA, csA, rsB, csB;
+    if (matrixBroadcast(self, other, &rows, &cols, &rsA, &csA, &rsB, &csB) != 0) {
+        return NULL;
+    }
+
+    if (matrixCheckDtypes(self, other) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data, *b = other->data;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF, *bF = other->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixAddMatrix(aF, bF, resF, rows, cols, rsA, csA, rsB, csB, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixAddMatrix(a, b, resData, rows, cols, rsA, csA, rsB, csB, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixSubMatrixReturn(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    double *resData;
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "O!|i", &MatrixCoreType, &other, &threads)) {
+        return NULL;
+    }
+
+    long rows, cols, rsA, csA, rsB, csB;
+    if (matrixBroadcast(self, other, &rows, &cols, &rsA, &csA, &rsB, &csB) != 0) {
+        return NULL;
+    }
+
+    if (matrixCheckDtypes(self, other) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data, *b = other->data;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF, *bF = other->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixSubMatrix(aF, bF, resF, rows, cols, rsA, csA, rsB, csB, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixSubMatrix(a, b, resData, rows, cols, rsA, csA, rsB, csB, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixMulMatrixReturn(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    double *resData;
     int threads = 8;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (!PyArg_ParseTuple(args, "O!|i", &MatrixCoreType, &other, &threads)) {
+        return NULL;
+    }
+
+    long rows, cols, rsA, csA, rsB, csB;
+    if (matrixBroadcast(self, other, &rows, &cols, &rsA, &csA, &rsB, &csB) != 0) {
+        return NULL;
+    }
+
+    if (matrixCheckDtypes(self, other) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data, *b = other->data;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF, *bF = other->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixMulMatrix(aF, bF, resF, rows, cols, rsA, csA, rsB, csB, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixMulMatrix(a, b, resData, rows, cols, rsA, csA, rsB, csB, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixDivMatrixReturn(MatrixCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    double *resData;
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "O!|i", &MatrixCoreType, &other, &threads)) {
+        return NULL;
+    }
+
+    long rows, cols, rsA, csA, rsB, csB;
+    if (matrixBroadcast(self, other, &rows, &cols, &rsA, &csA, &rsB, &csB) != 0) {
+        return NULL;
+    }
+
+    if (matrixCheckDtypes(self, other) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data, *b = other->data;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF, *bF = other->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixDivMatrix(aF, bF, resF, rows, cols, rsA, csA, rsB, csB, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixDivMatrix(a, b, resData, rows, cols, rsA, csA, rsB, csB, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixAddScalarReturn(MatrixCoreObject *self, PyObject *args) {
+    double other;
+    double *resData;
+    int threads = 1;
+
+    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixAddScalar(aF, (float) other, resF, rows, cols, rs, cs, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixAddScalar(a, other, resData, rows, cols, rs, cs, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixSubScalarReturn(MatrixCoreObject *self, PyObject *args) {
+    double other;
+    double *resData;
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixSubScalar(aF, (float) other, resF, rows, cols, rs, cs, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixSubScalar(a, other, resData, rows, cols, rs, cs, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixMulScalarReturn(MatrixCoreObject *self, PyObject *args) {
+    double other;
+    double *resData;
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixMulScalar(aF, (float) other, resF, rows, cols, rs, cs, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixMulScalar(a, other, resData, rows, cols, rs, cs, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixDivScalarReturn(MatrixCoreObject *self, PyObject *args) {
+    double other;
+    double *resData;
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "d|i", &other, &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    if (self->dtype == LpmFloat32) {
+        float *aF = self->dataF;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixDivScalar(aF, (float) other, resF, rows, cols, rs, cs, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    resData = allocateMemory(rows * cols);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    doubleMatrixDivScalar(a, other, resData, rows, cols, rs, cs, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyObject *res = (PyObject *) matrixNewC(resData, rows, cols, 0);
+
+    return res;
+}
+
+static PyObject *matrixFillScalar(MatrixCoreObject *self, PyObject *args) {
+    double scalar;
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "d|i", &scalar, &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixFillScalar(aF, (float) scalar, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixFillScalar(a, scalar, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixFillAscending(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixFillAscending(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixFillAscending(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixFillDescending(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixFillDescending(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixFillDescending(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixFillRandom(MatrixCoreObject *self, PyObject *args) {
+    double min = -1;
+    double max = 1;
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|ddi", &min, &max, &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    // randomRange seeds rand() on first use and draws from its global state, so the GIL stays held and two Python
+    // threads never fill at the same time
+    if (aF != NULL) {
+        floatMatrixFillRandomRange(aF, (float) min, (float) max, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixFillRandomRange(a, min, max, rows, cols, rs, cs, threads);
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Check an accuracy mode of the sigmoid, tanh and exp maps, ULM_MATH_FULL or ULM_MATH_FAST (see dvmath.h)
+static int matrixCheckMathMode(int mode) {
+    if (mode != ULM_MATH_FULL && mode != ULM_MATH_FAST) {
+        PyErr_SetString(PyExc_ValueError, "Invalid accuracy mode");
+        return -1;
+    }
+
+    return 0;
+}
+
+static PyObject *matrixMapSigmoid(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+    int mode = ULM_MATH_FULL;
+
+    if (!PyArg_ParseTuple(args, "|ii", &threads, &mode)) {
+        return NULL;
+    }
+
+    if (matrixCheckMathMode(mode) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapSigmoid(aF, rows, cols, rs, cs, mode, threads);
+    } else {
+        doubleMatrixMapSigmoid(a, rows, cols, rs, cs, mode, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapTanh(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+    int mode = ULM_MATH_FULL;
+
+    if (!PyArg_ParseTuple(args, "|ii", &threads, &mode)) {
+        return NULL;
+    }
+
+    if (matrixCheckMathMode(mode) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapTanh(aF, rows, cols, rs, cs, mode, threads);
+    } else {
+        doubleMatrixMapTanh(a, rows, cols, rs, cs, mode, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapExp(MatrixCoreObject *self, PyObject *args) {
+    int threads = 1;
+    int mode = ULM_MATH_FULL;
+
+    if (!PyArg_ParseTuple(args, "|ii", &threads, &mode)) {
+        return NULL;
+    }
+
+    if (matrixCheckMathMode(mode) != 0) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapExp(aF, rows, cols, rs, cs, mode, threads);
+    } else {
+        doubleMatrixMapExp(a, rows, cols, rs, cs, mode, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapRELU(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapRELU(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixMapRELU(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapLeakyRELU(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapLeakyRELU(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixMapLeakyRELU(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapSigmoidDerivative(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapSigmoidDerivative(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixMapSigmoidDerivative(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapTanhDerivative(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapTanhDerivative(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixMapTanhDerivative(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapRELUDerivative(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapRELUDerivative(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixMapRELUDerivative(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixMapLeakyRELUDerivative(MatrixCoreObject *self, PyObject *args) {
+    int threads = 8;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    double *a = self->data;
+    float *aF = self->dataF;
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    matrixInvalidatePack(self);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    if (aF != NULL) {
+        floatMatrixMapLeakyRELUDerivative(aF, rows, cols, rs, cs, threads);
+    } else {
+        doubleMatrixMapLeakyRELUDerivative(a, rows, cols, rs, cs, threads);
+    }
+    LPM_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *matrixToList(MatrixCoreObject *self, PyObject *args) {
+    PyObject *res = PyList_New(self->rows);
+    if (res != NULL) {
+        for (long i = 0; i < self->rows; i++) {
+            PyObject *row = PyList_New(self->cols);
+
+            if (row == NULL) {
+                return row;
+            }
+
+            for (long j = 0; j < self->cols; j++) {
+                long index = internalGet(i, j, self->rowStride, self->colStride);
+                double val = (self->dtype == LpmFloat32) ? self->dataF[index] : self->data[index];
+
+                PyList_SET_ITEM(row, j, Py_BuildValue("d", val));
+            }
+
+            PyList_SET_ITEM(res, i, row);
+        }
+    }
+
+    return res;
+}
+
+// Return a copy of the matrix holding values of the given type. Converting to float32 rounds every value to the nearest
+// float, and converting back to float64 is exact
+static PyObject *matrixAsType(MatrixCoreObject *self, PyObject *args) {
+    int dtype;
+    int threads = 1;
+
+    if (!PyArg_ParseTuple(args, "i|i", &dtype, &threads)) {
+        return NULL;
+    }
+
+    if (dtype != LpmFloat64 && dtype != LpmFloat32) {
+        PyErr_SetString(PyExc_ValueError, "Invalid datatype for matrix");
+        return NULL;
+    }
+
+    if (dtype == self->dtype) {
+        return matrixCopy(self);
+    }
+
+    long rows = self->rows, cols = self->cols, rs = self->rowStride, cs = self->colStride;
+
+    if (dtype == LpmFloat32) {
+        const double *a = self->data;
+        float *resF = allocateMemoryFloat(rows * cols);
+
+        if (resF == NULL) {
+            return NULL;
+        }
+
+        LPM_BEGIN_ALLOW_THREADS(rows * cols)
+        floatMatrixFromDouble(a, resF, rows, cols, rs, cs, threads);
+        LPM_END_ALLOW_THREADS
+
+        return (PyObject *) matrixNewCFloat(resF, rows, cols, 0);
+    }
+
+    const float *aF = self->dataF;
+    double *res = allocateMemory(rows * cols);
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+    floatMatrixToDouble(aF, res, rows, cols, rs, cs, threads);
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) matrixNewC(res, rows, cols, 0);
+}
+
+// ************************************************************************************************************************** //
+// ================================================== Sparse Matrix Class =================================================== //
+// ************************************************************************************************************************** //
+
+// Sparse float64 matrix in compressed sparse row (CSR) format. Row i holds values[p] in column columns[p] for
+// rowPointers[i] <= p < rowPointers[i + 1], and every other value is zero. The columns of each row are sorted and
+// unique, and the arrays are never changed once the matrix has been created
+typedef struct {
+    PyObject_HEAD
+
+    long int rows;
+    long int cols;
+    double *values;
+    int *columns;
+    long int *rowPointers;
+} SparseCoreObject;
+
+#define sparseNnz(self) ((self)->rowPointers[(self)->rows])
+
+static void sparseDealloc(SparseCoreObject *self) {
+    free(self->values);
+    free(self->columns);
+    free(self->rowPointers);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *sparseNew(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    SparseCoreObject *self;
+    self = (SparseCoreObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->rows = 0;
+        self->cols = 0;
+        self->values = NULL;
+        self->columns = NULL;
+        self->rowPointers = calloc(1, sizeof(long int));
+
+        if (self->rowPointers == NULL) {
+            Py_DECREF(self);
+            PyErr_SetString(PyExc_MemoryError, "Out of memory");
+            return NULL;
+        }
+    }
+
+    return (PyObject *) self;
+}
+
+// Wrap CSR arrays in a new sparse matrix, which takes ownership of them. The arrays are freed if the matrix could not be
+// created
+static SparseCoreObject *sparseNewC(double *values, int *columns, long int *rowPointers, long rows, long cols) {
+    SparseCoreObject *res;
+
+    res = PyObject_New(SparseCoreObject, &SparseCoreType);
+    if (res == NULL) {
+        free(values);
+        free(columns);
+        free(rowPointers);
+        return NULL;
+    }
+
+    res->rows = rows;
+    res->cols = cols;
+    res->values = values;
+    res->columns = columns;
+    res->rowPointers = rowPointers;
+
+    return res;
+}
+
+// Allocate the arrays of a sparse matrix with rows rows and nnz non-zero values. Returns -1 with a Python error, and
+// nothing allocated, if there is not enough memory
+static int sparseAllocate(long rows, long nnz, double **values, int **columns, long int **rowPointers) {
+    *values = malloc(sizeof(double) * (nnz > 0 ? nnz : 1));
+    *columns = malloc(sizeof(int) * (nnz > 0 ? nnz : 1));
+    *rowPointers = malloc(sizeof(long int) * (rows + 1));
+
+    if (*values == NULL || *columns == NULL || *rowPointers == NULL) {
+        free(*values);
+        free(*columns);
+        free(*rowPointers);
+        PyErr_SetString(PyExc_MemoryError, "There was not enough memory to allocate a sparse matrix of this size");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Raise a ValueError and return -1 unless a matrix with the given shape can be stored. The column indices are stored
+// in an int to save memory bandwidth in the products
+static int sparseCheckShape(long rows, long cols) {
+    if (rows < 0 || cols < 0) {
+        PyErr_SetString(PyExc_ValueError, "Sparse matrix must have non-negative dimensions");
+        return -1;
+    }
+
+    if (cols > INT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "Sparse matrix has too many columns");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Create a rows x cols sparse matrix from the CSR arrays given as Python sequences of values, column indices and row
+// pointers. The arrays are checked for consistency, so that no product can read out of bounds
+static int sparseInit(SparseCoreObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *valuesIn, *columnsIn, *rowPointersIn;
+    PyObject *seqValues = NULL, *seqColumns = NULL, *seqRowPointers = NULL;
+    double *values = NULL;
+    int *columns = NULL;
+    long int *rowPointers = NULL;
+    long rows, cols, nnz, i, p, column;
+
+    if (!PyArg_ParseTuple(args, "llOOO", &rows, &cols, &valuesIn, &columnsIn, &rowPointersIn))
+        return -1;
+
+    if (sparseCheckShape(rows, cols) != 0) {
+        return -1;
+    }
+
+    seqValues = PySequence_Fast(valuesIn, "Sparse matrix values must be a list");
+    seqColumns = seqValues ? PySequence_Fast(columnsIn, "Sparse matrix columns must be a list") : NULL;
+    seqRowPointers = seqColumns ? PySequence_Fast(rowPointersIn, "Sparse matrix row pointers must be a list") : NULL;
+    if (seqRowPointers == NULL) {
+        goto error;
+    }
+
+    nnz = PySequence_Fast_GET_SIZE(seqValues);
+    if (PySequence_Fast_GET_SIZE(seqColumns) != nnz || PySequence_Fast_GET_SIZE(seqRowPointers) != rows + 1) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Sparse matrix needs as many columns as values and one more row pointer than rows");
+        goto error;
+    }
+
+    if (sparseAllocate(rows, nnz, &values, &columns, &rowPointers) != 0) {
+        goto error;
+    }
+
+    for (i = 0; i <= rows; i++) {
+        rowPointers[i] = PyLong_AsLong(PySequence_Fast_GET_ITEM(seqRowPointers, i));
+        if (rowPointers[i] == -1 && PyErr_Occurred()) {
+            goto error;
+        }
+
+        if ((i == 0 && rowPointers[i] != 0) || (i > 0 && rowPointers[i] < rowPointers[i - 1]) || rowPointers[i] > nnz) {
+            PyErr_SetString(PyExc_ValueError, "Sparse matrix row pointers must rise from 0 to the number of values");
+            goto error;
+        }
+    }
+
+    if (rowPointers[rows] != nnz) {
+        PyErr_SetString(PyExc_ValueError, "Sparse matrix row pointers must rise from 0 to the number of values");
+        goto error;
+    }
+
+    for (i = 0; i < rows; i++) {
+        for (p = rowPointers[i]; p < rowPointers[i + 1]; p++) {
+            values[p] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seqValues, p));
+            column = PyLong_AsLong(PySequence_Fast_GET_ITEM(seqColumns, p));
+            if (PyErr_Occurred()) {
+                goto error;
+            }
+
+            if (column < 0 || column >= cols || (p > rowPointers[i] && column <= columns[p - 1])) {
+                PyErr_SetString(PyExc_ValueError, "Sparse matrix columns must be in range and rise along each row");
+                goto error;
+            }
+            columns[p] = (int) column;
+        }
+    }
+
+    free(self->values);
+    free(self->columns);
+    free(self->rowPointers);
+    self->rows = rows;
+    self->cols = cols;
+    self->values = values;
+    self->columns = columns;
+    self->rowPointers = rowPointers;
+
+    Py_DECREF(seqValues);
+    Py_DECREF(seqColumns);
+    Py_DECREF(seqRowPointers);
+    return 0;
+
+error:
+    free(values);
+    free(columns);
+    free(rowPointers);
+    Py_XDECREF(seqValues);
+    Py_XDECREF(seqColumns);
+    Py_XDECREF(seqRowPointers);
+    return -1;
+}
+
+static PyObject *sparseToString(SparseCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyUnicode_FromFormat("SparseMatrix(rows = %ld, cols = %ld, nnz = %ld)", self->rows, self->cols,
+                                sparseNnz(self));
+}
+
+static PyObject *sparseGetRows(SparseCoreObject *self, void *closure) {
+    return PyLong_FromLong(self->rows);
+}
+
+static PyObject *sparseGetCols(SparseCoreObject *self, void *closure) {
+    return PyLong_FromLong(self->cols);
+}
+
+static PyObject *sparseGetNnz(SparseCoreObject *self, void *closure) {
+    return PyLong_FromLong(sparseNnz(self));
+}
+
+// Convert a float64 matrix to a sparse matrix holding its non-zero values. The non-zero values of each row are counted
+// first, so the arrays are allocated once at their final size and every row is then filled in parallel
+static PyObject *sparseFromDense(PyObject *self, PyObject *args) {
+    MatrixCoreObject *mat;
+    double *values;
+    int *columns;
+    long int *rowPointers, *counts;
+    int threads = 1;
+    long i, j, nnz;
+
+    if (!PyArg_ParseTuple(args, "O!|i", &MatrixCoreType, &mat, &threads)) {
+        return NULL;
+    }
+
+    if (mat->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Only float64 matrices can be converted to sparse matrices");
+        return NULL;
+    }
+
+    long rows = mat->rows, cols = mat->cols, rs = mat->rowStride, cs = mat->colStride;
+    const double *a = mat->data;
+
+    if (sparseCheckShape(rows, cols) != 0) {
+        return NULL;
+    }
+
+    counts = malloc(sizeof(long int) * (rows + 1));
+    if (counts == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "Out of memory");
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+#   pragma omp parallel for private(j) num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        long count = 0;
+
+        for (j = 0; j < cols; j++) {
+            count += a[internalGet(i, j, rs, cs)] != 0.0;
+        }
+        counts[i + 1] = count;
+    }
+    LPM_END_ALLOW_THREADS
+
+    counts[0] = 0;
+    for (i = 0; i < rows; i++) {
+        counts[i + 1] += counts[i];
+    }
+    nnz = counts[rows];
+
+    if (sparseAllocate(rows, nnz, &values, &columns, &rowPointers) != 0) {
+        free(counts);
+        return NULL;
+    }
+    memcpy(rowPointers, counts, sizeof(long int) * (rows + 1));
+    free(counts);
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+#   pragma omp parallel for private(j) num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        long p = rowPointers[i];
+
+        for (j = 0; j < cols; j++) {
+            double val = a[internalGet(i, j, rs, cs)];
+
+            if (val != 0.0) {
+                values[p] = val;
+                columns[p] = (int) j;
+                p++;
+            }
+        }
+    }
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) sparseNewC(values, columns, rowPointers, rows, cols);
+}
+
+// Convert the sparse matrix to a row major float64 matrix, with zeros everywhere but at the stored values
+static PyObject *sparseToDense(SparseCoreObject *self, PyObject *args) {
+    double *res;
+    int threads = 1;
+    long i, p;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    long rows = self->rows, cols = self->cols;
+    const double *values = self->values;
+    const int *columns = self->columns;
+    const long int *rowPointers = self->rowPointers;
+
+    res = allocateMemory(rows * cols);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(rows * cols)
+#   pragma omp parallel for private(p) num_threads(threads > 1 ? threads : 1) if(rows * cols >= 90000)
+    for (i = 0; i < rows; i++) {
+        double *row = &res[i * cols];
+
+        memset(row, 0, sizeof(double) * cols);
+        for (p = rowPointers[i]; p < rowPointers[i + 1]; p++) {
+            row[columns[p]] = values[p];
+        }
+    }
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) matrixNewC(res, rows, cols, 0);
+}
+
+static PyObject *sparseTranspose(SparseCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    double *values;
+    int *columns;
+    long int *rowPointers;
+
+    if (sparseCheckShape(self->cols, self->rows) != 0) {
+        return NULL;
+    }
+
+    if (sparseAllocate(self->cols, sparseNnz(self), &values, &columns, &rowPointers) != 0) {
+        return NULL;
+    }
+
+    ulm_dcsr_transpose(self->rows, self->cols, self->values, self->columns, self->rowPointers,
+                       values, columns, rowPointers);
+
+    return (PyObject *) sparseNewC(values, columns, rowPointers, self->cols, self->rows);
+}
+
+// Return the CSR arrays of the matrix as a tuple of three lists: the values, their columns and the row pointers
+static PyObject *sparseToLists(SparseCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    long nnz = sparseNnz(self);
+    PyObject *values = PyList_New(nnz);
+    PyObject *columns = PyList_New(nnz);
+    PyObject *rowPointers = PyList_New(self->rows + 1);
+    long i;
+
+    if (values == NULL || columns == NULL || rowPointers == NULL) {
+        Py_XDECREF(values);
+        Py_XDECREF(columns);
+        Py_XDECREF(rowPointers);
+        return NULL;
+    }
+
+    for (i = 0; i < nnz; i++) {
+        PyList_SET_ITEM(values, i, PyFloat_FromDouble(self->values[i]));
+        PyList_SET_ITEM(columns, i, PyLong_FromLong(self->columns[i]));
+    }
+
+    for (i = 0; i <= self->rows; i++) {
+        PyList_SET_ITEM(rowPointers, i, PyLong_FromLong(self->rowPointers[i]));
+    }
+
+    return Py_BuildValue("(NNN)", values, columns, rowPointers);
+}
+
+// Calculate act(alpha * self @ op(other) + bias) for a dense float64 matrix other, where op transposes other if trans
+// is set. Only the non-zero values of self are read, so the product costs O(nnz) per column of the result. A single
+// column is computed as a sparse matrix-vector product
+static PyObject *sparseProduct(SparseCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    PyObject *bias = Py_None;
+    const struct ulm_epilogue *ep;
+    struct ulm_epilogue epilogue;
+    struct ulm_sepilogue epilogueF;
+    double *res;
+    double alpha = 1.0;
+    int threads = 1;
+    int trans = 0;
+    int activation = 0;
+    int status;
+
+    if (!PyArg_ParseTuple(args, "O!|ipdOi", &MatrixCoreType, &other, &threads, &trans, &alpha, &bias, &activation)) {
+        return NULL;
+    }
+
+    long M = self->rows;
+    long N = self->cols;
+    long K = trans ? other->rows : other->cols;
+    long rsB = trans ? other->colStride : other->rowStride;
+    long csB = trans ? other->rowStride : other->colStride;
+    const double *values = self->values;
+    const int *columns = self->columns;
+    const long int *rowPointers = self->rowPointers;
+    const double *b = other->data;
+
+    if (N != (trans ? other->cols : other->rows)) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix product");
+        return NULL;
+    }
+
+    if (other->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Sparse matrix products are only implemented for float64 matrices");
+        return NULL;
+    }
+
+    status = parseEpilogue(bias, activation, M, K, LpmFloat64, &epilogue, &epilogueF);
+    if (status < 0) {
+        return NULL;
+    }
+    ep = (status > 0) ? &epilogue : NULL;
+
+    res = allocateMemory(M * K);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS((sparseNnz(self) + M) * K)
+    ULMBLAS(dcsrmm)(M, K, alpha, values, columns, rowPointers, b, rsB, csB, 0.0, res, K, 1, threads);
+    ulm_epilogue_apply(ep, M, K, 0, 0, res, K, 1);
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) matrixNewC(res, M, K, 0);
+}
+
+// Calculate act(alpha * op(other) @ self + bias) for a dense float64 matrix other, where op transposes other if trans
+// is set. Every row of the result is gathered from the rows of self picked out by the non-zero values of a row of
+// other
+static PyObject *sparseProductLeft(SparseCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    PyObject *bias = Py_None;
+    const struct ulm_epilogue *ep;
+    struct ulm_epilogue epilogue;
+    struct ulm_sepilogue epilogueF;
+    double *res;
+    double alpha = 1.0;
+    int threads = 1;
+    int trans = 0;
+    int activation = 0;
+    int status;
+
+    if (!PyArg_ParseTuple(args, "O!|ipdOi", &MatrixCoreType, &other, &threads, &trans, &alpha, &bias, &activation)) {
+        return NULL;
+    }
+
+    long M = trans ? other->cols : other->rows;
+    long N = trans ? other->rows : other->cols;
+    long K = self->cols;
+    long rsA = trans ? other->colStride : other->rowStride;
+    long csA = trans ? other->rowStride : other->colStride;
+    const double *values = self->values;
+    const int *columns = self->columns;
+    const long int *rowPointers = self->rowPointers;
+    const double *a = other->data;
+
+    if (N != self->rows) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix product");
+        return NULL;
+    }
+
+    if (other->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Sparse matrix products are only implemented for float64 matrices");
+        return NULL;
+    }
+
+    status = parseEpilogue(bias, activation, M, K, LpmFloat64, &epilogue, &epilogueF);
+    if (status < 0) {
+        return NULL;
+    }
+    ep = (status > 0) ? &epilogue : NULL;
+
+    res = allocateMemory(M * K);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS((sparseNnz(self) + N) * M)
+    ULMBLAS(dgecsrmm)(M, K, N, alpha, a, rsA, csA, values, columns, rowPointers, 0.0, res, K, 1, threads);
+    ulm_epilogue_apply(ep, M, K, 0, 0, res, K, 1);
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) matrixNewC(res, M, K, 0);
+}
+
+// ************************************************************************************************************************** //
+// ================================================== Packed Matrix Class =================================================== //
+// ************************************************************************************************************************** //
+
+// Square float64 matrix that is symmetric, lower triangular or upper triangular, with only one triangle stored in
+// n * (n + 1) / 2 values. Row i of the lower triangle is kept at values[i * (i + 1) / 2], and an upper triangular matrix
+// is stored as its transpose (see dpackmm.h), so the same layout serves every kind
+typedef struct {
+    PyObject_HEAD
+
+    long int n;
+    int kind;
+    double *values;
+} PackedCoreObject;
+
+#define packedLength(self) ulm_dpack_length((self)->n)
+
+static void packedDealloc(PackedCoreObject *self) {
+    free(self->values);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *packedNew(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    PackedCoreObject *self;
+    self = (PackedCoreObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->n = 0;
+        self->kind = ULM_PACKED_SYMMETRIC;
+        self->values = NULL;
+    }
+
+    return (PyObject *) self;
+}
+
+// Wrap packed values in a new packed matrix, which takes ownership of them. The values are freed if the matrix could not
+// be created
+static PackedCoreObject *packedNewC(double *values, long n, int kind) {
+    PackedCoreObject *res;
+
+    res = PyObject_New(PackedCoreObject, &PackedCoreType);
+    if (res == NULL) {
+        free(values);
+        return NULL;
+    }
+
+    res->n = n;
+    res->kind = kind;
+    res->values = values;
+
+    return res;
+}
+
+// Raise a ValueError and return -1 unless kind is one of ULM_PACKED_SYMMETRIC, ULM_PACKED_LOWER and ULM_PACKED_UPPER
+static int packedCheckKind(int kind) {
+    if (kind != ULM_PACKED_SYMMETRIC && kind != ULM_PACKED_LOWER && kind != ULM_PACKED_UPPER) {
+        PyErr_SetString(PyExc_ValueError, "Packed matrix must be symmetric, lower triangular or upper triangular");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Create an n x n packed matrix of the given kind from a Python sequence of the n * (n + 1) / 2 stored values
+static int packedInit(PackedCoreObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *valuesIn, *seqValues;
+    double *values;
+    long n, i;
+    int kind = ULM_PACKED_SYMMETRIC;
+
+    if (!PyArg_ParseTuple(args, "lO|i", &n, &valuesIn, &kind))
+        return -1;
+
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, "Packed matrix must have non-negative dimensions");
+        return -1;
+    }
+
+    if (packedCheckKind(kind) != 0) {
+        return -1;
+    }
+
+    seqValues = PySequence_Fast(valuesIn, "Packed matrix values must be a list");
+    if (seqValues == NULL) {
+        return -1;
+    }
+
+    if (PySequence_Fast_GET_SIZE(seqValues) != ulm_dpack_length(n)) {
+        PyErr_SetString(PyExc_ValueError, "Packed matrix needs n * (n + 1) / 2 values");
+        Py_DECREF(seqValues);
+        return -1;
+    }
+
+    values = allocateMemory(ulm_dpack_length(n) > 0 ? ulm_dpack_length(n) : 1);
+    if (values == NULL) {
+        Py_DECREF(seqValues);
+        return -1;
+    }
+
+    for (i = 0; i < ulm_dpack_length(n); i++) {
+        values[i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seqValues, i));
+    }
+    Py_DECREF(seqValues);
+
+    if (PyErr_Occurred()) {
+        free(values);
+        return -1;
+    }
+
+    free(self->values);
+    self->n = n;
+    self->kind = kind;
+    self->values = values;
+
+    return 0;
+}
+
+static PyObject *packedToString(PackedCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    static const char *kinds[] = {"symmetric", "lower", "upper"};
+    return PyUnicode_FromFormat("PackedMatrix(n = %ld, kind = %s)", self->n, kinds[self->kind]);
+}
+
+static PyObject *packedGetRows(PackedCoreObject *self, void *closure) {
+    return PyLong_FromLong(self->n);
+}
+
+static PyObject *packedGetKind(PackedCoreObject *self, void *closure) {
+    return PyLong_FromLong(self->kind);
+}
+
+// Convert a square float64 matrix to a packed matrix of the given kind, keeping its lower triangle if it is symmetric or
+// lower triangular and its upper triangle if it is upper triangular. The other triangle is not read
+static PyObject *packedFromDense(PyObject *self, PyObject *args) {
+    MatrixCoreObject *mat;
+    double *values;
+    int kind = ULM_PACKED_SYMMETRIC;
+    int threads = 1;
+
+    if (!PyArg_ParseTuple(args, "O!|ii", &MatrixCoreType, &mat, &kind, &threads)) {
+        return NULL;
+    }
+
+    if (mat->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Only float64 matrices can be converted to packed matrices");
+        return NULL;
+    }
+
+    if (mat->rows != mat->cols) {
+        PyErr_SetString(PyExc_ValueError, "Matrix must be square to be packed");
+        return NULL;
+    }
+
+    if (packedCheckKind(kind) != 0) {
+        return NULL;
+    }
+
+    long n = mat->rows, rs = mat->rowStride, cs = mat->colStride;
+    const double *a = mat->data;
+
+    values = allocateMemory(n > 0 ? ulm_dpack_length(n) : 1);
+    if (values == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(ulm_dpack_length(n))
+    ulm_dpack_pack(kind, n, a, rs, cs, values, threads);
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) packedNewC(values, n, kind);
+}
+
+// Expand the packed matrix into a row major float64 matrix, mirroring a symmetric matrix and filling the empty triangle
+// of a triangular matrix with zeros
+static PyObject *packedToDense(PackedCoreObject *self, PyObject *args) {
+    double *res;
+    int threads = 1;
+
+    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+        return NULL;
+    }
+
+    long n = self->n;
+    int kind = self->kind;
+    const double *values = self->values;
+
+    res = allocateMemory(n * n);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(n * n)
+    ulm_dpack_unpack(kind, n, values, res, n, 1, threads);
+    LPM_END_ALLOW_THREADS
+
+    return (PyObject *) matrixNewC(res, n, n, 0);
+}
+
+// Return the stored values of the matrix as a list, row by row through the stored triangle
+static PyObject *packedToList(PackedCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    long length = packedLength(self);
+    PyObject *res = PyList_New(length);
+    long i;
+
+    if (res == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < length; i++) {
+        PyList_SET_ITEM(res, i, PyFloat_FromDouble(self->values[i]));
+    }
+
+    return res;
+}
+
+// Return the transpose of the matrix. Upper triangular matrices are stored as their transpose, so this copies the values
+// and swaps the lower and upper kinds
+static PyObject *packedTranspose(PackedCoreObject *self, PyObject *Py_UNUSED(ignored)) {
+    long length = packedLength(self);
+    double *values = allocateMemory(length > 0 ? length : 1);
+
+    if (values == NULL) {
+        return NULL;
+    }
+
+    memcpy(values, self->values, sizeof(double) * length);
+
+    return (PyObject *) packedNewC(values, self->n,
+                                   self->kind == ULM_PACKED_LOWER ? ULM_PACKED_UPPER :
+                                   self->kind == ULM_PACKED_UPPER ? ULM_PACKED_LOWER : ULM_PACKED_SYMMETRIC);
+}
+
+// Calculate act(alpha * self @ op(other) + bias) for a dense float64 matrix other, where op transposes other if trans
+// is set. The stored triangle is read once per block of rows of the result, and a single column is computed as a
+// packed matrix-vector product
+static PyObject *packedProduct(PackedCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    PyObject *bias = Py_None;
+    const struct ulm_epilogue *ep;
+    struct ulm_epilogue epilogue;
+    struct ulm_sepilogue epilogueF;
+    double *res;
+    double alpha = 1.0;
+    int threads = 1;
+    int trans = 0;
+    int activation = 0;
+    int status;
+
+    if (!PyArg_ParseTuple(args, "O!|ipdOi", &MatrixCoreType, &other, &threads, &trans, &alpha, &bias, &activation)) {
+        return NULL;
+    }
+
+    long M = self->n;
+    long K = trans ? other->rows : other->cols;
+    long rsB = trans ? other->colStride : other->rowStride;
+    long csB = trans ? other->rowStride : other->colStride;
+    int kind = self->kind;
+    const double *values = self->values;
+    const double *b = other->data;
+
+    if (M != (trans ? other->cols : other->rows)) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix product");
+        return NULL;
+    }
+
+    if (other->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Packed matrix products are only implemented for float64 matrices");
+        return NULL;
+    }
+
+    status = parseEpilogue(bias, activation, M, K, LpmFloat64, &epilogue, &epilogueF);
+    if (status < 0) {
+        return NULL;
+    }
+    ep = (status > 0) ? &epilogue : NULL;
+
+    res = allocateMemory(M * K);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(M * M * K)
+    status = ULMBLAS(dpackmm)(kind, M, K, alpha, values, b, rsB, csB, 0.0, res, K, 1, threads);
+    if (status == 0) {
+        ulm_epilogue_apply(ep, M, K, 0, 0, res, K, 1);
+    }
+    LPM_END_ALLOW_THREADS
+
+    if (status != 0) {
+        free(res);
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+        return NULL;
+    }
+
+    return (PyObject *) matrixNewC(res, M, K, 0);
+}
+
+// Calculate act(alpha * op(other) @ self + bias) for a dense float64 matrix other, where op transposes other if trans
+// is set. Every row of the stored triangle is read once per block of rows of other
+static PyObject *packedProductLeft(PackedCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    PyObject *bias = Py_None;
+    const struct ulm_epilogue *ep;
+    struct ulm_epilogue epilogue;
+    struct ulm_sepilogue epilogueF;
+    double *res;
+    double alpha = 1.0;
+    int threads = 1;
+    int trans = 0;
+    int activation = 0;
+    int status;
+
+    if (!PyArg_ParseTuple(args, "O!|ipdOi", &MatrixCoreType, &other, &threads, &trans, &alpha, &bias, &activation)) {
+        return NULL;
+    }
+
+    long M = trans ? other->cols : other->rows;
+    long N = self->n;
+    long rsA = trans ? other->colStride : other->rowStride;
+    long csA = trans ? other->rowStride : other->colStride;
+    int kind = self->kind;
+    const double *values = self->values;
+    const double *a = other->data;
+
+    if (N != (trans ? other->rows : other->cols)) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix product");
+        return NULL;
+    }
+
+    if (other->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Packed matrix products are only implemented for float64 matrices");
+        return NULL;
+    }
+
+    status = parseEpilogue(bias, activation, M, N, LpmFloat64, &epilogue, &epilogueF);
+    if (status < 0) {
+        return NULL;
+    }
+    ep = (status > 0) ? &epilogue : NULL;
+
+    res = allocateMemory(M * N);
+    if (res == NULL) {
+        return NULL;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(M * N * N)
+    status = ULMBLAS(dgepackmm)(kind, M, N, alpha, a, rsA, csA, values, 0.0, res, N, 1, threads);
+    if (status == 0) {
+        ulm_epilogue_apply(ep, M, N, 0, 0, res, N, 1);
+    }
+    LPM_END_ALLOW_THREADS
+
+    if (status != 0) {
+        free(res);
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+        return NULL;
+    }
+
+    return (PyObject *) matrixNewC(res, M, N, 0);
+}
+
+// Operations on the stored values of packed matrices. Every one of them keeps the empty triangle of a triangular matrix
+// at zero, or is applied to a symmetric matrix, so the result is a packed matrix of the same kind
+#define PACKED_ADD 0
+#define PACKED_SUB 1
+#define PACKED_MUL 2
+#define PACKED_DIV 3
+
+// Combine the stored values of two packed matrices of the same kind and size elementwise with PACKED_ADD, PACKED_SUB or
+// PACKED_MUL, reading only n * (n + 1) / 2 values of each
+static PyObject *packedElementwise(PackedCoreObject *self, PyObject *args) {
+    PackedCoreObject *other;
+    double *res;
+    int op = PACKED_ADD;
+    int threads = 1;
+    long i;
+
+    if (!PyArg_ParseTuple(args, "O!i|i", &PackedCoreType, &other, &op, &threads)) {
         return NULL;
     }
 
-    doubleMatrixMapLeakyRELU(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    if (self->n != other->n || self->kind != other->kind) {
+        PyErr_SetString(PyExc_ValueError, "Packed matrices must have the same size and kind");
+        return NULL;
+    }
 
-    Py_RETURN_NONE;
-}
+    if (op != PACKED_ADD && op != PACKED_SUB && op != PACKED_MUL) {
+        PyErr_SetString(PyExc_ValueError, "Invalid operation for packed matrices");
+        return NULL;
+    }
 
-static PyObject *matrixMapSigmoidDerivative(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+    long length = packedLength(self);
+    const double *a = self->values, *b = other->values;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    res = allocateMemory(length > 0 ? length : 1);
+    if (res == NULL) {
         return NULL;
     }
 
-    doubleMatrixMapSigmoidDerivative(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    LPM_BEGIN_ALLOW_THREADS(length)
+#   pragma omp parallel for num_threads(threads > 1 ? threads : 1) if(length >= 90000)
+    for (i = 0; i < length; i++) {
+        res[i] = op == PACKED_ADD ? a[i] + b[i] : op == PACKED_SUB ? a[i] - b[i] : a[i] * b[i];
+    }
+    LPM_END_ALLOW_THREADS
 
-    Py_RETURN_NONE;
+    return (PyObject *) packedNewC(res, self->n, self->kind);
 }
 
-static PyObject *matrixMapTanhDerivative(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+// Apply a scalar to every stored value with PACKED_ADD, PACKED_SUB, PACKED_MUL or PACKED_DIV. Adding or subtracting a
+// scalar would fill the empty triangle of a triangular matrix, so those are only allowed for symmetric matrices
+static PyObject *packedScalar(PackedCoreObject *self, PyObject *args) {
+    double *res;
+    double scalar;
+    int op = PACKED_MUL;
+    int threads = 1;
+    long i;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (!PyArg_ParseTuple(args, "di|i", &scalar, &op, &threads)) {
         return NULL;
     }
 
-    doubleMatrixMapTanhDerivative(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    if (op < PACKED_ADD || op > PACKED_DIV) {
+        PyErr_SetString(PyExc_ValueError, "Invalid operation for packed matrices");
+        return NULL;
+    }
 
-    Py_RETURN_NONE;
-}
+    if ((op == PACKED_ADD || op == PACKED_SUB) && self->kind != ULM_PACKED_SYMMETRIC) {
+        PyErr_SetString(PyExc_ValueError, "Adding a scalar to a triangular matrix does not give a triangular matrix");
+        return NULL;
+    }
 
-static PyObject *matrixMapRELUDerivative(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+    long length = packedLength(self);
+    const double *a = self->values;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    res = allocateMemory(length > 0 ? length : 1);
+    if (res == NULL) {
         return NULL;
     }
 
-    doubleMatrixMapRELUDerivative(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    if (op == PACKED_SUB) {
+        scalar = -scalar;
+    } else if (op == PACKED_DIV) {
+        scalar = 1.0 / scalar;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(length)
+#   pragma omp parallel for num_threads(threads > 1 ? threads : 1) if(length >= 90000)
+    for (i = 0; i < length; i++) {
+        res[i] = (op == PACKED_ADD || op == PACKED_SUB) ? a[i] + scalar : a[i] * scalar;
+    }
+    LPM_END_ALLOW_THREADS
 
-    Py_RETURN_NONE;
+    return (PyObject *) packedNewC(res, self->n, self->kind);
 }
 
-static PyObject *matrixMapLeakyRELUDerivative(MatrixCoreObject *self, PyObject *args) {
-    int threads = 8;
+// Calculate beta * other + alpha * self for a dense float64 matrix other, reading each element of self straight from
+// the packed values. The result is a dense matrix
+static PyObject *packedAddDense(PackedCoreObject *self, PyObject *args) {
+    MatrixCoreObject *other;
+    double *res;
+    double alpha = 1.0;
+    double beta = 1.0;
+    int threads = 1;
+    long i;
 
-    if (!PyArg_ParseTuple(args, "|i", &threads)) {
+    if (!PyArg_ParseTuple(args, "O!|ddi", &MatrixCoreType, &other, &alpha, &beta, &threads)) {
         return NULL;
     }
 
-    doubleMatrixMapLeakyRELUDerivative(self->data, self->rows, self->cols, self->rowStride, self->colStride, threads);
+    if (other->rows != self->n || other->cols != self->n) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix addition");
+        return NULL;
+    }
 
-    Py_RETURN_NONE;
-}
+    if (other->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Packed matrices can only be added to float64 matrices");
+        return NULL;
+    }
 
-static PyObject *matrixToList(MatrixCoreObject *self, PyObject *args) {
-    PyObject *res = PyList_New(self->rows);
-    if (res != NULL) {
-        for (long i = 0; i < self->rows; i++) {
-            PyObject *row = PyList_New(self->cols);
+    long n = self->n, rs = other->rowStride, cs = other->colStride;
+    int kind = self->kind;
+    const double *a = self->values, *b = other->data;
 
-            if (row == NULL) {
-                return row;
-            }
+    res = allocateMemory(n * n);
+    if (res == NULL) {
+        return NULL;
+    }
 
-            for (long j = 0; j < self->cols; j++) {
-                PyList_SET_ITEM(row, j, Py_BuildValue("d", self->data[internalGet(i, j, self->rowStride, self->colStride)]));
-            }
+    LPM_BEGIN_ALLOW_THREADS(n * n)
+    ulm_dpack_unpack(kind, n, a, res, n, 1, threads);
 
-            PyList_SET_ITEM(res, i, row);
+#   pragma omp parallel for num_threads(threads > 1 ? threads : 1) if(n * n >= 90000)
+    for (i = 0; i < n; i++) {
+        long j;
+
+        for (j = 0; j < n; j++) {
+            res[i * n + j] = beta * b[internalGet(i, j, rs, cs)] + alpha * res[i * n + j];
         }
     }
+    LPM_END_ALLOW_THREADS
 
-    return res;
+    return (PyObject *) matrixNewC(res, n, n, 0);
 }
 
 // ************************************************************************************************************************** //
 // ==================================================== Matrix Functions ==================================================== //
 // ************************************************************************************************************************** //
 
+// Wrap a row major buffer of values read from Python in a matrix of the given type, converting them to float32 if asked
+// to. Takes ownership of data
+static PyObject *matrixFromDoubles(double *data, long rows, long cols, int dtype) {
+    float *dataF;
+
+    if (dtype == LpmFloat64) {
+        return (PyObject *) matrixNewC(data, rows, cols, 0);
+    }
+
+    if (dtype != LpmFloat32) {
+        free(data);
+        PyErr_SetString(PyExc_ValueError, "Invalid datatype for matrix");
+        return NULL;
+    }
+
+    dataF = allocateMemoryFloat(rows * cols);
+    if (dataF == NULL) {
+        free(data);
+        return NULL;
+    }
+
+    floatMatrixFromDouble(data, dataF, rows, cols, cols, 1, 1);
+    free(data);
+
+    return (PyObject *) matrixNewCFloat(dataF, rows, cols, 0);
+}
+
 static PyObject *matrixFromData2D(MatrixCoreObject *self, PyObject *args) {
     PyObject *matrix;
     double *matrixData;
     long rows = -1;
     long cols = -1;
+    int dtype = LpmFloat64;
 
-    if (!PyArg_ParseTuple(args, "Oll", &matrix, &rows, &cols))
+    if (!PyArg_ParseTuple(args, "Oll|i", &matrix, &rows, &cols, &dtype))
         return NULL;
 
     if (rows < 0 || cols < 0)
@@ -633,7 +3071,7 @@ static PyObject *matrixFromData2D(MatrixCoreObject *self, PyObject *args) {
         }
     }
 
-    return (PyObject *) matrixNewC(matrixData, rows, cols, 0);
+    return matrixFromDoubles(matrixData, rows, cols, dtype);
 }
 
 static PyObject *matrixFromData1D(MatrixCoreObject *self, PyObject *args) {
@@ -641,8 +3079,9 @@ static PyObject *matrixFromData1D(MatrixCoreObject *self, PyObject *args) {
     double *matrixData;
     long rows = -1;
     long cols = -1;
+    int dtype = LpmFloat64;
 
-    if (!PyArg_ParseTuple(args, "Oll", &matrix, &rows, &cols))
+    if (!PyArg_ParseTuple(args, "Oll|i", &matrix, &rows, &cols, &dtype))
         return NULL;
 
     if (rows < 0 || cols < 0)
@@ -668,7 +3107,401 @@ static PyObject *matrixFromData1D(MatrixCoreObject *self, PyObject *args) {
         }
     }
 
-    return (PyObject *) matrixNewC(matrixData, rows, cols, 0);
+    return matrixFromDoubles(matrixData, rows, cols, dtype);
+}
+
+// One product of a batch, with everything it needs copied out of the Python objects
+typedef struct {
+    long M, N, K;
+    const double *a;
+    long rsA, csA;
+    const double *b;
+    long rsB, csB;
+    double *c;
+} ProductTask;
+
+// Run a batch of independent products C = A @ B into freshly allocated row major results. A batch with at least as
+// many products as threads gives each thread whole products, otherwise the products run one after another and each
+// one is threaded itself. Returns 0 on success and -1 if any product could not allocate its buffers
+static int runProductBatch(ProductTask *tasks, long count, int threads) {
+    long i;
+    int status = 0;
+
+    if (count >= threads && threads > 1) {
+#       pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(|:status)
+        for (i = 0; i < count; i++) {
+            ProductTask *t = &tasks[i];
+            status |= computeProduct(t->M, t->N, t->K, 1.0, t->a, t->rsA, t->csA, t->b, t->rsB, t->csB,
+                                     0.0, t->c, t->K, 1, 1, NULL, NULL, -1);
+        }
+    } else {
+        for (i = 0; i < count; i++) {
+            ProductTask *t = &tasks[i];
+            status |= computeProduct(t->M, t->N, t->K, 1.0, t->a, t->rsA, t->csA, t->b, t->rsB, t->csB,
+                                     0.0, t->c, t->K, 1, threads, NULL, NULL, -1);
+        }
+    }
+
+    return status == 0 ? 0 : -1;
+}
+
+// Calculate op(A[i]) @ op(B[i]) for every pair of matrices in two equal length lists, and return a list of the results.
+// The whole batch runs without the GIL and is spread over the threads
+static PyObject *matrixProductBatched(PyObject *self, PyObject *args) {
+    PyObject *listA, *listB, *seqA = NULL, *seqB = NULL, *res = NULL;
+    ProductTask *tasks = NULL;
+    long count = 0, work = 0, i;
+    int threads = 1;
+    int transA = 0;
+    int transB = 0;
+    int status;
+
+    if (!PyArg_ParseTuple(args, "OO|ipp", &listA, &listB, &threads, &transA, &transB))
+        return NULL;
+
+    seqA = PySequence_Fast(listA, "Batched matrix product requires a list of matrices");
+    seqB = seqA ? PySequence_Fast(listB, "Batched matrix product requires a list of matrices") : NULL;
+    if (seqB == NULL) {
+        goto error;
+    }
+
+    count = PySequence_Fast_GET_SIZE(seqA);
+    if (count != PySequence_Fast_GET_SIZE(seqB)) {
+        PyErr_SetString(PyExc_ValueError, "Batched matrix product requires two lists of the same length");
+        goto error;
+    }
+
+    tasks = PyMem_Calloc(count > 0 ? count : 1, sizeof(ProductTask));
+    if (tasks == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    for (i = 0; i < count; i++) {
+        PyObject *itemA = PySequence_Fast_GET_ITEM(seqA, i);
+        PyObject *itemB = PySequence_Fast_GET_ITEM(seqB, i);
+        MatrixCoreObject *matA, *matB;
+        ProductTask *t = &tasks[i];
+
+        if (!PyObject_TypeCheck(itemA, &MatrixCoreType) || !PyObject_TypeCheck(itemB, &MatrixCoreType)) {
+            PyErr_SetString(PyExc_TypeError, "Batched matrix product requires a list of matrices");
+            goto error;
+        }
+
+        matA = (MatrixCoreObject *) itemA;
+        matB = (MatrixCoreObject *) itemB;
+
+        if (matA->dtype != LpmFloat64 || matB->dtype != LpmFloat64) {
+            PyErr_SetString(PyExc_TypeError, "Batched matrix products are only implemented for float64 matrices");
+            goto error;
+        }
+
+        t->M = transA ? matA->cols : matA->rows;
+        t->N = transA ? matA->rows : matA->cols;
+        t->K = transB ? matB->rows : matB->cols;
+        t->a = matA->data;
+        t->rsA = transA ? matA->colStride : matA->rowStride;
+        t->csA = transA ? matA->rowStride : matA->colStride;
+        t->b = matB->data;
+        t->rsB = transB ? matB->colStride : matB->rowStride;
+        t->csB = transB ? matB->rowStride : matB->colStride;
+
+        if (t->N != (transB ? matB->cols : matB->rows)) {
+            PyErr_Format(PyExc_ValueError, "Invalid matrix size for matrix product at index %ld", i);
+            goto error;
+        }
+
+        t->c = allocateMemory(t->M * t->K);
+        if (t->c == NULL) {
+            goto error;
+        }
+
+        work += t->M * t->N * t->K;
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(work)
+    status = runProductBatch(tasks, count, threads);
+    LPM_END_ALLOW_THREADS
+
+    if (status != 0) {
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+        goto error;
+    }
+
+    res = PyList_New(count);
+    if (res == NULL) {
+        goto error;
+    }
+
+    for (i = 0; i < count; i++) {
+        PyObject *item = (PyObject *) matrixNewC(tasks[i].c, tasks[i].M, tasks[i].K, 0);
+
+        if (item == NULL) {
+            Py_CLEAR(res);
+            goto error;
+        }
+
+        // The list owns the data from here on
+        tasks[i].c = NULL;
+        PyList_SET_ITEM(res, i, item);
+    }
+
+    PyMem_Free(tasks);
+    Py_DECREF(seqA);
+    Py_DECREF(seqB);
+    return res;
+
+error:
+    if (tasks != NULL) {
+        for (i = 0; i < count; i++) {
+            free(tasks[i].c);
+        }
+        PyMem_Free(tasks);
+    }
+    Py_XDECREF(seqA);
+    Py_XDECREF(seqB);
+    return NULL;
+}
+
+// Batched product of equally shaped matrices stacked on top of each other: a holds `batch` M x N blocks and b holds
+// `batch` N x K blocks, and the result holds the `batch` M x K products in the same order. Unlike the list version no
+// Python objects are created per product
+static PyObject *matrixProductStridedBatched(PyObject *self, PyObject *args) {
+    MatrixCoreObject *matA, *matB;
+    ProductTask *tasks;
+    double *resData;
+    long batch, i;
+    int threads = 1;
+    int status;
+
+    if (!PyArg_ParseTuple(args, "O!O!l|i", &MatrixCoreType, &matA, &MatrixCoreType, &matB, &batch, &threads))
+        return NULL;
+
+    if (matA->dtype != LpmFloat64 || matB->dtype != LpmFloat64) {
+        PyErr_SetString(PyExc_TypeError, "Batched matrix products are only implemented for float64 matrices");
+        return NULL;
+    }
+
+    if (batch <= 0 || matA->rows % batch != 0 || matB->rows % batch != 0) {
+        PyErr_SetString(PyExc_ValueError, "The rows of both matrices must be a multiple of the batch size");
+        return NULL;
+    }
+
+    long M = matA->rows / batch;
+    long N = matA->cols;
+    long K = matB->cols;
+
+    if (matB->rows / batch != N) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size for matrix product");
+        return NULL;
+    }
+
+    resData = allocateMemory(batch * M * K);
+    if (resData == NULL) {
+        return NULL;
+    }
+
+    tasks = PyMem_Calloc(batch, sizeof(ProductTask));
+    if (tasks == NULL) {
+        free(resData);
+        return PyErr_NoMemory();
+    }
+
+    for (i = 0; i < batch; i++) {
+        ProductTask *t = &tasks[i];
+
+        t->M = M;
+        t->N = N;
+        t->K = K;
+        t->a = &matA->data[i * M * matA->rowStride];
+        t->rsA = matA->rowStride;
+        t->csA = matA->colStride;
+        t->b = &matB->data[i * N * matB->rowStride];
+        t->rsB = matB->rowStride;
+        t->csB = matB->colStride;
+        t->c = &resData[i * M * K];
+    }
+
+    LPM_BEGIN_ALLOW_THREADS(batch * M * N * K)
+    status = runProductBatch(tasks, batch, threads);
+    LPM_END_ALLOW_THREADS
+
+    PyMem_Free(tasks);
+
+    if (status != 0) {
+        free(resData);
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+        return NULL;
+    }
+
+    return (PyObject *) matrixNewC(resData, batch * M, K, 0);
+}
+
+static PyObject *gemmKernel(PyObject *self, PyObject *args) {
+    return Py_BuildValue("s", ULM_DGEMM_KERNEL->name);
+}
+
+static PyObject *sgemmKernel(PyObject *self, PyObject *args) {
+    return Py_BuildValue("s", ULM_SGEMM_KERNEL->name);
+}
+
+static PyObject *qgemmKernel(PyObject *self, PyObject *args) {
+    return Py_BuildValue("s", ULM_QGEMM_KERNEL->name);
+}
+
+static PyObject *gemmBlocking(PyObject *self, PyObject *args) {
+    return Py_BuildValue("(lll)", ULM_DGEMM_BLOCKING.mc, ULM_DGEMM_BLOCKING.kc, ULM_DGEMM_BLOCKING.nc);
+}
+
+static PyObject *setGemmBlocking(PyObject *self, PyObject *args) {
+    long mc = 0, kc = 0, nc = 0;
+
+    if (!PyArg_ParseTuple(args, "|lll", &mc, &kc, &nc))
+        return NULL;
+
+    // With no arguments, go back to the sizes derived from the caches
+    if (PyTuple_GET_SIZE(args) == 0) {
+        ULMBLAS(dgemm_auto_blocking)();
+        Py_RETURN_NONE;
+    }
+
+    if (PyTuple_GET_SIZE(args) != 3) {
+        PyErr_SetString(PyExc_TypeError, "setGemmBlocking takes either no arguments or all of mc, kc and nc");
+        return NULL;
+    }
+
+    if (mc <= 0 || kc <= 0 || nc <= 0) {
+        PyErr_SetString(PyExc_ValueError, "GEMM block sizes must be positive");
+        return NULL;
+    }
+
+    ULMBLAS(dgemm_set_blocking)(mc, kc, nc);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *gemmCrossover(PyObject *self, PyObject *args) {
+    return Py_BuildValue("l", ULM_DGEMM_SMALL_CROSSOVER);
+}
+
+static PyObject *setGemmCrossover(PyObject *self, PyObject *args) {
+    long crossover;
+
+    if (!PyArg_ParseTuple(args, "l", &crossover))
+        return NULL;
+
+    if (crossover < 0) {
+        PyErr_SetString(PyExc_ValueError, "GEMM crossover must not be negative");
+        return NULL;
+    }
+
+    ULM_DGEMM_SMALL_CROSSOVER = crossover;
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *gemmStrassen(PyObject *self, PyObject *args) {
+    return Py_BuildValue("ll", ULM_DGEMM_STRASSEN_CUTOFF, ULM_DGEMM_STRASSEN_AUTO);
+}
+
+// Set the size below which the Strassen-Winograd recursion hands over to the blocked product, and the size from which
+// products use it by default (0 to only use it when asked for)
+static PyObject *setGemmStrassen(PyObject *self, PyObject *args) {
+    long cutoff, autoSize;
+
+    if (!PyArg_ParseTuple(args, "ll", &cutoff, &autoSize))
+        return NULL;
+
+    if (cutoff < 16 || autoSize < 0) {
+        PyErr_SetString(PyExc_ValueError, "Invalid Strassen cutoff or automatic size");
+        return NULL;
+    }
+
+    ULM_DGEMM_STRASSEN_CUTOFF = cutoff;
+    ULM_DGEMM_STRASSEN_AUTO = autoSize;
+
+    Py_RETURN_NONE;
+}
+
+// Time the unpacked and packed products on square matrices of growing size, and use the unpacked kernels for every
+// product up to the largest size at which they were still faster. The packed path has to win at two sizes in a row
+// before the search stops, so one noisy timing does not end it early
+static PyObject *measureGemmCrossover(PyObject *self, PyObject *args) {
+    static const long sizes[] = {4, 6, 8, 12, 16, 20, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128};
+    const long count = (long) (sizeof(sizes) / sizeof(sizes[0]));
+    const long maxSize = sizes[count - 1];
+    long crossover = sizes[0] * sizes[0] * sizes[0];
+    long i, s, rep, reps, trial, wins = 0;
+    double start, smallTime, packedTime, t;
+    double *a, *b, *c;
+    int status = 0;
+
+    a = allocateMemory(maxSize * maxSize);
+    b = allocateMemory(maxSize * maxSize);
+    c = allocateMemory(maxSize * maxSize);
+    if (a == NULL || b == NULL || c == NULL) {
+        free(a);
+        free(b);
+        free(c);
+        return NULL;
+    }
+
+    for (i = 0; i < maxSize * maxSize; i++) {
+        a[i] = randomRange(-1, 1);
+        b[i] = randomRange(-1, 1);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < count && status == 0; i++) {
+        s = sizes[i];
+        reps = 1 + 2000000 / (s * s * s);
+        smallTime = packedTime = 1e30;
+
+        for (trial = 0; trial < 3; trial++) {
+            start = TIME;
+            for (rep = 0; rep < reps; rep++) {
+                ULMBLAS(dgemm_small)(s, s, s, 1.0, a, s, 1, b, s, 1, 0.0, c, s, 1);
+            }
+            t = TIME - start;
+            smallTime = t < smallTime ? t : smallTime;
+
+            start = TIME;
+            for (rep = 0; rep < reps && status == 0; rep++) {
+                status = ULMBLAS(dgemm_nn)(s, s, s, 1.0, a, s, 1, b, s, 1, 0.0, c, s, 1, 1);
+            }
+            t = TIME - start;
+            packedTime = t < packedTime ? t : packedTime;
+        }
+
+        if (packedTime < smallTime) {
+            if (++wins == 2) {
+                break;
+            }
+        } else {
+            crossover = s * s * s;
+            wins = 0;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    free(a);
+    free(b);
+    free(c);
+
+    if (status != 0) {
+        PyErr_SetString(PyExc_MemoryError, "Unable to allocate memory for the matrix product");
+        return NULL;
+    }
+
+    ULM_DGEMM_SMALL_CROSSOVER = crossover;
+
+    return Py_BuildValue("l", crossover);
+}
+
+static PyObject *cacheSizes(PyObject *self, PyObject *args) {
+    struct ulm_cache_info cache = ulm_cache_info();
+
+    return Py_BuildValue("(lll)", cache.l1, cache.l2, cache.l3);
 }
 
 // **************************************************************************************************************************** //
@@ -680,6 +3513,9 @@ static PyGetSetDef matrixGetSet[] = {
         {"cols",      (getter) matrixGetCols,      NULL, "Columns of matrix",       NULL},
         {"rowStride", (getter) matrixGetRowStride, NULL, "Row stride of matrix",    NULL},
         {"colStride", (getter) matrixGetColStride, NULL, "Column stride of matrix", NULL},
+        {"prepacked", (getter) matrixIsPrepacked,  NULL, "Prepacked for products",  NULL},
+        {"quantized", (getter) matrixIsQuantized,  NULL, "Quantized for products",  NULL},
+        {"dtype",     (getter) matrixGetDtype,     NULL, "Datatype of matrix",      NULL},
         {NULL}
 };
 
@@ -689,7 +3525,17 @@ static PyMethodDef matrixMethods[] = {
         {"toString",                     (PyCFunction) matrixToString,               METH_NOARGS,  "Give the matrix object as a string"},
         {"copy",                         (PyCFunction) matrixCopy,                   METH_NOARGS,  "Return an exact copy of a matrix"},
         {"transpose",                    (PyCFunction) matrixTransposeReturn,        METH_NOARGS,  "Transpose the matrix and return the result. This function actually swaps the data around"},
-        {"matrixProduct",                (PyCFunction) matrixProduct,                METH_VARARGS, "Calculate the matrix product between two matrices and return the result"},
+        {"columnMajor",                  (PyCFunction) matrixColumnMajor,            METH_NOARGS,  "Return a copy of the matrix with its values stored column by column"},
+        {"matrixProduct",                (PyCFunction) matrixProduct,                METH_VARARGS, "Calculate the matrix product between two matrices, either of which may be transposed, and return the result"},
+        {"matrixPrepack",                (PyCFunction) matrixPrepack,                METH_NOARGS,  "Keep a copy of the matrix packed for the matrix product kernel"},
+        {"matrixQuantize",               (PyCFunction) matrixQuantize,               METH_NOARGS,  "Keep a copy of the matrix quantized to int8 for the matrix product kernel"},
+        {"matrixDequantize",             (PyCFunction) matrixDequantize,             METH_NOARGS,  "Drop the int8 copy of the matrix made by matrixQuantize"},
+        {"matrixAddmm",                  (PyCFunction) matrixAddmm,                  METH_VARARGS, "Accumulate a scaled matrix product into the matrix in place"},
+        {"matrixAddOuter",               (PyCFunction) matrixAddOuter,               METH_VARARGS, "Add a scaled outer product of two vectors to the matrix in place"},
+        {"matrixGram",                   (PyCFunction) matrixGram,                   METH_VARARGS, "Calculate the symmetric product of the matrix with its own transpose and return the result"},
+        {"matrixScaleDiagonal",          (PyCFunction) matrixScaleDiagonal,          METH_VARARGS, "Calculate the matrix product with a diagonal matrix by scaling the rows or columns and return the result"},
+        {"matrixAddDiagonal",            (PyCFunction) matrixAddDiagonal,            METH_VARARGS, "Add a diagonal matrix to the matrix and return the result"},
+        {"matrixDiagonal",               (PyCFunction) matrixDiagonal,               METH_NOARGS,  "Return the diagonal of the matrix as a column vector"},
         {"matrixAddMatrixReturn",        (PyCFunction) matrixAddMatrixReturn,        METH_VARARGS, "Add one matrix to another and return the result"},
         {"matrixSubMatrixReturn",        (PyCFunction) matrixSubMatrixReturn,        METH_VARARGS, "Subtract one matrix from another and return the result"},
         {"matrixMulMatrixReturn",        (PyCFunction) matrixMulMatrixReturn,        METH_VARARGS, "Multiply one matrix by another and return the result"},
@@ -704,6 +3550,7 @@ static PyMethodDef matrixMethods[] = {
         {"matrixFillRandom",             (PyCFunction) matrixFillRandom,             METH_VARARGS, "Fill a matrix in with random values in a specified range"},
         {"matrixMapSigmoid",             (PyCFunction) matrixMapSigmoid,             METH_VARARGS, "Apply the sigmoid function to every element in a matrix"},
         {"matrixMapTanh",                (PyCFunction) matrixMapTanh,                METH_VARARGS, "Apply the tanh function to every element in a matrix"},
+        {"matrixMapExp",                 (PyCFunction) matrixMapExp,                 METH_VARARGS, "Apply the exponential function to every element in a matrix"},
         {"matrixMapRELU",                (PyCFunction) matrixMapRELU,                METH_VARARGS, "Apply the RELU function to every element in a matrix"},
         {"matrixMapLeakyRELU",           (PyCFunction) matrixMapLeakyRELU,           METH_VARARGS, "Apply the leaky variant of the RELU function to every element in a matrix"},
         {"matrixMapSigmoidDerivative",   (PyCFunction) matrixMapSigmoidDerivative,   METH_VARARGS, "Apply the sigmoid derivative function to every element in a matrix"},
@@ -714,12 +3561,64 @@ static PyMethodDef matrixMethods[] = {
         {"matrixReshape",                (PyCFunction) matrixReshape,                METH_VARARGS, "Resize the matrix"},
         {"matrixSum",                    (PyCFunction) matrixSum,                    METH_VARARGS, "Calculate the sum of all values in the matrix"},
         {"matrixMean",                   (PyCFunction) matrixMean,                   METH_VARARGS, "Calculate the mean of all values in the matrix"},
+        {"matrixReduce",                 (PyCFunction) matrixReduce,                 METH_VARARGS, "Reduce the matrix along the rows or columns with a sum, mean, minimum, maximum, argmin or argmax"},
+        {"matrixAsType",                 (PyCFunction) matrixAsType,                 METH_VARARGS, "Return a copy of the matrix converted to another datatype"},
+        {NULL}
+};
+
+static PyGetSetDef sparseGetSet[] = {
+        {"rows", (getter) sparseGetRows, NULL, "Rows of sparse matrix",            NULL},
+        {"cols", (getter) sparseGetCols, NULL, "Columns of sparse matrix",         NULL},
+        {"nnz",  (getter) sparseGetNnz,  NULL, "Non-zero values of sparse matrix", NULL},
+        {NULL}
+};
+
+static PyMethodDef sparseMethods[] = {
+        {"toDense",           (PyCFunction) sparseToDense,     METH_VARARGS, "Return the sparse matrix converted to a dense matrix"},
+        {"toLists",           (PyCFunction) sparseToLists,     METH_NOARGS,  "Return the values, columns and row pointers of the sparse matrix as lists"},
+        {"transpose",         (PyCFunction) sparseTranspose,   METH_NOARGS,  "Return the transpose of the sparse matrix"},
+        {"sparseProduct",     (PyCFunction) sparseProduct,     METH_VARARGS, "Calculate the matrix product of the sparse matrix with a dense matrix and return the result"},
+        {"sparseProductLeft", (PyCFunction) sparseProductLeft, METH_VARARGS, "Calculate the matrix product of a dense matrix with the sparse matrix and return the result"},
+        {NULL}
+};
+
+static PyGetSetDef packedGetSet[] = {
+        {"rows", (getter) packedGetRows, NULL, "Rows of packed matrix",    NULL},
+        {"cols", (getter) packedGetRows, NULL, "Columns of packed matrix", NULL},
+        {"kind", (getter) packedGetKind, NULL, "Kind of packed matrix",    NULL},
+        {NULL}
+};
+
+static PyMethodDef packedMethods[] = {
+        {"toDense",           (PyCFunction) packedToDense,     METH_VARARGS, "Return the packed matrix converted to a dense matrix"},
+        {"toList",            (PyCFunction) packedToList,      METH_NOARGS,  "Return the stored values of the packed matrix as a list"},
+        {"transpose",         (PyCFunction) packedTranspose,   METH_NOARGS,  "Return the transpose of the packed matrix"},
+        {"packedProduct",     (PyCFunction) packedProduct,     METH_VARARGS, "Calculate the matrix product of the packed matrix with a dense matrix and return the result"},
+        {"packedProductLeft", (PyCFunction) packedProductLeft, METH_VARARGS, "Calculate the matrix product of a dense matrix with the packed matrix and return the result"},
+        {"packedElementwise", (PyCFunction) packedElementwise, METH_VARARGS, "Add, subtract or multiply two packed matrices elementwise and return the result"},
+        {"packedScalar",      (PyCFunction) packedScalar,      METH_VARARGS, "Add, subtract, multiply or divide every stored value by a scalar and return the result"},
+        {"packedAddDense",    (PyCFunction) packedAddDense,    METH_VARARGS, "Add the packed matrix to a dense matrix and return the dense result"},
         {NULL}
 };
 
 static PyMethodDef matrixFunctionMethods[] = {
-        {"matrixFromData2D", (PyCFunction) matrixFromData2D, METH_VARARGS, "Create a new matrix from a 2D list of data"},
-        {"matrixFromData1D", (PyCFunction) matrixFromData1D, METH_VARARGS, "Create a new matrix from a 1D list of data"},
+        {"matrixFromData2D",            (PyCFunction) matrixFromData2D,            METH_VARARGS, "Create a new matrix from a 2D list of data"},
+        {"matrixFromData1D",            (PyCFunction) matrixFromData1D,            METH_VARARGS, "Create a new matrix from a 1D list of data"},
+        {"matrixProductBatched",        (PyCFunction) matrixProductBatched,        METH_VARARGS, "Calculate the matrix products of two lists of matrices pairwise and return a list of the results"},
+        {"matrixProductStridedBatched", (PyCFunction) matrixProductStridedBatched, METH_VARARGS, "Calculate the matrix products of equally shaped blocks stacked in two matrices and return them stacked"},
+        {"gemmKernel",                  (PyCFunction) gemmKernel,                  METH_NOARGS,  "Return the name of the micro kernel used for matrix products"},
+        {"sgemmKernel",                 (PyCFunction) sgemmKernel,                 METH_NOARGS,  "Return the name of the micro kernel used for float32 matrix products"},
+        {"qgemmKernel",                 (PyCFunction) qgemmKernel,                 METH_NOARGS,  "Return the name of the kernel used for products with quantized matrices"},
+        {"gemmBlocking",                (PyCFunction) gemmBlocking,                METH_NOARGS,  "Return the (mc, kc, nc) block sizes used for matrix products"},
+        {"setGemmBlocking",             (PyCFunction) setGemmBlocking,             METH_VARARGS, "Set the (mc, kc, nc) block sizes used for matrix products, or derive them from the caches if none are given"},
+        {"gemmCrossover",               (PyCFunction) gemmCrossover,               METH_NOARGS,  "Return the largest product (rows * inner * cols) that skips packing"},
+        {"setGemmCrossover",            (PyCFunction) setGemmCrossover,            METH_VARARGS, "Set the largest product (rows * inner * cols) that skips packing"},
+        {"gemmStrassen",                (PyCFunction) gemmStrassen,                METH_NOARGS,  "Return the (cutoff, automatic size) of the Strassen-Winograd recursion for matrix products"},
+        {"setGemmStrassen",             (PyCFunction) setGemmStrassen,             METH_VARARGS, "Set the (cutoff, automatic size) of the Strassen-Winograd recursion for matrix products"},
+        {"measureGemmCrossover",        (PyCFunction) measureGemmCrossover,        METH_NOARGS,  "Time the small and packed matrix products, use the faster one for each size and return the crossover"},
+        {"cacheSizes",                  (PyCFunction) cacheSizes,                  METH_NOARGS,  "Return the (L1, L2, L3) data cache sizes in bytes"},
+        {"sparseFromDense",             (PyCFunction) sparseFromDense,             METH_VARARGS, "Convert a dense matrix to a sparse matrix holding its non-zero values"},
+        {"packedFromDense",             (PyCFunction) packedFromDense,             METH_VARARGS, "Convert a square dense matrix to a packed symmetric or triangular matrix"},
         {NULL}
 };
 
@@ -739,6 +3638,36 @@ static PyTypeObject MatrixCoreType = {
         .tp_methods = matrixMethods,
 };
 
+static PyTypeObject SparseCoreType = {
+        PyVarObject_HEAD_INIT(NULL, 0)
+        .tp_name = "matrix.SparseMatrix",
+        .tp_doc = "Sparse matrix in compressed sparse row format",
+        .tp_basicsize = sizeof(SparseCoreObject),
+        .tp_itemsize = 0,
+        .tp_repr = (reprfunc) sparseToString,
+        .tp_flags = Py_TPFLAGS_DEFAULT,
+        .tp_new = sparseNew,
+        .tp_init = (initproc) sparseInit,
+        .tp_dealloc = (destructor) sparseDealloc,
+        .tp_getset = sparseGetSet,
+        .tp_methods = sparseMethods,
+};
+
+static PyTypeObject PackedCoreType = {
+        PyVarObject_HEAD_INIT(NULL, 0)
+        .tp_name = "matrix.PackedMatrix",
+        .tp_doc = "Symmetric or triangular matrix with one triangle stored in packed form",
+        .tp_basicsize = sizeof(PackedCoreObject),
+        .tp_itemsize = 0,
+        .tp_repr = (reprfunc) packedToString,
+        .tp_flags = Py_TPFLAGS_DEFAULT,
+        .tp_new = packedNew,
+        .tp_init = (initproc) packedInit,
+        .tp_dealloc = (destructor) packedDealloc,
+        .tp_getset = packedGetSet,
+        .tp_methods = packedMethods,
+};
+
 static PyModuleDef matrixCoreModule = {
         PyModuleDef_HEAD_INIT,
         .m_name = "matrix",
@@ -750,9 +3679,15 @@ static PyModuleDef matrixCoreModule = {
 PyMODINIT_FUNC
 PyInit_matrix(void) {
     PyObject *m;
-    if (PyType_Ready(&MatrixCoreType) < 0)
+    if (PyType_Ready(&MatrixCoreType) < 0 || PyType_Ready(&SparseCoreType) < 0 || PyType_Ready(&PackedCoreType) < 0)
         return NULL;
 
+    ULMBLAS(dgemm_select_kernel)();
+    ULMBLAS(dgemm_auto_blocking)();
+    ULMBLAS(dgemm_small_select)();
+    ULMBLAS(sgemm_select_kernel)();
+    ULMBLAS(qgemm_select_kernel)();
+
     m = PyModule_Create(&matrixCoreModule);
     if (m == NULL)
         return NULL;
@@ -764,5 +3699,19 @@ PyInit_matrix(void) {
         return NULL;
     }
 
+    Py_INCREF(&SparseCoreType);
+    if (PyModule_AddObject(m, "SparseMatrix", (PyObject *) &SparseCoreType) < 0) {
+        Py_DECREF(&SparseCoreType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
+    Py_INCREF(&PackedCoreType);
+    if (PyModule_AddObject(m, "PackedMatrix", (PyObject *) &PackedCoreType) < 0) {
+        Py_DECREF(&PackedCoreType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
     return m;
 }
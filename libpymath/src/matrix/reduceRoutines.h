@@ -0,0 +1,174 @@
+#ifndef LIBPYMATHMODULES_REDUCEFUNCTIONS_H
+#define LIBPYMATHMODULES_REDUCEFUNCTIONS_H
+
+#include <libpymath/src/internal.h>
+
+// Reductions along one axis of a matrix. The results are always written as doubles: sums and means are accumulated in
+// double precision for both types, every float32 minimum and maximum is exact in a double, and the indices returned by
+// argmin and argmax are exact up to 2^53
+#define LPM_REDUCE_SUM    0
+#define LPM_REDUCE_MEAN   1
+#define LPM_REDUCE_MIN    2
+#define LPM_REDUCE_MAX    3
+#define LPM_REDUCE_ARGMIN 4
+#define LPM_REDUCE_ARGMAX 5
+
+// Outputs given to each thread when reducing across the contiguous direction. Every row then adds a contiguous run of
+// this many elements into a run of results that stays in cache, and no two threads share a cache line of the results
+#define LPM_REDUCE_CHUNK 256
+
+// Define a function that reduces a matrix a of type T along one axis: res[o] is the reduction of the n elements
+// a[o * strideOut + i * strideIn] for 0 <= i < n, for each of the m outputs o. best must hold m doubles for argmin and
+// argmax, and is not used otherwise.
+//
+// If the elements of each output are closer together than the outputs (strideIn <= strideOut), every output is reduced
+// on its own with the outputs split between the threads. Otherwise the matrix is read a row of outputs at a time, with
+// every thread updating its own chunk of results, so that the elements are always read in the order they are stored
+//
+// NaN propagates like in NumPy: the minimum or maximum of elements that include a NaN is NaN, and argmin and argmax
+// return the index of the first NaN. Sums and means of elements that include a NaN are NaN anyway
+#define LPM_MATRIX_REDUCE_AXIS(prefix, T)                                                                                  \
+void prefix##MatrixReduceAxis(const T *a, int op, long int m, long int n, long int strideOut, long int strideIn,         \
+                              double *res, double *best, int threads) {                                                \
+    long int o, i;                                                                                                     \
+                                                                                                                       \
+    if (labs(strideIn) <= labs(strideOut)) {                                                                           \
+        _Pragma("omp parallel for private(i) num_threads(threads > 1 ? threads : 1) if(m * n >= 90000)")               \
+        for (o = 0; o < m; o++) {                                                                                      \
+            const T *x = &a[o * strideOut];                                                                            \
+                                                                                                                       \
+            if (op == LPM_REDUCE_SUM || op == LPM_REDUCE_MEAN) {                                                       \
+                double s = 0.0;                                                                                        \
+                                                                                                                       \
+                if (strideIn == 1) {                                                                                   \
+                    _Pragma("omp simd reduction(+:s)")                                                                 \
+                    for (i = 0; i < n; i++) {                                                                          \
+                        s += x[i];                                                                                     \
+                    }                                                                                                  \
+                } else {                                                                                               \
+                    for (i = 0; i < n; i++) {                                                                          \
+                        s += x[i * strideIn];                                                                          \
+                    }                                                                                                  \
+                }                                                                                                      \
+                res[o] = (op == LPM_REDUCE_MEAN) ? s / (double) n : s;                                                 \
+            } else if (op == LPM_REDUCE_MIN || op == LPM_REDUCE_MAX) {                                                 \
+                T v = x[0];                                                                                            \
+                int nan = 0;                                                                                           \
+                                                                                                                       \
+                if (strideIn == 1 && op == LPM_REDUCE_MIN) {                                                           \
+                    _Pragma("omp simd reduction(min:v) reduction(|:nan)")                                              \
+                    for (i = 0; i < n; i++) {                                                                          \
+                        v = x[i] < v ? x[i] : v;                                                                       \
+                        nan |= x[i] != x[i];                                                                           \
+                    }                                                                                                  \
+                } else if (strideIn == 1) {                                                                            \
+                    _Pragma("omp simd reduction(max:v) reduction(|:nan)")                                              \
+                    for (i = 0; i < n; i++) {                                                                          \
+                        v = x[i] > v ? x[i] : v;                                                                       \
+                        nan |= x[i] != x[i];                                                                           \
+                    }                                                                                                  \
+                } else if (op == LPM_REDUCE_MIN) {                                                                     \
+                    for (i = 0; i < n; i++) {                                                                          \
+                        v = x[i * strideIn] < v ? x[i * strideIn] : v;                                                 \
+                        nan |= x[i * strideIn] != x[i * strideIn];                                                     \
+                    }                                                                                                  \
+                } else {                                                                                               \
+                    for (i = 0; i < n; i++) {                                                                          \
+                        v = x[i * strideIn] > v ? x[i * strideIn] : v;                                                 \
+                        nan |= x[i * strideIn] != x[i * strideIn];                                                     \
+                    }                                                                                                  \
+                }                                                                                                      \
+                res[o] = nan ? NAN : (double) v;                                                                       \
+            } else {                                                                                                   \
+                T v = x[0];                                                                                            \
+                long int index = 0;                                                                                    \
+                                                                                                                       \
+                for (i = 0; i < n; i++) {                                                                              \
+                    T y = x[i * strideIn];                                                                             \
+                                                                                                                       \
+                    if (y != y) {                                                                                      \
+                        index = i;                                                                                     \
+                        break;                                                                                         \
+                    }                                                                                                  \
+                    if (op == LPM_REDUCE_ARGMIN ? y < v : y > v) {                                                     \
+                        v = y;                                                                                         \
+                        index = i;                                                                                     \
+                    }                                                                                                  \
+                }                                                                                                      \
+                res[o] = (double) index;                                                                               \
+            }                                                                                                          \
+        }                                                                                                              \
+        return;                                                                                                        \
+    }                                                                                                                  \
+                                                                                                                       \
+    long int chunks = (m + LPM_REDUCE_CHUNK - 1) / LPM_REDUCE_CHUNK, chunk;                                            \
+                                                                                                                       \
+    _Pragma("omp parallel for private(o, i) num_threads(threads > 1 ? threads : 1) if(m * n >= 90000)")                \
+    for (chunk = 0; chunk < chunks; chunk++) {                                                                         \
+        long int o0 = chunk * LPM_REDUCE_CHUNK;                                                                        \
+        long int o1 = (o0 + LPM_REDUCE_CHUNK < m) ? o0 + LPM_REDUCE_CHUNK : m;                                         \
+                                                                                                                       \
+        if (op == LPM_REDUCE_SUM || op == LPM_REDUCE_MEAN) {                                                           \
+            for (o = o0; o < o1; o++) {                                                                                \
+                res[o] = 0.0;                                                                                          \
+            }                                                                                                          \
+            for (i = 0; i < n; i++) {                                                                                  \
+                const T *x = &a[i * strideIn];                                                                         \
+                                                                                                                       \
+                for (o = o0; o < o1; o++) {                                                                            \
+                    res[o] += x[o * strideOut];                                                                        \
+                }                                                                                                      \
+            }                                                                                                          \
+            if (op == LPM_REDUCE_MEAN) {                                                                               \
+                for (o = o0; o < o1; o++) {                                                                            \
+                    res[o] /= (double) n;                                                                              \
+                }                                                                                                      \
+            }                                                                                                          \
+        } else if (op == LPM_REDUCE_MIN || op == LPM_REDUCE_MAX) {                                                     \
+            for (o = o0; o < o1; o++) {                                                                                \
+                res[o] = (double) a[o * strideOut];                                                                    \
+            }                                                                                                          \
+            for (i = 1; i < n; i++) {                                                                                  \
+                const T *x = &a[i * strideIn];                                                                         \
+                                                                                                                       \
+                if (op == LPM_REDUCE_MIN) {                                                                            \
+                    for (o = o0; o < o1; o++) {                                                                        \
+                        double y = (double) x[o * strideOut];                                                          \
+                                                                                                                       \
+                        res[o] = (y < res[o] || y != y) ? y : res[o];                                                  \
+                    }                                                                                                  \
+                } else {                                                                                               \
+                    for (o = o0; o < o1; o++) {                                                                        \
+                        double y = (double) x[o * strideOut];                                                          \
+                                                                                                                       \
+                        res[o] = (y > res[o] || y != y) ? y : res[o];                                                  \
+                    }                                                                                                  \
+                }                                                                                                      \
+            }                                                                                                          \
+        } else {                                                                                                       \
+            for (o = o0; o < o1; o++) {                                                                                \
+                best[o] = (double) a[o * strideOut];                                                                   \
+                res[o] = 0.0;                                                                                          \
+            }                                                                                                          \
+            for (i = 1; i < n; i++) {                                                                                  \
+                const T *x = &a[i * strideIn];                                                                         \
+                                                                                                                       \
+                for (o = o0; o < o1; o++) {                                                                            \
+                    double y = (double) x[o * strideOut];                                                              \
+                                                                                                                       \
+                    if (best[o] == best[o] && (y != y || (op == LPM_REDUCE_ARGMIN ? y < best[o] : y > best[o]))) {     \
+                        best[o] = y;                                                                                   \
+                        res[o] = (double) i;                                                                           \
+                    }                                                                                                  \
+                }                                                                                                      \
+            }                                                                                                          \
+        }                                                                                                              \
+    }                                                                                                                  \
+}
+
+LPM_MATRIX_REDUCE_AXIS(double, double)
+LPM_MATRIX_REDUCE_AXIS(float, float)
+
+#undef LPM_MATRIX_REDUCE_AXIS
+
+#endif // LIBPYMATHMODULES_REDUCEFUNCTIONS_H
@@ -0,0 +1,136 @@
+"""
+Accumulating products: addmm(c, a, b) and Matrix.dot(out=c).
+
+Both compute c = alpha * op(a) @ op(b) + beta * c in place, with alpha and
+beta defaulting to 1, so the two spellings must agree for every combination
+of transA and transB, on the vector, small and packed paths and for both
+dtypes. An output of the wrong shape, or one that shares memory with an
+operand, raises a ValueError and leaves c unchanged.
+
+Run with: python -m unittest tests.test_addmm
+"""
+
+import random
+import struct
+import unittest
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix, addmm
+
+# rows, inner, cols of the product
+SHAPES = ((1, 9, 7), (9, 7, 1), (3, 4, 5), (8, 8, 8), (70, 33, 81))
+
+
+def _float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def _product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def _transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+class TestAddmm(unittest.TestCase):
+    def setUp(self):
+        self.crossover = core.gemmCrossover()
+
+    def tearDown(self):
+        core.setGemmCrossover(self.crossover)
+
+    def _assertClose(self, got, expected, tolerance, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def test_accumulate(self):
+        rng = random.Random(11)
+
+        for crossover in (self.crossover, 0):
+            core.setGemmCrossover(crossover)
+
+            for rows, inner, cols in SHAPES:
+                for dtype, tolerance in (("float64", 1e-13), ("float32", 1e-5)):
+                    rounded = _float32 if dtype == "float32" else float
+                    a = [[rounded(rng.uniform(-1, 1)) for _ in range(inner)] for _ in range(rows)]
+                    b = [[rounded(rng.uniform(-1, 1)) for _ in range(cols)] for _ in range(inner)]
+                    c = [[rounded(rng.uniform(-1, 1)) for _ in range(cols)] for _ in range(rows)]
+                    p = _product(a, b)
+
+                    for transA in (False, True):
+                        for transB in (False, True):
+                            storedA = _transposed(a) if transA else a
+                            storedB = _transposed(b) if transB else b
+                            ma = Matrix(len(storedA), len(storedA[0]), data=storedA, dtype=dtype, threads=1)
+                            mb = Matrix(len(storedB), len(storedB[0]), data=storedB, dtype=dtype, threads=1)
+
+                            # alpha, beta, or None for the defaults
+                            for alpha, beta in ((None, None), (0.5, None), (None, 0.0), (-2.0, 3.0), (0.0, -1.0)):
+                                kwargs = {"transA": transA, "transB": transB}
+                                if alpha is not None:
+                                    kwargs["alpha"] = alpha
+                                if beta is not None:
+                                    kwargs["beta"] = beta
+
+                                al = 1.0 if alpha is None else alpha
+                                be = 1.0 if beta is None else beta
+                                expected = [[al * p[i][j] + be * c[i][j] for j in range(cols)] for i in range(rows)]
+                                message = (crossover, rows, inner, cols, dtype, transA, transB, alpha, beta)
+
+                                mc = Matrix(rows, cols, data=c, dtype=dtype, threads=1)
+                                self.assertIs(addmm(mc, ma, mb, **kwargs), mc)
+                                self._assertClose(mc.toList(), expected, tolerance * inner, message)
+
+                                out = Matrix(rows, cols, data=c, dtype=dtype, threads=1)
+                                self.assertIs(ma.dot(mb, out=out, **kwargs), out)
+                                self.assertEqual(out.toList(), mc.toList(), message)
+
+    def test_alpha_without_out(self):
+        a = Matrix(3, 4, data=[[i + j for j in range(4)] for i in range(3)], threads=1)
+        b = Matrix(4, 2, data=[[i - j for j in range(2)] for i in range(4)], threads=1)
+        expected = [[-3 * value for value in row] for row in a.dot(b).toList()]
+
+        self.assertEqual(a.dot(b, alpha=-3.0).toList(), expected)
+        # beta only applies to out
+        self.assertEqual(a.dot(b, alpha=-3.0, beta=5.0).toList(), expected)
+
+    def test_errors(self):
+        a = Matrix(4, 3, threads=1)
+        a.fillRandom(-1, 1)
+        b = Matrix(3, 5, threads=1)
+        b.fillRandom(-1, 1)
+        square = Matrix(4, 4, threads=1)
+        square.fillRandom(-1, 1)
+
+        for shape in ((4, 4), (5, 4), (1, 5), (4, 1)):
+            c = Matrix(*shape, threads=1)
+            c.fillScalar(0.0)
+
+            with self.assertRaises(ValueError, msg=shape):
+                addmm(c, a, b)
+            with self.assertRaises(ValueError, msg=shape):
+                a.dot(b, out=c)
+            self.assertEqual(c.toList(), [[0.0] * shape[1]] * shape[0], shape)
+
+        # The output is an operand, or another Matrix around the same data
+        before = square.toList()
+        for c, left, right in ((square, square, square), (square, square, Matrix(4, 4)),
+                               (Matrix._internal_new(square.matrix, threads=1), Matrix(4, 4), square)):
+            with self.assertRaises(ValueError):
+                addmm(c, left, right)
+            with self.assertRaises(ValueError):
+                left.dot(right, out=c)
+        self.assertEqual(square.toList(), before)
+
+        with self.assertRaises(ValueError):
+            addmm(Matrix(4, 5), a, b, transA=True)
+        with self.assertRaises(TypeError):
+            addmm([[0.0]], a, b)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,101 @@
+"""
+Batched products: dotBatched and dotStridedBatched.
+
+Each product of a batch must be exactly what Matrix.dot gives for the same
+pair, whatever the number of threads the batch is spread over, for every
+combination of transA and transB. The batches mix vector, small and packed
+products of different shapes, and use the same operand more than once.
+
+Run with: python -m unittest tests.test_batched
+"""
+
+import random
+import unittest
+
+from libpymath.matrix import Matrix, dotBatched, dotStridedBatched
+
+# rows, inner, cols of the products in one batch
+SHAPES = ((1, 9, 7), (9, 7, 1), (3, 4, 5), (16, 16, 16), (40, 1, 33), (100, 80, 90), (2, 2, 2), (31, 17, 29))
+
+
+def _randomMatrix(rows, cols, rng):
+    return Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)], threads=1)
+
+
+def _product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+class TestBatched(unittest.TestCase):
+    def test_batch(self):
+        rng = random.Random(12)
+
+        for transA in (False, True):
+            for transB in (False, True):
+                listA, listB = [], []
+
+                for rows, inner, cols in SHAPES:
+                    listA.append(_randomMatrix(inner, rows, rng) if transA else _randomMatrix(rows, inner, rng))
+                    listB.append(_randomMatrix(cols, inner, rng) if transB else _randomMatrix(inner, cols, rng))
+
+                # The same operands again, in another order
+                listA += listA[::-1]
+                listB += listB[::-1]
+                expected = [a.dot(b, transA=transA, transB=transB).toList() for a, b in zip(listA, listB)]
+
+                for threads in (1, 3, 8):
+                    results = dotBatched(listA, listB, transA=transA, transB=transB, threads=threads)
+
+                    self.assertEqual(len(results), len(expected))
+                    for i, (result, e) in enumerate(zip(results, expected)):
+                        self.assertEqual(result.toList(), e, (transA, transB, threads, i))
+
+        # And one batched product against a reference
+        a = [[rng.uniform(-1, 1) for _ in range(17)] for _ in range(31)]
+        b = [[rng.uniform(-1, 1) for _ in range(29)] for _ in range(17)]
+        got = dotBatched([Matrix(31, 17, data=a)], [Matrix(17, 29, data=b)], threads=2)[0].toList()
+        for row, rowExpected in zip(got, _product(a, b)):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=1e-13)
+
+    def test_strided(self):
+        rng = random.Random(13)
+
+        for batch, rows, inner, cols in ((1, 3, 4, 5), (7, 5, 6, 3), (12, 1, 8, 8), (5, 16, 16, 16), (3, 40, 30, 1)):
+            a = _randomMatrix(batch * rows, inner, rng)
+            b = _randomMatrix(batch * inner, cols, rng)
+            blocksA = a.toList()
+            blocksB = b.toList()
+
+            expected = []
+            for i in range(batch):
+                ma = Matrix(rows, inner, data=blocksA[i * rows:(i + 1) * rows], threads=1)
+                mb = Matrix(inner, cols, data=blocksB[i * inner:(i + 1) * inner], threads=1)
+                expected += ma.dot(mb).toList()
+
+            for threads in (1, 3):
+                self.assertEqual(dotStridedBatched(a, b, batch, threads).toList(), expected,
+                                 (batch, rows, inner, cols, threads))
+
+    def test_errors(self):
+        self.assertEqual(dotBatched([], []), [])
+
+        with self.assertRaises(ValueError):
+            dotBatched([Matrix(2, 3)], [])
+        with self.assertRaises(ValueError):
+            dotBatched([Matrix(2, 3), Matrix(2, 3)], [Matrix(3, 2), Matrix(2, 3)])
+        with self.assertRaises(ValueError):
+            dotBatched([Matrix(2, 3)], [Matrix(3, 2)], transA=True)
+        with self.assertRaises(TypeError):
+            dotBatched([Matrix(2, 3)], [[1, 2, 3]])
+        with self.assertRaises(TypeError):
+            dotBatched([Matrix(2, 3, dtype="float32")], [Matrix(3, 2, dtype="float32")])
+
+        with self.assertRaises(ValueError):
+            dotStridedBatched(Matrix(6, 2), Matrix(5, 2), 3)
+        with self.assertRaises(ValueError):
+            dotStridedBatched(Matrix(7, 2), Matrix(6, 2), 3)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,103 @@
+"""
+Clamping and rounding of the GEMM block sizes.
+
+setGemmBlocking rounds mc and nc to whole MR x NR micro tiles of the kernel in
+use and clamps all three sizes to the range of src/blas/dgemm_nn.h. A rounded
+size must never pass its maximum, which it did for nc with the avx2 kernel
+(NR = 6). The kernel is picked at import, so each kernel the processor
+supports is forced with LIBPYMATH_GEMM_KERNEL in a fresh interpreter.
+
+Run with: python -m unittest tests.test_blocking
+"""
+
+import json
+import os
+import subprocess
+import sys
+import unittest
+
+import libpymath
+
+# Name and MR x NR tile of every kernel in src/blas/dgemm_kernels.h
+KERNELS = {"avx512": (16, 8), "avx2": (8, 6), "sse2": (4, 4)}
+
+# Limits of dgemm_nn.h
+KC_MIN = 32
+KC_MAX = 2048
+MC_MAX = 4096
+NC_MAX = 16384
+
+# Requested (mc, kc, nc)
+REQUESTS = ((256, 512, 100000), (100000, 100000, 100000), (1, 1, 1), (100, 100, 100), (4095, 2047, 16383))
+
+# What the first request gives for each kernel. The avx2 kernel used to round
+# the clamped 16384 up to 16386
+CLAMPED = {"avx512": (256, 512, 16384), "avx2": (256, 512, 16380), "sse2": (256, 512, 16384)}
+
+_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(libpymath.__file__)))
+
+_CHILD = r"""
+import json
+import sys
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix
+
+result = {"kernel": core.gemmKernel(), "auto": core.gemmBlocking(), "blocking": []}
+
+for request in json.loads(sys.argv[1]):
+    core.setGemmBlocking(*request)
+    result["blocking"].append(core.gemmBlocking())
+
+# A product with the largest blocks still runs through the packed path
+core.setGemmCrossover(0)
+a = Matrix(40, 30, data=[[i - j for j in range(30)] for i in range(40)], threads=1)
+b = Matrix(30, 20, data=[[i + j for j in range(20)] for i in range(30)], threads=1)
+result["product"] = a.dot(b).toList()
+
+print(json.dumps(result))
+"""
+
+
+def _expected(request, mr, nr):
+    mc, kc, nc = request
+
+    def rounded(size, tile, maximum):
+        size = -(-min(max(size, tile), maximum) // tile) * tile
+        return size if size <= maximum else maximum // tile * tile
+
+    return rounded(mc, mr, MC_MAX), min(max(kc, KC_MIN), KC_MAX), rounded(nc, nr, NC_MAX)
+
+
+class TestBlocking(unittest.TestCase):
+    def test_kernels(self):
+        reference = [[sum((i - p) * (p + j) for p in range(30)) for j in range(20)] for i in range(40)]
+
+        for name, (mr, nr) in KERNELS.items():
+            with self.subTest(kernel=name):
+                env = dict(os.environ, LIBPYMATH_GEMM_KERNEL=name,
+                           PYTHONPATH=os.pathsep.join(filter(None, (_ROOT, os.environ.get("PYTHONPATH")))))
+                out = subprocess.run([sys.executable, "-c", _CHILD, json.dumps(REQUESTS)], env=env,
+                                     stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+                self.assertEqual(out.returncode, 0, out.stderr)
+                result = json.loads(out.stdout)
+
+                if result["kernel"] != name:
+                    self.skipTest("{} is not supported by this processor".format(name))
+
+                self.assertEqual(tuple(result["blocking"][0]), CLAMPED[name])
+
+                for request, (mc, kc, nc) in zip(REQUESTS, result["blocking"]):
+                    self.assertEqual((mc, kc, nc), _expected(request, mr, nr), request)
+
+                # The sizes derived from the caches follow the same rules
+                mc, kc, nc = result["auto"]
+                self.assertTrue(mc % mr == 0 and mr <= mc <= MC_MAX, result["auto"])
+                self.assertTrue(KC_MIN <= kc <= KC_MAX, result["auto"])
+                self.assertTrue(nc % nr == 0 and nr <= nc <= NC_MAX, result["auto"])
+
+                self.assertEqual(result["product"], reference)
+
+
+if __name__ == "__main__":
+    unittest.main()
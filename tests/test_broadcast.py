@@ -0,0 +1,84 @@
+"""
+Broadcasting in elementwise arithmetic.
+
+A 1 x cols row, a rows x 1 column or a 1 x 1 matrix combined with a larger
+matrix is applied to every row, column or element of it, on either side of
++, -, * and /. The broadcast operand is read again with a stride of 0 and
+never expanded, so every result must be exactly what the same operation
+gives on the expanded operands, for both dtypes, on one or several threads,
+and with the full operand stored row by row or column by column.
+
+Run with: python -m unittest tests.test_broadcast
+"""
+
+import operator
+import random
+import struct
+import unittest
+
+from libpymath.matrix import Matrix
+
+OPERATORS = {"add": operator.add, "sub": operator.sub, "mul": operator.mul, "div": operator.truediv}
+
+# Shapes of the two operands. The last ones are split between threads
+SHAPES = (((5, 7), (1, 7)), ((5, 7), (5, 1)), ((1, 7), (5, 7)), ((5, 1), (5, 7)), ((5, 1), (1, 7)), ((1, 7), (5, 1)),
+          ((5, 7), (1, 1)), ((1, 1), (5, 7)), ((1, 1), (1, 1)), ((9, 1), (9, 1)), ((300, 301), (300, 1)),
+          ((300, 301), (1, 301)), ((1, 301), (700, 301)), ((700, 1), (700, 300)))
+
+
+def _float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def _columnMajor(matrix):
+    return Matrix._internal_new(matrix.matrix.columnMajor(), matrix.dtype, matrix.threads)
+
+
+def _expanded(values, rows, cols):
+    return [[values[i if len(values) > 1 else 0][j if len(values[0]) > 1 else 0] for j in range(cols)]
+            for i in range(rows)]
+
+
+class TestBroadcast(unittest.TestCase):
+    def test_shapes(self):
+        rng = random.Random(35)
+
+        for (rowsA, colsA), (rowsB, colsB) in SHAPES:
+            rows, cols = max(rowsA, rowsB), max(colsA, colsB)
+
+            for dtype in ("float64", "float32"):
+                rounded = _float32 if dtype == "float32" else float
+                a = [[rounded(rng.uniform(1, 5)) for _ in range(colsA)] for _ in range(rowsA)]
+                b = [[rounded(rng.uniform(1, 5)) for _ in range(colsB)] for _ in range(rowsB)]
+                expandedA, expandedB = _expanded(a, rows, cols), _expanded(b, rows, cols)
+
+                for threads in (1, 3):
+                    ma = Matrix(rowsA, colsA, data=a, dtype=dtype, threads=threads)
+                    mb = Matrix(rowsB, colsB, data=b, dtype=dtype, threads=threads)
+                    fullA = Matrix(rows, cols, data=expandedA, dtype=dtype, threads=threads)
+                    fullB = Matrix(rows, cols, data=expandedB, dtype=dtype, threads=threads)
+
+                    for name, op in OPERATORS.items():
+                        expected = [[rounded(op(x, y)) for x, y in zip(ra, rb)] for ra, rb in zip(expandedA, expandedB)]
+                        message = (rowsA, colsA, rowsB, colsB, dtype, threads, name)
+
+                        for left, right in ((ma, mb), (_columnMajor(ma), mb), (ma, _columnMajor(mb)),
+                                            (_columnMajor(ma), _columnMajor(mb))):
+                            result = op(left, right)
+                            self.assertEqual(result.shape, (rows, cols), message)
+                            self.assertEqual(result.toList(), expected, message)
+
+                        self.assertEqual(op(fullA, fullB).toList(), expected, message)
+
+    def test_errors(self):
+        for shapeA, shapeB in (((5, 7), (5, 6)), ((5, 7), (4, 7)), ((2, 3), (3, 2)), ((2, 1), (3, 1)),
+                               ((1, 2), (1, 3))):
+            for op in OPERATORS.values():
+                with self.assertRaises(TypeError, msg=(shapeA, shapeB)):
+                    op(Matrix(*shapeA), Matrix(*shapeB))
+                with self.assertRaises(TypeError, msg=(shapeB, shapeA)):
+                    op(Matrix(*shapeB), Matrix(*shapeA))
+
+
+if __name__ == "__main__":
+    unittest.main()
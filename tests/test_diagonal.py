@@ -0,0 +1,133 @@
+"""
+Diagonal matrices: DiagonalMatrix and ScaledIdentity.
+
+Every operator must give what it gives on the dense matrix with the same
+diagonal: products with a Matrix on either side, with transposed operands
+and alpha, sums, differences and elementwise products in both orders, and
+the same operators between two diagonal matrices, which must stay
+diagonal. This is checked for both dtypes and on one or several threads.
+
+Run with: python -m unittest tests.test_diagonal
+"""
+
+import random
+import unittest
+
+from libpymath.matrix import Matrix, DiagonalMatrix, ScaledIdentity, RELU
+
+# n of the diagonal matrix, cols of the dense operand
+SHAPES = ((1, 1), (1, 5), (7, 5), (7, 1), (300, 40))
+
+
+def _randomMatrix(rows, cols, dtype, rng, threads=1):
+    return Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)], dtype=dtype,
+                  threads=threads)
+
+
+class TestDiagonal(unittest.TestCase):
+    def _assertClose(self, got, expected, tolerance, message):
+        got = got.toList()
+        expected = expected.toList()
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def test_dense(self):
+        rng = random.Random(29)
+
+        for n, k in SHAPES:
+            for dtype, tolerance in (("float64", 1e-15), ("float32", 1e-6)):
+                for threads in (1, 3):
+                    diagonals = (DiagonalMatrix([rng.uniform(-2, 2) for _ in range(n)], threads, dtype),
+                                 ScaledIdentity(n, -2.5, threads, dtype))
+
+                    for d in diagonals:
+                        D = d.toDense()
+                        a = _randomMatrix(n, k, dtype, rng, threads)
+                        b = _randomMatrix(k, n, dtype, rng, threads)
+                        square = _randomMatrix(n, n, dtype, rng, threads)
+                        message = (type(d).__name__, n, k, dtype, threads)
+
+                        self.assertEqual(d.shape, (n, n), message)
+                        self.assertEqual(d.dtype, dtype, message)
+                        self.assertEqual(D.toList(), [[d.diagonal[i, 0] if i == j else 0.0 for j in range(n)]
+                                                      for i in range(n)], message)
+
+                        # Products, scaling the rows or the columns of the other matrix
+                        self._assertClose(d @ a, D @ a, tolerance, message)
+                        self._assertClose(b @ d, b @ D, tolerance, message)
+                        self._assertClose(d.dot(b, transB=True), D.dot(b, transB=True), tolerance, message)
+                        self._assertClose(a.dot(d, transA=True), a.dot(D, transA=True), tolerance, message)
+                        self._assertClose(d.dot(a, alpha=3.0), D.dot(a, alpha=3.0), tolerance, message)
+                        self._assertClose(b.dot(d, alpha=-0.5), b.dot(D, alpha=-0.5), tolerance, message)
+
+                        # Sums and differences only change the diagonal
+                        self._assertClose(d + square, D + square, tolerance, message)
+                        self._assertClose(square + d, square + D, tolerance, message)
+                        self._assertClose(d - square, D - square, tolerance, message)
+                        self._assertClose(square - d, square - D, tolerance, message)
+                        added = square.copy()
+                        added += d
+                        self._assertClose(added, square + D, tolerance, message)
+
+                        # Elementwise products are diagonal
+                        for product, expected in ((d * square, D * square), (square * d, square * D),
+                                                  (d * 2, D * 2), (2 * d, D * 2)):
+                            self.assertIsInstance(product, DiagonalMatrix, message)
+                            self._assertClose(product.toDense(), expected, tolerance, message)
+
+                    # Between two diagonal matrices
+                    d, s = diagonals
+                    D, S = d.toDense(), s.toDense()
+                    for result, expected in ((d @ s, D @ S), (s @ d, S @ D), (d @ d, D @ D), (d + s, D + S),
+                                             (s - d, S - D), (d * s, D * S), (d.dot(s, alpha=2.0), (D @ S) * 2)):
+                        self.assertIsInstance(result, DiagonalMatrix, message)
+                        self._assertClose(result.toDense(), expected, tolerance, message)
+
+                    for result, expected in ((s @ s, S @ S), (s + s, S + S), (s - s, S - S), (s * 2, S * 2)):
+                        self.assertIsInstance(result, ScaledIdentity, message)
+                        self._assertClose(result.toDense(), expected, tolerance, message)
+                    self.assertEqual((s @ s).scale, 6.25)
+
+    def test_construction(self):
+        self.assertEqual(DiagonalMatrix([1.0, 2.0, 3.0]).toList(), [[1, 0, 0], [0, 2, 0], [0, 0, 3]])
+        self.assertEqual(DiagonalMatrix(Matrix(1, 3, data=[[1, 2, 3]])).toList(), [[1, 0, 0], [0, 2, 0], [0, 0, 3]])
+        self.assertEqual(DiagonalMatrix(Matrix(3, 1, data=[[1], [2], [3]])).toList(),
+                         [[1, 0, 0], [0, 2, 0], [0, 0, 3]])
+        self.assertEqual(ScaledIdentity(3, 2.0).diagonal.toList(), [[2.0]] * 3)
+        self.assertEqual(DiagonalMatrix(Matrix(1, 2, dtype="float32")).dtype, "float32")
+
+        # The values are copied
+        values = Matrix(2, 1, data=[[1], [2]])
+        d = DiagonalMatrix(values)
+        values[0, 0] = 5.0
+        self.assertEqual(d.toList(), [[1, 0], [0, 2]])
+
+        with self.assertRaises(ValueError):
+            DiagonalMatrix(Matrix(2, 2))
+        with self.assertRaises(TypeError):
+            DiagonalMatrix([])
+        with self.assertRaises(ValueError):
+            ScaledIdentity(0)
+        with self.assertRaises(TypeError):
+            ScaledIdentity(2.0)
+
+    def test_errors(self):
+        d = DiagonalMatrix([1.0, 2.0])
+
+        for operation in (lambda: d @ Matrix(3, 3), lambda: Matrix(3, 3) @ d, lambda: d + Matrix(2, 3),
+                          lambda: Matrix(3, 2) - d, lambda: d * Matrix(3, 3), lambda: d @ DiagonalMatrix([1.0]),
+                          lambda: d @ Matrix(2, 2, dtype="float32"), lambda: d @ [[1.0], [2.0]]):
+            with self.assertRaises(TypeError):
+                operation()
+
+        with self.assertRaises(NotImplementedError):
+            Matrix(2, 2).dot(d, out=Matrix(2, 2))
+        with self.assertRaises(NotImplementedError):
+            Matrix(2, 2).dot(d, activation=RELU)
+
+
+if __name__ == "__main__":
+    unittest.main()
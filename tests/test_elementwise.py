@@ -0,0 +1,94 @@
+"""
+Elementwise arithmetic, in src/blas/delementwise.h.
+
+a + b, a - b, a * b and a / b, with a matrix or a scalar for b, round each
+value once, so they must give exactly what Python gives value by value. Each
+operand is stored row by row, which takes the AVX loops over the matrix as
+one vector, or column by column, which takes the strided loop. The old
+unrolled loops read the neighbours of each value as if the columns were
+always 1 apart, so every combination of layouts is checked, with widths
+that are not a multiple of the vector length and sizes that are split
+between threads.
+
+Run with: python -m unittest tests.test_elementwise
+"""
+
+import operator
+import random
+import struct
+import unittest
+
+from libpymath.matrix import Matrix
+
+OPERATORS = {"add": operator.add, "sub": operator.sub, "mul": operator.mul, "div": operator.truediv}
+
+# rows, cols. The last ones are split between 3 threads
+SHAPES = ((1, 1), (1, 17), (17, 1), (3, 5), (5, 4), (17, 33), (64, 16), (300, 301), (700, 300))
+
+
+def _float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def _columnMajor(matrix):
+    return Matrix._internal_new(matrix.matrix.columnMajor(), matrix.dtype, matrix.threads)
+
+
+class TestElementwise(unittest.TestCase):
+    def test_layouts(self):
+        rng = random.Random(34)
+
+        for rows, cols in SHAPES:
+            for dtype in ("float64", "float32"):
+                rounded = _float32 if dtype == "float32" else float
+                a = [[rounded(rng.uniform(-5, 5)) for _ in range(cols)] for _ in range(rows)]
+                b = [[rounded(rng.uniform(1, 5)) for _ in range(cols)] for _ in range(rows)]
+                scalar = 1.75
+
+                for threads in (1, 3):
+                    ma = Matrix(rows, cols, data=a, dtype=dtype, threads=threads)
+                    mb = Matrix(rows, cols, data=b, dtype=dtype, threads=threads)
+                    layouts = {"rows": (ma, mb), "columns": (_columnMajor(ma), _columnMajor(mb))}
+
+                    for name, op in OPERATORS.items():
+                        expected = [[rounded(op(x, y)) for x, y in zip(ra, rb)] for ra, rb in zip(a, b)]
+                        expectedScalar = [[rounded(op(x, scalar)) for x in ra] for ra in a]
+
+                        for layoutA, (left, _) in layouts.items():
+                            message = (rows, cols, dtype, threads, name, layoutA)
+                            self.assertEqual(op(left, scalar).toList(), expectedScalar, message)
+
+                            for layoutB, (_, right) in layouts.items():
+                                result = op(left, right)
+                                self.assertEqual(result.shape, (rows, cols), message + (layoutB,))
+                                self.assertEqual(result.dtype, dtype, message + (layoutB,))
+                                self.assertEqual(result.toList(), expected, message + (layoutB,))
+
+                                # The result is an ordinary matrix, whatever the layout of the operands
+                                self.assertEqual(result.copy().toList(), expected, message + (layoutB,))
+
+    def test_special_values(self):
+        inf = float("inf")
+        a = Matrix(1, 6, data=[[1.0, -1.0, 0.0, inf, -0.0, 5e-324]], threads=1)
+        b = Matrix(1, 6, data=[[0.0, 0.0, 0.0, inf, 2.0, 0.5]], threads=1)
+
+        self.assertEqual((a / b).toList()[0][:2], [inf, -inf])
+        self.assertNotEqual((a / b)[0, 2], (a / b)[0, 2])
+        self.assertNotEqual((a - b)[0, 3], (a - b)[0, 3])
+        self.assertEqual(str((a * b)[0, 4]), "-0.0")
+        self.assertEqual((a * b)[0, 5], 0.0)
+
+    def test_errors(self):
+        a = Matrix(3, 4)
+
+        for op in OPERATORS.values():
+            with self.assertRaises(TypeError):
+                op(a, Matrix(4, 3))
+            with self.assertRaises(TypeError):
+                op(a, Matrix(3, 4, dtype="float32"))
+            with self.assertRaises(TypeError):
+                op(a, "2")
+
+
+if __name__ == "__main__":
+    unittest.main()
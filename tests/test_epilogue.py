@@ -0,0 +1,126 @@
+"""
+The bias and activation fused into matrix products, in src/blas/epilogue.h.
+
+a.dot(b, bias=c, activation=f) must give the same result as computing the
+product, adding the bias and mapping the activation in separate passes. The
+bias may be a full matrix, a column added to every column or a row added to
+every row. Every path applies the epilogue its own way, so the products go
+through the vector, small, packed and Strassen paths, with transposed
+operands, on one and four threads, for both dtypes, and through addmm.
+
+Run with: python -m unittest tests.test_epilogue
+"""
+
+import random
+import unittest
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix, addmm, SIGMOID, TANH, RELU, LEAKY_RELU, EXP
+
+ACTIVATIONS = (None, SIGMOID, TANH, RELU, LEAKY_RELU)
+
+# rows, inner, cols of the product
+SHAPES = ((5, 7, 1), (1, 7, 9), (6, 5, 4), (40, 60, 50), (130, 70, 90))
+
+
+def _randomMatrix(rows, cols, dtype, rng, threads=1):
+    return Matrix(rows, cols, data=[[rng.uniform(-2, 2) for _ in range(cols)] for _ in range(rows)], dtype=dtype,
+                  threads=threads)
+
+
+def _unfused(product, bias, activation):
+    result = product if bias is None else product + bias
+    return result if activation is None else result.mapped(activation)
+
+
+class TestEpilogue(unittest.TestCase):
+    def setUp(self):
+        self.crossover = core.gemmCrossover()
+
+    def tearDown(self):
+        core.setGemmCrossover(self.crossover)
+
+    def _assertClose(self, got, expected, tolerance, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def test_products(self):
+        rng = random.Random(14)
+
+        for crossover in (self.crossover, 0):
+            core.setGemmCrossover(crossover)
+
+            for rows, inner, cols in SHAPES:
+                for dtype, threads in (("float64", 1), ("float64", 4), ("float32", 1)):
+                    for transA, transB in ((False, False), (True, True)):
+                        shapeA = (inner, rows) if transA else (rows, inner)
+                        a = _randomMatrix(*shapeA, dtype, rng, threads)
+                        b = _randomMatrix(cols, inner, dtype, rng) if transB else _randomMatrix(inner, cols, dtype, rng)
+                        product = a.dot(b, transA=transA, transB=transB)
+
+                        for biasShape in (None, (rows, cols), (rows, 1), (1, cols)):
+                            bias = None if biasShape is None else _randomMatrix(*biasShape, dtype, rng)
+
+                            for activation in ACTIVATIONS:
+                                got = a.dot(b, transA=transA, transB=transB, bias=bias, activation=activation)
+                                expected = _unfused(product, bias, activation)
+                                message = (crossover, rows, inner, cols, dtype, threads, transA, transB,
+                                           biasShape, activation)
+                                self.assertEqual(got.toList(), expected.toList(), message)
+
+    def test_strassen(self):
+        rng = random.Random(15)
+        cutoff = core.gemmStrassen()
+        core.setGemmStrassen(32, 0)
+
+        try:
+            a = _randomMatrix(130, 100, "float64", rng)
+            b = _randomMatrix(100, 90, "float64", rng)
+            product = a.dot(b, strassen=True)
+
+            for bias in (None, _randomMatrix(130, 1, "float64", rng), _randomMatrix(1, 90, "float64", rng)):
+                for activation in ACTIVATIONS:
+                    got = a.dot(b, bias=bias, activation=activation, strassen=True)
+                    self.assertEqual(got.toList(), _unfused(product, bias, activation).toList(), activation)
+        finally:
+            core.setGemmStrassen(*cutoff)
+
+    def test_addmm(self):
+        rng = random.Random(16)
+
+        for rows, inner, cols in SHAPES:
+            a = _randomMatrix(rows, inner, "float64", rng)
+            b = _randomMatrix(inner, cols, "float64", rng)
+            c = _randomMatrix(rows, cols, "float64", rng)
+
+            for bias in (None, _randomMatrix(rows, 1, "float64", rng)):
+                for activation in ACTIVATIONS:
+                    out = c.copy()
+                    addmm(out, a, b, alpha=0.5, beta=-1.0, bias=bias, activation=activation)
+
+                    accumulated = c.copy()
+                    addmm(accumulated, a, b, alpha=0.5, beta=-1.0)
+                    self._assertClose(out.toList(), _unfused(accumulated, bias, activation).toList(), 1e-15,
+                                      (rows, inner, cols, activation))
+
+    def test_errors(self):
+        a = Matrix(4, 3, threads=1)
+        b = Matrix(3, 5, threads=1)
+
+        for shape in ((4, 4), (5, 5), (3, 1), (1, 4), (2, 2)):
+            with self.assertRaises(ValueError, msg=shape):
+                a.dot(b, bias=Matrix(*shape))
+
+        with self.assertRaises(TypeError):
+            a.dot(b, bias=[[0.0] * 5] * 4)
+        with self.assertRaises(TypeError):
+            a.dot(b, bias=Matrix(4, 5, dtype="float32"))
+        with self.assertRaises(NotImplementedError):
+            a.dot(b, activation=EXP)
+
+
+if __name__ == "__main__":
+    unittest.main()
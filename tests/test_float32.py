@@ -0,0 +1,151 @@
+"""
+float32 matrices: the SGEMM kernels in src/blas/sgemm.h, Matrix.astype and
+the datatype checks.
+
+Each SGEMM kernel the processor supports is forced with LIBPYMATH_GEMM_KERNEL
+in a fresh interpreter, as in tests.test_gemm_kernels, and its products are
+compared with the exact product of the same float32 values. Every element
+must be within the error bound of a float32 dot product of the inner length,
+relative to the sum of the absolute values of its terms.
+
+astype must round to the nearest float32 and convert back exactly, and every
+operation mixing the two datatypes must raise a TypeError.
+
+Run with: python -m unittest tests.test_float32
+"""
+
+import os
+import random
+import struct
+import subprocess
+import sys
+import unittest
+
+import libpymath
+from libpymath.matrix import Matrix, addmm
+
+# Name and MR x NR tile of every kernel in src/blas/sgemm.h
+KERNELS = {"avx512": (32, 8), "avx2": (16, 6), "avx": (8, 8)}
+
+_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(libpymath.__file__)))
+
+_CHILD = r"""
+import random
+import struct
+import sys
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix
+
+mr, nr = int(sys.argv[1]), int(sys.argv[2])
+print(core.sgemmKernel(), flush=True)
+rng = random.Random(2)
+
+# Unit roundoff of float32
+UNIT = 2.0 ** -24
+
+
+def float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+def check(got, a, b, message):
+    inner = len(b)
+
+    for i in range(len(a)):
+        for j in range(len(b[0])):
+            exact = sum(a[i][p] * b[p][j] for p in range(inner))
+            bound = 2 * (inner + 1) * UNIT * sum(abs(a[i][p] * b[p][j]) for p in range(inner))
+            if abs(got[i][j] - exact) > bound:
+                sys.exit("{} [{}, {}]: {} != {}".format(message, i, j, got[i][j], exact))
+
+
+for crossover in (core.gemmCrossover(), 0):
+    core.setGemmCrossover(crossover)
+
+    for rows in (1, mr - 1, mr + 1, 2 * mr + 3):
+        for cols in (1, nr - 1, nr + 1, 3 * nr + 2):
+            for inner in (1, 7, 300):
+                a = [[float32(rng.uniform(-1, 1)) for _ in range(inner)] for _ in range(rows)]
+                b = [[float32(rng.uniform(-1, 1)) for _ in range(cols)] for _ in range(inner)]
+                message = "crossover {} {}x{}x{}".format(crossover, rows, inner, cols)
+
+                for threads in (1, 3):
+                    ma = Matrix(rows, inner, data=a, dtype="float32", threads=threads)
+                    mb = Matrix(inner, cols, data=b, dtype="float32", threads=threads)
+                    result = ma.dot(mb)
+                    if result.dtype != "float32":
+                        sys.exit(message + ": " + result.dtype)
+
+                    check(result.toList(), a, b, message)
+                    check(mb.dot(ma, transA=True, transB=True).toList(), transposed(b), transposed(a),
+                          message + " transposed")
+"""
+
+
+def _float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+class TestFloat32(unittest.TestCase):
+    def test_kernels(self):
+        for name, (mr, nr) in KERNELS.items():
+            with self.subTest(kernel=name):
+                env = dict(os.environ, LIBPYMATH_GEMM_KERNEL=name,
+                           PYTHONPATH=os.pathsep.join(filter(None, (_ROOT, os.environ.get("PYTHONPATH")))))
+                result = subprocess.run([sys.executable, "-c", _CHILD, str(mr), str(nr)], env=env,
+                                        stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+
+                selected = result.stdout.split("\n")[0]
+                if selected != name:
+                    self.skipTest("{} is not supported by this processor".format(name))
+
+                self.assertEqual(result.returncode, 0, result.stderr)
+
+    def test_astype(self):
+        rng = random.Random(24)
+        values = [[rng.uniform(-1e3, 1e3) for _ in range(13)] for _ in range(7)]
+        values[0][:4] = [0.1, -0.0, 1e-40, 3.4e38]
+
+        for threads in (1, 3):
+            a = Matrix(7, 13, data=values, threads=threads)
+            single = a.astype("float32")
+            self.assertEqual(single.dtype, "float32")
+            self.assertEqual(single.toList(), [[_float32(v) for v in row] for row in values])
+
+            double = single.astype("float64")
+            self.assertEqual(double.dtype, "float64")
+            self.assertEqual(double.toList(), single.toList())
+            self.assertEqual(double.astype("float32").toList(), single.toList())
+
+            # A copy, even to the same datatype
+            same = a.astype("float64")
+            same[0, 0] = 5.0
+            self.assertEqual(a[0, 0], 0.1)
+
+            self.assertEqual(a.T.astype("float32").toList(), single.T.toList())
+
+        with self.assertRaises(NotImplementedError):
+            a.astype("int8")
+
+    def test_mixed_dtypes(self):
+        a = Matrix(3, 3, threads=1)
+        a.fillRandom(-1, 1)
+        single = a.astype("float32")
+
+        for x, y in ((a, single), (single, a)):
+            for operation in (lambda: x + y, lambda: x - y, lambda: x * y, lambda: x / y, lambda: x @ y,
+                              lambda: x.dot(y), lambda: x.dot(y, transA=True, transB=True),
+                              lambda: addmm(x.copy(), x, y), lambda: addmm(x.copy(), y, y),
+                              lambda: x.dot(x, bias=y), lambda: x.dot(x, out=y.copy()),
+                              lambda: x.copy().addOuter(Matrix(3, 1, dtype=y.dtype), Matrix(3, 1, dtype=y.dtype))):
+                with self.assertRaises(TypeError):
+                    operation()
+
+
+if __name__ == "__main__":
+    unittest.main()
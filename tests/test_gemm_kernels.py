@@ -0,0 +1,106 @@
+"""
+Every GEMM micro kernel against a reference product.
+
+The kernel is picked once, when the module is imported, so each kernel the
+processor supports is forced with LIBPYMATH_GEMM_KERNEL in a fresh interpreter.
+The small kernels are switched off with setGemmCrossover(0), and the shapes
+leave partial MR x NR tiles at the edges of C, with and without block sizes
+small enough to split the product into several blocks of each kind.
+
+Every matrix is stored row-major, and dgemm_nn computes a row-major C as its
+column-major transpose. Each product is therefore also computed transposed,
+as B^T @ A^T with transA and transB set, which hands the kernel the
+original product with C in column-major order.
+
+Run with: python -m unittest tests.test_gemm_kernels
+"""
+
+import os
+import subprocess
+import sys
+import unittest
+
+import libpymath
+
+# Name and MR x NR tile of every kernel in src/blas/dgemm_kernels.h
+KERNELS = {"avx512": (16, 8), "avx2": (8, 6), "sse2": (4, 4)}
+
+_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(libpymath.__file__)))
+
+_CHILD = r"""
+import random
+import sys
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix
+
+mr, nr = int(sys.argv[1]), int(sys.argv[2])
+print(core.gemmKernel(), flush=True)
+core.setGemmCrossover(0)
+rng = random.Random(1)
+
+
+def product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+def check(got, expected, inner, message):
+    if len(got) != len(expected) or len(got[0]) != len(expected[0]):
+        sys.exit("{}: {}x{} result".format(message, len(got), len(got[0])))
+
+    for i, (row, rowExpected) in enumerate(zip(got, expected)):
+        for j, (g, e) in enumerate(zip(row, rowExpected)):
+            if abs(g - e) > 1e-13 * inner * max(1.0, abs(e)):
+                sys.exit("{} [{}, {}]: {} != {}".format(message, i, j, g, e))
+
+
+for blocking in ((), (2 * mr, 32, 2 * nr)):
+    core.setGemmBlocking(*blocking)
+
+    for rows in (mr - 1, mr + 1, 2 * mr + 3, 5 * mr + 1):
+        for cols in (nr - 1, nr + 1, 3 * nr + 2, 5 * nr + 1):
+            for inner in (1, 7, 70):
+                a = [[rng.uniform(-1, 1) for _ in range(inner)] for _ in range(rows)]
+                b = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(inner)]
+                c = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)]
+                expected = product(a, b)
+                message = "blocking {} {}x{}x{}".format(core.gemmBlocking(), rows, inner, cols)
+
+                ma = Matrix(rows, inner, data=a, threads=1)
+                mb = Matrix(inner, cols, data=b, threads=1)
+                check(ma.dot(mb).toList(), expected, inner, message)
+
+                # C^T = B^T @ A^T
+                check(mb.dot(ma, transA=True, transB=True).toList(), transposed(expected), inner,
+                      message + " transposed")
+
+                # alpha and beta
+                out = Matrix(rows, cols, data=c, threads=1)
+                ma.dot(mb, out=out, alpha=-0.5, beta=2.0)
+                check(out.toList(), [[2 * c[i][j] - 0.5 * expected[i][j] for j in range(cols)] for i in range(rows)],
+                      inner, message + " accumulated")
+"""
+
+
+class TestGemmKernels(unittest.TestCase):
+    def test_kernels(self):
+        for name, (mr, nr) in KERNELS.items():
+            with self.subTest(kernel=name):
+                env = dict(os.environ, LIBPYMATH_GEMM_KERNEL=name,
+                           PYTHONPATH=os.pathsep.join(filter(None, (_ROOT, os.environ.get("PYTHONPATH")))))
+                result = subprocess.run([sys.executable, "-c", _CHILD, str(mr), str(nr)], env=env,
+                                        stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+
+                selected = result.stdout.split("\n")[0]
+                if selected != name:
+                    self.skipTest("{} is not supported by this processor".format(name))
+
+                self.assertEqual(result.returncode, 0, result.stderr)
+
+
+if __name__ == "__main__":
+    unittest.main()
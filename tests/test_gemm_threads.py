@@ -0,0 +1,102 @@
+"""
+The packed GEMM on several threads.
+
+dgemm_nn_ep splits the blocks of C between the threads it is given. With
+block sizes of 16 x 32 x 24 every product below spans several MC and NC
+blocks, with partial blocks at the edges, so each thread count splits it
+differently. The k loop is not split, so every thread count must give exactly
+the result of one thread, which must match a reference product.
+
+A thread count above OMP_THREAD_LIMIT is capped by OpenMP, which the split
+must follow. That is checked in a fresh interpreter, as OpenMP reads the
+limit once.
+
+Run with: python -m unittest tests.test_gemm_threads
+"""
+
+import os
+import random
+import subprocess
+import sys
+import unittest
+
+import libpymath
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix
+
+BLOCKING = (16, 32, 24)
+
+# rows, inner, cols
+SHAPES = ((100, 70, 130), (33, 65, 200), (250, 40, 25))
+
+_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(libpymath.__file__)))
+
+
+def _product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+class TestGemmThreads(unittest.TestCase):
+    def setUp(self):
+        self.blocking = core.gemmBlocking()
+        self.crossover = core.gemmCrossover()
+        core.setGemmBlocking(*BLOCKING)
+        core.setGemmCrossover(0)
+
+    def tearDown(self):
+        core.setGemmBlocking(*self.blocking)
+        core.setGemmCrossover(self.crossover)
+
+    def test_threads(self):
+        rng = random.Random(3)
+
+        for rows, inner, cols in SHAPES:
+            a = [[rng.uniform(-1, 1) for _ in range(inner)] for _ in range(rows)]
+            b = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(inner)]
+            expected = _product(a, b)
+            serial = {}
+
+            for threads in range(1, 9):
+                ma = Matrix(rows, inner, data=a, threads=threads)
+                mb = Matrix(inner, cols, data=b, threads=threads)
+
+                for transposed in (False, True):
+                    if transposed:
+                        # C^T = B^T @ A^T, which splits the other dimensions of C
+                        got = [list(column) for column in zip(*mb.dot(ma, transA=True, transB=True).toList())]
+                    else:
+                        got = ma.dot(mb).toList()
+
+                    if transposed not in serial:
+                        serial[transposed] = got
+                        for row, rowExpected in zip(got, expected):
+                            for g, e in zip(row, rowExpected):
+                                self.assertAlmostEqual(g, e, delta=1e-12 * inner, msg=(rows, inner, cols))
+
+                    self.assertEqual(got, serial[transposed], (rows, inner, cols, threads, transposed))
+
+    def test_thread_limit(self):
+        child = (
+            "import libpymath.core.matrix as core\n"
+            "from libpymath.matrix import Matrix\n"
+            "core.setGemmBlocking({0}, {1}, {2})\n"
+            "core.setGemmCrossover(0)\n"
+            "a = Matrix(150, 90, threads=1)\n"
+            "a.fillRandom(-1, 1)\n"
+            "b = Matrix(90, 170, threads=1)\n"
+            "b.fillRandom(-1, 1)\n"
+            "serial = a.dot(b).toList()\n"
+            "for threads in (3, 8):\n"
+            "    assert Matrix._internal_new(a.matrix, threads=threads).dot(b).toList() == serial, threads\n"
+        ).format(*BLOCKING)
+
+        for limit in (1, 2):
+            env = dict(os.environ, OMP_THREAD_LIMIT=str(limit),
+                       PYTHONPATH=os.pathsep.join(filter(None, (_ROOT, os.environ.get("PYTHONPATH")))))
+            result = subprocess.run([sys.executable, "-c", child], env=env, stdout=subprocess.PIPE,
+                                    stderr=subprocess.PIPE, universal_newlines=True)
+            self.assertEqual(result.returncode, 0, "OMP_THREAD_LIMIT={}: {}".format(limit, result.stderr))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,83 @@
+"""
+Products with a vector, which go to dgemv in src/blas/dgemv.h.
+
+A times a column runs y = A*x, and a row times B runs y = B^T*x. With transA
+and transB the same matrix is read row-major or column-major, so every
+product below goes through both vectorised layouts, and the vector itself is
+read with a unit or a non-unit stride. Each result is compared with a
+reference, and must not change with the number of threads, as the threads
+only split the rows or the blocks of y.
+
+Run with: python -m unittest tests.test_gemv
+"""
+
+import random
+import unittest
+
+from libpymath.matrix import Matrix
+
+# rows, cols of A. The last ones are above the 64K elements per thread
+SHAPES = ((2, 2), (5, 3), (7, 13), (1, 9), (9, 1), (130, 517), (1100, 70), (300, 301))
+
+
+def _product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def _transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+class TestGemv(unittest.TestCase):
+    def _assertClose(self, got, expected, inner, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=1e-13 * inner * max(1.0, abs(e)), msg=message)
+
+    def test_layouts(self):
+        rng = random.Random(8)
+
+        for rows, cols in SHAPES:
+            a = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)]
+            x = [[rng.uniform(-1, 1)] for _ in range(cols)]
+            y = [[rng.uniform(-1, 1)] for _ in range(rows)]
+            at = _transposed(a)
+
+            # name: (left, right, transA, transB, expected, inner)
+            cases = {
+                "A @ x": (a, x, False, False, _product(a, x), cols),
+                "(A^T)^T @ x": (at, x, True, False, _product(a, x), cols),
+                "A^T @ y": (a, y, True, False, _product(at, y), rows),
+                "y^T @ A": (_transposed(y), a, False, False, _product(_transposed(y), a), rows),
+                "y^T @ (A^T)^T": (_transposed(y), at, False, True, _product(_transposed(y), a), rows),
+                "(y)^T @ A": (y, a, True, False, _product(_transposed(y), a), rows),
+                "A @ (x^T)^T": (a, _transposed(x), False, True, _product(a, x), cols),
+            }
+
+            for name, (left, right, transA, transB, expected, inner) in cases.items():
+                serial = None
+
+                for threads in (1, 3):
+                    ml = Matrix(len(left), len(left[0]), data=left, threads=threads)
+                    mr = Matrix(len(right), len(right[0]), data=right, threads=threads)
+                    message = (name, rows, cols, threads)
+
+                    got = ml.dot(mr, transA=transA, transB=transB).toList()
+                    self._assertClose(got, expected, inner, message)
+
+                    if serial is None:
+                        serial = got
+                    self.assertEqual(got, serial, message)
+
+                    # alpha and beta
+                    c = [[rng.uniform(-1, 1) for _ in range(len(expected[0]))] for _ in range(len(expected))]
+                    out = Matrix(len(c), len(c[0]), data=c, threads=threads)
+                    ml.dot(mr, transA=transA, transB=transB, out=out, alpha=-0.5, beta=2.0)
+                    self._assertClose(out.toList(), [[2 * c[i][j] - 0.5 * e for j, e in enumerate(row)]
+                                                     for i, row in enumerate(expected)], inner, message)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,93 @@
+"""
+Gram matrices: Matrix.gram and Matrix.outerGram, in src/blas/dsyrk.h.
+
+a.gram() must match the dense product a.T @ a and a.outerGram() must match
+a @ a.T, for thin, wide and square matrices, on the small and the packed
+paths, on one or several threads and for both dtypes. Only one triangle is
+computed, so the result must be exactly symmetric.
+
+Run with: python -m unittest tests.test_gram
+"""
+
+import random
+import unittest
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix
+
+# rows, cols of the matrix
+SHAPES = ((1, 1), (1, 9), (9, 1), (5, 3), (3, 7), (17, 17), (40, 30), (300, 20), (20, 300), (130, 97))
+
+
+def _product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def _transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+class TestGram(unittest.TestCase):
+    def setUp(self):
+        self.crossover = core.gemmCrossover()
+
+    def tearDown(self):
+        core.setGemmCrossover(self.crossover)
+
+    def _assertClose(self, got, expected, tolerance, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def test_dense(self):
+        rng = random.Random(20)
+
+        for crossover in (self.crossover, 0):
+            core.setGemmCrossover(crossover)
+
+            for rows, cols in SHAPES:
+                a = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)]
+                expectedGram = _product(_transposed(a), a)
+                expectedOuter = _product(a, _transposed(a))
+                serial = None
+
+                for threads in (1, 3):
+                    m = Matrix(rows, cols, data=a, threads=threads)
+                    gram = m.gram().toList()
+                    outer = m.outerGram().toList()
+                    message = (crossover, rows, cols, threads)
+
+                    self._assertClose(gram, expectedGram, 1e-15 * rows, message)
+                    self._assertClose(outer, expectedOuter, 1e-15 * cols, message)
+                    self._assertClose(gram, m.dot(m, transA=True).toList(), 1e-15 * rows, message)
+                    self._assertClose(outer, m.dot(m, transB=True).toList(), 1e-15 * cols, message)
+
+                    self.assertEqual(gram, _transposed(gram), message)
+                    self.assertEqual(outer, _transposed(outer), message)
+
+                    # The Gram matrix of the columns of a.T is that of the rows of a
+                    self._assertClose(m.T.gram().toList(), outer, 1e-15 * cols, message)
+
+                    if serial is None:
+                        serial = (gram, outer)
+                    self.assertEqual((gram, outer), serial, message)
+
+    def test_float32(self):
+        rng = random.Random(21)
+
+        for rows, cols in SHAPES:
+            m = Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)],
+                       dtype="float32", threads=1)
+            gram = m.gram()
+            outer = m.outerGram()
+
+            self.assertEqual(gram.dtype, "float32")
+            self.assertEqual(outer.dtype, "float32")
+            self.assertEqual(gram.toList(), m.dot(m, transA=True).toList(), (rows, cols))
+            self.assertEqual(outer.toList(), m.dot(m, transB=True).toList(), (rows, cols))
+
+
+if __name__ == "__main__":
+    unittest.main()
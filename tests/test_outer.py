@@ -0,0 +1,98 @@
+"""
+The in-place rank-1 update Matrix.addOuter, in src/blas/dger.h.
+
+a.addOuter(x, y, alpha) must give a + alpha * x @ y.T for x and y given as
+rows or columns, on one or several threads, for both dtypes, and for a
+transposed target. It is compared with the same sum computed with a product
+and an addition.
+
+Run with: python -m unittest tests.test_outer
+"""
+
+import random
+import struct
+import unittest
+
+from libpymath.matrix import Matrix
+
+# rows, cols of the target. The last ones are split between threads
+SHAPES = ((1, 1), (2, 3), (7, 5), (17, 33), (300, 250))
+
+
+def _float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+class TestOuter(unittest.TestCase):
+    def _assertClose(self, got, expected, tolerance, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def _vectors(self, rows, cols, dtype, rng):
+        x = [rng.uniform(-1, 1) for _ in range(rows)]
+        y = [rng.uniform(-1, 1) for _ in range(cols)]
+        if dtype == "float32":
+            x = [_float32(value) for value in x]
+            y = [_float32(value) for value in y]
+
+        return x, y
+
+    def test_vectors(self):
+        rng = random.Random(9)
+
+        for rows, cols in SHAPES:
+            for dtype, tolerance in (("float64", 1e-15), ("float32", 1e-6)):
+                for threads in (1, 3):
+                    a = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)]
+                    x, y = self._vectors(rows, cols, dtype, rng)
+                    column = Matrix(rows, 1, data=[[v] for v in x], dtype=dtype, threads=threads)
+                    row = Matrix(1, cols, data=[y], dtype=dtype, threads=threads)
+
+                    for xLayout in ("row", "column"):
+                        for yLayout in ("row", "column"):
+                            mx = column if xLayout == "column" else Matrix(1, rows, data=[x], dtype=dtype)
+                            my = row if yLayout == "row" else Matrix(cols, 1, data=[[v] for v in y], dtype=dtype)
+
+                            for alpha in (1.0, -0.5):
+                                target = Matrix(rows, cols, data=a, dtype=dtype, threads=threads)
+                                expected = target + column.dot(row) * alpha
+
+                                target.addOuter(mx, my, alpha)
+                                message = (rows, cols, dtype, threads, xLayout, yLayout, alpha)
+                                self._assertClose(target.toList(), expected.toList(), tolerance, message)
+
+    def test_transposed_target(self):
+        rng = random.Random(10)
+
+        for rows, cols in SHAPES:
+            a = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)]
+            x, y = self._vectors(rows, cols, "float64", rng)
+            mx = Matrix(rows, 1, data=[[v] for v in x], threads=1)
+            my = Matrix(1, cols, data=[y], threads=1)
+
+            # (a + x @ y.T).T = a.T + y @ x.T, with y given as a row
+            target = Matrix(rows, cols, data=a, threads=1).T
+            target.addOuter(my, mx, 2.0)
+            expected = [[a[i][j] + 2.0 * x[i] * y[j] for i in range(rows)] for j in range(cols)]
+            self._assertClose(target.toList(), expected, 1e-15, (rows, cols))
+
+    def test_errors(self):
+        a = Matrix(3, 4, threads=1)
+
+        with self.assertRaises(ValueError):
+            a.addOuter(Matrix(3, 2), Matrix(4, 1))
+        with self.assertRaises(ValueError):
+            a.addOuter(Matrix(4, 1), Matrix(4, 1))
+        with self.assertRaises(ValueError):
+            a.addOuter(Matrix(3, 1), Matrix(1, 3))
+        with self.assertRaises(TypeError):
+            a.addOuter([1, 2, 3], Matrix(4, 1))
+        with self.assertRaises(TypeError):
+            a.addOuter(Matrix(3, 1, dtype="float32"), Matrix(4, 1))
+
+
+if __name__ == "__main__":
+    unittest.main()
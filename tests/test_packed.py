@@ -0,0 +1,174 @@
+"""
+Packed symmetric and triangular matrices: PackedMatrix and the products in
+src/blas/dpackmm.h.
+
+Every operator must give what it gives on the dense matrix holding the same
+values: products with a Matrix on either side, with transposed operands,
+alpha, a bias and an activation, sums and differences with a Matrix in both
+orders, and elementwise operations with another packed matrix or a scalar.
+This is checked for every kind, for sizes around the blocks of the product
+and on one or several threads.
+
+Run with: python -m unittest tests.test_packed
+"""
+
+import pickle
+import random
+import unittest
+
+from libpymath.matrix import Matrix, PackedMatrix, RELU
+
+KINDS = ("symmetric", "lower", "upper")
+
+# n of the packed matrix
+SIZES = (1, 2, 5, 63, 64, 65, 130)
+
+
+def _randomMatrix(rows, cols, rng, threads=1):
+    return Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)], threads=threads)
+
+
+def _structured(n, kind, rng, threads=1):
+    # A dense matrix with the structure of a packed matrix of the given kind
+    a = [[rng.uniform(-1, 1) for _ in range(n)] for _ in range(n)]
+
+    for i in range(n):
+        for j in range(n):
+            if kind == "symmetric" and j > i:
+                a[i][j] = a[j][i]
+            elif (kind == "lower" and j > i) or (kind == "upper" and j < i):
+                a[i][j] = 0.0
+
+    return Matrix(n, n, data=a, threads=threads)
+
+
+class TestPacked(unittest.TestCase):
+    def _assertClose(self, got, expected, tolerance, message):
+        got = got.toList()
+        expected = expected.toList()
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def test_products(self):
+        rng = random.Random(30)
+
+        for n in SIZES:
+            for kind in KINDS:
+                for threads in (1, 3):
+                    dense = _structured(n, kind, rng, threads)
+                    packed = PackedMatrix(dense, kind=kind)
+                    message = (n, kind, threads)
+                    tolerance = 1e-15 * n
+
+                    self.assertEqual(packed.shape, (n, n), message)
+                    self.assertEqual(packed.kind, kind, message)
+                    self.assertEqual(packed.threads, threads, message)
+                    self.assertEqual(packed.toList(), dense.toList(), message)
+                    self.assertEqual(packed.T.toList(), dense.T.toList(), message)
+
+                    for k in (1, 3, 17):
+                        b = _randomMatrix(n, k, rng, threads)
+                        c = _randomMatrix(k, n, rng, threads)
+                        bias = _randomMatrix(n, 1, rng)
+
+                        # Packed on the left
+                        self._assertClose(packed @ b, dense @ b, tolerance, message)
+                        self._assertClose(packed.dot(c, transB=True), dense.dot(c, transB=True), tolerance, message)
+                        self._assertClose(packed.dot(b, alpha=2.0), dense.dot(b, alpha=2.0), tolerance, message)
+                        self._assertClose(packed.dot(b, alpha=-0.5, bias=bias, activation=RELU),
+                                          dense.dot(b, alpha=-0.5, bias=bias, activation=RELU), tolerance, message)
+
+                        # Packed on the right
+                        self._assertClose(c @ packed, c @ dense, tolerance, message)
+                        self._assertClose(b.dot(packed, transA=True), b.dot(dense, transA=True), tolerance, message)
+                        self._assertClose(c.dot(packed, transB=True), c.dot(dense, transB=True), tolerance, message)
+                        self._assertClose(c.dot(packed, alpha=3.0, bias=bias.T, activation=RELU),
+                                          c.dot(dense, alpha=3.0, bias=bias.T, activation=RELU), tolerance, message)
+
+    def test_elementwise(self):
+        rng = random.Random(31)
+
+        for n in SIZES:
+            for kind in KINDS:
+                dense = _structured(n, kind, rng)
+                packed = PackedMatrix(dense, kind=kind)
+                other = _structured(n, kind, rng)
+                otherPacked = PackedMatrix(other, kind=kind)
+                square = _randomMatrix(n, n, rng)
+                message = (n, kind)
+
+                # With a dense matrix, in both orders
+                for result, expected in ((packed + square, dense + square), (square + packed, square + dense),
+                                         (packed - square, dense - square), (square - packed, square - dense)):
+                    self.assertIsInstance(result, Matrix, message)
+                    self._assertClose(result, expected, 1e-15, message)
+
+                # With another packed matrix or a scalar, which stays packed
+                results = [(packed + otherPacked, dense + other), (packed - otherPacked, dense - other),
+                           (packed * otherPacked, dense * other), (packed * 3, dense * 3), (2 * packed, dense * 2),
+                           (packed / 4, dense / 4)]
+                if kind == "symmetric":
+                    results += [(packed + 1, dense + 1), (packed - 1, dense - 1), (1 + packed, dense + 1)]
+
+                for result, expected in results:
+                    self.assertIsInstance(result, PackedMatrix, message)
+                    self.assertEqual(result.kind, kind, message)
+                    self._assertClose(result.toDense(), expected, 1e-15, message)
+
+                if kind != "symmetric":
+                    # A scalar would fill the empty triangle
+                    with self.assertRaises(ValueError, msg=message):
+                        packed + 1
+
+                copy = pickle.loads(pickle.dumps(packed))
+                self.assertEqual(copy.kind, kind, message)
+                self.assertEqual(copy.toList(), dense.toList(), message)
+
+    def test_construction(self):
+        self.assertEqual(PackedMatrix(2, [1, 2, 3]).toList(), [[1, 2], [2, 3]])
+        self.assertEqual(PackedMatrix(2, [1, 2, 3], kind="lower").toList(), [[1, 0], [2, 3]])
+        self.assertEqual(PackedMatrix(2, [1, 2, 3], kind="upper").toList(), [[1, 2], [0, 3]])
+
+        # Only the triangle of the kind is read
+        a = Matrix(2, 2, data=[[1, 5], [2, 3]])
+        self.assertEqual(PackedMatrix(a).toList(), [[1, 2], [2, 3]])
+        self.assertEqual(PackedMatrix(a, kind="upper").toList(), [[1, 5], [0, 3]])
+
+        with self.assertRaises(ValueError):
+            PackedMatrix(Matrix(3, 4))
+        with self.assertRaises(ValueError):
+            PackedMatrix(3, [1.0, 2.0])
+        with self.assertRaises(ValueError):
+            PackedMatrix(Matrix(2, 2), kind="diagonal")
+        with self.assertRaises(TypeError):
+            PackedMatrix(Matrix(2, 2, dtype="float32"))
+
+    def test_errors(self):
+        packed = PackedMatrix(2, [1, 2, 3])
+        square = Matrix(2, 2)
+
+        # Matrix leaves elementwise operators with a PackedMatrix to it, which does not multiply dense matrices
+        for method in ("__add__", "__sub__", "__mul__"):
+            self.assertIs(getattr(square, method)(packed), NotImplemented, method)
+
+        for operation in (lambda: square * packed, lambda: packed * square, lambda: packed / square,
+                          lambda: packed @ Matrix(3, 3), lambda: Matrix(3, 3) @ packed,
+                          lambda: packed + PackedMatrix(3, [1] * 6),
+                          lambda: packed + PackedMatrix(2, [1] * 3, kind="lower"), lambda: packed @ [[1.0], [2.0]]):
+            with self.assertRaises(TypeError):
+                operation()
+
+        with self.assertRaises(ValueError):
+            packed + Matrix(3, 3)
+        with self.assertRaises(ValueError):
+            Matrix(2, 3) - packed
+
+        with self.assertRaises(NotImplementedError):
+            square.dot(packed, out=Matrix(2, 2))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,141 @@
+"""
+Matrices kept in the packed layout of the product kernel by Matrix.prepack.
+
+A product with a prepacked matrix on the left must be exactly the product
+with an ordinary copy of it, on the vector, small and packed paths, with a
+bias and an activation, and on several threads. Any in-place change drops
+the packed copy, and the next product must use the new values. Panels made
+for other block sizes are not used, so products stay correct after the
+blocking changes.
+
+Run with: python -m unittest tests.test_prepack
+"""
+
+import random
+import unittest
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix, addmm, RELU, SIGMOID
+
+# rows, inner, cols of the product
+SHAPES = ((1, 9, 7), (9, 7, 1), (3, 4, 5), (33, 65, 17), (130, 70, 90), (257, 300, 40))
+
+
+def _randomMatrix(rows, cols, rng, threads=1):
+    return Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)], threads=threads)
+
+
+class TestPrepack(unittest.TestCase):
+    def setUp(self):
+        self.crossover = core.gemmCrossover()
+
+    def tearDown(self):
+        core.setGemmCrossover(self.crossover)
+        core.setGemmBlocking()
+
+    def test_products(self):
+        rng = random.Random(17)
+
+        for crossover in (self.crossover, 0):
+            core.setGemmCrossover(crossover)
+
+            for rows, inner, cols in SHAPES:
+                for threads in (1, 3):
+                    a = _randomMatrix(rows, inner, rng, threads)
+                    b = _randomMatrix(inner, cols, rng, threads)
+                    bT = b.T
+                    bias = _randomMatrix(rows, 1, rng)
+                    plain = a.copy()
+                    message = (crossover, rows, inner, cols, threads)
+
+                    a.prepack()
+                    self.assertTrue(a.prepacked, message)
+                    self.assertFalse(plain.prepacked, message)
+
+                    self.assertEqual(a.dot(b).toList(), plain.dot(b).toList(), message)
+                    self.assertEqual((a @ b).toList(), plain.dot(b).toList(), message)
+                    self.assertEqual(a.dot(bT, transB=True).toList(), plain.dot(bT, transB=True).toList(), message)
+                    self.assertEqual(a.dot(b, alpha=-0.5, bias=bias, activation=SIGMOID).toList(),
+                                     plain.dot(b, alpha=-0.5, bias=bias, activation=SIGMOID).toList(), message)
+
+                    # The panels only stand in for the matrix as stored
+                    c = _randomMatrix(rows, cols, rng)
+                    self.assertEqual(a.dot(c, transA=True).toList(), plain.dot(c, transA=True).toList(), message)
+
+                    # Products leave the packed copy in place
+                    self.assertTrue(a.prepacked, message)
+
+    def test_invalidation(self):
+        rng = random.Random(18)
+        core.setGemmCrossover(0)
+
+        def setValue(m):
+            m[3, 4] = 2.5
+
+        def reshape(m):
+            m.reshape(m.cols, m.rows)
+
+        def accumulate(m):
+            addmm(m, _randomMatrix(m.rows, 6, rng), _randomMatrix(6, m.cols, rng))
+
+        def addOuter(m):
+            m.addOuter(_randomMatrix(m.rows, 1, rng), _randomMatrix(1, m.cols, rng), 0.5)
+
+        mutators = {
+            "set": setValue,
+            "fillScalar": lambda m: m.fillScalar(3.0),
+            "fillAscending": lambda m: m.fillAscending(),
+            "fillDescending": lambda m: m.fillDescending(),
+            "fillRandom": lambda m: m.fillRandom(-2, 2),
+            "map": lambda m: m.map(RELU),
+            "reshape": reshape,
+            "addmm": accumulate,
+            "addOuter": addOuter,
+        }
+
+        for name, mutate in mutators.items():
+            a = _randomMatrix(40, 50, rng)
+            a.prepack()
+
+            mutate(a)
+            self.assertFalse(a.prepacked, name)
+
+            b = _randomMatrix(a.cols, 30, rng)
+            fresh = Matrix(a.rows, a.cols, data=a.toList(), threads=1)
+            self.assertEqual(a.dot(b).toList(), fresh.dot(b).toList(), name)
+
+            # And it can be packed again
+            a.prepack()
+            self.assertTrue(a.prepacked, name)
+            self.assertEqual(a.dot(b).toList(), fresh.dot(b).toList(), name)
+
+    def test_blocking_change(self):
+        rng = random.Random(19)
+        core.setGemmCrossover(0)
+
+        a = _randomMatrix(130, 300, rng)
+        b = _randomMatrix(300, 70, rng)
+        plain = a.copy()
+        a.prepack()
+
+        for blocking in ((16, 32, 24), (96, 256, 64), ()):
+            core.setGemmBlocking(*blocking)
+            self.assertEqual(a.dot(b).toList(), plain.dot(b).toList(), blocking)
+
+        # Packed again under other block sizes
+        core.setGemmBlocking(16, 32, 24)
+        a.prepack()
+        self.assertEqual(a.dot(b).toList(), plain.dot(b).toList())
+        core.setGemmBlocking()
+        self.assertEqual(a.dot(b).toList(), plain.dot(b).toList())
+
+    def test_errors(self):
+        a = Matrix(3, 4, dtype="float32")
+
+        with self.assertRaises(TypeError):
+            a.prepack()
+        self.assertFalse(a.prepacked)
+
+
+if __name__ == "__main__":
+    unittest.main()
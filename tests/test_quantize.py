@@ -0,0 +1,192 @@
+"""
+Products with int8 weights: Matrix.quantize, the qgemm kernels in
+src/blas/qgemm.h and Network.quantize.
+
+Each qgemm kernel the processor supports is forced with LIBPYMATH_GEMM_KERNEL
+in a fresh interpreter, as in tests.test_gemm_kernels. A row of A and a column
+of B are each rounded to 255 levels of their largest absolute value, so every
+element of a quantized product must be within inner * max|a_i| * max|b_j| / 127
+of the exact product, and values that are already on those levels must give
+the exact result. The int8 copy must be dropped when the matrix changes, and
+Network.quantize must report the errors and losses of the two paths.
+
+Run with: python -m unittest tests.test_quantize
+"""
+
+import os
+import random
+import subprocess
+import sys
+import unittest
+
+import libpymath
+from libpymath.matrix import Matrix
+from libpymath.network import Network, SIGMOID, TANH
+
+# Every kernel in src/blas/qgemm.h
+KERNELS = ("avx512vnni", "avx512", "avx2", "avx")
+
+_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(libpymath.__file__)))
+
+_CHILD = r"""
+import random
+import sys
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix, SIGMOID
+
+print(core.qgemmKernel(), flush=True)
+rng = random.Random(3)
+
+
+def product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+def check(got, a, b, alpha, message):
+    exact = product(a, b)
+    inner = len(b)
+    columnMax = [max(abs(v) for v in column) for column in zip(*b)]
+
+    for i, row in enumerate(a):
+        rowMax = max(abs(v) for v in row)
+        for j in range(len(b[0])):
+            # Rounding both operands, plus the float scales
+            bound = abs(alpha) * inner * rowMax * columnMax[j] * (1 / 127 + 1 / 64516 + 1e-6)
+            if abs(got[i][j] - alpha * exact[i][j]) > bound:
+                sys.exit("{} [{}, {}]: {} != {}".format(message, i, j, got[i][j], alpha * exact[i][j]))
+
+
+for rows, inner, cols in ((1, 1, 1), (3, 63, 1), (1, 65, 7), (5, 64, 9), (7, 200, 3), (130, 129, 70)):
+    a = [[rng.uniform(-1, 1) for _ in range(inner)] for _ in range(rows)]
+    b = [[rng.uniform(-3, 3) for _ in range(cols)] for _ in range(inner)]
+    message = "{}x{}x{}".format(rows, inner, cols)
+
+    for threads in (1, 3):
+        ma = Matrix(rows, inner, data=a, threads=threads)
+        mb = Matrix(inner, cols, data=b, threads=threads)
+        ma.quantize()
+        if not ma.quantized:
+            sys.exit(message + ": not quantized")
+
+        check(ma.dot(mb).toList(), a, b, 1.0, message)
+        check(ma.dot(mb, alpha=-0.5).toList(), a, b, -0.5, message + " alpha")
+        check(ma.dot(Matrix(cols, inner, data=transposed(b)), transB=True).toList(), a, b, 1.0,
+              message + " transposed")
+
+        # The epilogue is applied to the scaled result
+        bias = Matrix(rows, 1, data=[[rng.uniform(-1, 1)] for _ in range(rows)])
+        ma.dequantize()
+        expected = ma.dot(mb, bias=bias, activation=SIGMOID).toList()
+        ma.quantize()
+        got = ma.dot(mb, bias=bias, activation=SIGMOID).toList()
+        for i in range(rows):
+            for j in range(cols):
+                # The sigmoid has a slope of at most 1/4
+                if abs(got[i][j] - expected[i][j]) > inner * 3 / 127 / 4 + 1e-12:
+                    sys.exit("{} epilogue [{}, {}]: {} != {}".format(message, i, j, got[i][j], expected[i][j]))
+
+# Values already on the int8 levels of their row and column are exact
+a = [[127.0, -5, 3, 2, 0], [1, 2, 127, 4, -127], [-127, 0, 0, 1, 64]]
+b = [[127.0, 1], [2, 127], [-3, 4], [5, -127], [-127, 0]]
+ma = Matrix(3, 5, data=a)
+ma.quantize()
+if ma.dot(Matrix(5, 2, data=b)).toList() != product(a, b):
+    sys.exit("not exact")
+"""
+
+
+class TestQuantize(unittest.TestCase):
+    def test_kernels(self):
+        for name in KERNELS:
+            with self.subTest(kernel=name):
+                env = dict(os.environ, LIBPYMATH_GEMM_KERNEL=name,
+                           PYTHONPATH=os.pathsep.join(filter(None, (_ROOT, os.environ.get("PYTHONPATH")))))
+                result = subprocess.run([sys.executable, "-c", _CHILD], env=env,
+                                        stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+
+                selected = result.stdout.split("\n")[0]
+                if selected != name:
+                    self.skipTest("{} is not supported by this processor".format(name))
+
+                self.assertEqual(result.returncode, 0, result.stderr)
+
+    def test_invalidation(self):
+        rng = random.Random(25)
+        a = Matrix(20, 30, data=[[rng.uniform(-1, 1) for _ in range(30)] for _ in range(20)], threads=1)
+        b = Matrix(30, 4, data=[[rng.uniform(-1, 1) for _ in range(4)] for _ in range(30)], threads=1)
+        exact = a.dot(b).toList()
+
+        a.quantize()
+        quantized = a.dot(b).toList()
+        self.assertNotEqual(quantized, exact)
+
+        # A transposed left operand does not use the int8 copy
+        c = Matrix(20, 3, threads=1)
+        c.fillRandom(-1, 1)
+        plain = a.copy()
+        self.assertFalse(plain.quantized)
+        self.assertEqual(a.dot(c, transA=True).toList(), plain.dot(c, transA=True).toList())
+
+        a[0, 0] = a[0, 0]
+        self.assertFalse(a.quantized)
+        self.assertEqual(a.dot(b).toList(), exact)
+
+        a.quantize()
+        self.assertEqual(a.dot(b).toList(), quantized)
+        a.fillScalar(0.5)
+        self.assertFalse(a.quantized)
+        self.assertEqual(a.dot(b).toList(), Matrix(20, 30, data=[[0.5] * 30] * 20).dot(b).toList())
+
+        a.quantize()
+        a.dequantize()
+        self.assertFalse(a.quantized)
+
+        with self.assertRaises(TypeError):
+            Matrix(2, 2, dtype="float32").quantize()
+
+    def test_network(self):
+        random.seed(26)
+        data = [[0, 0, 0], [0, 1, 1], [1, 0, 1], [1, 1, 0]]
+        inputs = [d[:2] for d in data]
+        targets = [d[2:] for d in data]
+
+        network = Network(layers=(2, 8, 1), lr=0.3, activations=[TANH, SIGMOID])
+        for _ in range(2000):
+            d = random.choice(data)
+            network.backpropagate(d[:2], d[2:])
+
+        outputs = [network.feedForward(x)[0, 0] for x in inputs]
+        report = network.quantize(inputs, targets)
+        self.assertTrue(network.quantized)
+        quantizedOutputs = [network.feedForward(x)[0, 0] for x in inputs]
+
+        errors = [abs(x - y) for x, y in zip(outputs, quantizedOutputs)]
+        self.assertEqual(set(report), {"maxError", "meanError", "loss", "quantizedLoss"})
+        self.assertEqual(report["maxError"], max(errors))
+        self.assertAlmostEqual(report["meanError"], sum(errors) / len(errors), delta=1e-15)
+        self.assertAlmostEqual(report["loss"], sum((x - t[0]) ** 2 for x, t in zip(outputs, targets)) / 4,
+                               delta=1e-15)
+        self.assertAlmostEqual(report["quantizedLoss"],
+                               sum((x - t[0]) ** 2 for x, t in zip(quantizedOutputs, targets)) / 4, delta=1e-15)
+        self.assertLess(report["maxError"], 0.05)
+
+        # Without targets only the errors are returned, and without inputs nothing
+        self.assertEqual(set(network.quantize(inputs)), {"maxError", "meanError"})
+        self.assertIsNone(network.quantize())
+        self.assertTrue(network.quantized)
+
+        # Training returns every layer to float64
+        network.backpropagate(data[0][:2], data[0][2:])
+        self.assertFalse(network.quantized)
+        network.quantize()
+        network.dequantize()
+        self.assertFalse(network.quantized)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,103 @@
+"""
+NaN handling of the reductions.
+
+min, max, argmin and argmax follow NumPy: the result is NaN, or the index of
+the first NaN, wherever a NaN is among the values. Every layout is checked, so
+that the vectorised, strided and chunked paths in src/matrix/reduceRoutines.h
+all agree, for both dtypes and for the whole-matrix reductions built on them.
+
+Run with: python -m unittest tests.test_reduce
+"""
+
+import math
+import random
+import struct
+import unittest
+
+from libpymath.matrix import Matrix
+
+ROWS = 37
+COLS = 300
+
+
+def _float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def _reference(values, op):
+    # NumPy's rule: the first NaN wins, and otherwise the first extreme value
+    for i, value in enumerate(values):
+        if math.isnan(value):
+            return math.nan if op in ("min", "max") else i
+
+    best = min(values) if op in ("min", "argmin") else max(values)
+    return best if op in ("min", "max") else values.index(best)
+
+
+class TestReduceNaN(unittest.TestCase):
+    def setUp(self):
+        rng = random.Random(4)
+        self.data = [[rng.uniform(-1, 1) for _ in range(COLS)] for _ in range(ROWS)]
+
+        # NaN in the first element (the seed of every reduction), in the middle
+        # of a row, twice in one column, and as the last element
+        for row, col in ((0, 0), (5, 123), (20, 7), (30, 7), (ROWS - 1, COLS - 1)):
+            self.data[row][col] = math.nan
+
+    def _check(self, got, expected, message):
+        if isinstance(expected, float) and math.isnan(expected):
+            self.assertTrue(math.isnan(got), message)
+        else:
+            self.assertEqual(got, expected, message)
+
+    def _matrices(self):
+        for dtype in ("float64", "float32"):
+            # Row-major, and the transpose of the transposed data, which reads
+            # the same values through the other strides
+            yield dtype, "rows", Matrix(ROWS, COLS, data=self.data, dtype=dtype, threads=1)
+            transposed = [list(column) for column in zip(*self.data)]
+            yield dtype, "transposed", Matrix(COLS, ROWS, data=transposed, dtype=dtype, threads=1).T
+
+    def test_axis(self):
+        for dtype, layout, mat in self._matrices():
+            rows = self.data if dtype == "float64" else [[_float32(value) for value in row] for row in self.data]
+            columns = [list(column) for column in zip(*rows)]
+
+            for op in ("min", "max", "argmin", "argmax"):
+                along0 = getattr(mat, op)(axis=0).toList()
+                along1 = getattr(mat, op)(axis=1).toList()
+
+                for j in range(COLS):
+                    self._check(along0[0][j], _reference(columns[j], op), (dtype, layout, op, 0, j))
+                for i in range(ROWS):
+                    self._check(along1[i][0], _reference(rows[i], op), (dtype, layout, op, 1, i))
+
+    def test_whole(self):
+        for dtype, layout, mat in self._matrices():
+            self.assertTrue(math.isnan(mat.min()), (dtype, layout))
+            self.assertTrue(math.isnan(mat.max()), (dtype, layout))
+            self.assertEqual(mat.argmin(), (0, 0), (dtype, layout))
+            self.assertEqual(mat.argmax(), (0, 0), (dtype, layout))
+
+    def test_whole_later_nan(self):
+        self.data[0][0] = 2.0
+
+        for dtype, layout, mat in self._matrices():
+            self.assertTrue(math.isnan(mat.min()), (dtype, layout))
+            self.assertEqual(mat.argmin(), (5, 123), (dtype, layout))
+            self.assertEqual(mat.argmax(), (5, 123), (dtype, layout))
+
+    def test_no_nan(self):
+        flat = [value for row in self.data for value in row if not math.isnan(value)]
+        for row in self.data:
+            for j, value in enumerate(row):
+                if math.isnan(value):
+                    row[j] = 0.5
+
+        mat = Matrix(ROWS, COLS, data=self.data, threads=1)
+        self.assertEqual(mat.min(), min(flat))
+        self.assertEqual(mat.max(), max(flat))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,120 @@
+"""
+The register-blocked kernels for small products in src/blas/dgemm_small.h.
+
+Every product is computed twice, below the crossover by the small kernels and
+with setGemmCrossover(0) by the packed GEMM, and both are compared with a
+reference product. The shapes reach each of the small kernels: the unrolled
+2, 3 and 4 kernels, the 8, 16 and 32 kernels with k fixed at compile time,
+the masked edges of the 4 x 8 tiles, and the scalar tiles for a transposed B,
+whose rows are not unit stride.
+
+measureGemmCrossover times both paths for a while, and must let other Python
+threads run in the meantime.
+
+Run with: python -m unittest tests.test_small_gemm
+"""
+
+import random
+import threading
+import unittest
+from time import perf_counter
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix
+
+# rows, inner, cols
+SQUARE = [(s, s, s) for s in (2, 3, 4, 8, 16, 32)]
+EDGES = [(5, 7, 9), (13, 3, 11), (4, 8, 9), (9, 6, 17), (2, 1, 3), (31, 31, 31), (17, 40, 2)]
+
+LARGE = 10 ** 9
+
+
+def _product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def _transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+class TestSmallGemm(unittest.TestCase):
+    def setUp(self):
+        self.crossover = core.gemmCrossover()
+
+    def tearDown(self):
+        core.setGemmCrossover(self.crossover)
+
+    def _assertClose(self, got, expected, inner, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=1e-13 * inner * max(1.0, abs(e)), msg=message)
+
+    def _check(self, shapes, transA, transB):
+        rng = random.Random(7)
+
+        for rows, inner, cols in shapes:
+            a = [[rng.uniform(-1, 1) for _ in range(inner)] for _ in range(rows)]
+            b = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(inner)]
+            c = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)]
+            expected = _product(a, b)
+            accumulated = [[2 * c[i][j] - 0.5 * expected[i][j] for j in range(cols)] for i in range(rows)]
+
+            storedA = _transposed(a) if transA else a
+            storedB = _transposed(b) if transB else b
+            ma = Matrix(len(storedA), len(storedA[0]), data=storedA, threads=1)
+            mb = Matrix(len(storedB), len(storedB[0]), data=storedB, threads=1)
+
+            results = {}
+            for crossover in (LARGE, 0):
+                core.setGemmCrossover(crossover)
+                message = (crossover, rows, inner, cols, transA, transB)
+
+                results[crossover] = ma.dot(mb, transA=transA, transB=transB).toList()
+                self._assertClose(results[crossover], expected, inner, message)
+
+                out = Matrix(rows, cols, data=c, threads=1)
+                ma.dot(mb, transA=transA, transB=transB, out=out, alpha=-0.5, beta=2.0)
+                self._assertClose(out.toList(), accumulated, inner, message)
+
+            self._assertClose(results[LARGE], results[0], inner, (rows, inner, cols, transA, transB))
+
+    def test_square(self):
+        self._check(SQUARE, False, False)
+
+    def test_edges(self):
+        self._check(EDGES, False, False)
+
+    def test_strided(self):
+        for transA, transB in ((True, False), (False, True), (True, True)):
+            self._check(SQUARE + EDGES, transA, transB)
+
+    def test_measure_releases_gil(self):
+        done = threading.Event()
+        result = []
+
+        def measure():
+            result.append(core.measureGemmCrossover())
+            done.set()
+
+        worker = threading.Thread(target=measure)
+        start = last = perf_counter()
+        longest = 0.0
+        worker.start()
+
+        # Without the GIL released the loop would stall for the whole measurement
+        while not done.is_set():
+            now = perf_counter()
+            longest = max(longest, now - last)
+            last = now
+
+        worker.join()
+        total = perf_counter() - start
+
+        self.assertGreater(result[0], 0)
+        self.assertLess(longest, total / 2, "the loop stalled for {:.3f} of {:.3f} s".format(longest, total))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,132 @@
+"""
+Sparse matrices in CSR format: SparseMatrix and the products in
+src/blas/dcsrmm.h.
+
+Every sparse product must match the same product with the dense matrix
+holding the same values: sparse times a column (SpMV), sparse times a
+matrix (SpMM) and a dense matrix times a sparse one, with transposed
+operands, alpha, a bias and an activation, on one or several threads. The
+CSR arrays are validated on creation, and transposing and pickling must
+keep every stored value.
+
+Run with: python -m unittest tests.test_sparse
+"""
+
+import pickle
+import random
+import unittest
+
+from libpymath.matrix import Matrix, SparseMatrix, RELU
+
+# rows, cols of the sparse matrix, the columns of the dense operand and the density
+SHAPES = ((1, 1, 1, 1.0), (5, 7, 1, 0.3), (40, 30, 9, 0.1), (64, 80, 33, 0.05), (3, 100, 2, 0.0), (200, 150, 70, 0.02),
+          (1, 60, 5, 0.5), (60, 1, 1, 0.5))
+
+
+def _randomMatrix(rows, cols, rng, density=1.0, threads=1):
+    return Matrix(rows, cols, data=[[rng.uniform(-1, 1) if rng.random() < density else 0.0 for _ in range(cols)]
+                                    for _ in range(rows)], threads=threads)
+
+
+class TestSparse(unittest.TestCase):
+    def _assertClose(self, got, expected, tolerance, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def test_products(self):
+        rng = random.Random(27)
+
+        for rows, cols, other, density in SHAPES:
+            for threads in (1, 4):
+                dense = _randomMatrix(rows, cols, rng, density, threads)
+                sparse = SparseMatrix(dense)
+                message = (rows, cols, other, density, threads)
+                tolerance = 1e-15 * max(rows, cols)
+
+                self.assertEqual(sparse.threads, threads, message)
+                self.assertEqual(sparse.shape, (rows, cols), message)
+                self.assertEqual(sparse.nnz, sum(v != 0 for row in dense.toList() for v in row), message)
+                self.assertEqual(sparse.toList(), dense.toList(), message)
+
+                # Sparse on the left, with a column (SpMV) and a matrix (SpMM)
+                for width in (1, other):
+                    b = _randomMatrix(cols, width, rng, threads=threads)
+                    bT = b.T
+                    bias = _randomMatrix(rows, 1, rng)
+
+                    self._assertClose(sparse.dot(b).toList(), dense.dot(b).toList(), tolerance, message)
+                    self._assertClose((sparse @ b).toList(), dense.dot(b).toList(), tolerance, message)
+                    self._assertClose(sparse.dot(bT, transB=True).toList(), dense.dot(b).toList(), tolerance, message)
+                    self._assertClose(sparse.dot(b, alpha=0.5, bias=bias, activation=RELU).toList(),
+                                      dense.dot(b, alpha=0.5, bias=bias, activation=RELU).toList(), tolerance,
+                                      message)
+
+                # Dense on the left
+                left = _randomMatrix(other, rows, rng, threads=threads)
+                leftT = left.T
+                right = _randomMatrix(other, cols, rng, threads=threads)
+                bias = _randomMatrix(1, cols, rng)
+
+                self._assertClose(left.dot(sparse).toList(), left.dot(dense).toList(), tolerance, message)
+                self._assertClose((left @ sparse).toList(), left.dot(dense).toList(), tolerance, message)
+                self._assertClose(leftT.dot(sparse, transA=True).toList(), left.dot(dense).toList(), tolerance,
+                                  message)
+                self._assertClose(right.dot(sparse, transB=True).toList(), right.dot(dense, transB=True).toList(),
+                                  tolerance, message)
+                self._assertClose(left.dot(sparse, alpha=-2.0, bias=bias, activation=RELU).toList(),
+                                  left.dot(dense, alpha=-2.0, bias=bias, activation=RELU).toList(), tolerance,
+                                  message)
+
+    def test_transpose_and_pickle(self):
+        rng = random.Random(28)
+
+        for rows, cols, _, density in SHAPES:
+            dense = _randomMatrix(rows, cols, rng, density)
+            sparse = SparseMatrix(dense)
+
+            self.assertEqual(sparse.T.toList(), dense.T.toList())
+            self.assertEqual(sparse.T.nnz, sparse.nnz)
+            self.assertEqual(sparse.T.T.toLists(), sparse.toLists())
+
+            copy = pickle.loads(pickle.dumps(sparse))
+            self.assertEqual(copy.shape, sparse.shape)
+            self.assertEqual(copy.toLists(), sparse.toLists())
+
+    def test_csr(self):
+        sparse = SparseMatrix(2, 3, [1.0, 2.0, 3.0], [0, 2, 1], [0, 2, 3])
+        self.assertEqual(sparse.toList(), [[1.0, 0.0, 2.0], [0.0, 3.0, 0.0]])
+        self.assertEqual(sparse.toLists(), ([1.0, 2.0, 3.0], [0, 2, 1], [0, 2, 3]))
+        self.assertEqual(SparseMatrix(2, 3, [], [], [0, 0, 0]).toList(), [[0.0] * 3] * 2)
+
+        invalid = (
+            (2, 3, [1.0], [0], [0, 2, 3]),  # Row pointers past the values
+            (2, 3, [1.0, 2.0], [2, 1], [0, 2, 2]),  # Columns falling along a row
+            (2, 3, [1.0, 2.0], [1, 1], [0, 2, 2]),  # A column stored twice
+            (2, 3, [1.0], [3], [0, 1, 1]),  # Column out of range
+            (2, 3, [1.0], [-1], [0, 1, 1]),
+            (2, 3, [1.0], [0], [0, 1]),  # Too few row pointers
+            (2, 3, [1.0], [0], [1, 1, 1]),  # Not starting from 0
+            (2, 3, [1.0, 2.0], [0, 1], [0, 2, 1]),  # Falling row pointers
+            (2, 3, [1.0, 2.0], [0], [0, 1, 2]),  # Fewer columns than values
+        )
+        for args in invalid:
+            with self.assertRaises(ValueError, msg=args):
+                SparseMatrix(*args)
+
+        with self.assertRaises(TypeError):
+            sparse.dot(Matrix(2, 2))
+        with self.assertRaises(TypeError):
+            sparse.dot([[1.0], [2.0], [3.0]])
+        with self.assertRaises(TypeError):
+            Matrix(3, 3).dot(sparse)
+        with self.assertRaises(TypeError):
+            SparseMatrix(Matrix(2, 2, dtype="float32"))
+        with self.assertRaises(NotImplementedError):
+            Matrix(4, 2).dot(sparse, out=Matrix(4, 3))
+
+
+if __name__ == "__main__":
+    unittest.main()
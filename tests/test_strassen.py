@@ -0,0 +1,103 @@
+"""
+The Strassen-Winograd recursion for large products, in src/blas/dgemm_strassen.h.
+
+With a small cutoff set by setGemmStrassen, products of odd and uneven sizes
+recurse several times and have to peel the odd row, column and inner index
+at every level. Forced with strassen=True, or chosen by size above the
+automatic threshold, they must stay within the error bound of the
+recursion of the classical product, with transposed operands, alpha, beta,
+a bias and an activation, on one or several threads.
+
+Run with: python -m unittest tests.test_strassen
+"""
+
+import random
+import unittest
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix, addmm, RELU
+
+# rows, inner, cols of the product
+SHAPES = ((33, 35, 37), (64, 64, 64), (50, 17, 90), (100, 101, 99), (130, 66, 67), (127, 129, 31))
+
+CUTOFF = 16
+
+
+def _randomMatrix(rows, cols, rng, threads=1):
+    return Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)], threads=threads)
+
+
+class TestStrassen(unittest.TestCase):
+    def setUp(self):
+        self.strassen = core.gemmStrassen()
+
+    def tearDown(self):
+        core.setGemmStrassen(*self.strassen)
+
+    def _assertClose(self, got, expected, tolerance, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                # The error of the recursion is bounded relative to max|a| * max|b|, which is at most 1 here
+                self.assertAlmostEqual(g, e, delta=tolerance, msg=message)
+
+    def test_forced(self):
+        rng = random.Random(22)
+        core.setGemmStrassen(CUTOFF, 0)
+
+        for rows, inner, cols in SHAPES:
+            for transA in (False, True):
+                for transB in (False, True):
+                    for threads in (1, 3):
+                        shapeA = (inner, rows) if transA else (rows, inner)
+                        a = _randomMatrix(*shapeA, rng, threads)
+                        b = _randomMatrix(cols, inner, rng) if transB else _randomMatrix(inner, cols, rng)
+                        kwargs = {"transA": transA, "transB": transB}
+                        message = (rows, inner, cols, transA, transB, threads)
+
+                        classical = a.dot(b, strassen=False, **kwargs).toList()
+                        got = a.dot(b, strassen=True, **kwargs).toList()
+                        self._assertClose(got, classical, 1e-13 * inner, message)
+                        if min(rows, inner, cols) >= 2 * CUTOFF:
+                            # The recursion did run, so the rounding differs somewhere
+                            self.assertNotEqual(got, classical, message)
+
+                        bias = _randomMatrix(1, cols, rng)
+                        got = a.dot(b, alpha=0.5, bias=bias, activation=RELU, strassen=True, **kwargs).toList()
+                        classical = a.dot(b, alpha=0.5, bias=bias, activation=RELU, strassen=False, **kwargs).toList()
+                        self._assertClose(got, classical, 1e-13 * inner, message)
+
+    def test_automatic(self):
+        rng = random.Random(23)
+        core.setGemmStrassen(CUTOFF, 40)
+
+        a = _randomMatrix(90, 70, rng)
+        b = _randomMatrix(70, 80, rng)
+        self.assertEqual(a.dot(b).toList(), a.dot(b, strassen=True).toList())
+        self.assertNotEqual(a.dot(b).toList(), a.dot(b, strassen=False).toList())
+
+        # Below the automatic size in one dimension
+        small = _randomMatrix(70, 39, rng)
+        self.assertEqual(a.dot(small).toList(), a.dot(small, strassen=False).toList())
+
+        # Accumulated with beta through addmm
+        c = _randomMatrix(90, 80, rng)
+        expected = a.dot(b, strassen=False) * 0.5 + c * 2.0
+        addmm(c, a, b, 0.5, 2.0)
+        self._assertClose(c.toList(), expected.toList(), 1e-13 * 70, "addmm")
+
+        # And never with an automatic size of 0
+        core.setGemmStrassen(CUTOFF, 0)
+        self.assertEqual(a.dot(b).toList(), a.dot(b, strassen=False).toList())
+
+    def test_errors(self):
+        with self.assertRaises(ValueError):
+            core.setGemmStrassen(CUTOFF - 1, 0)
+        with self.assertRaises(ValueError):
+            core.setGemmStrassen(CUTOFF, -1)
+        self.assertEqual(core.gemmStrassen(), self.strassen)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,112 @@
+"""
+Whole-matrix sums and means, in src/blas/dsum.h.
+
+Every mode must stay within its error bound of the exact sum, for a matrix
+stored row by row, which is summed as one vector, and for the same values
+stored column by column, which are summed along the direction with the
+smaller stride. The matrices are large enough to be split between up to four
+threads. Each thread sums its own part and the parts are added in a fixed
+order, so repeating a sum on the same number of threads must give exactly
+the same result.
+
+Run with: python -m unittest tests.test_sum
+"""
+
+import math
+import random
+import unittest
+
+from libpymath.matrix import Matrix
+
+MODES = ("fast", "pairwise", "kahan")
+
+# rows, cols. The last ones have enough values for 3 and 4 threads
+SHAPES = ((1, 1), (1, 7), (7, 1), (3, 5), (17, 33), (300, 301), (300, 700), (1000, 263))
+
+# Unit roundoff of float64
+UNIT = 2.0 ** -53
+
+
+def _columnMajor(matrix):
+    return Matrix._internal_new(matrix.matrix.columnMajor(), matrix.dtype, matrix.threads)
+
+
+def _bound(mode, count, threads):
+    # Error bound relative to the sum of the absolute values, with the partial sums of the threads added at the end
+    if mode == "fast":
+        terms = count
+    elif mode == "pairwise":
+        terms = 128 + 2 * math.log2(count)
+    else:
+        terms = 4
+
+    return (terms + threads) * UNIT
+
+
+class TestSum(unittest.TestCase):
+    def test_modes(self):
+        rng = random.Random(32)
+
+        for rows, cols in SHAPES:
+            data = [[rng.uniform(-1, 1) * 10 ** rng.randint(-5, 5) for _ in range(cols)] for _ in range(rows)]
+            exact = math.fsum(v for row in data for v in row)
+            scale = math.fsum(abs(v) for row in data for v in row)
+            count = rows * cols
+
+            for threads in (1, 3, 4):
+                matrix = Matrix(rows, cols, data=data, threads=threads)
+                transposed = _columnMajor(matrix)
+                self.assertEqual(transposed.toList(), data)
+
+                for mode in MODES:
+                    tolerance = _bound(mode, count, threads) * scale
+
+                    for layout, m in (("rows", matrix), ("columns", transposed)):
+                        message = (rows, cols, threads, mode, layout)
+                        total = m.sum(mode=mode)
+                        self.assertAlmostEqual(total, exact, delta=tolerance, msg=message)
+                        self.assertAlmostEqual(m.mean(mode=mode), exact / count, delta=tolerance / count,
+                                               msg=message)
+
+                        # Nothing is shared between the threads, so the result never changes
+                        for _ in range(3):
+                            self.assertEqual(m.sum(mode=mode), total, message)
+
+    def test_float32(self):
+        rng = random.Random(33)
+
+        for rows, cols in SHAPES:
+            matrix = Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)],
+                            dtype="float32")
+            values = [v for row in matrix.toList() for v in row]
+            exact = math.fsum(values)
+            scale = math.fsum(abs(v) for v in values)
+
+            for threads in (1, 4):
+                matrix = Matrix(rows, cols, data=matrix.toList(), dtype="float32", threads=threads)
+
+                for m in (matrix, _columnMajor(matrix)):
+                    # Accumulated in double precision, whatever the mode
+                    for mode in MODES:
+                        self.assertAlmostEqual(m.sum(mode=mode), exact, delta=(rows * cols + threads) * UNIT * scale,
+                                               msg=(rows, cols, threads, mode))
+
+    def test_ill_conditioned(self):
+        matrix = Matrix(1000, 1000, threads=1)
+        matrix.fillScalar(0.1)
+        exact = 0.1 * 1000 * 1000
+
+        errors = {mode: abs(matrix.sum(mode=mode) - exact) for mode in MODES}
+        self.assertLessEqual(errors["kahan"], errors["pairwise"])
+        self.assertLessEqual(errors["pairwise"], errors["fast"])
+        self.assertLessEqual(errors["kahan"], UNIT * exact)
+
+    def test_errors(self):
+        with self.assertRaises(ValueError):
+            Matrix(2, 2).sum(mode="exact")
+        with self.assertRaises(ValueError):
+            Matrix(2, 2).mean(mode="exact")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,147 @@
+"""
+Stress test for the matrix kernels that release the GIL.
+
+Several Python threads run products, elementwise operations and maps on the
+same shared operands at once, and every result is compared with a reference
+computed serially beforehand. The operands are large enough for the kernels
+to release the GIL (see LPM_GIL_THRESHOLD in src/internal.h), so the threads
+really do run the kernels concurrently.
+
+Run with: python -m unittest tests.test_threads
+"""
+
+import random
+import threading
+import unittest
+
+from libpymath.matrix import Matrix, SIGMOID, TANH, RELU
+
+THREADS = 8
+ITERATIONS = 20
+SIZE = 160
+
+
+def _randomMatrix(rows, cols, seed):
+    rng = random.Random(seed)
+    return Matrix(rows, cols, data=[[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(rows)], threads=1)
+
+
+class TestThreads(unittest.TestCase):
+    def setUp(self):
+        self.a = _randomMatrix(SIZE, SIZE, 1)
+        self.b = _randomMatrix(SIZE, SIZE, 2)
+        self.column = _randomMatrix(SIZE, 1, 3)
+
+        # Every operation only reads the shared operands, so the results must
+        # not depend on what the other threads are doing
+        self.operations = {
+            "dot": lambda: self.a.dot(self.b),
+            "dotTransposed": lambda: self.a.dot(self.b, transA=True),
+            "add": lambda: self.a + self.b,
+            "sub": lambda: self.a - self.b,
+            "mul": lambda: self.a * self.b,
+            "div": lambda: self.a / (self.b + 2.0),
+            "scalar": lambda: self.a * 3.0 - 1.0,
+            "broadcast": lambda: self.a + self.column,
+            "sigmoid": lambda: self.a.mapped(SIGMOID),
+            "tanh": lambda: self.a.mapped(TANH, accuracy="fast"),
+            "relu": lambda: self.b.mapped(RELU),
+            "transpose": lambda: self.a.T,
+            "sum": lambda: self.a.sum(),
+            "sumAxis": lambda: self.a.sum(axis=0)
+        }
+
+        self.reference = {name: self._value(op()) for name, op in self.operations.items()}
+
+    @staticmethod
+    def _value(result):
+        return result.toList() if isinstance(result, Matrix) else result
+
+    def _worker(self, index, barrier, failures):
+        names = sorted(self.operations)
+        rng = random.Random(index)
+
+        try:
+            barrier.wait()
+
+            for _ in range(ITERATIONS):
+                name = rng.choice(names)
+                result = self._value(self.operations[name]())
+
+                if result != self.reference[name]:
+                    failures.append("{} gave a different result on thread {}".format(name, index))
+        except Exception as e:
+            failures.append("thread {} raised {!r}".format(index, e))
+
+    def test_shared_operands(self):
+        barrier = threading.Barrier(THREADS)
+        failures = []
+        workers = [threading.Thread(target=self._worker, args=(i, barrier, failures)) for i in range(THREADS)]
+
+        for worker in workers:
+            worker.start()
+        for worker in workers:
+            worker.join()
+
+        self.assertEqual(failures, [])
+
+    def test_in_place_maps(self):
+        # Each thread maps its own copy in place, while all of them read the same source
+        barrier = threading.Barrier(THREADS)
+        failures = []
+        expected = self.a.mapped(SIGMOID).toList()
+
+        def worker(index):
+            try:
+                barrier.wait()
+
+                for _ in range(ITERATIONS):
+                    copy = self.a.copy()
+                    copy.map(SIGMOID)
+
+                    if copy.toList() != expected:
+                        failures.append("map gave a different result on thread {}".format(index))
+            except Exception as e:
+                failures.append("thread {} raised {!r}".format(index, e))
+
+        workers = [threading.Thread(target=worker, args=(i,)) for i in range(THREADS)]
+
+        for w in workers:
+            w.start()
+        for w in workers:
+            w.join()
+
+        self.assertEqual(failures, [])
+
+    def test_fill_random(self):
+        # fillRandom keeps the GIL, as rand() has one global state, but must
+        # still give every thread values in its own range
+        barrier = threading.Barrier(THREADS)
+        failures = []
+
+        def worker(index):
+            try:
+                mat = Matrix(SIZE, SIZE, threads=1)
+                barrier.wait()
+
+                for _ in range(ITERATIONS):
+                    mat.fillRandom(index, index + 1)
+                    values = [value for row in mat.toList() for value in row]
+
+                    if not all(index <= value <= index + 1 for value in values):
+                        failures.append("fillRandom left its range on thread {}".format(index))
+            except Exception as e:
+                failures.append("thread {} raised {!r}".format(index, e))
+
+        workers = [threading.Thread(target=worker, args=(i,)) for i in range(THREADS)]
+
+        for w in workers:
+            w.start()
+        for w in workers:
+            w.join()
+
+        self.assertEqual(failures, [])
+
+
+if __name__ == "__main__":
+    unittest.main()
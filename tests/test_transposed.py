@@ -0,0 +1,95 @@
+"""
+Products of transposed operands.
+
+Matrix.dot(transA=True) and dot(transB=True) hand the kernels the operand with
+its strides swapped instead of a transposed copy. Every kernel reads them that
+way: the vector kernels for a single row or column, the small kernels and the
+packed GEMM, for both dtypes. Each combination of flags is compared with the
+product of the transposed copies from .T and with a reference product.
+
+Run with: python -m unittest tests.test_transposed
+"""
+
+import random
+import struct
+import unittest
+
+import libpymath.core.matrix as core
+from libpymath.matrix import Matrix
+
+# rows, inner, cols of the product, covering the matrix-vector, vector-matrix,
+# small and packed paths
+SHAPES = ((1, 9, 7), (9, 7, 1), (1, 1, 1), (3, 4, 5), (8, 8, 8), (17, 5, 23), (70, 33, 81), (130, 66, 40))
+
+
+def _float32(value):
+    return struct.unpack("f", struct.pack("f", value))[0]
+
+
+def _product(a, b):
+    return [[sum(a[i][p] * b[p][j] for p in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def _transposed(a):
+    return [list(column) for column in zip(*a)]
+
+
+class TestTransposed(unittest.TestCase):
+    def setUp(self):
+        self.crossover = core.gemmCrossover()
+
+    def tearDown(self):
+        core.setGemmCrossover(self.crossover)
+
+    def _assertClose(self, got, expected, tolerance, message):
+        self.assertEqual((len(got), len(got[0])), (len(expected), len(expected[0])), message)
+
+        for row, rowExpected in zip(got, expected):
+            for g, e in zip(row, rowExpected):
+                self.assertAlmostEqual(g, e, delta=tolerance * max(1.0, abs(e)), msg=message)
+
+    def test_flags(self):
+        rng = random.Random(5)
+
+        # Small kernels up to the measured crossover, and the packed GEMM for everything
+        for crossover in (self.crossover, 0):
+            core.setGemmCrossover(crossover)
+
+            for rows, inner, cols in SHAPES:
+                for dtype, tolerance in (("float64", 1e-12), ("float32", 1e-5)):
+                    a = [[rng.uniform(-1, 1) for _ in range(inner)] for _ in range(rows)]
+                    b = [[rng.uniform(-1, 1) for _ in range(cols)] for _ in range(inner)]
+                    if dtype == "float32":
+                        a = [[_float32(value) for value in row] for row in a]
+                        b = [[_float32(value) for value in row] for row in b]
+                    expected = _product(a, b)
+
+                    for transA in (False, True):
+                        for transB in (False, True):
+                            # Store the operands so that the flags undo the transpose
+                            storedA = _transposed(a) if transA else a
+                            storedB = _transposed(b) if transB else b
+                            ma = Matrix(len(storedA), len(storedA[0]), data=storedA, dtype=dtype, threads=1)
+                            mb = Matrix(len(storedB), len(storedB[0]), data=storedB, dtype=dtype, threads=1)
+                            message = (crossover, rows, inner, cols, dtype, transA, transB)
+
+                            got = ma.dot(mb, transA=transA, transB=transB).toList()
+                            self._assertClose(got, expected, tolerance * inner, message)
+
+                            copied = (ma.T if transA else ma).dot(mb.T if transB else mb).toList()
+                            self._assertClose(got, copied, tolerance * inner, message)
+
+    def test_shapes(self):
+        a = Matrix(3, 4, threads=1)
+
+        a.dot(Matrix(3, 4, threads=1), transB=True)
+        a.dot(Matrix(3, 5, threads=1), transA=True)
+
+        for other, transA, transB in ((Matrix(3, 4), False, False), (Matrix(4, 3), False, True),
+                                      (Matrix(4, 5), True, False)):
+            with self.assertRaises(TypeError):
+                a.dot(other, transA=transA, transB=transB)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,172 @@
+"""
+Accuracy of the vectorised exp, tanh and sigmoid in src/blas/dvmath.h.
+
+The results are compared in units in the last place (ULP) with exp(x),
+tanh(x) and 1 / (1 + exp(-x)) evaluated to 50 digits with the decimal
+module, which is exact where math.exp and math.tanh are only within about one
+ULP themselves, and does not overflow for 1 / (1 + exp(-x)) at large negative
+x. The special values are checked against math.exp and math.tanh directly.
+
+accuracy="full" must be within 1 ULP for exp and 2 ULP for tanh and sigmoid,
+and within 1 float32 ULP for "float32" matrices. accuracy="fast" rounds x to
+float32 for tanh and sigmoid and must be within 2 float32 ULP of the result
+for the rounded x, while its exp keeps doubles with a relative error below
+1e-8. Below the smallest normal number the ULP is that of the subnormals.
+
+Run with: python -m unittest tests.test_vmath
+"""
+
+import decimal
+import math
+import random
+import struct
+import unittest
+
+from libpymath.matrix import Matrix, SIGMOID, TANH, EXP
+
+# Clamps of dvmath.h
+EXP_HI = 710.0
+EXP_LO = -746.0
+TANH_HI = 20.0
+
+_DECIMAL = decimal.Context(prec=50, Emin=-999999, Emax=999999)
+
+# Mantissa bits and smallest normal exponent of each dtype
+_FORMATS = {"float64": (52, -1022), "float32": (23, -126)}
+
+
+def _float32(value):
+    try:
+        return struct.unpack("f", struct.pack("f", value))[0]
+    except OverflowError:
+        return math.copysign(math.inf, value)
+
+
+def _exact(fn, x):
+    x = decimal.Decimal(x)
+
+    if fn == EXP:
+        return _DECIMAL.exp(x)
+    elif fn == SIGMOID:
+        return _DECIMAL.divide(1, 1 + _DECIMAL.exp(-x))
+
+    # The series avoids the cancellation in exp(2x) - 1 for tiny x
+    if abs(x) < decimal.Decimal("1e-6"):
+        return x - x ** 3 / 3 + 2 * x ** 5 / 15
+    if abs(x) > 400:
+        return decimal.Decimal(1).copy_sign(x)
+    e = _DECIMAL.exp(2 * x)
+    return _DECIMAL.divide(e - 1, e + 1)
+
+
+def _ulps(got, exact, dtype):
+    bits, emin = _FORMATS[dtype]
+    exponent = emin
+
+    if abs(exact) >= _DECIMAL.power(2, emin):
+        # float(exact) may round up to the next power of 2
+        exponent = math.frexp(float(abs(exact)))[1] - 1
+        if _DECIMAL.power(2, exponent) > abs(exact):
+            exponent -= 1
+
+    return float(abs(decimal.Decimal(got) - exact) / _DECIMAL.power(2, exponent - bits))
+
+
+def _mapped(values, fn, accuracy, dtype):
+    return Matrix(1, len(values), data=[values], dtype=dtype, threads=1).mapped(fn, accuracy=accuracy).toList()[0]
+
+
+class TestVmath(unittest.TestCase):
+    def setUp(self):
+        rng = random.Random(6)
+
+        # Uniform over the whole range of each function, including the results
+        # that are subnormal, and small magnitudes down to 1e-300
+        ranges = {EXP: (EXP_LO, EXP_HI - 1), TANH: (-TANH_HI - 1, TANH_HI + 1), SIGMOID: (EXP_LO, 40)}
+        self.inputs = {}
+        for fn, (lo, hi) in ranges.items():
+            self.inputs[fn] = ([rng.uniform(lo, hi) for _ in range(3000)] +
+                               [rng.uniform(-746, -700) for _ in range(1000) if fn != TANH] +
+                               [rng.choice((-1, 1)) * 10 ** rng.uniform(-300, 0) for _ in range(1000)])
+
+        # The float32 range of exp
+        self.inputs32 = dict(self.inputs)
+        self.inputs32[EXP] = [x for x in self.inputs[EXP] if x < 88.7]
+
+    def _check(self, fn, accuracy, dtype, bound):
+        values = self.inputs[fn] if dtype == "float64" else [_float32(x) for x in self.inputs32[fn]]
+
+        for x, got in zip(values, _mapped(values, fn, accuracy, dtype)):
+            self.assertLessEqual(_ulps(got, _exact(fn, x), dtype), bound, (fn, accuracy, dtype, x, got))
+
+    def test_full(self):
+        self._check(EXP, "full", "float64", 1.0)
+        self._check(TANH, "full", "float64", 2.0)
+        self._check(SIGMOID, "full", "float64", 2.0)
+
+        for fn in (EXP, TANH, SIGMOID):
+            self._check(fn, "full", "float32", 1.0)
+
+    def test_fast(self):
+        for fn in (TANH, SIGMOID):
+            self._check(fn, "fast", "float32", 2.0)
+
+            # float64 values are rounded to float32 first
+            values = self.inputs[fn]
+            for x, got in zip(values, _mapped(values, fn, "fast", "float64")):
+                self.assertLessEqual(_ulps(got, _exact(fn, _float32(x)), "float32"), 2.0, (fn, x, got))
+
+        values = self.inputs[EXP]
+        for x, got in zip(values, _mapped(values, EXP, "fast", "float64")):
+            exact = _exact(EXP, x)
+            self.assertLessEqual(abs(decimal.Decimal(got) - exact), exact * decimal.Decimal("1e-8") +
+                                 decimal.Decimal(2) ** -1074, (x, got))
+
+        self._check(EXP, "fast", "float32", 1.0)
+
+    def test_sigmoid_subnormal(self):
+        # 1 / (1 + exp(-x)) gave 1 / inf = 0 from x = -709.78 on, and from
+        # x = -88.7 on in float32
+        self.assertEqual(_mapped([-709.80], SIGMOID, "full", "float64")[0], 5.467348342354227e-309)
+
+        for accuracy in ("full", "fast"):
+            got = _mapped([-100.0], SIGMOID, accuracy, "float32")[0]
+            self.assertLessEqual(_ulps(got, _exact(SIGMOID, -100.0), "float32"), 2.0, accuracy)
+
+    def test_special(self):
+        def mathExp(x):
+            try:
+                return math.exp(x)
+            except OverflowError:
+                return math.inf
+
+        def mathSigmoid(x):
+            return mathExp(x) / (1 + mathExp(x)) if x < 0 else 1 / (1 + mathExp(-x))
+
+        cases = {
+            EXP: (mathExp, (math.inf, -math.inf, EXP_HI, -EXP_HI, EXP_LO, 709.78, -745.13, 0.0, -0.0)),
+            TANH: (math.tanh, (math.inf, -math.inf, TANH_HI, -TANH_HI, 19.1, -19.1, 5e-324, -5e-324, 0.0, -0.0)),
+            SIGMOID: (mathSigmoid, (math.inf, -math.inf, EXP_HI, -EXP_HI, EXP_LO, -EXP_LO, 0.0, -0.0)),
+        }
+
+        for fn, (reference, values) in cases.items():
+            for accuracy in ("full", "fast"):
+                for dtype in ("float64", "float32"):
+                    got = _mapped([math.nan] + list(values), fn, accuracy, dtype)
+                    self.assertTrue(math.isnan(got[0]), (fn, accuracy, dtype))
+
+                    for x, g in zip(values, got[1:]):
+                        if dtype == "float32" or (accuracy == "fast" and fn != EXP):
+                            expected = _float32(reference(_float32(x)))
+                        else:
+                            expected = reference(x)
+
+                        if expected == 0 or math.isinf(expected) or abs(expected) == 1:
+                            self.assertEqual(g, expected, (fn, accuracy, dtype, x))
+                            self.assertEqual(math.copysign(1, g), math.copysign(1, expected), (fn, accuracy, dtype, x))
+                        else:
+                            self.assertAlmostEqual(g / expected, 1.0, delta=1e-6, msg=(fn, accuracy, dtype, x))
+
+
+if __name__ == "__main__":
+    unittest.main()